@@ -0,0 +1,268 @@
+#include <string.h>
+#include "acquisition.h"
+#include "config_store.h"
+
+/**
+ * @brief Layout version of the stored configuration
+ */
+#define CONFIG_VERSION 1
+
+/**
+ * @brief Sample rates of a level
+ */
+typedef struct
+{
+    ccs811_drive_mode drive_mode;    /**< CCS811 drive mode */
+    uint32_t interval;               /**< Measurement interval in ms */
+} acquisition_level_rates;
+
+/**
+ * @brief Sample rates of every level, the CCS811 never runs slower than the measurements
+ */
+static const acquisition_level_rates level_rates[ACQUISITION_LEVEL_COUNT] = {
+    [ACQUISITION_LEVEL_FAST]   = { CCS811_DRIVE_1SEC,  5000 },
+    [ACQUISITION_LEVEL_NORMAL] = { CCS811_DRIVE_10SEC, 20000 },
+    [ACQUISITION_LEVEL_SLOW]   = { CCS811_DRIVE_60SEC, 60000 }
+};
+
+/**
+ * @brief Acquisition controller state
+ */
+static acquisition acquisition_dev;
+
+/* Acquisition private functions */
+static void update_rates(const int32_t values[PUBLISH_CHANNEL_COUNT], uint32_t tick);
+static acquisition_level select_level(void);
+
+void acquisition_init(ccs811_device *device)
+{
+    memset(&acquisition_dev, 0, sizeof(acquisition_dev));
+
+    acquisition_config *config = &acquisition_dev.configuration;
+    config->rate[PUBLISH_CHANNEL_TEMPERATURE] = ACQUISITION_DEFAULT_TEMPERATURE_RATE;
+    config->rate[PUBLISH_CHANNEL_HUMIDITY] = ACQUISITION_DEFAULT_HUMIDITY_RATE;
+    config->rate[PUBLISH_CHANNEL_PRESSURE] = ACQUISITION_DEFAULT_PRESSURE_RATE;
+    config->rate[PUBLISH_CHANNEL_TVOC] = ACQUISITION_DEFAULT_TVOC_RATE;
+    config->rate[PUBLISH_CHANNEL_ECO2] = ACQUISITION_DEFAULT_ECO2_RATE;
+    config->fastest = ACQUISITION_LEVEL_FAST;
+    config->slowest = ACQUISITION_LEVEL_SLOW;
+    config->stable_samples = ACQUISITION_DEFAULT_STABLE_SAMPLES;
+
+    acquisition_dev.device = device;
+    acquisition_dev.level = ACQUISITION_LEVEL_FAST;
+    acquisition_dev.drive_mode = level_rates[ACQUISITION_LEVEL_FAST].drive_mode;
+
+    /* Drive mode written by the driver initialization */
+    if (device != NULL)
+    {
+        device->drive_mode = acquisition_dev.drive_mode;
+    }
+
+    acquisition_config stored;
+
+    if (config_store_read(CONFIG_KEY_ACQUISITION, CONFIG_VERSION, &stored, sizeof(stored)))
+    {
+        acquisition_set_configuration(&stored);
+    }
+}
+
+bool acquisition_set_configuration(const acquisition_config *config)
+{
+    if (config == NULL)
+        return false;
+
+    if (config->fastest > config->slowest || config->slowest >= ACQUISITION_LEVEL_COUNT
+        || config->stable_samples == 0)
+    {
+        return false;
+    }
+
+    /* Used right away, even if it can not be saved */
+    acquisition_dev.configuration = *config;
+    acquisition_dev.stable_count = 0;
+
+    return config_store_write(CONFIG_KEY_ACQUISITION, CONFIG_VERSION,
+            &acquisition_dev.configuration, sizeof(acquisition_dev.configuration));
+}
+
+void acquisition_get_configuration(acquisition_config *config)
+{
+    if (config == NULL)
+        return;
+
+    *config = acquisition_dev.configuration;
+}
+
+bool acquisition_update(const bme280_measurements *environmental_data,
+        const ccs811_measurements *air_quality)
+{
+    if (environmental_data == NULL || air_quality == NULL)
+        return false;
+
+    int32_t values[PUBLISH_CHANNEL_COUNT];
+
+    /* Same units as the telemetry samples */
+    values[PUBLISH_CHANNEL_TEMPERATURE] = environmental_data->temperature;
+    values[PUBLISH_CHANNEL_HUMIDITY] = (int32_t)((environmental_data->humidity + 5) / 10);
+    values[PUBLISH_CHANNEL_PRESSURE] = (int32_t)environmental_data->pressure;
+    values[PUBLISH_CHANNEL_TVOC] = air_quality->tvoc;
+    values[PUBLISH_CHANNEL_ECO2] = air_quality->eco2;
+
+    update_rates(values, HAL_GetTick());
+    acquisition_dev.statistics.samples[acquisition_dev.level]++;
+
+    acquisition_level level = select_level();
+
+    if (level == acquisition_dev.level)
+        return false;
+
+    if (level < acquisition_dev.level)
+    {
+        acquisition_dev.statistics.speedups++;
+    }
+    else
+    {
+        acquisition_dev.statistics.slowdowns++;
+    }
+
+    acquisition_dev.level = level;
+    acquisition_handler();
+
+    return true;
+}
+
+void acquisition_handler(void)
+{
+    ccs811_device *device = acquisition_dev.device;
+    ccs811_drive_mode target = level_rates[acquisition_dev.level].drive_mode;
+    ccs811_drive_mode mode = target;
+
+    if (acquisition_dev.drive_mode == target || !ccs811_is_ready(device))
+        return;
+
+    /* Drive modes are ordered by decreasing sample rate, idle aside */
+    if (acquisition_dev.drive_mode == CCS811_DRIVE_IDLE)
+    {
+        if (target > acquisition_dev.idle_from
+            && HAL_GetTick() - acquisition_dev.idle_tick < CCS811_MODE_IDLE_TIME)
+        {
+            return;
+        }
+    }
+    else if (target > acquisition_dev.drive_mode)
+    {
+        mode = CCS811_DRIVE_IDLE;
+    }
+
+    if (!ccs811_set_drive_mode(device, mode))
+        return;
+
+    if (mode == CCS811_DRIVE_IDLE)
+    {
+        acquisition_dev.idle_from = acquisition_dev.drive_mode;
+        acquisition_dev.idle_tick = HAL_GetTick();
+    }
+
+    acquisition_dev.drive_mode = mode;
+    acquisition_dev.statistics.drive_changes++;
+}
+
+uint32_t acquisition_get_interval(void)
+{
+    return level_rates[acquisition_dev.level].interval;
+}
+
+acquisition_level acquisition_get_level(void)
+{
+    return acquisition_dev.level;
+}
+
+void acquisition_get_statistics(acquisition_statistics *statistics)
+{
+    if (statistics == NULL)
+        return;
+
+    *statistics = acquisition_dev.statistics;
+}
+
+/**
+ * @brief Update the smoothed rate of change of every channel
+ * @param values: Sample values indexed by publish_channel
+ * @param tick: HAL tick of the sample
+ */
+static void update_rates(const int32_t values[PUBLISH_CHANNEL_COUNT], uint32_t tick)
+{
+    uint32_t elapsed = tick - acquisition_dev.last_tick;
+
+    if (acquisition_dev.has_sample && elapsed > 0)
+    {
+        for (uint8_t channel = 0; channel < PUBLISH_CHANNEL_COUNT; channel++)
+        {
+            int32_t last = acquisition_dev.last_values[channel];
+            uint32_t change = (values[channel] > last)
+                    ? (uint32_t)(values[channel] - last) : (uint32_t)(last - values[channel]);
+
+            /* Limited change keeps the product within 32 bits */
+            if (change > ACQUISITION_MAX_CHANGE)
+            {
+                change = ACQUISITION_MAX_CHANGE;
+            }
+
+            uint32_t rate = change * 60000UL / elapsed;
+
+            /* Average with the previous rate, a single noisy sample only counts half */
+            acquisition_dev.rates[channel] = (acquisition_dev.rates[channel] + rate) / 2;
+        }
+    }
+
+    memcpy(acquisition_dev.last_values, values, sizeof(acquisition_dev.last_values));
+    acquisition_dev.last_tick = tick;
+    acquisition_dev.has_sample = true;
+}
+
+/**
+ * @brief Select the level for the current rates of change
+ * @return: New acquisition level
+ */
+static acquisition_level select_level(void)
+{
+    const acquisition_config *config = &acquisition_dev.configuration;
+    acquisition_level level = acquisition_dev.level;
+    bool fast = false;
+    bool stable = true;
+
+    for (uint8_t channel = 0; channel < PUBLISH_CHANNEL_COUNT; channel++)
+    {
+        uint32_t rate = acquisition_dev.rates[channel];
+
+        fast |= (rate >= config->rate[channel]);
+        stable &= (rate < config->rate[channel] / 2);
+    }
+
+    /* Limits may have changed with the configuration */
+    if (level < config->fastest)
+        return config->fastest;
+
+    if (level > config->slowest)
+        return config->slowest;
+
+    if (fast)
+    {
+        acquisition_dev.stable_count = 0;
+        return config->fastest;
+    }
+
+    if (!stable)
+    {
+        acquisition_dev.stable_count = 0;
+        return level;
+    }
+
+    if (++acquisition_dev.stable_count >= config->stable_samples && level < config->slowest)
+    {
+        acquisition_dev.stable_count = 0;
+        level++;
+    }
+
+    return level;
+}
@@ -0,0 +1,151 @@
+#ifndef ACQUISITION_H
+#define ACQUISITION_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "stm32g0xx_hal.h"
+#include "bme280.h"
+#include "ccs811.h"
+#include "publish_policy.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Default rate of change of every channel that needs the fastest level, per minute
+ *
+ * Rates are in the integer units of the telemetry samples.
+ */
+#define ACQUISITION_DEFAULT_TEMPERATURE_RATE   10     /**< 0.1 degC */
+#define ACQUISITION_DEFAULT_HUMIDITY_RATE      50     /**< 0.5 % */
+#define ACQUISITION_DEFAULT_PRESSURE_RATE      20     /**< 0.2 hPa */
+#define ACQUISITION_DEFAULT_TVOC_RATE          20     /**< 20 ppb */
+#define ACQUISITION_DEFAULT_ECO2_RATE          30     /**< 30 ppm */
+
+/**
+ * @brief Default number of stable samples before the next slower level is used
+ */
+#define ACQUISITION_DEFAULT_STABLE_SAMPLES     6
+
+/**
+ * @brief Largest channel change used for the rate, limits the effect of a single glitch
+ */
+#define ACQUISITION_MAX_CHANGE 0xFFFF
+
+/**
+ * @brief Acquisition levels, from the highest to the lowest sample rate
+ */
+typedef enum
+{
+    ACQUISITION_LEVEL_FAST,      /**< CCS811 every second, measurement every 5 s */
+    ACQUISITION_LEVEL_NORMAL,    /**< CCS811 every 10 s, measurement every 20 s */
+    ACQUISITION_LEVEL_SLOW,      /**< CCS811 every 60 s, measurement every 60 s */
+    ACQUISITION_LEVEL_COUNT
+} acquisition_level;
+
+/**
+ * @brief Acquisition configuration
+ */
+typedef struct
+{
+    uint32_t rate[PUBLISH_CHANNEL_COUNT];    /**< Rate of change per minute that needs the fastest level */
+    acquisition_level fastest;               /**< Highest sample rate level used */
+    acquisition_level slowest;               /**< Lowest sample rate level used */
+    uint8_t stable_samples;                  /**< Stable samples before the next slower level, at least 1 */
+} acquisition_config;
+
+/**
+ * @brief Acquisition statistics
+ */
+typedef struct
+{
+    uint32_t speedups;                              /**< Changes to the fastest level */
+    uint32_t slowdowns;                             /**< Changes to the next slower level */
+    uint32_t drive_changes;                         /**< CCS811 drive mode writes */
+    uint32_t samples[ACQUISITION_LEVEL_COUNT];      /**< Samples taken at every level */
+} acquisition_statistics;
+
+/**
+ * @brief Acquisition controller state
+ */
+typedef struct
+{
+    ccs811_device *device;                    /**< CCS811 whose drive mode is controlled */
+    acquisition_config configuration;         /**< Acquisition configuration */
+    acquisition_statistics statistics;        /**< Acquisition statistics */
+    acquisition_level level;                  /**< Current level */
+    uint8_t stable_count;                     /**< Consecutive stable samples */
+    ccs811_drive_mode drive_mode;             /**< Drive mode written to the CCS811 */
+    ccs811_drive_mode idle_from;              /**< Drive mode before the idle period */
+    uint32_t idle_tick;                       /**< HAL tick when the idle period started */
+    int32_t last_values[PUBLISH_CHANNEL_COUNT];    /**< Values of the previous sample */
+    uint32_t rates[PUBLISH_CHANNEL_COUNT];    /**< Smoothed rate of change per minute */
+    uint32_t last_tick;                       /**< HAL tick of the previous sample */
+    bool has_sample;                          /**< A previous sample exists */
+} acquisition;
+
+/**
+ * @brief Initialize the controller with the saved or the default configuration, at the fastest level
+ * @param device: Pointer to CCS811 device, its drive mode is set to the fastest level
+ */
+void acquisition_init(ccs811_device *device);
+
+/**
+ * @brief Set and save the acquisition configuration
+ * @param config: Pointer to configuration structure
+ * @return: true if the configuration is valid and was saved, false otherwise
+ */
+bool acquisition_set_configuration(const acquisition_config *config);
+
+/**
+ * @brief Read the acquisition configuration
+ * @param config: Pointer to configuration structure
+ */
+void acquisition_get_configuration(acquisition_config *config);
+
+/**
+ * @brief Track the rate of change of a new sample and select the level
+ *
+ * Any channel changing faster than its configured rate selects the fastest
+ * level, after the configured number of samples with every channel below
+ * half of its rate the next slower level is selected.
+ *
+ * @param environmental_data: Measurements of the BME280
+ * @param air_quality: Measurements of the CCS811
+ * @return: true if the measurement interval changed, false otherwise
+ */
+bool acquisition_update(const bme280_measurements *environmental_data,
+        const ccs811_measurements *air_quality);
+
+/**
+ * @brief Write the drive mode of the current level to the CCS811 once it is ready
+ *
+ * A lower sample rate is entered only after the CCS811 spent
+ * CCS811_MODE_IDLE_TIME in idle mode.
+ */
+void acquisition_handler(void);
+
+/**
+ * @brief Measurement interval of the current level
+ * @return: Interval in ms
+ */
+uint32_t acquisition_get_interval(void);
+
+/**
+ * @brief Read the current level
+ * @return: Acquisition level
+ */
+acquisition_level acquisition_get_level(void);
+
+/**
+ * @brief Read the acquisition statistics
+ * @param statistics: Pointer to statistics structure
+ */
+void acquisition_get_statistics(acquisition_statistics *statistics);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* ACQUISITION_H */
@@ -0,0 +1,237 @@
+#include <string.h>
+#include "aggregate.h"
+#include "system_time.h"
+
+#define QUEUE_MASK (AGGREGATE_QUEUE_SIZE - 1)
+
+_Static_assert((AGGREGATE_QUEUE_SIZE & QUEUE_MASK) == 0, "Invalid aggregate queue size");
+
+/**
+ * @brief Aggregation state
+ */
+static aggregate aggregate_dev;
+
+/* Aggregate private functions */
+static void open_window(uint32_t tick);
+static void close_window(void);
+static int32_t round_fraction(int64_t value);
+static uint32_t square_root(uint64_t value);
+
+void aggregate_init(void)
+{
+    memset(&aggregate_dev, 0, sizeof(aggregate_dev));
+}
+
+bool aggregate_set_period(uint16_t period)
+{
+    if (period > AGGREGATE_MAX_PERIOD)
+        return false;
+
+    aggregate_dev.period = period;
+    aggregate_dev.window_open = false;
+
+    return true;
+}
+
+uint16_t aggregate_get_period(void)
+{
+    return aggregate_dev.period;
+}
+
+void aggregate_add(const int32_t values[PUBLISH_CHANNEL_COUNT], uint32_t tick)
+{
+    if (values == NULL || aggregate_dev.period == 0)
+        return;
+
+    aggregate_update(tick);
+
+    if (!aggregate_dev.window_open)
+    {
+        open_window(tick);
+    }
+
+    /* Window statistics stay valid, the sample is not counted */
+    if (aggregate_dev.count == UINT16_MAX)
+        return;
+
+    aggregate_dev.count++;
+    aggregate_dev.statistics.samples++;
+
+    for (uint8_t channel = 0; channel < PUBLISH_CHANNEL_COUNT; channel++)
+    {
+        aggregate_accumulator *accumulator = &aggregate_dev.accumulators[channel];
+        int32_t value = values[channel];
+
+        if (aggregate_dev.count == 1)
+        {
+            accumulator->mean = value * (1 << AGGREGATE_FRACTION_BITS);
+            accumulator->m2 = 0;
+            accumulator->min = value;
+            accumulator->max = value;
+            continue;
+        }
+
+        accumulator->min = (value < accumulator->min) ? value : accumulator->min;
+        accumulator->max = (value > accumulator->max) ? value : accumulator->max;
+
+        /* Welford update, the second difference uses the new mean */
+        int32_t scaled = value * (1 << AGGREGATE_FRACTION_BITS);
+        int32_t delta = scaled - accumulator->mean;
+        int32_t count = aggregate_dev.count;
+
+        /* Rounded division, truncation would bias the mean towards the first sample */
+        accumulator->mean += (delta >= 0) ? (delta + count / 2) / count : (delta - count / 2) / count;
+        int32_t delta2 = scaled - accumulator->mean;
+        accumulator->m2 += (int64_t)delta * delta2;
+    }
+}
+
+void aggregate_update(uint32_t tick)
+{
+    if (!aggregate_dev.window_open)
+        return;
+
+    if (tick - aggregate_dev.window_start >= aggregate_dev.period * 1000UL)
+    {
+        close_window();
+    }
+}
+
+uint8_t aggregate_pending(void)
+{
+    return (uint8_t)(aggregate_dev.head - aggregate_dev.tail);
+}
+
+const aggregate_record *aggregate_peek(uint8_t index)
+{
+    if (index >= aggregate_pending())
+        return NULL;
+
+    return &aggregate_dev.queue[(uint8_t)(aggregate_dev.tail + index) & QUEUE_MASK];
+}
+
+void aggregate_release(uint8_t count)
+{
+    uint8_t pending = aggregate_pending();
+
+    aggregate_dev.tail += (count < pending) ? count : pending;
+}
+
+bool aggregate_get_last(aggregate_record *record)
+{
+    if (record == NULL || !aggregate_dev.has_last)
+        return false;
+
+    *record = aggregate_dev.last;
+    return true;
+}
+
+void aggregate_get_statistics(aggregate_statistics *statistics)
+{
+    if (statistics == NULL)
+        return;
+
+    *statistics = aggregate_dev.statistics;
+}
+
+/**
+ * @brief Start a window at the last period boundary before a sample
+ * @param tick: HAL tick of the first sample
+ */
+static void open_window(uint32_t tick)
+{
+    uint32_t period = aggregate_dev.period * 1000UL;
+    uint64_t time = system_time_from_tick(tick);
+
+    /* Boundaries in Unix time once it is known, so windows of all devices line up */
+    uint32_t offset = (time != 0) ? (uint32_t)(time % period) : (tick % period);
+
+    aggregate_dev.window_start = tick - offset;
+    aggregate_dev.window_open = true;
+    aggregate_dev.count = 0;
+}
+
+/**
+ * @brief Move the statistics of the open window to the queue
+ */
+static void close_window(void)
+{
+    aggregate_record *record = &aggregate_dev.last;
+
+    record->start_tick = aggregate_dev.window_start;
+    record->period = aggregate_dev.period;
+    record->count = aggregate_dev.count;
+
+    for (uint8_t channel = 0; channel < PUBLISH_CHANNEL_COUNT; channel++)
+    {
+        const aggregate_accumulator *accumulator = &aggregate_dev.accumulators[channel];
+        aggregate_channel *result = &record->channels[channel];
+        uint32_t stddev = 0;
+
+        /* Rounded means can leave a tiny negative sum */
+        if (aggregate_dev.count > 1 && accumulator->m2 > 0)
+        {
+            stddev = square_root((uint64_t)accumulator->m2 / (aggregate_dev.count - 1));
+        }
+
+        result->min = accumulator->min;
+        result->max = accumulator->max;
+        result->mean = round_fraction(accumulator->mean);
+        result->stddev = (uint32_t)round_fraction(stddev);
+    }
+
+    if (aggregate_pending() >= AGGREGATE_QUEUE_SIZE)
+    {
+        aggregate_dev.tail++;
+        aggregate_dev.statistics.dropped++;
+    }
+
+    aggregate_dev.queue[aggregate_dev.head & QUEUE_MASK] = *record;
+    aggregate_dev.head++;
+    aggregate_dev.has_last = true;
+    aggregate_dev.window_open = false;
+    aggregate_dev.statistics.windows++;
+}
+
+/**
+ * @brief Round a fixed point value to channel units
+ * @param value: Value with AGGREGATE_FRACTION_BITS fraction bits
+ * @return: Rounded value
+ */
+static int32_t round_fraction(int64_t value)
+{
+    return (int32_t)((value + (1 << (AGGREGATE_FRACTION_BITS - 1))) >> AGGREGATE_FRACTION_BITS);
+}
+
+/**
+ * @brief Integer square root, one result bit per iteration
+ * @param value: Radicand
+ * @return: Square root, rounded down
+ */
+static uint32_t square_root(uint64_t value)
+{
+    uint64_t result = 0;
+    uint64_t bit = (uint64_t)1 << 62;
+
+    while (bit > value)
+    {
+        bit >>= 2;
+    }
+
+    while (bit != 0)
+    {
+        if (value >= result + bit)
+        {
+            value -= result + bit;
+            result = (result >> 1) + bit;
+        }
+        else
+        {
+            result >>= 1;
+        }
+
+        bit >>= 2;
+    }
+
+    return (uint32_t)result;
+}
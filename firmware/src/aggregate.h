@@ -0,0 +1,160 @@
+#ifndef AGGREGATE_H
+#define AGGREGATE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "stm32g0xx_hal.h"
+#include "publish_policy.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Number of closed windows kept until they are sent, power of two
+ */
+#define AGGREGATE_QUEUE_SIZE 8
+
+/**
+ * @brief Fraction bits of the running mean, the sum of squares has twice as many
+ */
+#define AGGREGATE_FRACTION_BITS 8
+
+/**
+ * @brief Longest window period in s, one hour
+ */
+#define AGGREGATE_MAX_PERIOD 3600
+
+/**
+ * @brief Statistics of a channel over a closed window, in channel units
+ */
+typedef struct
+{
+    int32_t min;        /**< Smallest value */
+    int32_t max;        /**< Largest value */
+    int32_t mean;       /**< Mean value, rounded */
+    uint32_t stddev;    /**< Sample standard deviation, rounded, 0 for a single sample */
+} aggregate_channel;
+
+/**
+ * @brief Closed window
+ */
+typedef struct
+{
+    uint32_t start_tick;                                  /**< HAL tick of the window start */
+    uint16_t period;                                      /**< Window period in s */
+    uint16_t count;                                       /**< Samples in the window */
+    aggregate_channel channels[PUBLISH_CHANNEL_COUNT];    /**< Statistics of every channel */
+} aggregate_record;
+
+/**
+ * @brief Running statistics of a channel, Welford's algorithm in fixed point
+ */
+typedef struct
+{
+    int32_t mean;       /**< Running mean, AGGREGATE_FRACTION_BITS fraction bits */
+    int64_t m2;         /**< Sum of squared differences from the mean, twice the fraction bits */
+    int32_t min;        /**< Smallest value */
+    int32_t max;        /**< Largest value */
+} aggregate_accumulator;
+
+/**
+ * @brief Aggregation statistics
+ */
+typedef struct
+{
+    uint32_t samples;    /**< Samples added to windows */
+    uint32_t windows;    /**< Closed windows */
+    uint32_t dropped;    /**< Closed windows overwritten before they were sent */
+} aggregate_statistics;
+
+/**
+ * @brief Aggregation state
+ */
+typedef struct
+{
+    uint16_t period;                                              /**< Window period in s, 0 disables aggregation */
+    bool window_open;                                             /**< A window has samples */
+    uint32_t window_start;                                        /**< HAL tick of the open window start */
+    uint16_t count;                                               /**< Samples in the open window */
+    aggregate_accumulator accumulators[PUBLISH_CHANNEL_COUNT];    /**< Running statistics of the open window */
+    aggregate_record queue[AGGREGATE_QUEUE_SIZE];                 /**< Closed windows, oldest first */
+    uint8_t head;                                                 /**< Next free position, free running */
+    uint8_t tail;                                                 /**< Oldest window, free running */
+    aggregate_record last;                                        /**< Newest closed window */
+    bool has_last;                                                /**< A window was closed */
+    aggregate_statistics statistics;                              /**< Aggregation statistics */
+} aggregate;
+
+/**
+ * @brief Initialize aggregation, disabled until a period is set
+ */
+void aggregate_init(void);
+
+/**
+ * @brief Set the window period, the open window is discarded
+ *
+ * Windows start at multiples of the period in Unix time once the time is
+ * synchronized, at multiples of the period in HAL ticks before.
+ *
+ * @param period: Window period in s, 0 disables aggregation
+ * @return: true if the period is valid, false otherwise
+ */
+bool aggregate_set_period(uint16_t period);
+
+/**
+ * @brief Read the window period
+ * @return: Window period in s, 0 if aggregation is disabled
+ */
+uint16_t aggregate_get_period(void);
+
+/**
+ * @brief Add a sample to the open window, an expired window is closed first
+ * @param values: Sample values indexed by publish_channel
+ * @param tick: HAL tick of the sample
+ */
+void aggregate_add(const int32_t values[PUBLISH_CHANNEL_COUNT], uint32_t tick);
+
+/**
+ * @brief Close the open window once its period has passed
+ * @param tick: Current HAL tick
+ */
+void aggregate_update(uint32_t tick);
+
+/**
+ * @brief Number of closed windows waiting to be sent
+ * @return: Number of windows
+ */
+uint8_t aggregate_pending(void);
+
+/**
+ * @brief Read a closed window waiting to be sent
+ * @param index: Position from the oldest window, below aggregate_pending
+ * @return: Pointer to the window, NULL if the index is not valid
+ */
+const aggregate_record *aggregate_peek(uint8_t index);
+
+/**
+ * @brief Remove the oldest closed windows after they were sent
+ * @param count: Number of windows
+ */
+void aggregate_release(uint8_t count);
+
+/**
+ * @brief Read the newest closed window
+ * @param record: Pointer to window record
+ * @return: true if a window was closed, false otherwise
+ */
+bool aggregate_get_last(aggregate_record *record);
+
+/**
+ * @brief Read the aggregation statistics
+ * @param statistics: Pointer to statistics structure
+ */
+void aggregate_get_statistics(aggregate_statistics *statistics);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* AGGREGATE_H */
@@ -0,0 +1,307 @@
+#include <string.h>
+#include "at_command.h"
+
+/**
+ * @brief AT command engine state
+ */
+typedef struct
+{
+    uart_tx *tx;                              /**< Transmitter of the UART connected to the AT device */
+    at_unsolicited_callback unsolicited;      /**< Callback for responses not consumed by commands */
+    at_command queue[AT_COMMAND_QUEUE_SIZE];  /**< Command queue, the active command is at tail */
+    uint8_t head;                             /**< Next free queue position */
+    uint8_t tail;                             /**< Oldest queued command */
+    uint8_t count;                            /**< Number of queued commands */
+    bool active;                              /**< Command at tail was transmitted */
+    volatile bool transmitting;               /**< UART transmission in progress */
+    uint32_t start_time;                      /**< Transmission start of the active command */
+    at_command_statistics statistics;         /**< Engine statistics */
+} at_engine;
+
+/**
+ * @brief AT command engine
+ */
+static at_engine engine;
+
+/* AT command engine private functions */
+static at_command *queue_command(uint32_t success_mask, uint32_t failure_mask,
+        uint32_t timeout, at_command_callback callback, void *context);
+static void start_next(void);
+static void complete(at_result result, at_event event);
+static void abort_queued(uint8_t count);
+static void transmit_done(void *context);
+
+bool at_command_init(uart_tx *tx, at_unsolicited_callback unsolicited)
+{
+    if (tx == NULL)
+        return false;
+
+    memset(&engine, 0, sizeof(engine));
+    engine.tx = tx;
+    engine.unsolicited = unsolicited;
+
+    return true;
+}
+
+bool at_command_send(const char *command, uint32_t success_mask, uint32_t failure_mask,
+        uint32_t timeout, at_command_callback callback, void *context)
+{
+    if (command == NULL)
+        return false;
+
+    size_t length = strlen(command);
+    if (length == 0 || length >= AT_COMMAND_MAX_LENGTH)
+        return false;
+
+    at_command *entry = queue_command(success_mask, failure_mask, timeout, callback, context);
+    if (entry == NULL)
+        return false;
+
+    memcpy(entry->text, command, length + 1);
+    entry->data = NULL;
+    entry->length = (uint16_t)length;
+
+    start_next();
+    return true;
+}
+
+bool at_command_send_data(const uint8_t *data, uint16_t length, uint32_t success_mask,
+        uint32_t failure_mask, uint32_t timeout, at_command_callback callback, void *context)
+{
+    if (data == NULL || length == 0)
+        return false;
+
+    at_command *entry = queue_command(success_mask, failure_mask, timeout, callback, context);
+    if (entry == NULL)
+        return false;
+
+    entry->text[0] = '\0';
+    entry->data = data;
+    entry->length = length;
+
+    start_next();
+    return true;
+}
+
+void at_command_flush(void)
+{
+    if (engine.transmitting)
+    {
+        uart_tx_abort(engine.tx);
+        engine.transmitting = false;
+    }
+
+    abort_queued(engine.count);
+}
+
+bool at_command_is_idle(void)
+{
+    return (engine.count == 0);
+}
+
+uint32_t at_command_time_left(void)
+{
+    if (engine.count == 0)
+        return UINT32_MAX;
+
+    if (!engine.active)
+        return 0;
+
+    uint32_t elapsed = HAL_GetTick() - engine.start_time;
+    uint32_t timeout = engine.queue[engine.tail].timeout;
+
+    return (elapsed < timeout) ? timeout - elapsed : 0;
+}
+
+void at_command_process_event(at_event event)
+{
+    if (event == AT_EVENT_NONE)
+        return;
+
+    if (engine.active)
+    {
+        at_command *command = &engine.queue[engine.tail];
+
+        if (command->success_mask & AT_EVENT_MASK(event))
+        {
+            complete(AT_RESULT_SUCCESS, event);
+            start_next();
+            return;
+        }
+        else if (command->failure_mask & AT_EVENT_MASK(event))
+        {
+            complete(AT_RESULT_FAILURE, event);
+            start_next();
+            return;
+        }
+    }
+
+    if (engine.unsolicited != NULL)
+    {
+        engine.unsolicited(event);
+    }
+}
+
+void at_command_handler(void)
+{
+    if (engine.active
+        && (HAL_GetTick() - engine.start_time >= engine.queue[engine.tail].timeout))
+    {
+        complete(AT_RESULT_TIMEOUT, AT_EVENT_NONE);
+    }
+
+    start_next();
+}
+
+void at_command_get_statistics(at_command_statistics *statistics)
+{
+    if (statistics == NULL)
+        return;
+
+    *statistics = engine.statistics;
+}
+
+/**
+ * @brief Reserve a queue entry
+ * @param success_mask: Responses completing the command successfully
+ * @param failure_mask: Responses completing the command with failure
+ * @param timeout: Response timeout in ms
+ * @param callback: Completion callback
+ * @param context: Context passed to the callback
+ * @return: Pointer to the queue entry, NULL if the queue is full
+ */
+static at_command *queue_command(uint32_t success_mask, uint32_t failure_mask,
+        uint32_t timeout, at_command_callback callback, void *context)
+{
+    if (engine.count >= AT_COMMAND_QUEUE_SIZE)
+        return NULL;
+
+    at_command *entry = &engine.queue[engine.head];
+    entry->success_mask = success_mask;
+    entry->failure_mask = failure_mask;
+    entry->timeout = timeout;
+    entry->callback = callback;
+    entry->context = context;
+
+    engine.head = (engine.head + 1) % AT_COMMAND_QUEUE_SIZE;
+    engine.count++;
+
+    return entry;
+}
+
+/**
+ * @brief Transmit the oldest queued command if the engine is free
+ */
+static void start_next(void)
+{
+    if (engine.active || engine.transmitting || engine.count == 0)
+        return;
+
+    at_command *command = &engine.queue[engine.tail];
+    const uint8_t *data = (command->data != NULL) ? command->data : (const uint8_t *)command->text;
+
+    engine.active = true;
+    engine.transmitting = true;
+    engine.start_time = HAL_GetTick();
+
+    /* The command stays queued until it completes, so the text outlives the transfer */
+    if (!uart_tx_send(engine.tx, data, command->length, transmit_done, NULL))
+    {
+        engine.transmitting = false;
+        complete(AT_RESULT_TX_ERROR, AT_EVENT_NONE);
+    }
+}
+
+/**
+ * @brief Complete the active command
+ *
+ * Commands queued behind a command that did not succeed are aborted before
+ * its callback is called, so the callback can queue a recovery sequence.
+ *
+ * @param result: Command result
+ * @param event: Response that completed the command
+ */
+static void complete(at_result result, at_event event)
+{
+    at_command *command = &engine.queue[engine.tail];
+    at_command_callback callback = command->callback;
+    at_completion completion = {
+        .result = result,
+        .event = event,
+        .latency = HAL_GetTick() - engine.start_time,
+        .context = command->context
+    };
+
+    engine.tail = (engine.tail + 1) % AT_COMMAND_QUEUE_SIZE;
+    engine.count--;
+    engine.active = false;
+
+    engine.statistics.last_latency = completion.latency;
+    if (completion.latency > engine.statistics.max_latency)
+    {
+        engine.statistics.max_latency = completion.latency;
+    }
+
+    if (result == AT_RESULT_SUCCESS)
+    {
+        engine.statistics.completed++;
+    }
+    else if (result == AT_RESULT_TIMEOUT)
+    {
+        engine.statistics.timeouts++;
+    }
+    else
+    {
+        engine.statistics.failed++;
+    }
+
+    if (result != AT_RESULT_SUCCESS)
+    {
+        abort_queued(engine.count);
+    }
+
+    if (callback != NULL)
+    {
+        callback(&completion);
+    }
+}
+
+/**
+ * @brief Abort the oldest queued commands
+ * @param count: Number of commands to abort
+ */
+static void abort_queued(uint8_t count)
+{
+    while (count > 0 && engine.count > 0)
+    {
+        at_command *command = &engine.queue[engine.tail];
+        at_command_callback callback = command->callback;
+        at_completion completion = {
+            .result = AT_RESULT_ABORTED,
+            .event = AT_EVENT_NONE,
+            .latency = 0,
+            .context = command->context
+        };
+
+        engine.tail = (engine.tail + 1) % AT_COMMAND_QUEUE_SIZE;
+        engine.count--;
+        engine.active = false;
+        engine.statistics.failed++;
+        count--;
+
+        if (callback != NULL)
+        {
+            callback(&completion);
+        }
+    }
+}
+
+/**
+ * @brief Transmitter callback, the command was sent or the transfer was dropped
+ * @param context: Unused
+ */
+static void transmit_done(void *context)
+{
+    (void)context;
+    engine.transmitting = false;
+}
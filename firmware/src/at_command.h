@@ -0,0 +1,166 @@
+#ifndef AT_COMMAND_H
+#define AT_COMMAND_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "stm32g0xx_hal.h"
+#include "at_tokenizer.h"
+#include "uart_tx.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief AT command engine size related macros
+ */
+#define AT_COMMAND_QUEUE_SIZE 8
+#define AT_COMMAND_MAX_LENGTH 128
+
+/**
+ * @brief Bit mask of an AT tokenizer event, used for expected responses
+ */
+#define AT_EVENT_MASK(event) (1UL << (event))
+
+/**
+ * @brief Result of an AT command
+ */
+typedef enum
+{
+    AT_RESULT_SUCCESS,     /**< One of the expected responses was received */
+    AT_RESULT_FAILURE,     /**< One of the failure responses was received */
+    AT_RESULT_TIMEOUT,     /**< No final response before the timeout */
+    AT_RESULT_TX_ERROR,    /**< The command could not be transmitted */
+    AT_RESULT_ABORTED      /**< A previous command failed or the queue was flushed */
+} at_result;
+
+/**
+ * @brief Completion information passed to the command callback
+ */
+typedef struct
+{
+    at_result result;    /**< Command result */
+    at_event event;      /**< Response that completed the command, AT_EVENT_NONE if none */
+    uint32_t latency;    /**< Time from transmission start to completion in ms */
+    void *context;       /**< Context given when the command was queued */
+} at_completion;
+
+/**
+ * @brief Command completion callback
+ */
+typedef void (*at_command_callback)(const at_completion *completion);
+
+/**
+ * @brief Callback for responses that do not complete the active command
+ */
+typedef void (*at_unsolicited_callback)(at_event event);
+
+/**
+ * @brief Queued AT command
+ */
+typedef struct
+{
+    char text[AT_COMMAND_MAX_LENGTH];    /**< Command text, used when data is NULL */
+    const uint8_t *data;                 /**< Raw data to transmit instead of the text */
+    uint16_t length;                     /**< Number of bytes to transmit */
+    uint32_t success_mask;               /**< Responses completing the command successfully */
+    uint32_t failure_mask;               /**< Responses completing the command with failure */
+    uint32_t timeout;                    /**< Response timeout in ms */
+    at_command_callback callback;        /**< Completion callback, can be NULL */
+    void *context;                       /**< Context passed to the callback */
+} at_command;
+
+/**
+ * @brief AT command engine statistics
+ */
+typedef struct
+{
+    uint32_t completed;       /**< Commands completed successfully */
+    uint32_t failed;          /**< Commands completed with failure or aborted */
+    uint32_t timeouts;        /**< Commands without response */
+    uint32_t last_latency;    /**< Latency of the last completed command in ms */
+    uint32_t max_latency;     /**< Highest command latency in ms */
+} at_command_statistics;
+
+/**
+ * @brief Initialize the AT command engine
+ * @param tx: Transmitter of the UART connected to the AT device
+ * @param unsolicited: Callback for responses not consumed by commands, can be NULL
+ * @return: true if the engine was initialized, false otherwise
+ */
+bool at_command_init(uart_tx *tx, at_unsolicited_callback unsolicited);
+
+/**
+ * @brief Queue an AT command
+ *
+ * Commands are transmitted one after the other, a command that does not
+ * succeed aborts all the commands queued after it so a sequence can be
+ * queued at once.
+ *
+ * @param command: Null terminated command text including the line ending
+ * @param success_mask: Responses completing the command successfully
+ * @param failure_mask: Responses completing the command with failure
+ * @param timeout: Response timeout in ms
+ * @param callback: Completion callback, can be NULL
+ * @param context: Context passed to the callback
+ * @return: true if the command was queued, false if the queue is full
+ */
+bool at_command_send(const char *command, uint32_t success_mask, uint32_t failure_mask,
+        uint32_t timeout, at_command_callback callback, void *context);
+
+/**
+ * @brief Queue raw data, for example the data phase of AT+CIPSEND
+ *
+ * The data is not copied and must stay valid until the callback is called.
+ *
+ * @param data: Pointer to the data
+ * @param length: Number of bytes
+ * @param success_mask: Responses completing the transfer successfully
+ * @param failure_mask: Responses completing the transfer with failure
+ * @param timeout: Response timeout in ms
+ * @param callback: Completion callback, can be NULL
+ * @param context: Context passed to the callback
+ * @return: true if the data was queued, false if the queue is full
+ */
+bool at_command_send_data(const uint8_t *data, uint16_t length, uint32_t success_mask,
+        uint32_t failure_mask, uint32_t timeout, at_command_callback callback, void *context);
+
+/**
+ * @brief Abort the active command and all queued commands
+ */
+void at_command_flush(void);
+
+/**
+ * @brief Check if the engine has no active or queued command
+ * @return: true if the engine is idle, false otherwise
+ */
+bool at_command_is_idle(void);
+
+/**
+ * @brief Time until the active command times out, at_command_handler must run then
+ * @return: Time in ms, 0 if a queued command waits to be transmitted, UINT32_MAX if idle
+ */
+uint32_t at_command_time_left(void);
+
+/**
+ * @brief Pass a tokenized response to the engine
+ * @param event: Event generated by the AT tokenizer
+ */
+void at_command_process_event(at_event event);
+
+/**
+ * @brief AT command engine handler, starts queued commands and checks timeouts
+ */
+void at_command_handler(void);
+
+/**
+ * @brief Read the engine statistics
+ * @param statistics: Pointer to statistics structure
+ */
+void at_command_get_statistics(at_command_statistics *statistics);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* AT_COMMAND_H */
@@ -0,0 +1,238 @@
+#include <stddef.h>
+#include "at_tokenizer.h"
+
+/**
+ * @brief Known result codes
+ *
+ * Each received byte removes the result codes that no longer match the line
+ * from the candidate mask, so a line is recognized when it ends without
+ * comparing it again. The +IPD header is matched as a line prefix.
+ */
+typedef struct
+{
+    const char *text;    /**< Result code text */
+    uint8_t length;      /**< Result code length */
+    at_event event;      /**< Event generated for the result code */
+} at_result_code;
+
+static const at_result_code result_codes[] = {
+    { "OK",                 2, AT_EVENT_OK                },
+    { "ERROR",              5, AT_EVENT_ERROR             },
+    { "FAIL",               4, AT_EVENT_FAIL              },
+    { "SEND OK",            7, AT_EVENT_SEND_OK           },
+    { "SEND FAIL",          9, AT_EVENT_SEND_FAIL         },
+    { "ready",              5, AT_EVENT_READY             },
+    { "CLOSED",             6, AT_EVENT_CLOSED            },
+    { "WIFI DISCONNECTED", 17, AT_EVENT_WIFI_DISCONNECTED },
+    { "ALREADY CONNECTED", 17, AT_EVENT_ALREADY_CONNECTED },
+    { "+IPD,",              5, AT_EVENT_IPD               }
+};
+
+#define RESULT_CODE_COUNT (sizeof(result_codes) / sizeof(result_codes[0]))
+#define RESULT_CODE_IPD   (RESULT_CODE_COUNT - 1)
+#define ALL_CANDIDATES    ((uint16_t)((1 << RESULT_CODE_COUNT) - 1))
+
+/* AT tokenizer private functions */
+static void start_line(at_tokenizer *tokenizer);
+static at_event finish_line(at_tokenizer *tokenizer);
+static void match_byte(at_tokenizer *tokenizer, uint8_t byte);
+
+void at_tokenizer_reset(at_tokenizer *tokenizer)
+{
+    if (tokenizer == NULL)
+        return;
+
+    tokenizer->ipd_length = 0;
+    tokenizer->ipd_remaining = 0;
+    tokenizer->data = NULL;
+    tokenizer->data_length = 0;
+    tokenizer->line[0] = '\0';
+    start_line(tokenizer);
+}
+
+uint16_t at_tokenizer_process(at_tokenizer *tokenizer, const uint8_t *data, uint16_t length,
+        at_event *event)
+{
+    if (tokenizer == NULL || data == NULL || event == NULL)
+        return 0;
+
+    *event = AT_EVENT_NONE;
+
+    for (uint16_t index = 0; index < length; index++)
+    {
+        uint8_t byte = data[index];
+
+        switch (tokenizer->state)
+        {
+        case AT_TOKENIZER_LINE:
+            if (byte == '\r' || byte == '\n')
+            {
+                /* Skip empty lines and the second byte of CR LF */
+                if (tokenizer->position == 0)
+                    break;
+
+                *event = finish_line(tokenizer);
+                return index + 1;
+            }
+
+            if (tokenizer->position == 0 && byte == '>')
+            {
+                /* Prompt is not followed by a line ending */
+                tokenizer->state = AT_TOKENIZER_SKIP_LINE;
+                *event = AT_EVENT_PROMPT;
+                return index + 1;
+            }
+
+            match_byte(tokenizer, byte);
+
+            if ((tokenizer->candidates & (1 << RESULT_CODE_IPD))
+                && tokenizer->position == result_codes[RESULT_CODE_IPD].length)
+            {
+                tokenizer->line[tokenizer->position] = '\0';
+                tokenizer->state = AT_TOKENIZER_IPD_LENGTH;
+                tokenizer->ipd_length = 0;
+            }
+            break;
+
+        case AT_TOKENIZER_IPD_LENGTH:
+            if (byte >= '0' && byte <= '9')
+            {
+                tokenizer->ipd_length = tokenizer->ipd_length * 10 + (byte - '0');
+            }
+            else if (byte == ',')
+            {
+                /* Link id in multiple connection mode, length follows */
+                tokenizer->ipd_length = 0;
+            }
+            else if (byte == ':')
+            {
+                tokenizer->ipd_remaining = tokenizer->ipd_length;
+                start_line(tokenizer);
+
+                if (tokenizer->ipd_remaining > 0)
+                {
+                    tokenizer->state = AT_TOKENIZER_IPD_DATA;
+                }
+
+                *event = AT_EVENT_IPD;
+                return index + 1;
+            }
+            else
+            {
+                /* Malformed header */
+                start_line(tokenizer);
+            }
+            break;
+
+        case AT_TOKENIZER_IPD_DATA:
+        {
+            uint16_t count = length - index;
+
+            if (count > tokenizer->ipd_remaining)
+            {
+                count = tokenizer->ipd_remaining;
+            }
+
+            tokenizer->data = &data[index];
+            tokenizer->data_length = count;
+            tokenizer->ipd_remaining -= count;
+
+            if (tokenizer->ipd_remaining == 0)
+            {
+                start_line(tokenizer);
+            }
+
+            *event = AT_EVENT_DATA;
+            return index + count;
+        }
+
+        case AT_TOKENIZER_SKIP_LINE:
+            if (byte == '\r' || byte == '\n')
+            {
+                start_line(tokenizer);
+            }
+            break;
+
+        default:
+            start_line(tokenizer);
+            break;
+        }
+    }
+
+    return length;
+}
+
+const char *at_tokenizer_line(at_tokenizer *tokenizer)
+{
+    if (tokenizer == NULL)
+        return "";
+
+    return tokenizer->line;
+}
+
+/**
+ * @brief Prepare the tokenizer for a new line
+ * @param tokenizer: Pointer to AT tokenizer
+ */
+static void start_line(at_tokenizer *tokenizer)
+{
+    tokenizer->state = AT_TOKENIZER_LINE;
+    tokenizer->candidates = ALL_CANDIDATES;
+    tokenizer->position = 0;
+}
+
+/**
+ * @brief Terminate the current line and find the matching result code
+ * @param tokenizer: Pointer to AT tokenizer
+ * @return: Result code event or AT_EVENT_LINE
+ */
+static at_event finish_line(at_tokenizer *tokenizer)
+{
+    at_event event = AT_EVENT_LINE;
+    uint16_t position = tokenizer->position;
+
+    tokenizer->line[(position < AT_LINE_SIZE) ? position : (AT_LINE_SIZE - 1)] = '\0';
+
+    for (uint8_t index = 0; index < RESULT_CODE_COUNT; index++)
+    {
+        if ((tokenizer->candidates & (1 << index))
+            && result_codes[index].length == position)
+        {
+            event = result_codes[index].event;
+            break;
+        }
+    }
+
+    start_line(tokenizer);
+    return event;
+}
+
+/**
+ * @brief Add a byte to the current line and update the candidates
+ * @param tokenizer: Pointer to AT tokenizer
+ * @param byte: Received byte
+ */
+static void match_byte(at_tokenizer *tokenizer, uint8_t byte)
+{
+    uint16_t position = tokenizer->position;
+    uint16_t candidates = tokenizer->candidates;
+
+    for (uint8_t index = 0; candidates >> index; index++)
+    {
+        if ((candidates & (1 << index)) == 0)
+            continue;
+
+        if (position >= result_codes[index].length
+            || (uint8_t)result_codes[index].text[position] != byte)
+        {
+            tokenizer->candidates &= ~(1 << index);
+        }
+    }
+
+    if (position < AT_LINE_SIZE - 1)
+    {
+        tokenizer->line[position] = (char)byte;
+    }
+
+    tokenizer->position = position + 1;
+}
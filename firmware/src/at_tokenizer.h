@@ -0,0 +1,102 @@
+#ifndef AT_TOKENIZER_H
+#define AT_TOKENIZER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Size of the buffer holding the current response line
+ *
+ * Longer lines are still recognized, only the copy is truncated.
+ */
+#define AT_LINE_SIZE 64
+
+/**
+ * @brief Events generated by the AT response tokenizer
+ */
+typedef enum
+{
+    AT_EVENT_NONE,                 /**< No event, more data is needed */
+    AT_EVENT_OK,                   /**< OK result code */
+    AT_EVENT_ERROR,                /**< ERROR result code */
+    AT_EVENT_FAIL,                 /**< FAIL result code */
+    AT_EVENT_SEND_OK,              /**< SEND OK, data was sent */
+    AT_EVENT_SEND_FAIL,            /**< SEND FAIL, data was not sent */
+    AT_EVENT_READY,                /**< ready, chip finished restarting */
+    AT_EVENT_CLOSED,               /**< CLOSED, connection was closed */
+    AT_EVENT_WIFI_DISCONNECTED,    /**< WIFI DISCONNECTED, network connection was lost */
+    AT_EVENT_ALREADY_CONNECTED,    /**< ALREADY CONNECTED, connection is already open */
+    AT_EVENT_PROMPT,               /**< > prompt, chip waits for data to send */
+    AT_EVENT_IPD,                  /**< +IPD,n: header, n bytes of network data follow */
+    AT_EVENT_DATA,                 /**< Block of network data following +IPD */
+    AT_EVENT_LINE                  /**< Any other non empty line */
+} at_event;
+
+/**
+ * @brief AT tokenizer internal states
+ */
+typedef enum
+{
+    AT_TOKENIZER_LINE,          /**< Reading a response line */
+    AT_TOKENIZER_IPD_LENGTH,    /**< Reading the +IPD data length */
+    AT_TOKENIZER_IPD_DATA,      /**< Forwarding +IPD data */
+    AT_TOKENIZER_SKIP_LINE      /**< Ignoring the rest of the line */
+} at_tokenizer_state;
+
+/**
+ * @brief AT response tokenizer
+ */
+typedef struct
+{
+    at_tokenizer_state state;    /**< Current state */
+    uint16_t candidates;         /**< Result codes still matching the current line */
+    uint16_t position;           /**< Position in the current line */
+    char line[AT_LINE_SIZE];     /**< Copy of the current line, null terminated */
+    uint16_t ipd_length;         /**< Length announced by the last +IPD header */
+    uint16_t ipd_remaining;      /**< +IPD data bytes not yet forwarded */
+    const uint8_t *data;         /**< Network data block of the last AT_EVENT_DATA */
+    uint16_t data_length;        /**< Length of the network data block */
+} at_tokenizer;
+
+/**
+ * @brief Reset tokenizer state
+ * @param tokenizer: Pointer to AT tokenizer
+ */
+void at_tokenizer_reset(at_tokenizer *tokenizer);
+
+/**
+ * @brief Process received bytes until an event is generated
+ *
+ * The function stops right after the byte that completed an event, the
+ * caller should call it again with the remaining bytes. For AT_EVENT_DATA
+ * the data and data_length members point inside the input block.
+ *
+ * @param tokenizer: Pointer to AT tokenizer
+ * @param data: Received bytes
+ * @param length: Number of received bytes
+ * @param event: Generated event, AT_EVENT_NONE if all bytes were consumed without event
+ * @return: Number of bytes consumed
+ */
+uint16_t at_tokenizer_process(at_tokenizer *tokenizer, const uint8_t *data, uint16_t length,
+        at_event *event);
+
+/**
+ * @brief Get the last complete line
+ *
+ * The line is valid after AT_EVENT_LINE and the result code events until
+ * the next call of at_tokenizer_process.
+ *
+ * @param tokenizer: Pointer to AT tokenizer
+ * @return: Null terminated line without line ending
+ */
+const char *at_tokenizer_line(at_tokenizer *tokenizer);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* AT_TOKENIZER_H */
@@ -2,175 +2,339 @@
 
 #define CONCAT_BYTES(msb, lsb) (((uint16_t)msb << 8) | (uint16_t)lsb)
 
+/**
+ * @brief Oversampling factor of every bme280_sampling value
+ */
+static const uint8_t sampling_factor[] = { 0, 1, 2, 4, 8, 16 };
+
 /* BME280 private functions */
-static uint8_t read_hardware_id(bme280_device *device);
-static bool soft_reset(bme280_device *device);
-static uint8_t read_status(bme280_device *device);
-static bool read_calibration_data(bme280_device *device);
-static bool configure_sampling(bme280_device *device);
-static float compensate_temperature(bme280_device *device, int32_t adc_temperature);
-static float compensate_pressure(bme280_device *device, int32_t adc_pressure);
-static float compensate_humidity(bme280_device *device, int32_t adc_humidity);
+static void transfer_completed(i2c_bus_result result, void *context);
+static bool read_register(bme280_device *device, bme280_state state, uint8_t reg, uint16_t length);
+static bool write_register(bme280_device *device, bme280_state state, uint8_t reg, uint8_t value);
+static void set_state(bme280_device *device, bme280_state state);
+static uint8_t ctrl_meas_value(bme280_device *device, bme280_mode mode);
+static uint8_t measurement_time(bme280_device *device);
+static void parse_calibration_data(bme280_device *device);
+static void parse_measurements(bme280_device *device);
 
 bool bme280_init(bme280_device *device)
 {
     if (device == NULL)
         return false;
 
-    device->i2c_address = (uint8_t)(device->i2c_address << 1);
-    device->hardware_id = read_hardware_id(device);
+    device->hardware_id = 0;
+    device->data_ready = false;
+    device->conversion_time = measurement_time(device);
 
-    if (device->hardware_id != BME280_DEFAULT_HW_ID)
+    if (!read_register(device, BME280_STATE_READ_ID, BME280_REG_CHIPID, 1))
+    {
+        set_state(device, BME280_STATE_ERROR);
         return false;
+    }
 
-    soft_reset(device);
+    return true;
+}
 
-    while (1)
+void bme280_handler(bme280_device *device)
+{
+    if (device == NULL)
+        return;
+
+    uint32_t elapsed = HAL_GetTick() - device->state_time;
+
+    if (device->state == BME280_STATE_STARTUP && elapsed >= BME280_STARTUP_TIME)
     {
-        uint8_t status = read_status(device);
-        if ((status & (1 << 0)) == 0)
-            break;
+        if (!read_register(device, BME280_STATE_READ_UPDATE_STATUS, BME280_REG_STATUS, 1))
+        {
+            set_state(device, BME280_STATE_ERROR);
+        }
+    }
+    else if (device->state == BME280_STATE_CONVERTING && elapsed >= device->wait_time)
+    {
+        if (!read_register(device, BME280_STATE_READ_DATA, BME280_REG_STATUS,
+                BME280_BURST_DATA_LENGTH))
+        {
+            set_state(device, BME280_STATE_READY);
+        }
+    }
+    else if (device->state == BME280_STATE_ERROR && elapsed >= BME280_RETRY_INTERVAL)
+    {
+        bme280_init(device);
     }
+}
 
-    if (!read_calibration_data(device))
+bool bme280_start_measurement(bme280_device *device)
+{
+    if (device == NULL || device->state != BME280_STATE_READY)
         return false;
 
-    if (!configure_sampling(device))
-        return false;
+    if (device->mode == BMP280_MODE_FORCED)
+    {
+        return write_register(device, BME280_STATE_WRITE_TRIGGER, BME280_REG_CTRLMEAS,
+                ctrl_meas_value(device, BMP280_MODE_FORCED));
+    }
 
-    return true;
+    /* Data registers are shadowed in normal mode, a burst read is always consistent */
+    return read_register(device, BME280_STATE_READ_DATA, BME280_REG_STATUS,
+            BME280_BURST_DATA_LENGTH);
 }
 
-uint8_t bme280_get_status(bme280_device *device)
+bool bme280_is_busy(bme280_device *device)
 {
     if (device == NULL)
         return false;
 
-    uint8_t status = 0;
-
-    HAL_StatusTypeDef result = HAL_OK;
-    result = HAL_I2C_Mem_Read(device->i2c_handle, device->i2c_address, BME280_REG_STATUS,
-            I2C_MEMADD_SIZE_8BIT, &status, sizeof(status), HAL_MAX_DELAY);
-
-    if (result != HAL_OK)
-        return 0;
-
-    return status;
+    return (device->state == BME280_STATE_WRITE_TRIGGER || device->state == BME280_STATE_CONVERTING
+            || device->state == BME280_STATE_READ_DATA);
 }
 
-bool bme280_is_measuring(bme280_device *device)
+bool bme280_is_ready(bme280_device *device)
 {
     if (device == NULL)
         return false;
 
-    uint8_t status = bme280_get_status(device);
-    return (status & (1 << 3));
+    return (device->state == BME280_STATE_READY);
 }
 
-bool bme280_read_measurements(bme280_device *device, bme280_measurements *measurements)
+bool bme280_get_measurements(bme280_device *device, bme280_measurements *measurements)
 {
-    if (device == NULL || measurements == NULL)
+    if (device == NULL || measurements == NULL || !device->data_ready)
         return false;
 
-    int32_t adc_pressure = 0;
-    int32_t adc_temperature = 0;
-    int32_t adc_humidity = 0;
-    uint8_t buffer[BME280_MEASURE_DATA_LENGTH] = { 0 };
+    *measurements = device->measurements;
+    device->data_ready = false;
 
-    HAL_StatusTypeDef result = HAL_OK;
-    result = HAL_I2C_Mem_Read(device->i2c_handle, device->i2c_address, BME280_REG_PRESSUREDATA,
-            I2C_MEMADD_SIZE_8BIT, buffer, BME280_MEASURE_DATA_LENGTH, HAL_MAX_DELAY);
+    return true;
+}
 
-    if (result != HAL_OK)
+bool bme280_configure(bme280_device *device, bme280_mode mode, bme280_filter filter,
+        bme280_sampling temperature_sampling, bme280_sampling pressure_sampling,
+        bme280_sampling humidity_sampling)
+{
+    if (device == NULL || device->state != BME280_STATE_READY)
         return false;
 
-    adc_pressure = (buffer[0] << 12) | (buffer[1] << 4) | (buffer[2] >> 4);
-    adc_temperature = (buffer[3] << 12) | (buffer[4] << 4) | (buffer[5] >> 4);
-    adc_humidity = (buffer[6] << 8) | buffer[7];
+    /* Temperature is needed for the compensation of the other channels, which are published */
+    if ((mode != BMP280_MODE_FORCED && mode != BMP280_MODE_NORMAL) || filter > BMP280_FILTER_16
+        || temperature_sampling == BME280_SAMPLING_NONE || temperature_sampling > BME280_SAMPLING_X16
+        || pressure_sampling == BME280_SAMPLING_NONE || pressure_sampling > BME280_SAMPLING_X16
+        || humidity_sampling == BME280_SAMPLING_NONE || humidity_sampling > BME280_SAMPLING_X16)
+    {
+        return false;
+    }
 
-    measurements->temperature = compensate_temperature(device, adc_temperature);
-    measurements->pressure = compensate_pressure(device, adc_pressure);
-    measurements->humidity = compensate_humidity(device, adc_humidity);
+    device->mode = mode;
+    device->filter = filter;
+    device->temperature_sampling = temperature_sampling;
+    device->pressure_sampling = pressure_sampling;
+    device->humidity_sampling = humidity_sampling;
+    device->conversion_time = measurement_time(device);
 
-    return true;
+    /* Same sequence as initialization, configuration is only written in sleep mode */
+    return write_register(device, BME280_STATE_WRITE_SLEEP, BME280_REG_CTRLMEAS, BMP280_MODE_SLEEP);
 }
 
 /**
- * @brief Read senzor hardware id
- * @param device: Pointer to BME280 device
- * @return: The device hardware id value, this should be 0x60
+ * @brief I2C transfer completion, moves the driver to the next state
+ * @param result: Transfer result
+ * @param context: Pointer to BME280 device
  */
-static uint8_t read_hardware_id(bme280_device *device)
+static void transfer_completed(i2c_bus_result result, void *context)
 {
-    uint8_t hardware_id = 0;
+    bme280_device *device = (bme280_device *)context;
+    bool queued = true;
+
+    if (result != I2C_BUS_SUCCESS)
+    {
+        /* A failed measurement read keeps the device usable */
+        bool reading = bme280_is_busy(device);
+        set_state(device, reading ? BME280_STATE_READY : BME280_STATE_ERROR);
+        return;
+    }
 
-    HAL_StatusTypeDef result = HAL_OK;
-    result = HAL_I2C_Mem_Read(device->i2c_handle, device->i2c_address, BME280_REG_CHIPID,
-            I2C_MEMADD_SIZE_8BIT, &hardware_id, sizeof(hardware_id), HAL_MAX_DELAY);
+    switch (device->state)
+    {
+    case BME280_STATE_READ_ID:
+        device->hardware_id = device->buffer[0];
 
-    if (result != HAL_OK)
-        return 0;
+        if (device->hardware_id != BME280_DEFAULT_HW_ID)
+        {
+            queued = false;
+            break;
+        }
 
-    return hardware_id;
+        queued = write_register(device, BME280_STATE_RESET, BME280_REG_SOFTRESET,
+                BME280_RESET_COMMAND);
+        break;
+
+    case BME280_STATE_RESET:
+        set_state(device, BME280_STATE_STARTUP);
+        break;
+
+    case BME280_STATE_READ_UPDATE_STATUS:
+        /* Calibration data is still being copied from the NVM */
+        if (device->buffer[0] & BME280_STATUS_IM_UPDATE)
+        {
+            set_state(device, BME280_STATE_STARTUP);
+            break;
+        }
+
+        queued = read_register(device, BME280_STATE_READ_CALIB0, BME280_REG_CALIB0,
+                BME280_CALIB0_DATA_LENGTH);
+        break;
+
+    case BME280_STATE_READ_CALIB0:
+        queued = read_register(device, BME280_STATE_READ_CALIB26, BME280_REG_CALIB26,
+                BME280_CALIB26_DATA_LENGTH);
+        break;
+
+    case BME280_STATE_READ_CALIB26:
+        parse_calibration_data(device);
+
+        /* Put device to sleep first */
+        queued = write_register(device, BME280_STATE_WRITE_SLEEP, BME280_REG_CTRLMEAS,
+                BMP280_MODE_SLEEP);
+        break;
+
+    case BME280_STATE_WRITE_SLEEP:
+        queued = write_register(device, BME280_STATE_WRITE_CTRL_HUMIDITY, BME280_REG_CTRLHUMID,
+                device->humidity_sampling);
+        break;
+
+    case BME280_STATE_WRITE_CTRL_HUMIDITY:
+        queued = write_register(device, BME280_STATE_WRITE_CONFIG, BME280_REG_CONFIG,
+                (device->standby_duration << 5) | (device->filter << 2));
+        break;
+
+    case BME280_STATE_WRITE_CONFIG:
+        /* Forced mode stays asleep until a measurement is started */
+        queued = write_register(device, BME280_STATE_WRITE_CTRL_MEAS, BME280_REG_CTRLMEAS,
+                ctrl_meas_value(device, (device->mode == BMP280_MODE_FORCED)
+                        ? BMP280_MODE_SLEEP : device->mode));
+        break;
+
+    case BME280_STATE_WRITE_CTRL_MEAS:
+        set_state(device, BME280_STATE_READY);
+        break;
+
+    case BME280_STATE_WRITE_TRIGGER:
+        device->wait_time = device->conversion_time;
+        set_state(device, BME280_STATE_CONVERTING);
+        break;
+
+    case BME280_STATE_READ_DATA:
+        /* The forced conversion took longer than the datasheet maximum */
+        if (device->mode == BMP280_MODE_FORCED && (device->buffer[0] & BME280_STATUS_MEASURING))
+        {
+            device->wait_time = BME280_CONVERSION_POLL;
+            set_state(device, BME280_STATE_CONVERTING);
+            break;
+        }
+
+        parse_measurements(device);
+        set_state(device, BME280_STATE_READY);
+        break;
+
+    default:
+        break;
+    }
+
+    if (!queued)
+    {
+        set_state(device, BME280_STATE_ERROR);
+    }
 }
 
 /**
- * @brief Reset the device using soft-reset
+ * @brief Queue a register read into the transfer buffer
  * @param device: Pointer to BME280 device
- * @return: True if the device was restarted successfully, false otherwise
+ * @param state: State while the read is in progress
+ * @param reg: First register address
+ * @param length: Number of bytes to read
+ * @return: True if the read was queued, false otherwise
  */
-static bool soft_reset(bme280_device *device)
+static bool read_register(bme280_device *device, bme280_state state, uint8_t reg, uint16_t length)
 {
-    uint8_t command = BME280_RESET_COMMAND;
+    /* The second calibration block follows the first one in the buffer */
+    uint8_t *data = (state == BME280_STATE_READ_CALIB26)
+            ? &device->buffer[BME280_CALIB0_DATA_LENGTH] : device->buffer;
 
-    HAL_StatusTypeDef result = HAL_OK;
-    result = HAL_I2C_Mem_Read(device->i2c_handle, device->i2c_address, BME280_REG_SOFTRESET,
-            I2C_MEMADD_SIZE_8BIT, &command, sizeof(command), HAL_MAX_DELAY);
+    set_state(device, state);
 
-    return (result == HAL_OK);
+    return i2c_bus_read(device->i2c_address, reg, data, length, I2C_BUS_DEFAULT_TIMEOUT,
+            transfer_completed, device);
 }
 
 /**
- * @brief Read device status
+ * @brief Queue a single register write from the transfer buffer
  * @param device: Pointer to BME280 device
- * @return: Device status code
+ * @param state: State while the write is in progress
+ * @param reg: Register address
+ * @param value: Register value
+ * @return: True if the write was queued, false otherwise
  */
-static uint8_t read_status(bme280_device *device)
+static bool write_register(bme280_device *device, bme280_state state, uint8_t reg, uint8_t value)
 {
-    uint8_t status = 0;
+    device->buffer[0] = value;
+    set_state(device, state);
 
-    HAL_StatusTypeDef result = HAL_OK;
-    result = HAL_I2C_Mem_Read(device->i2c_handle, device->i2c_address, BME280_REG_STATUS,
-            I2C_MEMADD_SIZE_8BIT, &status, sizeof(status), HAL_MAX_DELAY);
+    return i2c_bus_write(device->i2c_address, reg, device->buffer, 1, I2C_BUS_DEFAULT_TIMEOUT,
+            transfer_completed, device);
+}
 
-    if (result != HAL_OK)
-        return 0;
+/**
+ * @brief Change the driver state
+ * @param device: Pointer to BME280 device
+ * @param state: New state
+ */
+static void set_state(bme280_device *device, bme280_state state)
+{
+    device->state = state;
+    device->state_time = HAL_GetTick();
+}
 
-    return status;
+/**
+ * @brief CTRL_MEAS register value for the oversampling settings
+ * @param device: Pointer to BME280 device
+ * @param mode: Mode written to the register
+ * @return: Register value
+ */
+static uint8_t ctrl_meas_value(bme280_device *device, bme280_mode mode)
+{
+    return (uint8_t)((device->temperature_sampling << 5) | (device->pressure_sampling << 2) | mode);
 }
 
 /**
- * @brief Read calibration data
+ * @brief Maximum measurement time from the BME280 datasheet, appendix B
  * @param device: Pointer to BME280 device
- * @return: True if calibration data was read successfully, false otherwise
+ * @return: Measurement time in ms, rounded up
  */
-static bool read_calibration_data(bme280_device *device)
+static uint8_t measurement_time(bme280_device *device)
 {
-    uint8_t calib0_data[BME280_CALIB0_DATA_LENGTH] = { 0 };
-    uint8_t calib26_data[BME280_CALIB26_DATA_LENGTH] = { 0 };
+    uint32_t time = 1250 + 2300 * sampling_factor[device->temperature_sampling];
 
-    HAL_StatusTypeDef result = HAL_OK;
-    result = HAL_I2C_Mem_Read(device->i2c_handle, device->i2c_address, BME280_REG_CALIB0,
-            I2C_MEMADD_SIZE_8BIT, calib0_data, BME280_CALIB0_DATA_LENGTH, HAL_MAX_DELAY);
+    if (device->pressure_sampling != BME280_SAMPLING_NONE)
+    {
+        time += 2300 * sampling_factor[device->pressure_sampling] + 575;
+    }
 
-    if (result != HAL_OK)
-        return false;
+    if (device->humidity_sampling != BME280_SAMPLING_NONE)
+    {
+        time += 2300 * sampling_factor[device->humidity_sampling] + 575;
+    }
 
-    result = HAL_I2C_Mem_Read(device->i2c_handle, device->i2c_address, BME280_REG_CALIB26,
-            I2C_MEMADD_SIZE_8BIT, calib26_data, BME280_CALIB26_DATA_LENGTH, HAL_MAX_DELAY);
+    /* Time is in us */
+    return (uint8_t)((time + 999) / 1000);
+}
 
-    if (result != HAL_OK)
-        return false;
+/**
+ * @brief Parse the calibration data read into the transfer buffer
+ * @param device: Pointer to BME280 device
+ */
+static void parse_calibration_data(bme280_device *device)
+{
+    const uint8_t *calib0_data = device->buffer;
+    const uint8_t *calib26_data = &device->buffer[BME280_CALIB0_DATA_LENGTH];
 
     /* Parse temperature compensation value */
     device->calibration_data.dig_t1 = CONCAT_BYTES(calib0_data[1], calib0_data[0]);
@@ -196,138 +360,33 @@ static bool read_calibration_data(bme280_device *device)
     device->calibration_data.dig_h5 = ((int16_t)(int8_t)calib26_data[5] * 16) | ((int16_t)(calib26_data[4] >> 4));
     device->calibration_data.dig_h6 = (int8_t)calib26_data[6];
 
-    return true;
-}
-
-/**
- * @brief Configure device sampling
- * @param device: Pointer to BME280 device
- * @return: True if the device was configured, false otherwise
- */
-static bool configure_sampling(bme280_device *device)
-{
-    uint8_t sleep = BMP280_MODE_SLEEP;
-    uint8_t config = (device->standby_duration << 5) | (device->filter << 2);
-    uint8_t ctrl = (device->temperature_sampling << 5) | (device->pressure_sampling << 2) | (device->mode);
-    uint8_t ctrl_hum = device->humidity_sampling;
-
-    /* Put device to sleep first */
-    HAL_StatusTypeDef result = HAL_OK;
-    result = HAL_I2C_Mem_Write(device->i2c_handle, device->i2c_address, BME280_REG_CTRLMEAS,
-            I2C_MEMADD_SIZE_8BIT, &sleep, sizeof(sleep), HAL_MAX_DELAY);
-
-    if (result != HAL_OK)
-        return false;
-
-    /* Write humidity register */
-    result = HAL_I2C_Mem_Write(device->i2c_handle, device->i2c_address, BME280_REG_CTRLHUMID,
-            I2C_MEMADD_SIZE_8BIT, &ctrl_hum, sizeof(ctrl_hum), HAL_MAX_DELAY);
-
-    if (result != HAL_OK)
-        return false;
-
-    /* Write config register */
-    result = HAL_I2C_Mem_Write(device->i2c_handle, device->i2c_address, BME280_REG_CONFIG,
-            I2C_MEMADD_SIZE_8BIT, &config, sizeof(config), HAL_MAX_DELAY);
-
-    if (result != HAL_OK)
-        return false;
-
-    /* Write ctrl register */
-    result = HAL_I2C_Mem_Write(device->i2c_handle, device->i2c_address, BME280_REG_CTRLMEAS,
-            I2C_MEMADD_SIZE_8BIT, &ctrl, sizeof(ctrl), HAL_MAX_DELAY);
-
-    if (result != HAL_OK)
-        return false;
-
-    return true;
+    bme280_compensation_init(&device->compensation, &device->calibration_data);
 }
 
 /**
- * @brief Temperature compensation algorithm from BME280 datasheet
+ * @brief Compensate the measurement data of a burst read
  * @param device: Pointer to BME280 device
- * @param adc_temperature: ADC reading for temperature
- * @return: Temperature value in degrees Celsius, resolution is 0.01 degrees Celsius.
  */
-static float compensate_temperature(bme280_device *device, int32_t adc_temperature)
+static void parse_measurements(bme280_device *device)
 {
-    int32_t var1 = 0;
-    int32_t var2 = 0;
-
-    var1 = ((((adc_temperature >> 3) - ((int32_t)device->calibration_data.dig_t1 << 1)))
-            * (int32_t)device->calibration_data.dig_t2) >> 11;
-    var2 = (((((adc_temperature >> 4) - (int32_t)device->calibration_data.dig_t1)
-            * ((adc_temperature >> 4) - (int32_t)device->calibration_data.dig_t1)) >> 12)
-            * (int32_t)device->calibration_data.dig_t3) >> 14;
-
-    /* Set fine temperature */
-    device->calibration_data.t_fine = var1 + var2;
-
-    float temperature = (device->calibration_data.t_fine * 5 + 128) >> 8;
-    return (temperature / 100);
-}
-
-/**
- * @brief Pressure compensation algorithm from BME280 datasheet
- * @param device: Pointer to BME280 device
- * @param adc_pressure: ADC reading for pressure
- * @return: Pressure value in Pa (Pascal).
- */
-static float compensate_pressure(bme280_device *device, int32_t adc_pressure)
-{
-    int64_t var1 = 0;
-    int64_t var2 = 0;
-    int64_t pressure = 0;
-
-    var1 = ((int64_t)device->calibration_data.t_fine) - 128000;
-    var2 = var1 * var1 * (int64_t)device->calibration_data.dig_p6;
-    var2 = var2 + ((var1 * (int64_t)device->calibration_data.dig_p5) << 17);
-    var2 = var2 + (((int64_t)device->calibration_data.dig_p4) << 35);
-    var1 = ((var1 * var1 * (int64_t)device->calibration_data.dig_p3) >> 8)
-            + ((var1 * (int64_t)device->calibration_data.dig_p2) << 12);
-
-    var1 = (((((int64_t)1) << 47) + var1)) * ((int64_t)device->calibration_data.dig_p1) >> 33;
-
-    if (var1 == 0)
-        return 0;
-
-    pressure = 1048576 - adc_pressure;
-    pressure = (((pressure << 31) - var2) * 3125) / var1;
-    var1 = (((int64_t)device->calibration_data.dig_p9) * (pressure >> 13) * (pressure >> 13)) >> 25;
-    var2 = (((int64_t)device->calibration_data.dig_p8) * pressure) >> 19;
-
-    pressure = ((pressure + var1 + var2) >> 8) + (((int64_t)device->calibration_data.dig_p7) << 4);
-
-    return ((float)pressure / 256);
-}
-
-/**
- * @brief Humidity compensation algorithm from BME280 datasheet
- * @param device: Pointer to BME280 device
- * @param adc_humidity: ADC reading for humidity
- * @return: Humidity value in %RH (relative humidity)
- */
-static float compensate_humidity(bme280_device *device, int32_t adc_humidity)
-{
-    int32_t v_x1_u32r = 0;
-    float humidity = 0;
-
-    v_x1_u32r = (device->calibration_data.t_fine - ((int32_t)76800));
-
-    v_x1_u32r = (((((adc_humidity << 14) - (((int32_t)device->calibration_data.dig_h4) << 20)
-            - (((int32_t)device->calibration_data.dig_h5) * v_x1_u32r)) + ((int32_t)16384)) >> 15)
-            * (((((((v_x1_u32r * ((int32_t)device->calibration_data.dig_h6)) >> 10)
-            * (((v_x1_u32r * ((int32_t)device->calibration_data.dig_h3)) >> 11)
-            + ((int32_t)32768))) >> 10) + ((int32_t)2097152))
-            * ((int32_t)device->calibration_data.dig_h2) + 8192) >> 14));
-
-    v_x1_u32r = (v_x1_u32r - (((((v_x1_u32r >> 15) * (v_x1_u32r >> 15)) >> 7)
-            * ((int32_t)device->calibration_data.dig_h1)) >> 4));
-
-    v_x1_u32r = (v_x1_u32r < 0) ? 0 : v_x1_u32r;
-    v_x1_u32r = (v_x1_u32r > 419430400) ? 419430400 : v_x1_u32r;
-
-    humidity = (v_x1_u32r >> 12);
-
-    return (humidity / 1024.0);
+    const uint8_t *buffer = &device->buffer[BME280_BURST_DATA_OFFSET];
+    int32_t adc_pressure = (buffer[0] << 12) | (buffer[1] << 4) | (buffer[2] >> 4);
+    int32_t adc_temperature = (buffer[3] << 12) | (buffer[4] << 4) | (buffer[5] >> 4);
+    int32_t adc_humidity = (buffer[6] << 8) | buffer[7];
+
+    int32_t t_fine = 0;
+
+    /* Temperature first, it sets the fine temperature used by the others */
+    device->measurements.temperature = bme280_compensate_temperature(&device->compensation,
+            adc_temperature, &t_fine);
+#if BME280_PRESSURE_32BIT
+    device->measurements.pressure = bme280_compensate_pressure_32(&device->compensation,
+            adc_pressure, t_fine);
+#else
+    device->measurements.pressure = bme280_compensate_pressure(&device->compensation,
+            adc_pressure, t_fine);
+#endif
+    device->measurements.humidity = bme280_compensate_humidity(&device->compensation,
+            adc_humidity, t_fine);
+    device->data_ready = true;
 }
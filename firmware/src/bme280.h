@@ -4,6 +4,8 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include "stm32g0xx_hal.h"
+#include "i2c_bus.h"
+#include "bme280_compensation.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -64,13 +66,54 @@ extern "C" {
  */
 #define BME280_CALIB0_DATA_LENGTH  26
 #define BME280_CALIB26_DATA_LENGTH 7
-#define BME280_MEASURE_DATA_LENGTH 8
+
+/**
+ * @brief Burst read from the status register to the end of the measurement data
+ */
+#define BME280_BURST_DATA_LENGTH 12
+#define BME280_BURST_DATA_OFFSET (BME280_REG_PRESSUREDATA - BME280_REG_STATUS)
 
 /**
  * @brief BME280 commands
  */
 #define BME280_RESET_COMMAND 0xb6
 
+/**
+ * @brief Status bits
+ */
+#define BME280_STATUS_IM_UPDATE (1 << 0)
+#define BME280_STATUS_MEASURING (1 << 3)
+
+/**
+ * @brief Timing related macros in ms
+ */
+#define BME280_STARTUP_TIME   2       /**< Time from soft reset to the first status poll */
+#define BME280_RETRY_INTERVAL 1000    /**< Time before initialization is retried after an error */
+#define BME280_CONVERSION_POLL 1       /**< Time before the data is read again if the conversion was not done */
+
+/**
+ * @brief Driver states, every transfer of a sequence has its own state
+ */
+typedef enum
+{
+    BME280_STATE_IDLE,                  /**< Not initialized */
+    BME280_STATE_READ_ID,               /**< Reading the chip id */
+    BME280_STATE_RESET,                 /**< Writing the soft reset command */
+    BME280_STATE_STARTUP,               /**< Waiting for the chip after reset */
+    BME280_STATE_READ_UPDATE_STATUS,    /**< Polling until the calibration data was copied */
+    BME280_STATE_READ_CALIB0,           /**< Reading the first calibration block */
+    BME280_STATE_READ_CALIB26,          /**< Reading the second calibration block */
+    BME280_STATE_WRITE_SLEEP,           /**< Putting the chip to sleep before configuration */
+    BME280_STATE_WRITE_CTRL_HUMIDITY,   /**< Writing humidity oversampling */
+    BME280_STATE_WRITE_CONFIG,          /**< Writing filter and standby configuration */
+    BME280_STATE_WRITE_CTRL_MEAS,       /**< Writing oversampling and mode */
+    BME280_STATE_READY,                 /**< Initialized, no transfer in progress */
+    BME280_STATE_WRITE_TRIGGER,         /**< Starting a forced mode conversion */
+    BME280_STATE_CONVERTING,            /**< Waiting for the forced mode conversion */
+    BME280_STATE_READ_DATA,             /**< Reading status and measurement data in one burst */
+    BME280_STATE_ERROR                  /**< Transfer failed, initialization is retried */
+} bme280_state;
+
 /**
  * @brief BME280 working mode
  */
@@ -122,44 +165,20 @@ typedef enum
 } bme280_standby;
 
 /**
- * @brief BME280 Calibration data
+ * @brief BME280 measurements
  */
 typedef struct
 {
-    /* Temperature compensation value */
-    uint16_t dig_t1;
-    int16_t  dig_t2;
-    int16_t  dig_t3;
-
-    /* Pressure compensation value */
-    uint16_t dig_p1;
-    int16_t  dig_p2;
-    int16_t  dig_p3;
-    int16_t  dig_p4;
-    int16_t  dig_p5;
-    int16_t  dig_p6;
-    int16_t  dig_p7;
-    int16_t  dig_p8;
-    int16_t  dig_p9;
-
-    /* Humidity compensation value */
-    uint16_t dig_h1;
-    int16_t  dig_h2;
-    int16_t  dig_h3;
-    uint16_t dig_h4;
-    int16_t  dig_h5;
-    int8_t   dig_h6;
-
-    /* Temperature with high resolution */
-    int32_t t_fine;
-} bme280_calibration_data;
+    uint32_t pressure;      /**< Pressure in Pa */
+    int32_t temperature;    /**< Temperature in 0.01 degC */
+    uint32_t humidity;      /**< Relative humidity in 0.001 % */
+} bme280_measurements;
 
 /**
  * @brief BME280 device
  */
 typedef struct
 {
-    I2C_HandleTypeDef *i2c_handle;               /**< I2C handle connected to the sensor */
     uint8_t i2c_address;                         /**< Sensor I2C address */
     uint8_t hardware_id;                         /**< Chip hardware Id */
     bme280_mode mode;                            /**< Working mode */
@@ -169,46 +188,76 @@ typedef struct
     bme280_sampling temperature_sampling;        /**< Temperature oversampling */
     bme280_sampling humidity_sampling;           /**< Humidity oversampling */
     bme280_calibration_data calibration_data;    /**< Calibration data */
+    bme280_compensation compensation;            /**< Constants derived from the calibration data */
+    uint8_t conversion_time;                     /**< Maximum conversion time in ms for the oversampling settings */
+    bme280_state state;                          /**< Driver state */
+    uint32_t state_time;                         /**< HAL tick when the state was entered */
+    uint32_t wait_time;                          /**< Time to wait in the converting state in ms */
+    uint8_t buffer[BME280_CALIB0_DATA_LENGTH + BME280_CALIB26_DATA_LENGTH];    /**< Transfer buffer */
+    bme280_measurements measurements;            /**< Last measurements */
+    bool data_ready;                             /**< New measurements were read */
 } bme280_device;
 
 /**
- * @brief BME280 measurements
+ * @brief Start BME280 initialization
+ *
+ * All transfers are queued on the I2C bus, the driver continues in the bus
+ * callbacks and in bme280_handler.
+ *
+ * @param device: Pointer to BME280 device
+ * @return: true if initialization was started, false otherwise
  */
-typedef struct
-{
-    float pressure;
-    float temperature;
-    float humidity;
-} bme280_measurements;
+bool bme280_init(bme280_device *device);
 
 /**
- * @brief BME180 initialization
+ * @brief BME280 handler, handles the startup delay and retries a failed initialization
  * @param device: Pointer to BME280 device
- * @return: true if device was initialized successfully, false otherwise
  */
-bool bme280_init(bme280_device *device);
+void bme280_handler(bme280_device *device);
 
 /**
- * @brief Get the device status
+ * @brief Start reading the measurements
+ * In forced mode a conversion is triggered and read after the conversion time.
  * @param device: Pointer to BME280 device
- * @return: The status of the BME280 sensor
+ * @return: true if the read was started, false if the device is not ready
  */
-uint8_t bme280_get_status(bme280_device *device);
+bool bme280_start_measurement(bme280_device *device);
 
 /**
- * @brief Check if the device is taking measurements
+ * @brief Check if a read started by bme280_start_measurement is in progress
  * @param device: Pointer to BME280 device
- * @return: true if the device is taking measurements, false otherwise
+ * @return: true if the device is reading, false otherwise
  */
-bool bme280_is_measuring(bme280_device *device);
+bool bme280_is_busy(bme280_device *device);
 
 /**
- * @brief Read measurements
+ * @brief Check if the device finished initialization and no read is in progress
+ * @param device: Pointer to BME280 device
+ * @return: true if a measurement can be started, false otherwise
+ */
+bool bme280_is_ready(bme280_device *device);
+
+/**
+ * @brief Get the measurements read since the last call
  * @param device: Pointer to BME280 device
  * @param measurements: Pointer to BME280 measurements structure
- * @return: true if measurements were read successfully, false otherwise
+ * @return: true if new measurements were copied, false otherwise
+ */
+bool bme280_get_measurements(bme280_device *device, bme280_measurements *measurements);
+
+/**
+ * @brief Change mode, filter and oversampling of an initialized device
+ * @param device: Pointer to BME280 device
+ * @param mode: BMP280_MODE_FORCED or BMP280_MODE_NORMAL
+ * @param filter: IIR filter coefficient
+ * @param temperature_sampling: Temperature oversampling, can not be BME280_SAMPLING_NONE
+ * @param pressure_sampling: Pressure oversampling, can not be BME280_SAMPLING_NONE
+ * @param humidity_sampling: Humidity oversampling, can not be BME280_SAMPLING_NONE
+ * @return: true if the configuration is written, false if it is invalid or the device is busy
  */
-bool bme280_read_measurements(bme280_device *device, bme280_measurements *measurements);
+bool bme280_configure(bme280_device *device, bme280_mode mode, bme280_filter filter,
+        bme280_sampling temperature_sampling, bme280_sampling pressure_sampling,
+        bme280_sampling humidity_sampling);
 
 #ifdef __cplusplus
 }
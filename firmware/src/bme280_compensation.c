@@ -0,0 +1,129 @@
+#include <stddef.h>
+#include "bme280_compensation.h"
+
+/**
+ * @brief Highest humidity result in Q22.10 before the final shift, 100 %RH
+ */
+#define HUMIDITY_LIMIT 419430400
+
+void bme280_compensation_init(bme280_compensation *compensation,
+        const bme280_calibration_data *calibration)
+{
+    if (compensation == NULL || calibration == NULL)
+        return;
+
+    compensation->t1 = calibration->dig_t1;
+    compensation->t1_x2 = (int32_t)calibration->dig_t1 << 1;
+    compensation->t2 = calibration->dig_t2;
+    compensation->t3 = calibration->dig_t3;
+
+    compensation->p4_q35 = (int64_t)calibration->dig_p4 * ((int64_t)1 << 35);
+    compensation->p4_q16 = (int32_t)calibration->dig_p4 * (1 << 16);
+    compensation->p7_q4 = (int32_t)calibration->dig_p7 * (1 << 4);
+    compensation->p1 = calibration->dig_p1;
+    compensation->p2 = calibration->dig_p2;
+    compensation->p3 = calibration->dig_p3;
+    compensation->p5 = calibration->dig_p5;
+    compensation->p6 = calibration->dig_p6;
+    compensation->p7 = calibration->dig_p7;
+    compensation->p8 = calibration->dig_p8;
+    compensation->p9 = calibration->dig_p9;
+
+    /* dig_h4 is a signed 12-bit value stored in a uint16_t */
+    compensation->h4_q20 = (int32_t)(int16_t)calibration->dig_h4 * (1 << 20);
+    compensation->h1 = calibration->dig_h1;
+    compensation->h2 = calibration->dig_h2;
+    compensation->h3 = calibration->dig_h3;
+    compensation->h5 = calibration->dig_h5;
+    compensation->h6 = calibration->dig_h6;
+}
+
+int32_t bme280_compensate_temperature(const bme280_compensation *compensation,
+        int32_t adc_temperature, int32_t *t_fine)
+{
+    int32_t delta = (adc_temperature >> 4) - compensation->t1;
+    int32_t var1 = (((adc_temperature >> 3) - compensation->t1_x2) * compensation->t2) >> 11;
+    int32_t var2 = (((delta * delta) >> 12) * compensation->t3) >> 14;
+
+    *t_fine = var1 + var2;
+
+    return (*t_fine * 5 + 128) >> 8;
+}
+
+uint32_t bme280_compensate_pressure(const bme280_compensation *compensation,
+        int32_t adc_pressure, int32_t t_fine)
+{
+    int64_t var1 = (int64_t)t_fine - 128000;
+    int64_t var1_squared = var1 * var1;
+    int64_t var2 = var1_squared * compensation->p6 + ((var1 * compensation->p5) << 17)
+            + compensation->p4_q35;
+
+    var1 = ((var1_squared * compensation->p3) >> 8) + ((var1 * compensation->p2) << 12);
+    var1 = ((((int64_t)1) << 47) + var1) * compensation->p1 >> 33;
+
+    if (var1 == 0)
+        return 0;
+
+    int64_t pressure = 1048576 - adc_pressure;
+    pressure = (((pressure << 31) - var2) * 3125) / var1;
+
+    int64_t scaled = pressure >> 13;
+    var1 = (compensation->p9 * scaled * scaled) >> 25;
+    var2 = (compensation->p8 * pressure) >> 19;
+
+    pressure = ((pressure + var1 + var2) >> 8) + compensation->p7_q4;
+
+    /* Result is in Q24.8 format, round to Pa */
+    return (uint32_t)((pressure + 128) >> 8);
+}
+
+uint32_t bme280_compensate_pressure_32(const bme280_compensation *compensation,
+        int32_t adc_pressure, int32_t t_fine)
+{
+    int32_t var1 = (t_fine >> 1) - 64000;
+    int32_t var1_squared = (var1 >> 2) * (var1 >> 2);
+    int32_t var2 = ((var1_squared >> 11) * compensation->p6) + ((var1 * compensation->p5) << 1);
+
+    var2 = (var2 >> 2) + compensation->p4_q16;
+    var1 = (((compensation->p3 * (var1_squared >> 13)) >> 3) + ((compensation->p2 * var1) >> 1)) >> 18;
+    var1 = ((32768 + var1) * compensation->p1) >> 15;
+
+    if (var1 == 0)
+        return 0;
+
+    uint32_t pressure = ((uint32_t)(1048576 - adc_pressure) - (uint32_t)(var2 >> 12)) * 3125;
+
+    /* Keep the most significant bit */
+    if (pressure < 0x80000000)
+    {
+        pressure = (pressure << 1) / (uint32_t)var1;
+    }
+    else
+    {
+        pressure = (pressure / (uint32_t)var1) * 2;
+    }
+
+    var1 = (compensation->p9 * (int32_t)(((pressure >> 3) * (pressure >> 3)) >> 13)) >> 12;
+    var2 = ((int32_t)(pressure >> 2) * compensation->p8) >> 13;
+
+    return (uint32_t)((int32_t)pressure + ((var1 + var2 + compensation->p7) >> 4));
+}
+
+uint32_t bme280_compensate_humidity(const bme280_compensation *compensation,
+        int32_t adc_humidity, int32_t t_fine)
+{
+    int32_t t = t_fine - 76800;
+    int32_t var = ((((adc_humidity << 14) - compensation->h4_q20 - (compensation->h5 * t)) + 16384) >> 15)
+            * (((((((t * compensation->h6) >> 10) * (((t * compensation->h3) >> 11) + 32768)) >> 10)
+            + 2097152) * compensation->h2 + 8192) >> 14);
+
+    var = var - (((((var >> 15) * (var >> 15)) >> 7) * compensation->h1) >> 4);
+
+    var = (var < 0) ? 0 : var;
+    var = (var > HUMIDITY_LIMIT) ? HUMIDITY_LIMIT : var;
+
+    /* Result is in Q22.10 format, at most 100 %RH so the product fits */
+    uint32_t humidity = (uint32_t)(var >> 12);
+
+    return (humidity * 1000 + 512) >> 10;
+}
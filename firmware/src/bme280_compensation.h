@@ -0,0 +1,140 @@
+#ifndef BME280_COMPENSATION_H
+#define BME280_COMPENSATION_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Pressure compensation variant used by the driver
+ *
+ * 0 uses the 64-bit datasheet algorithm, 1 the 32-bit one. The 32-bit
+ * variant has no 64-bit multiply or division, but test/bme280_compensation_test.c
+ * measures up to 6 Pa of error against the double precision algorithm,
+ * the 64-bit one stays below 1 Pa.
+ */
+#ifndef BME280_PRESSURE_32BIT
+#define BME280_PRESSURE_32BIT 0
+#endif
+
+/**
+ * @brief BME280 Calibration data
+ */
+typedef struct
+{
+    /* Temperature compensation value */
+    uint16_t dig_t1;
+    int16_t  dig_t2;
+    int16_t  dig_t3;
+
+    /* Pressure compensation value */
+    uint16_t dig_p1;
+    int16_t  dig_p2;
+    int16_t  dig_p3;
+    int16_t  dig_p4;
+    int16_t  dig_p5;
+    int16_t  dig_p6;
+    int16_t  dig_p7;
+    int16_t  dig_p8;
+    int16_t  dig_p9;
+
+    /* Humidity compensation value */
+    uint16_t dig_h1;
+    int16_t  dig_h2;
+    int16_t  dig_h3;
+    uint16_t dig_h4;
+    int16_t  dig_h5;
+    int8_t   dig_h6;
+} bme280_calibration_data;
+
+/**
+ * @brief Compensation constants derived from the calibration data
+ *
+ * Every constant is already widened and shifted as the datasheet
+ * algorithms use it, so a compensation is only arithmetic on registers.
+ */
+typedef struct
+{
+    /* Temperature */
+    int32_t t1;          /**< dig_t1 */
+    int32_t t1_x2;       /**< dig_t1 * 2 */
+    int32_t t2;          /**< dig_t2 */
+    int32_t t3;          /**< dig_t3 */
+
+    /* Pressure */
+    int64_t p4_q35;      /**< dig_p4 * 2^35, 64-bit variant */
+    int32_t p4_q16;      /**< dig_p4 * 2^16, 32-bit variant */
+    int32_t p7_q4;       /**< dig_p7 * 2^4, 64-bit variant */
+    int32_t p1;          /**< dig_p1 */
+    int32_t p2;          /**< dig_p2 */
+    int32_t p3;          /**< dig_p3 */
+    int32_t p5;          /**< dig_p5 */
+    int32_t p6;          /**< dig_p6 */
+    int32_t p7;          /**< dig_p7 */
+    int32_t p8;          /**< dig_p8 */
+    int32_t p9;          /**< dig_p9 */
+
+    /* Humidity */
+    int32_t h4_q20;      /**< dig_h4 * 2^20 */
+    int32_t h1;          /**< dig_h1 */
+    int32_t h2;          /**< dig_h2 */
+    int32_t h3;          /**< dig_h3 */
+    int32_t h5;          /**< dig_h5 */
+    int32_t h6;          /**< dig_h6 */
+} bme280_compensation;
+
+/**
+ * @brief Derive the compensation constants, once after the calibration data was read
+ * @param compensation: Pointer to compensation constants
+ * @param calibration: Pointer to calibration data
+ */
+void bme280_compensation_init(bme280_compensation *compensation,
+        const bme280_calibration_data *calibration);
+
+/**
+ * @brief Temperature compensation algorithm from BME280 datasheet
+ * @param compensation: Pointer to compensation constants
+ * @param adc_temperature: ADC reading for temperature
+ * @param t_fine: Fine temperature used by pressure and humidity compensation
+ * @return: Temperature in 0.01 degC
+ */
+int32_t bme280_compensate_temperature(const bme280_compensation *compensation,
+        int32_t adc_temperature, int32_t *t_fine);
+
+/**
+ * @brief 64-bit pressure compensation algorithm from BME280 datasheet
+ * @param compensation: Pointer to compensation constants
+ * @param adc_pressure: ADC reading for pressure
+ * @param t_fine: Fine temperature of the same measurement
+ * @return: Pressure in Pa, rounded from the Q24.8 result
+ */
+uint32_t bme280_compensate_pressure(const bme280_compensation *compensation,
+        int32_t adc_pressure, int32_t t_fine);
+
+/**
+ * @brief 32-bit pressure compensation algorithm from BME280 datasheet
+ * @param compensation: Pointer to compensation constants
+ * @param adc_pressure: ADC reading for pressure
+ * @param t_fine: Fine temperature of the same measurement
+ * @return: Pressure in Pa
+ */
+uint32_t bme280_compensate_pressure_32(const bme280_compensation *compensation,
+        int32_t adc_pressure, int32_t t_fine);
+
+/**
+ * @brief Humidity compensation algorithm from BME280 datasheet
+ * @param compensation: Pointer to compensation constants
+ * @param adc_humidity: ADC reading for humidity
+ * @param t_fine: Fine temperature of the same measurement
+ * @return: Relative humidity in 0.001 %
+ */
+uint32_t bme280_compensate_humidity(const bme280_compensation *compensation,
+        int32_t adc_humidity, int32_t t_fine);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* BME280_COMPENSATION_H */
@@ -1,99 +1,217 @@
 #include "ccs811.h"
 
+/**
+ * @brief Software reset sequence written to CCS811_SOFTWARE_RESET
+ */
+static uint8_t reset_sequence[4] = { 0x11, 0xE5, 0x72, 0x8A };
+
 /* CCS811 private functions */
-static bool software_reset(ccs811_device *device);
-static uint8_t read_status(ccs811_device *device);
-static bool start_application(ccs811_device *device);
-static bool configure_drive_mode(ccs811_device *device);
+static void transfer_completed(i2c_bus_result result, void *context);
+static void env_data_written(i2c_bus_result result, void *context);
+static void baseline_read(i2c_bus_result result, void *context);
+static void baseline_written(i2c_bus_result result, void *context);
+static bool read_register(ccs811_device *device, ccs811_state state, uint8_t reg, uint16_t length);
+static bool write_register(ccs811_device *device, ccs811_state state, uint8_t reg,
+        uint8_t *data, uint16_t length);
+static void set_state(ccs811_device *device, ccs811_state state);
+static void enter_ready(ccs811_device *device);
+static void configure_interrupt_pin(ccs811_device *device);
 
 bool ccs811_init(ccs811_device *device)
 {
     if (device == NULL)
         return false;
 
-    device->i2c_address = (uint8_t)(device->i2c_address << 1);
+    device->data_ready = false;
+    device->baseline_ready = false;
+    device->interrupt_pending = false;
+    configure_interrupt_pin(device);
 
-    if (!software_reset(device))
+    if (!write_register(device, CCS811_STATE_RESET, CCS811_SOFTWARE_RESET,
+            reset_sequence, sizeof(reset_sequence)))
+    {
+        set_state(device, CCS811_STATE_ERROR);
         return false;
+    }
 
-    HAL_Delay(75);
+    return true;
+}
 
-    uint8_t status = read_status(device);
-    if (status & CCS811_STATUS_ERROR || !(status & CCS811_APP_VALID))
-        return false;
+void ccs811_handler(ccs811_device *device)
+{
+    if (device == NULL)
+        return;
 
-    if (!start_application(device))
-        return false;
+    uint32_t elapsed = HAL_GetTick() - device->state_time;
+    bool queued = true;
 
-    HAL_Delay(75);
+    switch (device->state)
+    {
+    case CCS811_STATE_RESET_STARTUP:
+        if (elapsed >= CCS811_STARTUP_TIME)
+        {
+            queued = read_register(device, CCS811_STATE_READ_BOOT_STATUS, CCS811_STATUS, 1);
+        }
+        break;
+
+    case CCS811_STATE_APP_STARTUP:
+        if (elapsed >= CCS811_STARTUP_TIME)
+        {
+            queued = read_register(device, CCS811_STATE_READ_HW_ID, CCS811_HW_ID, 1);
+        }
+        break;
+
+    case CCS811_STATE_READY:
+        if (device->interrupt_pending)
+        {
+            /* ALG_RESULT_DATA also holds STATUS, reading it releases nINT */
+            device->interrupt_pending = false;
+
+            if (!read_register(device, CCS811_STATE_READ_DATA, CCS811_RESULT_DATA,
+                    CCS811_RESULT_DATA_LENGTH))
+            {
+                enter_ready(device);
+            }
+        }
+        break;
+
+    case CCS811_STATE_ERROR:
+        if (elapsed >= CCS811_RETRY_INTERVAL)
+        {
+            ccs811_init(device);
+        }
+        break;
+
+    default:
+        break;
+    }
 
-    HAL_StatusTypeDef result = HAL_OK;
-    result = HAL_I2C_Mem_Read(device->i2c_handle, device->i2c_address, CCS811_HW_ID,
-            I2C_MEMADD_SIZE_8BIT, &device->hardware_id, sizeof(device->hardware_id),
-            HAL_MAX_DELAY);
+    if (!queued)
+    {
+        set_state(device, CCS811_STATE_ERROR);
+    }
+}
 
-    if (result != HAL_OK)
+bool ccs811_start_measurement(ccs811_device *device)
+{
+    if (device == NULL)
         return false;
 
-    result = HAL_I2C_Mem_Read(device->i2c_handle, device->i2c_address, CCS811_HW_VERSION,
-            I2C_MEMADD_SIZE_8BIT, &device->hardware_version, sizeof(device->hardware_version),
-            HAL_MAX_DELAY);
+    if (device->interrupt_mode != CCS811_INTERRUPT_NONE)
+        return (device->state == CCS811_STATE_READY || ccs811_is_busy(device));
 
-    if (result != HAL_OK)
+    if (device->state != CCS811_STATE_READY)
         return false;
 
-    if (device->hardware_id != CCS811_DEFAULT_HW_ID)
+    return read_register(device, CCS811_STATE_READ_STATUS, CCS811_STATUS, 1);
+}
+
+bool ccs811_is_busy(ccs811_device *device)
+{
+    if (device == NULL)
         return false;
 
-    if (!configure_drive_mode(device))
+    return (device->state == CCS811_STATE_READ_STATUS || device->state == CCS811_STATE_READ_DATA);
+}
+
+bool ccs811_is_ready(ccs811_device *device)
+{
+    if (device == NULL)
         return false;
 
+    return (device->state == CCS811_STATE_READY);
+}
+
+bool ccs811_get_measurements(ccs811_device *device, ccs811_measurements *measurements)
+{
+    if (device == NULL || measurements == NULL || !device->data_ready)
+        return false;
+
+    *measurements = device->measurements;
+    device->data_ready = false;
+
     return true;
 }
 
-bool ccs811_data_available(ccs811_device *device)
+bool ccs811_set_drive_mode(ccs811_device *device, ccs811_drive_mode mode)
 {
-    if (device == NULL)
+    if (device == NULL || device->state != CCS811_STATE_READY || mode > CCS811_DRIVE_RAW)
         return false;
 
-    uint8_t status = read_status(device);
-    return (status && CCS811_DATA_READY);
+    device->drive_mode = mode;
+
+    /* Same sequence as initialization, the mode register is read and written back */
+    return read_register(device, CCS811_STATE_READ_MEAS_MODE, CCS811_MEASURE_MODE, 1);
 }
 
-uint16_t ccs811_get_baseline(ccs811_device *device)
+bool ccs811_set_interrupt_mode(ccs811_device *device, ccs811_interrupt_mode mode,
+        const ccs811_thresholds *thresholds)
 {
-    if (device == NULL)
-        return 0;
+    if (device == NULL || device->state != CCS811_STATE_READY)
+        return false;
 
-    uint8_t buffer[2];
-    HAL_StatusTypeDef result = HAL_OK;
-    result = HAL_I2C_Mem_Read(device->i2c_handle, device->i2c_address, CCS811_BASELINE,
-            I2C_MEMADD_SIZE_8BIT, buffer, 2, HAL_MAX_DELAY);
+    if (mode == CCS811_INTERRUPT_THRESHOLD && thresholds == NULL)
+        return false;
 
-    if (result != HAL_OK)
-        return 0;
+    device->interrupt_mode = mode;
+    configure_interrupt_pin(device);
 
-    return ((uint16_t)buffer[0] << 8) | ((uint16_t)buffer[1]);
+    if (thresholds != NULL)
+    {
+        device->thresholds = *thresholds;
+    }
+
+    /* Same sequence as initialization, the mode register is read and written back */
+    return read_register(device, CCS811_STATE_READ_MEAS_MODE, CCS811_MEASURE_MODE, 1);
 }
 
-bool ccs811_set_baseline(ccs811_device *device, uint16_t baseline)
+void ccs811_interrupt_callback(ccs811_device *device)
 {
-    if (device == NULL)
+    if (device == NULL || device->interrupt_mode == CCS811_INTERRUPT_NONE)
+        return;
+
+    device->interrupt_pending = true;
+    scheduler_post(device->interrupt_task);
+}
+
+bool ccs811_request_baseline(ccs811_device *device)
+{
+    if (device == NULL || device->state != CCS811_STATE_READY || device->baseline_pending)
         return false;
 
-    uint8_t buffer[] = {
-        (uint8_t)((baseline >> 8) & 0xFF),
-        (uint8_t)(baseline & 0xFF)
-    };
+    device->baseline_ready = false;
+    device->baseline_pending = i2c_bus_read(device->i2c_address, CCS811_BASELINE,
+            device->baseline_buffer, sizeof(device->baseline_buffer), I2C_BUS_DEFAULT_TIMEOUT,
+            baseline_read, device);
+
+    return device->baseline_pending;
+}
 
-    HAL_StatusTypeDef result = HAL_OK;
-    result = HAL_I2C_Mem_Write(device->i2c_handle, device->i2c_address, CCS811_BASELINE,
-            I2C_MEMADD_SIZE_8BIT, buffer, 2, HAL_MAX_DELAY);
+bool ccs811_get_baseline(ccs811_device *device, uint16_t *baseline)
+{
+    if (device == NULL || baseline == NULL || !device->baseline_ready)
+        return false;
 
-    return (result == HAL_OK);
+    *baseline = ((uint16_t)device->baseline_buffer[0] << 8) | ((uint16_t)device->baseline_buffer[1]);
+    return true;
 }
 
-bool ccs811_set_environmental_data(ccs811_device *device, float humidity, float temperature)
+bool ccs811_set_baseline(ccs811_device *device, uint16_t baseline)
+{
+    if (device == NULL || device->state != CCS811_STATE_READY || device->baseline_pending)
+        return false;
+
+    device->baseline_buffer[0] = (uint8_t)((baseline >> 8) & 0xFF);
+    device->baseline_buffer[1] = (uint8_t)(baseline & 0xFF);
+    device->baseline_ready = false;
+    device->baseline_pending = i2c_bus_write(device->i2c_address, CCS811_BASELINE,
+            device->baseline_buffer, sizeof(device->baseline_buffer), I2C_BUS_DEFAULT_TIMEOUT,
+            baseline_written, device);
+
+    return device->baseline_pending;
+}
+
+bool ccs811_set_environmental_data(ccs811_device *device, uint32_t humidity, int32_t temperature)
 {
     if (device == NULL)
         return false;
@@ -104,117 +222,303 @@ bool ccs811_set_environmental_data(ccs811_device *device, float humidity, float
         return false;
     }
 
+    /* The register is written again with the next measurement */
+    if (device->state != CCS811_STATE_READY && !ccs811_is_busy(device))
+        return false;
+
+    if (device->env_pending)
+        return false;
+
     device->env_data.humidity = humidity;
     device->env_data.temperature = temperature;
 
-    uint16_t hum = humidity * 512.0f + 0.5f;
-    uint16_t temp = (temperature + 25.0f) * 512.0f + 0.5f;
+    /* Register values are in 1/512 units, temperature is offset by 25 degC */
+    int32_t offset_temperature = (temperature < -2500) ? 0 : temperature + 2500;
+    uint16_t hum = (uint16_t)((humidity * 512 + 500) / 1000);
+    uint16_t temp = (uint16_t)((offset_temperature * 512 + 50) / 100);
 
-    uint8_t buffer[] = {
-        (uint8_t)((hum >> 8) & 0xFF),
-        (uint8_t)(hum & 0xFF),
-        (uint8_t)((temp >> 8) & 0xFF),
-        (uint8_t)(temp & 0xFF)
-    };
+    device->env_buffer[0] = (uint8_t)((hum >> 8) & 0xFF);
+    device->env_buffer[1] = (uint8_t)(hum & 0xFF);
+    device->env_buffer[2] = (uint8_t)((temp >> 8) & 0xFF);
+    device->env_buffer[3] = (uint8_t)(temp & 0xFF);
 
-    HAL_StatusTypeDef result = HAL_OK;
-    result = HAL_I2C_Mem_Write(device->i2c_handle, device->i2c_address, CCS811_ENV_DATA,
-            I2C_MEMADD_SIZE_8BIT, buffer, 4, HAL_MAX_DELAY);
+    device->env_pending = i2c_bus_write(device->i2c_address, CCS811_ENV_DATA,
+            device->env_buffer, sizeof(device->env_buffer), I2C_BUS_DEFAULT_TIMEOUT,
+            env_data_written, device);
 
-    return (result == HAL_OK);
+    return device->env_pending;
 }
 
-bool ccs811_read_measurements(ccs811_device *device, ccs811_measurements *measurements)
+/**
+ * @brief I2C transfer completion, moves the driver to the next state
+ * @param result: Transfer result
+ * @param context: Pointer to CCS811 device
+ */
+static void transfer_completed(i2c_bus_result result, void *context)
 {
-    if (device == NULL)
-        return false;
+    ccs811_device *device = (ccs811_device *)context;
+    bool queued = true;
+
+    if (result != I2C_BUS_SUCCESS)
+    {
+        /* A failed measurement read keeps the device usable */
+        if (ccs811_is_busy(device))
+        {
+            enter_ready(device);
+        }
+        else
+        {
+            set_state(device, CCS811_STATE_ERROR);
+        }
+        return;
+    }
+
+    switch (device->state)
+    {
+    case CCS811_STATE_RESET:
+        set_state(device, CCS811_STATE_RESET_STARTUP);
+        break;
+
+    case CCS811_STATE_READ_BOOT_STATUS:
+        if ((device->buffer[0] & CCS811_STATUS_ERROR) || !(device->buffer[0] & CCS811_APP_VALID))
+        {
+            queued = false;
+            break;
+        }
+
+        /* Application start is a write of the register address only */
+        queued = write_register(device, CCS811_STATE_APP_START, CCS811_APP_START, NULL, 0);
+        break;
+
+    case CCS811_STATE_APP_START:
+        set_state(device, CCS811_STATE_APP_STARTUP);
+        break;
+
+    case CCS811_STATE_READ_HW_ID:
+        device->hardware_id = device->buffer[0];
+
+        if (device->hardware_id != CCS811_DEFAULT_HW_ID)
+        {
+            queued = false;
+            break;
+        }
+
+        queued = read_register(device, CCS811_STATE_READ_HW_VERSION, CCS811_HW_VERSION, 1);
+        break;
+
+    case CCS811_STATE_READ_HW_VERSION:
+        device->hardware_version = device->buffer[0];
+        queued = read_register(device, CCS811_STATE_READ_MEAS_MODE, CCS811_MEASURE_MODE, 1);
+        break;
+
+    case CCS811_STATE_READ_MEAS_MODE:
+        device->buffer[0] &= ~(CCS811_MEAS_MODE_DRIVE_MASK | CCS811_MEAS_MODE_INT_DATARDY
+                | CCS811_MEAS_MODE_INT_THRESH);
+        device->buffer[0] |= ((uint8_t)device->drive_mode << 4);
+
+        /* Threshold interrupts need the data ready interrupt enabled too */
+        if (device->interrupt_mode != CCS811_INTERRUPT_NONE)
+        {
+            device->buffer[0] |= CCS811_MEAS_MODE_INT_DATARDY;
+        }
+
+        if (device->interrupt_mode == CCS811_INTERRUPT_THRESHOLD)
+        {
+            device->buffer[0] |= CCS811_MEAS_MODE_INT_THRESH;
+            device->buffer[1] = (uint8_t)((device->thresholds.low_to_medium >> 8) & 0xFF);
+            device->buffer[2] = (uint8_t)(device->thresholds.low_to_medium & 0xFF);
+            device->buffer[3] = (uint8_t)((device->thresholds.medium_to_high >> 8) & 0xFF);
+            device->buffer[4] = (uint8_t)(device->thresholds.medium_to_high & 0xFF);
+            device->buffer[5] = device->thresholds.hysteresis;
+
+            queued = write_register(device, CCS811_STATE_WRITE_THRESHOLDS, CCS811_THRESHOLDS,
+                    &device->buffer[1], 5);
+            break;
+        }
+
+        queued = write_register(device, CCS811_STATE_WRITE_MEAS_MODE, CCS811_MEASURE_MODE,
+                device->buffer, 1);
+        break;
+
+    case CCS811_STATE_WRITE_THRESHOLDS:
+        queued = write_register(device, CCS811_STATE_WRITE_MEAS_MODE, CCS811_MEASURE_MODE,
+                device->buffer, 1);
+        break;
+
+    case CCS811_STATE_WRITE_MEAS_MODE:
+        enter_ready(device);
+        break;
+
+    case CCS811_STATE_READ_STATUS:
+        if (!(device->buffer[0] & CCS811_DATA_READY))
+        {
+            set_state(device, CCS811_STATE_READY);
+            break;
+        }
+
+        if (!read_register(device, CCS811_STATE_READ_DATA, CCS811_RESULT_DATA,
+                CCS811_RESULT_DATA_LENGTH))
+        {
+            set_state(device, CCS811_STATE_READY);
+        }
+        break;
+
+    case CCS811_STATE_READ_DATA:
+        device->measurements.eco2 = ((uint16_t)device->buffer[0] << 8) | ((uint16_t)device->buffer[1]);
+        device->measurements.tvoc = ((uint16_t)device->buffer[2] << 8) | ((uint16_t)device->buffer[3]);
+        device->measurements.current_selected = ((uint16_t)device->buffer[6] >> 2);
+        device->measurements.raw_adc = ((uint16_t)(device->buffer[6] & 3) << 8)
+                | ((uint16_t)device->buffer[7]);
+        device->data_ready = true;
+        enter_ready(device);
+        break;
+
+    default:
+        break;
+    }
 
-     uint8_t buffer[8];
-     HAL_StatusTypeDef result = HAL_OK;
-     result = HAL_I2C_Mem_Read(device->i2c_handle, device->i2c_address, CCS811_RESULT_DATA,
-             I2C_MEMADD_SIZE_8BIT, buffer, 8, HAL_MAX_DELAY);
+    if (!queued)
+    {
+        set_state(device, CCS811_STATE_ERROR);
+    }
+}
 
-     if (result != HAL_OK)
-         return false;
+/**
+ * @brief ENV_DATA write completion
+ * @param result: Transfer result
+ * @param context: Pointer to CCS811 device
+ */
+static void env_data_written(i2c_bus_result result, void *context)
+{
+    ccs811_device *device = (ccs811_device *)context;
 
-     measurements->eco2 = ((uint16_t)buffer[0] << 8) | ((uint16_t)buffer[1]);
-     measurements->tvoc = ((uint16_t)buffer[2] << 8) | ((uint16_t)buffer[3]);
-     measurements->current_selected = ((uint16_t)buffer[6] >> 2);
-     measurements->raw_adc = ((uint16_t)(buffer[6] & 3) << 8) | ((uint16_t)buffer[7]);
+    device->env_pending = false;
 
-     return true;
+    /* Write the same values again next time */
+    if (result != I2C_BUS_SUCCESS)
+    {
+        device->env_data.humidity = 0;
+        device->env_data.temperature = 0;
+    }
 }
 
 /**
- * @brief Reset the internal software
- * @param device: Pointer to BME280 device
- * @return: True if the device was restarted successfully, false otherwise
+ * @brief BASELINE read completion
+ * @param result: Transfer result
+ * @param context: Pointer to CCS811 device
  */
-static bool software_reset(ccs811_device *device)
+static void baseline_read(i2c_bus_result result, void *context)
 {
-    uint8_t buffer[4] = { 0x11, 0xE5, 0x72, 0x8A };
+    ccs811_device *device = (ccs811_device *)context;
 
-    HAL_StatusTypeDef result = HAL_OK;
-    result = HAL_I2C_Mem_Write(device->i2c_handle, device->i2c_address,
-            CCS811_SOFTWARE_RESET, I2C_MEMADD_SIZE_8BIT, buffer, 4, HAL_MAX_DELAY);
+    device->baseline_pending = false;
+    device->baseline_ready = (result == I2C_BUS_SUCCESS);
+}
 
-    return (result == HAL_OK);
+/**
+ * @brief BASELINE write completion
+ * @param result: Transfer result
+ * @param context: Pointer to CCS811 device
+ */
+static void baseline_written(i2c_bus_result result, void *context)
+{
+    ccs811_device *device = (ccs811_device *)context;
+
+    device->baseline_pending = false;
+    device->baseline_ready = (result == I2C_BUS_SUCCESS);
 }
 
 /**
- * @brief Read the status value from the register
- * @param device: Pointer to BME280 device
- * @return: The device status code
+ * @brief Queue a register read into the transfer buffer
+ * @param device: Pointer to CCS811 device
+ * @param state: State while the read is in progress
+ * @param reg: First register address
+ * @param length: Number of bytes to read
+ * @return: True if the read was queued, false otherwise
  */
-static uint8_t read_status(ccs811_device *device)
+static bool read_register(ccs811_device *device, ccs811_state state, uint8_t reg, uint16_t length)
 {
-    uint8_t status = 0;
-    HAL_StatusTypeDef result = HAL_OK;
-    result = HAL_I2C_Mem_Read(device->i2c_handle, device->i2c_address, CCS811_STATUS,
-            I2C_MEMADD_SIZE_8BIT, &status, sizeof(status), HAL_MAX_DELAY);
+    set_state(device, state);
 
-    if (result != HAL_OK)
-        return 0;
+    return i2c_bus_read(device->i2c_address, reg, device->buffer, length, I2C_BUS_DEFAULT_TIMEOUT,
+            transfer_completed, device);
+}
 
-    return status;
+/**
+ * @brief Queue a register write
+ * @param device: Pointer to CCS811 device
+ * @param state: State while the write is in progress
+ * @param reg: Register address
+ * @param data: Register data, must stay valid until completion
+ * @param length: Number of bytes, 0 writes only the register address
+ * @return: True if the write was queued, false otherwise
+ */
+static bool write_register(ccs811_device *device, ccs811_state state, uint8_t reg,
+        uint8_t *data, uint16_t length)
+{
+    set_state(device, state);
+
+    return i2c_bus_write(device->i2c_address, reg, data, length, I2C_BUS_DEFAULT_TIMEOUT,
+            transfer_completed, device);
 }
 
 /**
- * @brief Start internal application
- * @param device: Pointer to BME280 device
- * @return: True if the application was started successfully, false otherwise
+ * @brief Enter the ready state, data already signaled by nINT is read
+ *
+ * nINT stays low until the result data is read, an edge before the EXTI was
+ * armed or during a read would otherwise be lost.
+ *
+ * @param device: Pointer to CCS811 device
  */
-static bool start_application(ccs811_device *device)
+static void enter_ready(ccs811_device *device)
 {
-    uint8_t data = CCS811_APP_START;
-    HAL_StatusTypeDef result = HAL_OK;
-    result = HAL_I2C_Master_Transmit(device->i2c_handle, device->i2c_address, &data,
-            sizeof(data), HAL_MAX_DELAY);
+    set_state(device, CCS811_STATE_READY);
+
+    if (device->interrupt_mode == CCS811_INTERRUPT_NONE || device->interrupt_port == NULL)
+        return;
 
-    return (result == HAL_OK);
+    if (HAL_GPIO_ReadPin(device->interrupt_port, device->interrupt_pin) == GPIO_PIN_RESET)
+    {
+        device->interrupt_pending = true;
+        scheduler_post(device->interrupt_task);
+    }
 }
 
 /**
- * @brief Configure CCS811 drive mode
- * @param device: Pointer to BME280 device
- * @return: True if the device was configured successfully, false otherwise
+ * @brief Arm the falling edge EXTI of nINT for the nINT modes, a plain input otherwise
+ * @param device: Pointer to CCS811 device
  */
-static bool configure_drive_mode(ccs811_device *device)
+static void configure_interrupt_pin(ccs811_device *device)
 {
-    uint8_t value = 0;
-    uint8_t mode = (uint8_t)device->drive_mode;
-    HAL_StatusTypeDef result = HAL_OK;
-    result = HAL_I2C_Mem_Read(device->i2c_handle, device->i2c_address, CCS811_MEASURE_MODE,
-            I2C_MEMADD_SIZE_8BIT, &value, sizeof(value), HAL_MAX_DELAY);
+    if (device->interrupt_port == NULL)
+        return;
 
-    if (result != HAL_OK)
-        return false;
+    GPIO_InitTypeDef GPIO_InitStruct = { 0 };
+    bool enabled = (device->interrupt_mode != CCS811_INTERRUPT_NONE);
+
+    HAL_NVIC_DisableIRQ(device->interrupt_irq);
 
-    value &= ~(0b00000111 << 4);
-    value |= (mode << 4);
+    /* nINT is open drain and active low, an unconnected pin is held high */
+    GPIO_InitStruct.Pin = device->interrupt_pin;
+    GPIO_InitStruct.Mode = enabled ? GPIO_MODE_IT_FALLING : GPIO_MODE_INPUT;
+    GPIO_InitStruct.Pull = GPIO_PULLUP;
+    HAL_GPIO_Init(device->interrupt_port, &GPIO_InitStruct);
 
-    result = HAL_I2C_Mem_Write(device->i2c_handle, device->i2c_address, CCS811_MEASURE_MODE,
-            I2C_MEMADD_SIZE_8BIT, &value, sizeof(value) + 1, HAL_MAX_DELAY);
+    if (enabled)
+    {
+        __HAL_GPIO_EXTI_CLEAR_FALLING_IT(device->interrupt_pin);
+        HAL_NVIC_SetPriority(device->interrupt_irq, 0, 0);
+        HAL_NVIC_EnableIRQ(device->interrupt_irq);
+    }
+}
 
-    return (result == HAL_OK);
+/**
+ * @brief Change the driver state
+ * @param device: Pointer to CCS811 device
+ * @param state: New state
+ */
+static void set_state(ccs811_device *device, ccs811_state state)
+{
+    device->state = state;
+    device->state_time = HAL_GetTick();
 }
@@ -4,6 +4,8 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include "stm32g0xx_hal.h"
+#include "i2c_bus.h"
+#include "scheduler.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -51,6 +53,20 @@ extern "C" {
  */
 #define CCS811_DEFAULT_HW_ID 0x81
 
+/**
+ * @brief MEAS_MODE register bits
+ */
+#define CCS811_MEAS_MODE_DRIVE_MASK  (0b00000111 << 4)
+#define CCS811_MEAS_MODE_INT_DATARDY (1 << 3)
+#define CCS811_MEAS_MODE_INT_THRESH  (1 << 2)
+
+/**
+ * @brief Default eCO2 thresholds in ppm, from the datasheet
+ */
+#define CCS811_DEFAULT_LOW_TO_MEDIUM  1500
+#define CCS811_DEFAULT_MEDIUM_TO_HIGH 2500
+#define CCS811_DEFAULT_HYSTERESIS     50
+
 /**
  * @brief Default I2C address
  *
@@ -59,6 +75,40 @@ extern "C" {
  */
 #define CCS811_DEFAULT_ADDRESS 0x5a
 
+/**
+ * @brief Timing related macros in ms
+ */
+#define CCS811_STARTUP_TIME   75      /**< Time after reset and after starting the application */
+#define CCS811_RETRY_INTERVAL 1000    /**< Time before initialization is retried after an error */
+#define CCS811_MODE_IDLE_TIME (10UL * 60 * 1000)    /**< Idle time before a mode with a lower sample rate */
+
+/**
+ * @brief Length of the result data block
+ */
+#define CCS811_RESULT_DATA_LENGTH 8
+
+/**
+ * @brief Driver states, every transfer of a sequence has its own state
+ */
+typedef enum
+{
+    CCS811_STATE_IDLE,                 /**< Not initialized */
+    CCS811_STATE_RESET,                /**< Writing the software reset sequence */
+    CCS811_STATE_RESET_STARTUP,        /**< Waiting for the boot loader after reset */
+    CCS811_STATE_READ_BOOT_STATUS,     /**< Checking for a valid application */
+    CCS811_STATE_APP_START,            /**< Starting the application */
+    CCS811_STATE_APP_STARTUP,          /**< Waiting for the application */
+    CCS811_STATE_READ_HW_ID,           /**< Reading the hardware id */
+    CCS811_STATE_READ_HW_VERSION,      /**< Reading the hardware version */
+    CCS811_STATE_READ_MEAS_MODE,       /**< Reading the measurement mode */
+    CCS811_STATE_WRITE_THRESHOLDS,     /**< Writing the eCO2 thresholds */
+    CCS811_STATE_WRITE_MEAS_MODE,      /**< Writing the drive and interrupt mode */
+    CCS811_STATE_READY,                /**< Initialized, no transfer in progress */
+    CCS811_STATE_READ_STATUS,          /**< Reading the status before the result data */
+    CCS811_STATE_READ_DATA,            /**< Reading the result data */
+    CCS811_STATE_ERROR                 /**< Transfer failed, initialization is retried */
+} ccs811_state;
+
 /**
  * @brief CCS811 drive modes
  */
@@ -72,26 +122,33 @@ typedef enum
 } ccs811_drive_mode;
 
 /**
- * @brief CCS811 environmental data
+ * @brief CCS811 nINT modes
+ */
+typedef enum
+{
+    CCS811_INTERRUPT_NONE,          /**< nINT not used, STATUS is read for every measurement */
+    CCS811_INTERRUPT_DATA_READY,    /**< nINT asserted for every new measurement */
+    CCS811_INTERRUPT_THRESHOLD      /**< nINT asserted when eCO2 moves to another threshold band */
+} ccs811_interrupt_mode;
+
+/**
+ * @brief CCS811 eCO2 thresholds
  */
 typedef struct
 {
-    float humidity;       /**< Humidity value used for the measurement algorithm */
-    float temperature;    /**< temperature value used for the measurement algorithm */
-} ccs811_environmental_data;
+    uint16_t low_to_medium;     /**< Boundary between the low and medium band in ppm */
+    uint16_t medium_to_high;    /**< Boundary between the medium and high band in ppm */
+    uint8_t hysteresis;         /**< Hysteresis of both boundaries in ppm */
+} ccs811_thresholds;
 
 /**
- * @brief CCS811 device
+ * @brief CCS811 environmental data
  */
 typedef struct
 {
-    I2C_HandleTypeDef *i2c_handle;         /**< I2C handle connected to the sensor */
-    uint8_t i2c_address;                   /**< Sensor I2C address */
-    ccs811_drive_mode drive_mode;          /**< Sensor drive mode */
-    uint8_t hardware_id;                   /**< Sensor hardware ID */
-    uint8_t hardware_version;              /**< Sensor hardware version */
-    ccs811_environmental_data env_data;    /**< Environmental data used for the measurement algorithm */
-} ccs811_device;
+    uint32_t humidity;      /**< Humidity used for the measurement algorithm in 0.001 % */
+    int32_t temperature;    /**< Temperature used for the measurement algorithm in 0.01 degC */
+} ccs811_environmental_data;
 
 /**
  * @brief CCS811 measurements
@@ -105,50 +162,147 @@ typedef struct
 } ccs811_measurements;
 
 /**
- * @brief Initialize sensor
+ * @brief CCS811 device
+ */
+typedef struct
+{
+    uint8_t i2c_address;                   /**< Sensor I2C address */
+    ccs811_drive_mode drive_mode;          /**< Sensor drive mode */
+    ccs811_interrupt_mode interrupt_mode;  /**< nINT mode */
+    ccs811_thresholds thresholds;          /**< eCO2 thresholds of CCS811_INTERRUPT_THRESHOLD */
+    GPIO_TypeDef *interrupt_port;          /**< nINT GPIO port */
+    uint16_t interrupt_pin;                /**< nINT GPIO pin */
+    IRQn_Type interrupt_irq;               /**< EXTI interrupt of the nINT pin */
+    scheduler_task *interrupt_task;        /**< Task calling ccs811_handler, posted on nINT */
+    volatile bool interrupt_pending;       /**< nINT was asserted */
+    uint8_t hardware_id;                   /**< Sensor hardware ID */
+    uint8_t hardware_version;              /**< Sensor hardware version */
+    ccs811_environmental_data env_data;    /**< Environmental data used for the measurement algorithm */
+    ccs811_state state;                    /**< Driver state */
+    uint32_t state_time;                   /**< HAL tick when the state was entered */
+    uint8_t buffer[CCS811_RESULT_DATA_LENGTH];    /**< Transfer buffer of the state machine */
+    uint8_t env_buffer[4];                 /**< ENV_DATA register value being written */
+    bool env_pending;                      /**< ENV_DATA write in progress */
+    uint8_t baseline_buffer[2];            /**< BASELINE register value being read or written */
+    bool baseline_pending;                 /**< BASELINE transfer in progress */
+    bool baseline_ready;                   /**< Baseline buffer matches the sensor, after a read or a write */
+    ccs811_measurements measurements;      /**< Last measurements */
+    bool data_ready;                       /**< New measurements were read */
+} ccs811_device;
+
+/**
+ * @brief Start sensor initialization
+ *
+ * All transfers are queued on the I2C bus, the driver continues in the bus
+ * callbacks and in ccs811_handler.
+ *
  * @param device: Pointer to CCS811 device
- * @return: true if device was initialized successfully, false otherwise
+ * @return: true if initialization was started, false otherwise
  */
 bool ccs811_init(ccs811_device *device);
 
 /**
- * @brief Check if data is available to be read
+ * @brief CCS811 handler, handles the startup delays and retries a failed initialization
  * @param device: Pointer to CCS811 device
- * @return: true if data is available to be read, false otherwise
  */
-bool ccs811_data_available(ccs811_device *device);
+void ccs811_handler(ccs811_device *device);
 
 /**
- * @brief Get the current baseline
+ * @brief Start reading the measurements, the result data is read only when data is ready
+ * With an nINT mode the data is read on the interrupt and nothing is transferred.
  * @param device: Pointer to CCS811 device
- * @return: Current baseline
+ * @return: true if the read was started or the data comes with nINT, false if the device is not ready
  */
-uint16_t ccs811_get_baseline(ccs811_device *device);
+bool ccs811_start_measurement(ccs811_device *device);
 
 /**
- * @brief Set current baseline
+ * @brief Check if a read started by ccs811_start_measurement is in progress
  * @param device: Pointer to CCS811 device
- * @param baseline: The baseline value
- * @return: true if baseline was configured successfully, false otherwise
+ * @return: true if the device is reading, false otherwise
  */
-bool ccs811_set_baseline(ccs811_device *device, uint16_t baseline);
+bool ccs811_is_busy(ccs811_device *device);
 
 /**
- * @brief Set environmental data
+ * @brief Check if the device finished initialization and no read is in progress
  * @param device: Pointer to CCS811 device
- * @param humidity: The humidity value
- * @param temperature: The temperature value
- * @return: true if environmental data was configured successfully, false otherwise
+ * @return: true if a measurement can be started, false otherwise
  */
-bool ccs811_set_environmental_data(ccs811_device *device, float humidity, float temperature);
+bool ccs811_is_ready(ccs811_device *device);
 
 /**
- * @brief Read measurements
+ * @brief Get the measurements read since the last call
  * @param device: Pointer to CCS811 device
  * @param measurements: Pointer to CCS811 measurements structure
- * @return: true if measurements were read successfully, false otherwise
+ * @return: true if new measurements were copied, false otherwise
+ */
+bool ccs811_get_measurements(ccs811_device *device, ccs811_measurements *measurements);
+
+/**
+ * @brief Change the drive mode of an initialized device
+ *
+ * The datasheet requires CCS811_MODE_IDLE_TIME in CCS811_DRIVE_IDLE before
+ * a mode with a lower sample rate is entered, the caller has to respect it.
+ *
+ * @param device: Pointer to CCS811 device
+ * @param mode: New drive mode
+ * @return: true if the change was started, false if the device is busy
+ */
+bool ccs811_set_drive_mode(ccs811_device *device, ccs811_drive_mode mode);
+
+/**
+ * @brief Change the nINT mode and thresholds of an initialized device
+ *
+ * The nINT modes need nINT connected to interrupt_pin. Data ready mode reads
+ * every measurement of the drive mode, once per second in CCS811_DRIVE_1SEC,
+ * even when the acquisition interval is longer. The EXTI of the pin is only
+ * enabled while an nINT mode is selected.
+ *
+ * @param device: Pointer to CCS811 device
+ * @param mode: New nINT mode
+ * @param thresholds: eCO2 thresholds, used by CCS811_INTERRUPT_THRESHOLD
+ * @return: true if the change was started, false if the device is busy
+ */
+bool ccs811_set_interrupt_mode(ccs811_device *device, ccs811_interrupt_mode mode,
+        const ccs811_thresholds *thresholds);
+
+/**
+ * @brief nINT falling edge handler
+ * This function must be called from the EXTI interrupt of the nINT pin
+ * @param device: Pointer to CCS811 device
+ */
+void ccs811_interrupt_callback(ccs811_device *device);
+
+/**
+ * @brief Start reading the current baseline
+ * @param device: Pointer to CCS811 device
+ * @return: true if the read was started, false otherwise
+ */
+bool ccs811_request_baseline(ccs811_device *device);
+
+/**
+ * @brief Get the baseline read by ccs811_request_baseline or written by ccs811_set_baseline
+ * @param device: Pointer to CCS811 device
+ * @param baseline: Current baseline
+ * @return: true if the baseline was read, false otherwise
+ */
+bool ccs811_get_baseline(ccs811_device *device, uint16_t *baseline);
+
+/**
+ * @brief Set current baseline
+ * @param device: Pointer to CCS811 device
+ * @param baseline: The baseline value
+ * @return: true if the write was started, false otherwise
+ */
+bool ccs811_set_baseline(ccs811_device *device, uint16_t baseline);
+
+/**
+ * @brief Set environmental data
+ * @param device: Pointer to CCS811 device
+ * @param humidity: The humidity value in 0.001 %
+ * @param temperature: The temperature value in 0.01 degC
+ * @return: true if the write was started, false otherwise
  */
-bool ccs811_read_measurements(ccs811_device *device, ccs811_measurements *measurements);
+bool ccs811_set_environmental_data(ccs811_device *device, uint32_t humidity, int32_t temperature);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,185 @@
+#include <string.h>
+#include "ccs811_baseline.h"
+#include "config_store.h"
+#include "scheduler.h"
+#include "system_time.h"
+
+/**
+ * @brief Layout version of the stored baseline record
+ */
+#define CONFIG_VERSION 1
+
+/**
+ * @brief Baseline manager
+ */
+static ccs811_baseline baseline_dev;
+
+/* Baseline private functions */
+static void baseline_task_handler(void);
+static bool save_record(uint16_t baseline);
+
+/**
+ * @brief Baseline task, runs on the baseline timer
+ */
+SCHEDULER_TASK_DEF(baseline_task, baseline_task_handler, SCHEDULER_PRIORITY_LOW);
+
+/**
+ * @brief Baseline timer, next restore, save or poll
+ */
+SCHEDULER_TIMER_DEF(baseline_timer, &baseline_task);
+
+bool ccs811_baseline_init(ccs811_device *device)
+{
+    if (device == NULL)
+        return false;
+
+    memset(&baseline_dev, 0, sizeof(baseline_dev));
+    baseline_dev.device = device;
+    baseline_dev.state = CCS811_BASELINE_STATE_RESTORE;
+    baseline_dev.start_time = HAL_GetTick();
+
+    baseline_dev.stored = config_store_read(CONFIG_KEY_CCS811_BASELINE, CONFIG_VERSION,
+            &baseline_dev.record, sizeof(baseline_dev.record));
+
+    if (!scheduler_register(&baseline_task))
+        return false;
+
+    scheduler_post(&baseline_task);
+    return true;
+}
+
+void ccs811_baseline_measurement_read(void)
+{
+    if (baseline_dev.statistics.valid_time != 0)
+        return;
+
+    uint32_t elapsed = HAL_GetTick() - baseline_dev.start_time;
+
+    /* Without a restored baseline the readings settle after the run-in time */
+    bool restoring = (baseline_dev.state == CCS811_BASELINE_STATE_RESTORE
+            || baseline_dev.state == CCS811_BASELINE_STATE_RESTORING);
+
+    if (baseline_dev.statistics.restored || (!restoring && elapsed >= CCS811_BASELINE_RUN_IN_TIME))
+    {
+        /* Zero means not valid yet */
+        baseline_dev.statistics.valid_time = (elapsed > 0) ? elapsed : 1;
+    }
+}
+
+void ccs811_baseline_get_statistics(ccs811_baseline_statistics *statistics)
+{
+    if (statistics == NULL)
+        return;
+
+    *statistics = baseline_dev.statistics;
+}
+
+/**
+ * @brief Restore the saved baseline, then read and save the baseline periodically
+ */
+static void baseline_task_handler(void)
+{
+    ccs811_device *device = baseline_dev.device;
+    uint32_t delay = CCS811_BASELINE_POLL_INTERVAL;
+    uint16_t baseline = 0;
+
+    switch (baseline_dev.state)
+    {
+    case CCS811_BASELINE_STATE_RESTORE:
+        if (!baseline_dev.stored)
+        {
+            baseline_dev.state = CCS811_BASELINE_STATE_RUNNING;
+            delay = CCS811_BASELINE_FIRST_SAVE;
+            break;
+        }
+
+        if (!ccs811_is_ready(device))
+        {
+            delay = CCS811_BASELINE_WAIT_INTERVAL;
+            break;
+        }
+
+        if (ccs811_set_baseline(device, baseline_dev.record.baseline))
+        {
+            baseline_dev.state = CCS811_BASELINE_STATE_RESTORING;
+        }
+        break;
+
+    case CCS811_BASELINE_STATE_RESTORING:
+        if (device->baseline_pending)
+            break;
+
+        if (ccs811_get_baseline(device, &baseline))
+        {
+            baseline_dev.statistics.restored = true;
+            baseline_dev.statistics.baseline = baseline;
+            baseline_dev.statistics.timestamp = baseline_dev.record.timestamp;
+        }
+        else
+        {
+            baseline_dev.statistics.errors++;
+        }
+
+        baseline_dev.state = CCS811_BASELINE_STATE_RUNNING;
+        delay = CCS811_BASELINE_FIRST_SAVE;
+        break;
+
+    case CCS811_BASELINE_STATE_RUNNING:
+        if (!ccs811_is_ready(device))
+        {
+            delay = CCS811_BASELINE_WAIT_INTERVAL;
+            break;
+        }
+
+        if (ccs811_request_baseline(device))
+        {
+            baseline_dev.state = CCS811_BASELINE_STATE_READING;
+        }
+        break;
+
+    case CCS811_BASELINE_STATE_READING:
+        if (device->baseline_pending)
+            break;
+
+        if (!ccs811_get_baseline(device, &baseline) || !save_record(baseline))
+        {
+            baseline_dev.statistics.errors++;
+        }
+
+        baseline_dev.state = CCS811_BASELINE_STATE_RUNNING;
+        delay = CCS811_BASELINE_SAVE_INTERVAL;
+        break;
+
+    default:
+        break;
+    }
+
+    scheduler_timer_start(&baseline_timer, delay, 0);
+}
+
+/**
+ * @brief Save a baseline record
+ * @param baseline: BASELINE register value
+ * @return: True if the record was saved or the baseline did not change, false otherwise
+ */
+static bool save_record(uint16_t baseline)
+{
+    if (baseline_dev.stored && baseline_dev.record.baseline == baseline)
+        return true;
+
+    ccs811_baseline_record record = {
+        .baseline = baseline,
+        .timestamp = (uint32_t)(system_time_from_tick(HAL_GetTick()) / 1000)
+    };
+
+    if (!config_store_write(CONFIG_KEY_CCS811_BASELINE, CONFIG_VERSION, &record, sizeof(record)))
+        return false;
+
+    baseline_dev.record = record;
+    baseline_dev.stored = true;
+    baseline_dev.statistics.baseline = baseline;
+    baseline_dev.statistics.timestamp = record.timestamp;
+    baseline_dev.statistics.saves++;
+
+    return true;
+}
@@ -0,0 +1,97 @@
+#ifndef CCS811_BASELINE_H
+#define CCS811_BASELINE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "stm32g0xx_hal.h"
+#include "ccs811.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Timing related macros in ms
+ */
+#define CCS811_BASELINE_FIRST_SAVE    (30UL * 60 * 1000)         /**< Run time before the first baseline is saved */
+#define CCS811_BASELINE_SAVE_INTERVAL (24UL * 60 * 60 * 1000)    /**< Time between baseline saves */
+#define CCS811_BASELINE_RUN_IN_TIME   (20UL * 60 * 1000)         /**< Time to valid data without a restored baseline */
+#define CCS811_BASELINE_POLL_INTERVAL 10                          /**< Poll interval while a transfer is in progress */
+#define CCS811_BASELINE_WAIT_INTERVAL 100                         /**< Poll interval while the sensor is starting */
+
+/**
+ * @brief Baseline record, saved in the configuration store
+ */
+typedef struct
+{
+    uint16_t baseline;     /**< BASELINE register value */
+    uint16_t reserved;     /**< Unused, zero */
+    uint32_t timestamp;    /**< Unix time in s of the save, 0 if the time was not known */
+} ccs811_baseline_record;
+
+/**
+ * @brief Baseline manager states
+ */
+typedef enum
+{
+    CCS811_BASELINE_STATE_RESTORE,      /**< Waiting for the sensor to restore the saved baseline */
+    CCS811_BASELINE_STATE_RESTORING,    /**< Writing the saved baseline */
+    CCS811_BASELINE_STATE_RUNNING,      /**< Waiting for the next save */
+    CCS811_BASELINE_STATE_READING       /**< Reading the baseline to save it */
+} ccs811_baseline_state;
+
+/**
+ * @brief Baseline statistics
+ */
+typedef struct
+{
+    bool restored;           /**< Saved baseline was written to the sensor after startup */
+    uint16_t baseline;       /**< Last restored or saved baseline */
+    uint32_t timestamp;      /**< Unix time in s of the last restored or saved baseline */
+    uint32_t valid_time;     /**< Time from startup to the first valid reading in ms, 0 until then */
+    uint32_t saves;          /**< Baselines saved */
+    uint32_t errors;         /**< Failed sensor transfers and saves */
+} ccs811_baseline_statistics;
+
+/**
+ * @brief Baseline manager
+ */
+typedef struct
+{
+    ccs811_device *device;                     /**< Managed CCS811 device */
+    ccs811_baseline_state state;               /**< Manager state */
+    uint32_t start_time;                       /**< HAL tick of startup */
+    uint32_t restore_time;                     /**< HAL tick when the baseline was restored */
+    bool stored;                               /**< A baseline was saved */
+    ccs811_baseline_record record;             /**< Saved baseline */
+    ccs811_baseline_statistics statistics;     /**< Baseline statistics */
+} ccs811_baseline;
+
+/**
+ * @brief Load the saved baseline and start the manager
+ *
+ * The saved baseline is written as soon as the sensor is ready, the
+ * baseline is saved again after CCS811_BASELINE_FIRST_SAVE and then every
+ * CCS811_BASELINE_SAVE_INTERVAL.
+ *
+ * @param device: Pointer to CCS811 device, initialization must be started
+ * @return: true if the manager was started, false otherwise
+ */
+bool ccs811_baseline_init(ccs811_device *device);
+
+/**
+ * @brief Note a new CCS811 reading, used for the time to valid data
+ */
+void ccs811_baseline_measurement_read(void);
+
+/**
+ * @brief Read the baseline statistics
+ * @param statistics: Pointer to statistics structure
+ */
+void ccs811_baseline_get_statistics(ccs811_baseline_statistics *statistics);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CCS811_BASELINE_H */
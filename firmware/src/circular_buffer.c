@@ -1,34 +1,227 @@
+#include <string.h>
 #include "circular_buffer.h"
 
-void circular_buffer_push(circular_buffer *cbuf, uint8_t data)
+/* Circular buffer private functions */
+static uint16_t used_space(uint16_t head, uint16_t tail);
+
+bool circular_buffer_push(circular_buffer *cbuf, uint8_t data)
 {
     if (cbuf == NULL)
-        return;
+        return false;
+
+    uint16_t head = cbuf->head;
+    uint16_t tail = cbuf->tail;
+
+    if (used_space(head, tail) > cbuf->mask)
+    {
+        cbuf->overflow_count++;
+        return false;
+    }
+
+    cbuf->buffer[head & cbuf->mask] = data;
+
+    /* Data must be visible before the consumer sees the new head */
+    __DMB();
+    cbuf->head = head + 1;
+
+    return true;
+}
+
+uint16_t circular_buffer_push_span(circular_buffer *cbuf, const uint8_t *data, uint16_t length)
+{
+    if (cbuf == NULL || data == NULL)
+        return 0;
+
+    uint16_t head = cbuf->head;
+    uint16_t tail = cbuf->tail;
+    uint16_t capacity = cbuf->mask + 1;
+    uint16_t free_space = capacity - used_space(head, tail);
+
+    if (length > free_space)
+    {
+        cbuf->overflow_count += length - free_space;
+        length = free_space;
+    }
+
+    /* Copy in at most two blocks, up to the end of storage and from the start */
+    uint16_t offset = head & cbuf->mask;
+    uint16_t first = capacity - offset;
+
+    if (first > length)
+    {
+        first = length;
+    }
+
+    memcpy(&cbuf->buffer[offset], data, first);
+    memcpy(cbuf->buffer, &data[first], length - first);
+
+    __DMB();
+    cbuf->head = head + length;
+
+    return length;
+}
+
+bool circular_buffer_pop(circular_buffer *cbuf, uint8_t *data)
+{
+    if (cbuf == NULL || data == NULL)
+        return false;
+
+    uint16_t head = cbuf->head;
+    uint16_t tail = cbuf->tail;
+
+    if (head == tail)
+        return false;
+
+    /* Read data only after the head written by the producer is observed */
+    __DMB();
+    *data = cbuf->buffer[tail & cbuf->mask];
+
+    /* Slot must be read before the producer is allowed to reuse it */
+    __DMB();
+    cbuf->tail = tail + 1;
+
+    return true;
+}
+
+uint16_t circular_buffer_pop_span(circular_buffer *cbuf, uint8_t *data, uint16_t length)
+{
+    if (cbuf == NULL || data == NULL)
+        return 0;
+
+    uint16_t count = 0;
+
+    while (count < length)
+    {
+        const uint8_t *block = NULL;
+        uint16_t available = circular_buffer_peek(cbuf, &block);
+
+        if (available == 0)
+            break;
+
+        if (available > length - count)
+        {
+            available = length - count;
+        }
 
-    cbuf->buffer[cbuf->head] = data;
+        memcpy(&data[count], block, available);
+        circular_buffer_consume(cbuf, available);
+        count += available;
+    }
+
+    return count;
+}
+
+uint16_t circular_buffer_pop_until(circular_buffer *cbuf, uint8_t *data, uint16_t length,
+        uint8_t delimiter)
+{
+    if (cbuf == NULL || data == NULL)
+        return 0;
 
-    cbuf->head++;
-    if (cbuf->head >= cbuf->capacity)
+    uint16_t count = 0;
+
+    while (count < length)
     {
-        cbuf->head = 0;
+        const uint8_t *block = NULL;
+        uint16_t available = circular_buffer_peek(cbuf, &block);
+
+        if (available == 0)
+            break;
+
+        if (available > length - count)
+        {
+            available = length - count;
+        }
+
+        const uint8_t *found = memchr(block, delimiter, available);
+        if (found != NULL)
+        {
+            available = (uint16_t)(found - block) + 1;
+        }
+
+        memcpy(&data[count], block, available);
+        circular_buffer_consume(cbuf, available);
+        count += available;
+
+        if (found != NULL)
+            break;
     }
+
+    return count;
+}
+
+uint16_t circular_buffer_peek(circular_buffer *cbuf, const uint8_t **data)
+{
+    if (cbuf == NULL || data == NULL)
+        return 0;
+
+    uint16_t head = cbuf->head;
+    uint16_t tail = cbuf->tail;
+    uint16_t available = used_space(head, tail);
+    uint16_t offset = tail & cbuf->mask;
+    uint16_t contiguous = (cbuf->mask + 1) - offset;
+
+    __DMB();
+    *data = &cbuf->buffer[offset];
+
+    return (available < contiguous) ? available : contiguous;
 }
 
-void circular_buffer_pop(circular_buffer *cbuf, uint8_t *data)
+void circular_buffer_consume(circular_buffer *cbuf, uint16_t length)
 {
     if (cbuf == NULL)
         return;
 
-    *data = cbuf->buffer[cbuf->tail];
+    uint16_t tail = cbuf->tail;
+    uint16_t available = used_space(cbuf->head, tail);
 
-    cbuf->tail++;
-    if (cbuf->tail >= cbuf->capacity)
+    if (length > available)
     {
-        cbuf->tail = 0;
+        length = available;
     }
+
+    __DMB();
+    cbuf->tail = tail + length;
+}
+
+uint16_t circular_buffer_size(circular_buffer *cbuf)
+{
+    if (cbuf == NULL)
+        return 0;
+
+    return used_space(cbuf->head, cbuf->tail);
+}
+
+uint16_t circular_buffer_free_space(circular_buffer *cbuf)
+{
+    if (cbuf == NULL)
+        return 0;
+
+    return (cbuf->mask + 1) - used_space(cbuf->head, cbuf->tail);
 }
 
 bool circular_buffer_has_data(circular_buffer *cbuf)
 {
+    if (cbuf == NULL)
+        return false;
+
     return (cbuf->head != cbuf->tail);
 }
+
+uint32_t circular_buffer_overflow_count(circular_buffer *cbuf)
+{
+    if (cbuf == NULL)
+        return 0;
+
+    return cbuf->overflow_count;
+}
+
+/**
+ * @brief Number of bytes between tail and head
+ * @param head: Head position snapshot
+ * @param tail: Tail position snapshot
+ * @return: Number of bytes stored in the buffer
+ */
+static uint16_t used_space(uint16_t head, uint16_t tail)
+{
+    return (uint16_t)(head - tail);
+}
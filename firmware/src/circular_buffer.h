@@ -11,42 +11,120 @@ extern "C" {
 
 /**
  * @brief Macro for circular buffer definition
+ *
+ * The buffer is a single producer / single consumer queue, one context
+ * (usually an interrupt) may push while another context pops without locking.
+ * The size must be a power of two and not larger than 32768 bytes.
+ *
  * @param name: Circular buffer name
  * @param size: Circular buffer size
  */
-#define CIRCULAR_BUFFER_DEF(name, size)      \
-    static uint8_t name##_data_buffer[size]; \
-    static circular_buffer name = {          \
-        .buffer   = name##_data_buffer,      \
-        .head     = 0,                       \
-        .tail     = 0,                       \
-        .capacity = size                     \
+#define CIRCULAR_BUFFER_DEF(name, size)                           \
+    _Static_assert((((size) & ((size) - 1)) == 0)                 \
+        && ((size) <= 32768), "Invalid circular buffer size");    \
+    static uint8_t name##_data_buffer[size];                      \
+    static circular_buffer name = {                               \
+        .buffer         = name##_data_buffer,                     \
+        .head           = 0,                                      \
+        .tail           = 0,                                      \
+        .mask           = (size) - 1,                             \
+        .overflow_count = 0                                       \
     }
 
 /**
  * @brief Circular buffer structure type
+ *
+ * Head and tail are free running indexes, they are masked only when
+ * the storage buffer is accessed.
  */
 typedef struct
 {
-    uint8_t *buffer;            /**< Pointer to storage buffer */
-    uint16_t head;              /**< Head position             */
-    uint16_t tail;              /**< Tail position             */
-    const uint16_t capacity;    /**< Buffer capacity           */
+    uint8_t *buffer;                     /**< Pointer to storage buffer                  */
+    volatile uint16_t head;              /**< Head position, written only by producer    */
+    volatile uint16_t tail;              /**< Tail position, written only by consumer    */
+    const uint16_t mask;                 /**< Buffer capacity - 1                        */
+    volatile uint32_t overflow_count;    /**< Number of bytes dropped on a full buffer   */
 } circular_buffer;
 
 /**
  * @brief Push a single byte to the circular buffer
  * @param cbuf: Pointer to circular buffer
  * @param data: Single byte value that will be added to the buffer
+ * @return: true if the byte was added, false if the buffer is full
  */
-void circular_buffer_push(circular_buffer *cbuf, uint8_t data);
+bool circular_buffer_push(circular_buffer *cbuf, uint8_t data);
+
+/**
+ * @brief Push multiple bytes to the circular buffer
+ *
+ * Bytes that do not fit are dropped and added to the overflow counter.
+ *
+ * @param cbuf: Pointer to circular buffer
+ * @param data: Pointer to the bytes that will be added to the buffer
+ * @param length: Number of bytes
+ * @return: Number of bytes added to the buffer
+ */
+uint16_t circular_buffer_push_span(circular_buffer *cbuf, const uint8_t *data, uint16_t length);
 
 /**
  * @brief Get a single byte from the circular buffer
  * @param cbuf: Pointer to circular buffer
  * @param data: Single byte value that will be read from the buffer
+ * @return: true if a byte was read, false if the buffer is empty
+ */
+bool circular_buffer_pop(circular_buffer *cbuf, uint8_t *data);
+
+/**
+ * @brief Get multiple bytes from the circular buffer
+ * @param cbuf: Pointer to circular buffer
+ * @param data: Pointer to the destination buffer
+ * @param length: Size of the destination buffer
+ * @return: Number of bytes read from the buffer
+ */
+uint16_t circular_buffer_pop_span(circular_buffer *cbuf, uint8_t *data, uint16_t length);
+
+/**
+ * @brief Get bytes from the circular buffer up to and including a delimiter
+ * @param cbuf: Pointer to circular buffer
+ * @param data: Pointer to the destination buffer
+ * @param length: Size of the destination buffer
+ * @param delimiter: Byte value that stops the read
+ * @return: Number of bytes read from the buffer
+ */
+uint16_t circular_buffer_pop_until(circular_buffer *cbuf, uint8_t *data, uint16_t length,
+        uint8_t delimiter);
+
+/**
+ * @brief Get the contiguous block of data that can be read without copying
+ *
+ * The data stays in the buffer until circular_buffer_consume is called.
+ *
+ * @param cbuf: Pointer to circular buffer
+ * @param data: Pointer set to the first readable byte
+ * @return: Number of contiguous bytes available at data
  */
-void circular_buffer_pop(circular_buffer *cbuf, uint8_t *data);
+uint16_t circular_buffer_peek(circular_buffer *cbuf, const uint8_t **data);
+
+/**
+ * @brief Remove bytes returned by circular_buffer_peek from the buffer
+ * @param cbuf: Pointer to circular buffer
+ * @param length: Number of bytes to remove
+ */
+void circular_buffer_consume(circular_buffer *cbuf, uint16_t length);
+
+/**
+ * @brief Number of bytes that can be read
+ * @param cbuf: Pointer to circular buffer
+ * @return: Number of bytes stored in the buffer
+ */
+uint16_t circular_buffer_size(circular_buffer *cbuf);
+
+/**
+ * @brief Number of bytes that can be written
+ * @param cbuf: Pointer to circular buffer
+ * @return: Free space in the buffer
+ */
+uint16_t circular_buffer_free_space(circular_buffer *cbuf);
 
 /**
  * @brief Buffer has data that can be read
@@ -55,6 +133,13 @@ void circular_buffer_pop(circular_buffer *cbuf, uint8_t *data);
  */
 bool circular_buffer_has_data(circular_buffer *cbuf);
 
+/**
+ * @brief Number of bytes dropped because the buffer was full
+ * @param cbuf: Pointer to circular buffer
+ * @return: Overflow counter value
+ */
+uint32_t circular_buffer_overflow_count(circular_buffer *cbuf);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,516 @@
+#include <stddef.h>
+#include <string.h>
+#include "config_store.h"
+#include "scheduler.h"
+
+/**
+ * @brief Page header magic, "CNFG"
+ */
+#define CONFIG_STORE_MAGIC 0x47464E43UL
+
+/**
+ * @brief First flash page of the store
+ */
+#define CONFIG_STORE_FIRST_PAGE ((CONFIG_STORE_FLASH_ADDRESS - FLASH_BASE) / FLASH_PAGE_SIZE)
+
+/**
+ * @brief Flash space of a record, the value is padded to a double word
+ */
+#define RECORD_SIZE(length) (sizeof(config_store_record) + (((length) + 7U) & ~7U))
+
+_Static_assert(sizeof(config_store_page_header) == 8, "Invalid store page header size");
+_Static_assert(sizeof(config_store_record) == 8, "Invalid store record size");
+_Static_assert(CONFIG_STORE_PAGE_COUNT >= 3, "Compaction needs a spare page");
+_Static_assert(CONFIG_STORE_SIZE <= UINT16_MAX, "Store offsets are 16 bits");
+
+/**
+ * @brief Store flash storage, not programmed with the firmware
+ */
+__attribute__((__section__(".config_store")))
+    const uint8_t config_data[CONFIG_STORE_SIZE];
+
+/**
+ * @brief Store state
+ */
+static config_store store_dev;
+
+/* Store private functions */
+static void config_store_task_handler(void);
+static bool page_blank(uint8_t page);
+static void scan_page(uint8_t page);
+static bool append_record(config_key key, uint8_t version, const uint8_t *value, uint16_t length);
+static bool open_page(void);
+static bool spare_available(void);
+static void compact_page(uint8_t page);
+static bool erase_page(uint8_t page);
+static bool program(uint32_t offset, const uint8_t *data, uint16_t length);
+static uint16_t record_crc(const config_store_record *record, const uint8_t *value);
+static uint16_t crc16(uint16_t crc, const uint8_t *data, uint16_t length);
+
+/**
+ * @brief Store task, erases damaged pages and compacts the oldest page
+ */
+SCHEDULER_TASK_DEF(config_store_task, config_store_task_handler, SCHEDULER_PRIORITY_LOW);
+
+bool config_store_init(void)
+{
+    uint8_t order[CONFIG_STORE_PAGE_COUNT];
+    uint8_t active = 0;
+
+    memset(&store_dev, 0, sizeof(store_dev));
+
+    for (uint8_t page = 0; page < CONFIG_STORE_PAGE_COUNT; page++)
+    {
+        const config_store_page_header *header =
+                (const config_store_page_header *)&config_data[page * FLASH_PAGE_SIZE];
+
+        if (header->magic == CONFIG_STORE_MAGIC)
+        {
+            store_dev.pages[page] = CONFIG_PAGE_ACTIVE;
+            store_dev.sequences[page] = header->sequence;
+
+            /* Insertion by sequence, records of newer pages replace older ones */
+            uint8_t index = active++;
+
+            while (index > 0 && (int32_t)(store_dev.sequences[order[index - 1]] - header->sequence) > 0)
+            {
+                order[index] = order[index - 1];
+                index--;
+            }
+
+            order[index] = page;
+        }
+        else
+        {
+            store_dev.pages[page] = page_blank(page) ? CONFIG_PAGE_ERASED : CONFIG_PAGE_DIRTY;
+        }
+    }
+
+    /* Nothing to keep, format now so the first write does not have to wait */
+    if (active == 0)
+    {
+        for (uint8_t page = 0; page < CONFIG_STORE_PAGE_COUNT; page++)
+        {
+            if (store_dev.pages[page] == CONFIG_PAGE_DIRTY)
+            {
+                erase_page(page);
+            }
+        }
+    }
+
+    /* Without an active page the first write opens one */
+    store_dev.head = CONFIG_STORE_PAGE_COUNT - 1;
+    store_dev.offset = FLASH_PAGE_SIZE;
+
+    for (uint8_t index = 0; index < active; index++)
+    {
+        scan_page(order[index]);
+    }
+
+    if (!scheduler_register(&config_store_task))
+        return false;
+
+    scheduler_post(&config_store_task);
+
+    return (store_dev.offset < FLASH_PAGE_SIZE || spare_available());
+}
+
+bool config_store_read(config_key key, uint8_t version, void *value, uint16_t length)
+{
+    if (value == NULL || key >= CONFIG_KEY_COUNT)
+        return false;
+
+    const config_store_entry *entry = &store_dev.entries[key];
+
+    if (!entry->valid || entry->version != version || entry->length != length)
+        return false;
+
+    /* The CRC was checked when the record was found or written */
+    memcpy(value, &config_data[entry->offset + sizeof(config_store_record)], length);
+
+    return true;
+}
+
+bool config_store_write(config_key key, uint8_t version, const void *value, uint16_t length)
+{
+    if (value == NULL || key >= CONFIG_KEY_COUNT || length > CONFIG_STORE_MAX_LENGTH)
+        return false;
+
+    const config_store_entry *entry = &store_dev.entries[key];
+
+    if (entry->valid && entry->version == version && entry->length == length
+            && memcmp(&config_data[entry->offset + sizeof(config_store_record)], value, length) == 0)
+    {
+        store_dev.statistics.unchanged++;
+        return true;
+    }
+
+    bool result = append_record(key, version, (const uint8_t *)value, length);
+
+    /* The spare page was opened, make a new one before the head page fills up */
+    if (!spare_available())
+    {
+        scheduler_post(&config_store_task);
+    }
+
+    return result;
+}
+
+uint16_t config_store_free(void)
+{
+    uint16_t free = 0;
+
+    if (store_dev.pages[store_dev.head] == CONFIG_PAGE_ACTIVE)
+    {
+        free = FLASH_PAGE_SIZE - store_dev.offset;
+    }
+
+    for (uint8_t page = 0; page < CONFIG_STORE_PAGE_COUNT; page++)
+    {
+        if (store_dev.pages[page] == CONFIG_PAGE_ERASED)
+        {
+            free += FLASH_PAGE_SIZE - sizeof(config_store_page_header);
+        }
+    }
+
+    return free;
+}
+
+void config_store_get_statistics(config_store_statistics *statistics)
+{
+    if (statistics == NULL)
+        return;
+
+    *statistics = store_dev.statistics;
+}
+
+/**
+ * @brief Erase one damaged page per run, then compact the oldest page if no spare page is left
+ */
+static void config_store_task_handler(void)
+{
+    for (uint8_t page = 0; page < CONFIG_STORE_PAGE_COUNT; page++)
+    {
+        if (store_dev.pages[page] == CONFIG_PAGE_DIRTY)
+        {
+            erase_page(page);
+            scheduler_post(&config_store_task);
+            return;
+        }
+    }
+
+    if (spare_available())
+        return;
+
+    /* Oldest active page, it holds the fewest live records */
+    uint8_t oldest = store_dev.head;
+
+    for (uint8_t page = 0; page < CONFIG_STORE_PAGE_COUNT; page++)
+    {
+        if (store_dev.pages[page] == CONFIG_PAGE_ACTIVE && page != store_dev.head
+                && (oldest == store_dev.head
+                    || (int32_t)(store_dev.sequences[page] - store_dev.sequences[oldest]) < 0))
+        {
+            oldest = page;
+        }
+    }
+
+    if (oldest != store_dev.head)
+    {
+        compact_page(oldest);
+    }
+}
+
+/**
+ * @brief Check if a page is erased
+ * @param page: Store page index
+ * @return: True if every byte of the page is erased, false otherwise
+ */
+static bool page_blank(uint8_t page)
+{
+    const uint32_t *data = (const uint32_t *)&config_data[page * FLASH_PAGE_SIZE];
+
+    for (uint16_t index = 0; index < FLASH_PAGE_SIZE / sizeof(uint32_t); index++)
+    {
+        if (data[index] != 0xFFFFFFFF)
+            return false;
+    }
+
+    return true;
+}
+
+/**
+ * @brief Add the valid records of a page to the index, the page becomes the head page
+ *
+ * Records with a wrong CRC are skipped, a damaged header ends the page so
+ * nothing is programmed over it.
+ *
+ * @param page: Store page index
+ */
+static void scan_page(uint8_t page)
+{
+    uint16_t offset = sizeof(config_store_page_header);
+
+    while (offset + sizeof(config_store_record) <= FLASH_PAGE_SIZE)
+    {
+        uint16_t position = page * FLASH_PAGE_SIZE + offset;
+        const config_store_record *record = (const config_store_record *)&config_data[position];
+
+        if (record->key == 0xFF && record->length == 0xFFFF)
+            break;
+
+        if (record->key >= CONFIG_KEY_COUNT || record->length > CONFIG_STORE_MAX_LENGTH
+                || offset + RECORD_SIZE(record->length) > FLASH_PAGE_SIZE)
+        {
+            store_dev.statistics.errors++;
+            offset = FLASH_PAGE_SIZE;
+            break;
+        }
+
+        if (record->crc == record_crc(record, &config_data[position + sizeof(*record)]))
+        {
+            config_store_entry *entry = &store_dev.entries[record->key];
+
+            entry->valid = true;
+            entry->version = record->version;
+            entry->length = record->length;
+            entry->offset = position;
+        }
+        else
+        {
+            store_dev.statistics.errors++;
+        }
+
+        offset += RECORD_SIZE(record->length);
+    }
+
+    store_dev.head = page;
+    store_dev.offset = offset;
+}
+
+/**
+ * @brief Append a record to the head page, the next erased page is opened when it is full
+ * @param key: Configuration key
+ * @param version: Layout version of the value
+ * @param value: Value to store, may point into the store
+ * @param length: Value length
+ * @return: True if the record was written, false otherwise
+ */
+static bool append_record(config_key key, uint8_t version, const uint8_t *value, uint16_t length)
+{
+    uint16_t size = RECORD_SIZE(length);
+
+    if (store_dev.offset + size > FLASH_PAGE_SIZE && !open_page())
+        return false;
+
+    config_store_record record = {
+        .key = key,
+        .version = version,
+        .length = length,
+        .reserved = 0xFFFF
+    };
+
+    record.crc = record_crc(&record, value);
+
+    uint16_t position = store_dev.head * FLASH_PAGE_SIZE + store_dev.offset;
+
+    /* A failed record is skipped on the next scan, its space is lost */
+    store_dev.offset += size;
+
+    if (!program(position, (const uint8_t *)&record, sizeof(record))
+            || !program(position + sizeof(record), value, length))
+    {
+        store_dev.statistics.errors++;
+        return false;
+    }
+
+    config_store_entry *entry = &store_dev.entries[key];
+
+    entry->valid = true;
+    entry->version = version;
+    entry->length = length;
+    entry->offset = position;
+
+    store_dev.statistics.writes++;
+
+    return true;
+}
+
+/**
+ * @brief Open the next erased page as head page
+ * @return: True if a page was opened, false if no page is erased
+ */
+static bool open_page(void)
+{
+    for (uint8_t index = 1; index <= CONFIG_STORE_PAGE_COUNT; index++)
+    {
+        uint8_t page = (store_dev.head + index) % CONFIG_STORE_PAGE_COUNT;
+
+        if (store_dev.pages[page] != CONFIG_PAGE_ERASED)
+            continue;
+
+        config_store_page_header header = {
+            .magic = CONFIG_STORE_MAGIC,
+            .sequence = store_dev.sequences[store_dev.head] + 1
+        };
+
+        if (!program(page * FLASH_PAGE_SIZE, (const uint8_t *)&header, sizeof(header)))
+        {
+            store_dev.pages[page] = CONFIG_PAGE_DIRTY;
+            store_dev.statistics.errors++;
+            scheduler_post(&config_store_task);
+            return false;
+        }
+
+        store_dev.pages[page] = CONFIG_PAGE_ACTIVE;
+        store_dev.sequences[page] = header.sequence;
+        store_dev.head = page;
+        store_dev.offset = sizeof(header);
+
+        return true;
+    }
+
+    return false;
+}
+
+/**
+ * @brief Check if an erased page is ready for the next head page
+ * @return: True if a page is erased, false otherwise
+ */
+static bool spare_available(void)
+{
+    for (uint8_t page = 0; page < CONFIG_STORE_PAGE_COUNT; page++)
+    {
+        if (store_dev.pages[page] == CONFIG_PAGE_ERASED)
+            return true;
+    }
+
+    return false;
+}
+
+/**
+ * @brief Copy the live records of a page to the head page and erase it
+ * @param page: Store page index, not the head page
+ */
+static void compact_page(uint8_t page)
+{
+    for (uint8_t key = 0; key < CONFIG_KEY_COUNT; key++)
+    {
+        const config_store_entry *entry = &store_dev.entries[key];
+
+        if (!entry->valid || entry->offset / FLASH_PAGE_SIZE != page)
+            continue;
+
+        /* The page keeps the record until it is erased, a failed copy is tried again on the next write */
+        if (!append_record((config_key)key, entry->version,
+                &config_data[entry->offset + sizeof(config_store_record)], entry->length))
+        {
+            return;
+        }
+    }
+
+    store_dev.statistics.compactions++;
+    erase_page(page);
+}
+
+/**
+ * @brief Erase a page, blocking
+ *
+ * The CPU fetches from the same flash bank, so an erase always stalls it.
+ * Erases only run in the store task, never while a value is written.
+ *
+ * @param page: Store page index
+ * @return: True if the page was erased, false otherwise
+ */
+static bool erase_page(uint8_t page)
+{
+    FLASH_EraseInitTypeDef EraseInitStruct = { 0 };
+    uint32_t erase_error = 0;
+
+    EraseInitStruct.TypeErase = FLASH_TYPEERASE_PAGES;
+    EraseInitStruct.Page      = CONFIG_STORE_FIRST_PAGE + page;
+    EraseInitStruct.NbPages   = 1;
+
+    HAL_FLASH_Unlock();
+    HAL_StatusTypeDef status = HAL_FLASHEx_Erase(&EraseInitStruct, &erase_error);
+    HAL_FLASH_Lock();
+
+    if (status != HAL_OK)
+    {
+        store_dev.pages[page] = CONFIG_PAGE_DIRTY;
+        store_dev.statistics.errors++;
+        return false;
+    }
+
+    store_dev.pages[page] = CONFIG_PAGE_ERASED;
+    store_dev.sequences[page] = 0;
+    store_dev.statistics.erases++;
+
+    return true;
+}
+
+/**
+ * @brief Program data in double words, the last one is padded with erased bytes
+ * @param offset: Offset in the store, double word aligned
+ * @param data: Data to program
+ * @param length: Data length
+ * @return: True if the data was programmed, false otherwise
+ */
+static bool program(uint32_t offset, const uint8_t *data, uint16_t length)
+{
+    bool result = true;
+
+    HAL_FLASH_Unlock();
+
+    for (uint16_t index = 0; index < length; index += 8)
+    {
+        uint64_t word = UINT64_MAX;
+        memcpy(&word, &data[index], (length - index < 8) ? length - index : 8);
+
+        if (HAL_FLASH_Program(FLASH_TYPEPROGRAM_DOUBLEWORD,
+                CONFIG_STORE_FLASH_ADDRESS + offset + index, word) != HAL_OK)
+        {
+            result = false;
+            break;
+        }
+    }
+
+    HAL_FLASH_Lock();
+
+    return result;
+}
+
+/**
+ * @brief CRC of a record
+ * @param record: Record header
+ * @param value: Record value
+ * @return: CRC-16 of the header fields before the CRC and of the value
+ */
+static uint16_t record_crc(const config_store_record *record, const uint8_t *value)
+{
+    uint16_t crc = crc16(0xFFFF, (const uint8_t *)record, offsetof(config_store_record, crc));
+
+    return crc16(crc, value, record->length);
+}
+
+/**
+ * @brief CRC-16 with polynomial 0x1021
+ * @param crc: Initial value or CRC of the previous data
+ * @param data: Data to check
+ * @param length: Data length
+ * @return: CRC value
+ */
+static uint16_t crc16(uint16_t crc, const uint8_t *data, uint16_t length)
+{
+    while (length--)
+    {
+        crc ^= (uint16_t)(*data++ << 8);
+
+        for (uint8_t bit = 0; bit < 8; bit++)
+        {
+            crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+        }
+    }
+
+    return crc;
+}
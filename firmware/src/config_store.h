@@ -0,0 +1,154 @@
+#ifndef CONFIG_STORE_H
+#define CONFIG_STORE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "stm32g0xx_hal.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Store flash region, must match the CONFIG region of the linker script
+ */
+#define CONFIG_STORE_FLASH_ADDRESS 0x8017000
+#define CONFIG_STORE_PAGE_COUNT    3
+#define CONFIG_STORE_SIZE          (CONFIG_STORE_PAGE_COUNT * FLASH_PAGE_SIZE)
+
+/**
+ * @brief Longest value of a record in bytes
+ */
+#define CONFIG_STORE_MAX_LENGTH    256
+
+/**
+ * @brief Configuration keys, one record per key is live
+ */
+typedef enum
+{
+    CONFIG_KEY_WIFI,               /**< wifi_config */
+    CONFIG_KEY_CCS811_BASELINE,    /**< ccs811_baseline_record */
+    CONFIG_KEY_PUBLISH_POLICY,     /**< publish_policy_config */
+    CONFIG_KEY_TELEMETRY,          /**< telemetry_config */
+    CONFIG_KEY_ACQUISITION,        /**< acquisition_config */
+    CONFIG_KEY_COUNT
+} config_key;
+
+/**
+ * @brief Page header, first double word of every page in use
+ */
+typedef struct
+{
+    uint32_t magic;       /**< CONFIG_STORE_MAGIC for a page in use */
+    uint32_t sequence;    /**< Page sequence number, increments with every opened page */
+} config_store_page_header;
+
+/**
+ * @brief Record header, the value follows padded to a double word
+ */
+typedef struct
+{
+    uint8_t key;         /**< config_key, 0xFF in erased flash */
+    uint8_t version;     /**< Layout version of the value */
+    uint16_t length;     /**< Value length in bytes */
+    uint16_t crc;        /**< CRC-16 of the fields before it and of the value */
+    uint16_t reserved;   /**< Unused, left erased */
+} config_store_record;
+
+/**
+ * @brief Page states
+ */
+typedef enum
+{
+    CONFIG_PAGE_ERASED,    /**< Erased, ready to be opened */
+    CONFIG_PAGE_ACTIVE,    /**< Holds a header and records */
+    CONFIG_PAGE_DIRTY      /**< Unknown content, waits for an erase */
+} config_page_state;
+
+/**
+ * @brief Location of the live record of a key
+ */
+typedef struct
+{
+    bool valid;          /**< A record was found */
+    uint8_t version;     /**< Layout version of the value */
+    uint16_t length;     /**< Value length in bytes */
+    uint16_t offset;     /**< Offset of the record header in the store */
+} config_store_entry;
+
+/**
+ * @brief Store statistics
+ */
+typedef struct
+{
+    uint32_t writes;         /**< Records appended, relocated ones included */
+    uint32_t unchanged;      /**< Writes skipped because the value was already stored */
+    uint32_t compactions;    /**< Pages compacted */
+    uint32_t erases;         /**< Pages erased */
+    uint32_t errors;         /**< Failed flash operations and damaged records */
+} config_store_statistics;
+
+/**
+ * @brief Store state
+ */
+typedef struct
+{
+    config_page_state pages[CONFIG_STORE_PAGE_COUNT];    /**< State of every page */
+    uint32_t sequences[CONFIG_STORE_PAGE_COUNT];         /**< Sequence of every active page */
+    uint8_t head;                                        /**< Page receiving new records */
+    uint16_t offset;                                     /**< Offset of the next record in the head page */
+    config_store_entry entries[CONFIG_KEY_COUNT];        /**< Live record of every key */
+    config_store_statistics statistics;                  /**< Store statistics */
+} config_store;
+
+/**
+ * @brief Mount the store and build the index of the live records
+ *
+ * A store without any valid page is formatted, this erases its pages once
+ * after the store was introduced. Damaged pages are erased in the background.
+ *
+ * @return: true if the store can be written, false otherwise
+ */
+bool config_store_init(void);
+
+/**
+ * @brief Read the live value of a key
+ * @param key: Configuration key
+ * @param version: Expected layout version
+ * @param value: Output buffer
+ * @param length: Expected value length
+ * @return: true if a value with this version and length was stored, false otherwise
+ */
+bool config_store_read(config_key key, uint8_t version, void *value, uint16_t length);
+
+/**
+ * @brief Append a new value of a key, flash is never erased here
+ *
+ * When a page fills up, the next erased page is opened and the oldest page
+ * is compacted and erased later by a low priority task.
+ *
+ * @param key: Configuration key
+ * @param version: Layout version of the value
+ * @param value: Value to store
+ * @param length: Value length, up to CONFIG_STORE_MAX_LENGTH
+ * @return: true if the value was stored, false if the write failed or no page was free
+ */
+bool config_store_write(config_key key, uint8_t version, const void *value, uint16_t length);
+
+/**
+ * @brief Free bytes in the head page and the erased pages
+ * @return: Free bytes
+ */
+uint16_t config_store_free(void);
+
+/**
+ * @brief Read the store statistics
+ * @param statistics: Pointer to statistics structure
+ */
+void config_store_get_statistics(config_store_statistics *statistics);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CONFIG_STORE_H */
@@ -0,0 +1,241 @@
+#include <string.h>
+#include "filter.h"
+
+/**
+ * @brief Fixed point one of the Kalman gain
+ */
+#define GAIN_ONE (1UL << 16)
+
+/**
+ * @brief Filter stage state
+ */
+static filter filter_dev;
+
+/* Filter private functions */
+static int32_t apply_median(filter_channel *channel, int32_t value);
+static int32_t apply_ewma(filter_channel *channel, int32_t value);
+static int32_t apply_kalman(filter_channel *channel, int32_t value);
+static int32_t round_estimate(int32_t estimate);
+
+void filter_init(void)
+{
+    memset(&filter_dev, 0, sizeof(filter_dev));
+
+    for (uint8_t channel = 0; channel < PUBLISH_CHANNEL_COUNT; channel++)
+    {
+        filter_config *config = &filter_dev.channels[channel].configuration;
+
+        config->type = FILTER_TYPE_NONE;
+        config->median_size = FILTER_DEFAULT_MEDIAN_SIZE;
+        config->ewma_weight = FILTER_DEFAULT_EWMA_WEIGHT;
+        config->process_noise = FILTER_DEFAULT_PROCESS_NOISE;
+        config->measurement_noise = FILTER_DEFAULT_MEASUREMENT_NOISE;
+    }
+
+    filter_dev.channels[PUBLISH_CHANNEL_TVOC].configuration.type = FILTER_TYPE_MEDIAN;
+    filter_dev.channels[PUBLISH_CHANNEL_ECO2].configuration.type = FILTER_TYPE_MEDIAN;
+}
+
+bool filter_set_configuration(publish_channel channel, const filter_config *config)
+{
+    if (config == NULL || channel >= PUBLISH_CHANNEL_COUNT)
+        return false;
+
+    if (config->type >= FILTER_TYPE_COUNT
+        || config->median_size == 0 || config->median_size > FILTER_MEDIAN_MAX_SIZE
+        || config->ewma_weight == 0 || config->ewma_weight > (1 << FILTER_FRACTION_BITS)
+        || config->process_noise == 0)
+    {
+        return false;
+    }
+
+    filter_channel *state = &filter_dev.channels[channel];
+
+    memset(state, 0, sizeof(*state));
+    state->configuration = *config;
+
+    return true;
+}
+
+bool filter_get_configuration(publish_channel channel, filter_config *config)
+{
+    if (config == NULL || channel >= PUBLISH_CHANNEL_COUNT)
+        return false;
+
+    *config = filter_dev.channels[channel].configuration;
+    return true;
+}
+
+void filter_apply(int32_t values[PUBLISH_CHANNEL_COUNT])
+{
+    if (values == NULL)
+        return;
+
+    for (uint8_t index = 0; index < PUBLISH_CHANNEL_COUNT; index++)
+    {
+        filter_channel *channel = &filter_dev.channels[index];
+
+        switch (channel->configuration.type)
+        {
+        case FILTER_TYPE_MEDIAN:
+            values[index] = apply_median(channel, values[index]);
+            break;
+
+        case FILTER_TYPE_EWMA:
+            values[index] = apply_ewma(channel, values[index]);
+            break;
+
+        case FILTER_TYPE_KALMAN:
+            values[index] = apply_kalman(channel, values[index]);
+            break;
+
+        default:
+            break;
+        }
+    }
+}
+
+uint16_t filter_get_latency(publish_channel channel)
+{
+    if (channel >= PUBLISH_CHANNEL_COUNT)
+        return 0;
+
+    const filter_channel *state = &filter_dev.channels[channel];
+    const filter_config *config = &state->configuration;
+    uint32_t gain = 0;
+
+    switch (config->type)
+    {
+    case FILTER_TYPE_MEDIAN:
+        return (config->median_size - 1) / 2;
+
+    case FILTER_TYPE_EWMA:
+        gain = (uint32_t)config->ewma_weight << (16 - FILTER_FRACTION_BITS);
+        break;
+
+    case FILTER_TYPE_KALMAN:
+        /* Before the first sample the estimate follows the measurement */
+        gain = state->has_estimate ? state->gain : GAIN_ONE;
+        break;
+
+    default:
+        return 0;
+    }
+
+    if (gain == 0)
+        return UINT16_MAX;
+
+    uint32_t latency = (GAIN_ONE - gain + gain / 2) / gain;
+
+    return (latency > UINT16_MAX) ? UINT16_MAX : (uint16_t)latency;
+}
+
+/**
+ * @brief Median of the last samples, the lower one of the middle pair while the window fills
+ * @param channel: Channel filter
+ * @param value: New sample
+ * @return: Filtered value
+ */
+static int32_t apply_median(filter_channel *channel, int32_t value)
+{
+    uint8_t size = channel->configuration.median_size;
+    int32_t sorted[FILTER_MEDIAN_MAX_SIZE];
+
+    channel->history[channel->index] = value;
+    channel->index = (channel->index + 1) % size;
+
+    if (channel->count < size)
+    {
+        channel->count++;
+    }
+
+    /* Insertion sort, the window holds at most nine samples */
+    for (uint8_t i = 0; i < channel->count; i++)
+    {
+        int32_t sample = channel->history[i];
+        uint8_t j = i;
+
+        while (j > 0 && sorted[j - 1] > sample)
+        {
+            sorted[j] = sorted[j - 1];
+            j--;
+        }
+
+        sorted[j] = sample;
+    }
+
+    return sorted[(channel->count - 1) / 2];
+}
+
+/**
+ * @brief Exponentially weighted moving average, the first sample initializes it
+ * @param channel: Channel filter
+ * @param value: New sample
+ * @return: Filtered value
+ */
+static int32_t apply_ewma(filter_channel *channel, int32_t value)
+{
+    int32_t scaled = value * (1 << FILTER_FRACTION_BITS);
+
+    if (!channel->has_estimate)
+    {
+        channel->estimate = scaled;
+        channel->has_estimate = true;
+        return value;
+    }
+
+    /* Pressure in Q8 times the weight does not fit in 32 bits */
+    int64_t step = (int64_t)(scaled - channel->estimate) * channel->configuration.ewma_weight;
+    channel->estimate += (int32_t)((step + (1 << (FILTER_FRACTION_BITS - 1))) >> FILTER_FRACTION_BITS);
+
+    return round_estimate(channel->estimate);
+}
+
+/**
+ * @brief Scalar Kalman filter for a random walk, the first sample initializes it
+ *
+ * The gain settles where the process and the measurement noise balance, a
+ * larger measurement noise gives a smoother and slower estimate.
+ *
+ * @param channel: Channel filter
+ * @param value: New sample
+ * @return: Filtered value
+ */
+static int32_t apply_kalman(filter_channel *channel, int32_t value)
+{
+    const filter_config *config = &channel->configuration;
+    int32_t scaled = value * (1 << FILTER_FRACTION_BITS);
+    uint32_t noise = (uint32_t)config->measurement_noise << FILTER_FRACTION_BITS;
+
+    if (!channel->has_estimate)
+    {
+        channel->estimate = scaled;
+        channel->variance = noise;
+        channel->gain = GAIN_ONE;
+        channel->has_estimate = true;
+        return value;
+    }
+
+    /* Predict, the value may have drifted since the last sample */
+    channel->variance += (uint32_t)config->process_noise << FILTER_FRACTION_BITS;
+
+    /* Update, the variance stays below measurement plus process noise */
+    uint32_t gain = (uint32_t)(((uint64_t)channel->variance << 16) / (channel->variance + noise));
+    int64_t step = (int64_t)(scaled - channel->estimate) * gain;
+
+    channel->estimate += (int32_t)((step + (GAIN_ONE / 2)) >> 16);
+    channel->variance = (uint32_t)(((uint64_t)channel->variance * (GAIN_ONE - gain)) >> 16);
+    channel->gain = gain;
+
+    return round_estimate(channel->estimate);
+}
+
+/**
+ * @brief Round an estimate to channel units
+ * @param estimate: Value with FILTER_FRACTION_BITS fraction bits
+ * @return: Rounded value
+ */
+static int32_t round_estimate(int32_t estimate)
+{
+    return (estimate + (1 << (FILTER_FRACTION_BITS - 1))) >> FILTER_FRACTION_BITS;
+}
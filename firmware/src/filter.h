@@ -0,0 +1,122 @@
+#ifndef FILTER_H
+#define FILTER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "publish_policy.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Largest median window in samples
+ */
+#define FILTER_MEDIAN_MAX_SIZE 9
+
+/**
+ * @brief Fraction bits of the EWMA and Kalman estimates
+ */
+#define FILTER_FRACTION_BITS 8
+
+/**
+ * @brief Default filter parameters, the CCS811 channels drop single sample spikes
+ */
+#define FILTER_DEFAULT_MEDIAN_SIZE         3
+#define FILTER_DEFAULT_EWMA_WEIGHT         64     /**< 1/4 */
+#define FILTER_DEFAULT_PROCESS_NOISE       1
+#define FILTER_DEFAULT_MEASUREMENT_NOISE   100
+
+/**
+ * @brief Filter types
+ */
+typedef enum
+{
+    FILTER_TYPE_NONE,      /**< Values pass unchanged */
+    FILTER_TYPE_MEDIAN,    /**< Median of the last samples */
+    FILTER_TYPE_EWMA,      /**< Exponentially weighted moving average */
+    FILTER_TYPE_KALMAN,    /**< Scalar Kalman filter for a slowly drifting value */
+    FILTER_TYPE_COUNT
+} filter_type;
+
+/**
+ * @brief Filter configuration of a channel, variances in channel units squared
+ */
+typedef struct
+{
+    filter_type type;              /**< Filter type */
+    uint8_t median_size;           /**< Median window, 1 to FILTER_MEDIAN_MAX_SIZE samples */
+    uint16_t ewma_weight;          /**< Weight of a new sample in 1/256, 1 to 256 */
+    uint16_t process_noise;        /**< Kalman variance of the change between samples, at least 1 */
+    uint16_t measurement_noise;    /**< Kalman variance of the sensor noise */
+} filter_config;
+
+/**
+ * @brief Filter state of a channel
+ */
+typedef struct
+{
+    filter_config configuration;                  /**< Filter configuration */
+    int32_t history[FILTER_MEDIAN_MAX_SIZE];      /**< Last samples, median window */
+    uint8_t count;                                /**< Samples in the median window */
+    uint8_t index;                                /**< Next position in the median window */
+    bool has_estimate;                            /**< Estimate was initialized by a sample */
+    int32_t estimate;                             /**< EWMA or Kalman estimate, FILTER_FRACTION_BITS fraction bits */
+    uint32_t variance;                            /**< Kalman estimate variance, FILTER_FRACTION_BITS fraction bits */
+    uint32_t gain;                                /**< Last Kalman gain, 16 fraction bits */
+} filter_channel;
+
+/**
+ * @brief Filter stage state
+ */
+typedef struct
+{
+    filter_channel channels[PUBLISH_CHANNEL_COUNT];    /**< Filter of every channel */
+} filter;
+
+/**
+ * @brief Initialize the filters with the default configuration
+ *
+ * The CCS811 channels use a median of three samples, the BME280 channels
+ * are not filtered.
+ */
+void filter_init(void);
+
+/**
+ * @brief Set the filter of a channel, its state is reset
+ * @param channel: Channel to configure
+ * @param config: Pointer to configuration structure
+ * @return: true if the configuration is valid, false otherwise
+ */
+bool filter_set_configuration(publish_channel channel, const filter_config *config);
+
+/**
+ * @brief Read the filter of a channel
+ * @param channel: Channel to read
+ * @param config: Pointer to configuration structure
+ * @return: true if the channel is valid, false otherwise
+ */
+bool filter_get_configuration(publish_channel channel, filter_config *config);
+
+/**
+ * @brief Filter a new sample of every channel in place
+ * @param values: Sample values indexed by publish_channel
+ */
+void filter_apply(int32_t values[PUBLISH_CHANNEL_COUNT]);
+
+/**
+ * @brief Delay of a channel filter for a slow change
+ *
+ * The median delays by half its window, the EWMA and the Kalman filter by
+ * (1 - gain) / gain samples with the current gain.
+ *
+ * @param channel: Channel to read
+ * @return: Delay in samples, rounded
+ */
+uint16_t filter_get_latency(publish_channel channel);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FILTER_H */
@@ -0,0 +1,70 @@
+#include "format.h"
+
+/**
+ * @brief Powers of ten used to split the decimal part
+ */
+static const uint32_t powers_of_ten[] = {
+    1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000
+};
+
+uint8_t format_uint(char *buffer, uint32_t value, uint8_t min_digits)
+{
+    char digits[10];
+    uint8_t count = 0;
+
+    do
+    {
+        uint32_t quotient = value / 10;
+        digits[count++] = (char)('0' + (value - quotient * 10));
+        value = quotient;
+    } while (value != 0);
+
+    while (count < min_digits && count < sizeof(digits))
+    {
+        digits[count++] = '0';
+    }
+
+    for (uint8_t index = 0; index < count; index++)
+    {
+        buffer[index] = digits[count - 1 - index];
+    }
+
+    return count;
+}
+
+uint8_t format_fixed(char *buffer, int32_t value, uint8_t decimals)
+{
+    uint8_t length = 0;
+    uint32_t magnitude = (uint32_t)value;
+
+    if (value < 0)
+    {
+        buffer[length++] = '-';
+        magnitude = 0 - magnitude;
+    }
+
+    if (decimals == 0 || decimals >= sizeof(powers_of_ten) / sizeof(powers_of_ten[0]))
+        return length + format_uint(&buffer[length], magnitude, 1);
+
+    uint32_t scale = powers_of_ten[decimals];
+    uint32_t integer = magnitude / scale;
+
+    length += format_uint(&buffer[length], integer, 1);
+    buffer[length++] = '.';
+    length += format_uint(&buffer[length], magnitude - integer * scale, decimals);
+
+    return length;
+}
+
+uint16_t format_text(char *buffer, const char *text)
+{
+    uint16_t length = 0;
+
+    while (text[length] != '\0')
+    {
+        buffer[length] = text[length];
+        length++;
+    }
+
+    return length;
+}
@@ -0,0 +1,48 @@
+#ifndef FORMAT_H
+#define FORMAT_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Longest text written by the number formatters, "-2147483648" or "-21474836.48"
+ */
+#define FORMAT_NUMBER_MAX_LENGTH 12
+
+/**
+ * @brief Format an unsigned integer, without terminating null character
+ * @param buffer: Output buffer of at least FORMAT_NUMBER_MAX_LENGTH bytes
+ * @param value: Value to format
+ * @param min_digits: Minimum number of digits, padded with zeros
+ * @return: Number of characters written
+ */
+uint8_t format_uint(char *buffer, uint32_t value, uint8_t min_digits);
+
+/**
+ * @brief Format a fixed point number, without terminating null character
+ *
+ * The value 12345 with two decimals is written as "123.45".
+ *
+ * @param buffer: Output buffer of at least FORMAT_NUMBER_MAX_LENGTH bytes
+ * @param value: Value in units of 10^-decimals
+ * @param decimals: Number of decimal digits, 0 to 9
+ * @return: Number of characters written
+ */
+uint8_t format_fixed(char *buffer, int32_t value, uint8_t decimals);
+
+/**
+ * @brief Copy a string, without terminating null character
+ * @param buffer: Output buffer
+ * @param text: Null terminated string
+ * @return: Number of characters written
+ */
+uint16_t format_text(char *buffer, const char *text);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FORMAT_H */
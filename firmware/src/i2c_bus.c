@@ -0,0 +1,288 @@
+#include <string.h>
+#include "i2c_bus.h"
+#include "scheduler.h"
+
+/**
+ * @brief Half period of the recovery clock, a few us at 16 MHz
+ */
+#define RECOVERY_DELAY 16
+
+/**
+ * @brief I2C bus scheduler
+ */
+static i2c_bus bus;
+
+/**
+ * @brief Bus task, runs on transfer completion and on the timeout of the active transaction
+ */
+SCHEDULER_TASK_DEF(i2c_bus_task, i2c_bus_handler, SCHEDULER_PRIORITY_HIGH);
+SCHEDULER_TIMER_DEF(i2c_bus_timeout_timer, &i2c_bus_task);
+
+/* I2C bus private functions */
+static bool queue_transaction(uint8_t address, uint8_t reg, bool read, uint8_t *data,
+        uint16_t length, uint32_t timeout, i2c_bus_callback callback, void *context);
+static void start_next(void);
+static void complete(i2c_bus_result result);
+static void recover_bus(void);
+static void recovery_delay(void);
+
+bool i2c_bus_init(I2C_HandleTypeDef *hi2c)
+{
+    if (hi2c == NULL)
+        return false;
+
+    memset(&bus, 0, sizeof(bus));
+    bus.i2c_handle = hi2c;
+
+    return scheduler_register(&i2c_bus_task);
+}
+
+bool i2c_bus_read(uint8_t address, uint8_t reg, uint8_t *data, uint16_t length,
+        uint32_t timeout, i2c_bus_callback callback, void *context)
+{
+    if (data == NULL || length == 0)
+        return false;
+
+    return queue_transaction(address, reg, true, data, length, timeout, callback, context);
+}
+
+bool i2c_bus_write(uint8_t address, uint8_t reg, uint8_t *data, uint16_t length,
+        uint32_t timeout, i2c_bus_callback callback, void *context)
+{
+    if (data == NULL && length > 0)
+        return false;
+
+    return queue_transaction(address, reg, false, data, length, timeout, callback, context);
+}
+
+void i2c_bus_handler(void)
+{
+    while (bus.active)
+    {
+        if (bus.done)
+        {
+            complete(bus.failed ? I2C_BUS_ERROR : I2C_BUS_SUCCESS);
+        }
+        else if (HAL_GetTick() - bus.start_time >= bus.queue[bus.tail].timeout)
+        {
+            /* A slave holding the bus low never lets the transfer finish */
+            recover_bus();
+            complete(I2C_BUS_TIMEOUT);
+        }
+        else
+        {
+            return;
+        }
+
+        start_next();
+    }
+
+    start_next();
+}
+
+bool i2c_bus_is_idle(void)
+{
+    return (bus.count == 0);
+}
+
+void i2c_bus_get_statistics(i2c_bus_statistics *statistics)
+{
+    if (statistics == NULL)
+        return;
+
+    *statistics = bus.statistics;
+}
+
+void i2c_bus_transfer_callback(I2C_HandleTypeDef *hi2c, bool success)
+{
+    if (hi2c != bus.i2c_handle || !bus.active)
+        return;
+
+    bus.failed = !success;
+    bus.done = true;
+    scheduler_post(&i2c_bus_task);
+}
+
+/**
+ * @brief Add a transaction to the queue
+ * @param address: 7-bit slave address
+ * @param reg: Register address
+ * @param read: Register read, write otherwise
+ * @param data: Data buffer
+ * @param length: Number of data bytes
+ * @param timeout: Transaction timeout in ms
+ * @param callback: Completion callback
+ * @param context: Context passed to the callback
+ * @return: True if the transaction was queued, false if the queue is full
+ */
+static bool queue_transaction(uint8_t address, uint8_t reg, bool read, uint8_t *data,
+        uint16_t length, uint32_t timeout, i2c_bus_callback callback, void *context)
+{
+    if (bus.i2c_handle == NULL || bus.count >= I2C_BUS_QUEUE_SIZE)
+        return false;
+
+    i2c_transaction *transaction = &bus.queue[bus.head];
+
+    transaction->address = address;
+    transaction->reg = reg;
+    transaction->read = read;
+    transaction->data = data;
+    transaction->length = length;
+    transaction->timeout = timeout;
+    transaction->callback = callback;
+    transaction->context = context;
+    bus.queued_time[bus.head] = HAL_GetTick();
+
+    bus.head = (bus.head + 1) % I2C_BUS_QUEUE_SIZE;
+    bus.count++;
+
+    start_next();
+    return true;
+}
+
+/**
+ * @brief Start the transaction at the queue tail if the bus is free
+ */
+static void start_next(void)
+{
+    while (!bus.active && bus.count > 0)
+    {
+        i2c_transaction *transaction = &bus.queue[bus.tail];
+        uint16_t address = (uint16_t)(transaction->address << 1);
+        HAL_StatusTypeDef result = HAL_OK;
+
+        bus.done = false;
+        bus.failed = false;
+        bus.active = true;
+        bus.start_time = HAL_GetTick();
+
+        if (transaction->read)
+        {
+            result = HAL_I2C_Mem_Read_IT(bus.i2c_handle, address, transaction->reg,
+                    I2C_MEMADD_SIZE_8BIT, transaction->data, transaction->length);
+        }
+        else if (transaction->length == 0)
+        {
+            result = HAL_I2C_Master_Transmit_IT(bus.i2c_handle, address, &transaction->reg, 1);
+        }
+        else
+        {
+            result = HAL_I2C_Mem_Write_IT(bus.i2c_handle, address, transaction->reg,
+                    I2C_MEMADD_SIZE_8BIT, transaction->data, transaction->length);
+        }
+
+        if (result == HAL_OK)
+        {
+            scheduler_timer_start(&i2c_bus_timeout_timer, transaction->timeout, 0);
+            return;
+        }
+
+        /* Peripheral is still busy with a transfer that never ended */
+        if (result == HAL_BUSY)
+        {
+            recover_bus();
+        }
+
+        complete(I2C_BUS_ERROR);
+    }
+}
+
+/**
+ * @brief Complete the active transaction and call its callback
+ * @param result: Transaction result
+ */
+static void complete(i2c_bus_result result)
+{
+    i2c_transaction transaction = bus.queue[bus.tail];
+    uint32_t latency = HAL_GetTick() - bus.queued_time[bus.tail];
+
+    bus.tail = (bus.tail + 1) % I2C_BUS_QUEUE_SIZE;
+    bus.count--;
+    bus.active = false;
+    scheduler_timer_stop(&i2c_bus_timeout_timer);
+
+    bus.statistics.last_latency = latency;
+    if (latency > bus.statistics.max_latency)
+    {
+        bus.statistics.max_latency = latency;
+    }
+
+    if (result == I2C_BUS_SUCCESS)
+    {
+        bus.statistics.completed++;
+    }
+    else if (result == I2C_BUS_TIMEOUT)
+    {
+        bus.statistics.timeouts++;
+    }
+    else
+    {
+        bus.statistics.errors++;
+    }
+
+    /* Callback can queue the next transaction of its sequence */
+    if (transaction.callback != NULL)
+    {
+        transaction.callback(result, transaction.context);
+    }
+}
+
+/**
+ * @brief Release a stuck bus and restart the peripheral
+ *
+ * A slave reset in the middle of a read can keep SDA low forever. Up to
+ * nine clock pulses let it finish the byte, then a stop condition frees
+ * the bus.
+ */
+static void recover_bus(void)
+{
+    I2C_HandleTypeDef *hi2c = bus.i2c_handle;
+    GPIO_InitTypeDef GPIO_InitStruct = { 0 };
+
+    HAL_I2C_DeInit(hi2c);
+
+    HAL_GPIO_WritePin(I2C_BUS_GPIO_PORT, I2C_BUS_SCL_PIN | I2C_BUS_SDA_PIN, GPIO_PIN_SET);
+
+    GPIO_InitStruct.Pin = I2C_BUS_SCL_PIN | I2C_BUS_SDA_PIN;
+    GPIO_InitStruct.Mode = GPIO_MODE_OUTPUT_OD;
+    GPIO_InitStruct.Pull = GPIO_PULLUP;
+    GPIO_InitStruct.Speed = GPIO_SPEED_FREQ_LOW;
+    HAL_GPIO_Init(I2C_BUS_GPIO_PORT, &GPIO_InitStruct);
+
+    for (uint8_t pulse = 0; pulse < 9; pulse++)
+    {
+        if (HAL_GPIO_ReadPin(I2C_BUS_GPIO_PORT, I2C_BUS_SDA_PIN) == GPIO_PIN_SET)
+            break;
+
+        HAL_GPIO_WritePin(I2C_BUS_GPIO_PORT, I2C_BUS_SCL_PIN, GPIO_PIN_RESET);
+        recovery_delay();
+        HAL_GPIO_WritePin(I2C_BUS_GPIO_PORT, I2C_BUS_SCL_PIN, GPIO_PIN_SET);
+        recovery_delay();
+    }
+
+    /* Stop condition, SDA rises while SCL is high */
+    HAL_GPIO_WritePin(I2C_BUS_GPIO_PORT, I2C_BUS_SCL_PIN, GPIO_PIN_RESET);
+    recovery_delay();
+    HAL_GPIO_WritePin(I2C_BUS_GPIO_PORT, I2C_BUS_SDA_PIN, GPIO_PIN_RESET);
+    recovery_delay();
+    HAL_GPIO_WritePin(I2C_BUS_GPIO_PORT, I2C_BUS_SCL_PIN, GPIO_PIN_SET);
+    recovery_delay();
+    HAL_GPIO_WritePin(I2C_BUS_GPIO_PORT, I2C_BUS_SDA_PIN, GPIO_PIN_SET);
+    recovery_delay();
+
+    /* MSP initialization restores the alternate function of the pins */
+    HAL_I2C_Init(hi2c);
+    HAL_I2CEx_ConfigAnalogFilter(hi2c, I2C_ANALOGFILTER_ENABLE);
+    HAL_I2CEx_ConfigDigitalFilter(hi2c, 0);
+
+    bus.statistics.recoveries++;
+}
+
+/**
+ * @brief Busy wait for half a period of the recovery clock
+ */
+static void recovery_delay(void)
+{
+    for (volatile uint8_t count = 0; count < RECOVERY_DELAY; count++)
+        ;
+}
@@ -0,0 +1,154 @@
+#ifndef I2C_BUS_H
+#define I2C_BUS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "stm32g0xx_hal.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief I2C bus size related macros
+ */
+#define I2C_BUS_QUEUE_SIZE 8
+
+/**
+ * @brief Default transaction timeout in ms, a 32 byte transfer takes about 3 ms at 100 kHz
+ */
+#define I2C_BUS_DEFAULT_TIMEOUT 25
+
+/**
+ * @brief Bus pins, used to clock out a stuck slave during bus recovery
+ */
+#define I2C_BUS_GPIO_PORT GPIOB
+#define I2C_BUS_SCL_PIN   GPIO_PIN_8
+#define I2C_BUS_SDA_PIN   GPIO_PIN_9
+
+/**
+ * @brief Result of an I2C transaction
+ */
+typedef enum
+{
+    I2C_BUS_SUCCESS,    /**< Transaction completed */
+    I2C_BUS_ERROR,      /**< Slave did not acknowledge or a bus error occurred */
+    I2C_BUS_TIMEOUT     /**< Transaction did not complete in time, the bus was recovered */
+} i2c_bus_result;
+
+/**
+ * @brief Transaction completion callback, called from i2c_bus_handler
+ */
+typedef void (*i2c_bus_callback)(i2c_bus_result result, void *context);
+
+/**
+ * @brief Queued I2C transaction
+ */
+typedef struct
+{
+    uint8_t address;              /**< 7-bit slave address */
+    uint8_t reg;                  /**< Register address */
+    bool read;                    /**< Register read, write otherwise */
+    uint8_t *data;                /**< Data buffer, must stay valid until completion */
+    uint16_t length;              /**< Number of data bytes, 0 writes only the register address */
+    uint32_t timeout;             /**< Transaction timeout in ms */
+    i2c_bus_callback callback;    /**< Completion callback, can be NULL */
+    void *context;                /**< Context passed to the callback */
+} i2c_transaction;
+
+/**
+ * @brief I2C bus statistics
+ */
+typedef struct
+{
+    uint32_t completed;       /**< Transactions completed successfully */
+    uint32_t errors;          /**< Transactions completed with error */
+    uint32_t timeouts;        /**< Transactions without completion */
+    uint32_t recoveries;      /**< Bus recoveries */
+    uint32_t last_latency;    /**< Latency of the last transaction in ms, from queueing to completion */
+    uint32_t max_latency;     /**< Highest transaction latency in ms */
+} i2c_bus_statistics;
+
+/**
+ * @brief I2C bus scheduler state
+ */
+typedef struct
+{
+    I2C_HandleTypeDef *i2c_handle;               /**< I2C handle of the bus */
+    i2c_transaction queue[I2C_BUS_QUEUE_SIZE];   /**< Transaction queue, the active transaction is at tail */
+    uint32_t queued_time[I2C_BUS_QUEUE_SIZE];    /**< HAL tick when the transaction was queued */
+    uint8_t head;                                /**< Next free queue position */
+    uint8_t tail;                                /**< Oldest queued transaction */
+    uint8_t count;                               /**< Number of queued transactions */
+    bool active;                                 /**< Transaction at tail was started */
+    volatile bool done;                          /**< Active transaction finished, set by the interrupt */
+    volatile bool failed;                        /**< Active transaction finished with error */
+    uint32_t start_time;                         /**< Start of the active transaction */
+    i2c_bus_statistics statistics;               /**< Bus statistics */
+} i2c_bus;
+
+/**
+ * @brief Initialize the I2C bus scheduler
+ * @param hi2c: Handle of the I2C peripheral, initialized in interrupt mode
+ * @return: true if the scheduler was initialized, false otherwise
+ */
+bool i2c_bus_init(I2C_HandleTypeDef *hi2c);
+
+/**
+ * @brief Queue a register read
+ * @param address: 7-bit slave address
+ * @param reg: First register address
+ * @param data: Buffer for the read data, must stay valid until completion
+ * @param length: Number of bytes to read
+ * @param timeout: Transaction timeout in ms
+ * @param callback: Completion callback, can be NULL
+ * @param context: Context passed to the callback
+ * @return: true if the transaction was queued, false if the queue is full
+ */
+bool i2c_bus_read(uint8_t address, uint8_t reg, uint8_t *data, uint16_t length,
+        uint32_t timeout, i2c_bus_callback callback, void *context);
+
+/**
+ * @brief Queue a register write
+ * @param address: 7-bit slave address
+ * @param reg: First register address
+ * @param data: Data to write, not copied, must stay valid until completion
+ * @param length: Number of bytes to write, 0 writes only the register address
+ * @param timeout: Transaction timeout in ms
+ * @param callback: Completion callback, can be NULL
+ * @param context: Context passed to the callback
+ * @return: true if the transaction was queued, false if the queue is full
+ */
+bool i2c_bus_write(uint8_t address, uint8_t reg, uint8_t *data, uint16_t length,
+        uint32_t timeout, i2c_bus_callback callback, void *context);
+
+/**
+ * @brief I2C bus handler, completes transactions, checks timeouts and starts queued transactions
+ * The handler is a scheduler task posted by the transfer interrupts.
+ */
+void i2c_bus_handler(void);
+
+/**
+ * @brief Check if the bus has no active or queued transaction
+ * @return: true if the bus is idle, false otherwise
+ */
+bool i2c_bus_is_idle(void);
+
+/**
+ * @brief Read the bus statistics
+ * @param statistics: Pointer to statistics structure
+ */
+void i2c_bus_get_statistics(i2c_bus_statistics *statistics);
+
+/**
+ * @brief I2C transfer complete callback
+ * @param hi2c: I2C handle that finished the transfer
+ * @param success: true if the transfer completed, false on error
+ */
+void i2c_bus_transfer_callback(I2C_HandleTypeDef *hi2c, bool success);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* I2C_BUS_H */
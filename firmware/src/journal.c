@@ -0,0 +1,615 @@
+#include <string.h>
+#include "journal.h"
+
+/**
+ * @brief Page header magic, "JRNL"
+ */
+#define JOURNAL_MAGIC 0x4C4E524AUL
+
+/**
+ * @brief First flash page of the journal
+ */
+#define JOURNAL_FIRST_PAGE ((JOURNAL_FLASH_ADDRESS - FLASH_BASE) / FLASH_PAGE_SIZE)
+
+/**
+ * @brief Result of reading a single record
+ */
+#define RECORD_SAMPLE  1     /**< Sample decoded */
+#define RECORD_SKIPPED 0     /**< Cursor or unreadable record consumed */
+#define RECORD_END     (-1)  /**< No more records in the page */
+
+_Static_assert(sizeof(journal_page_header) == 8, "Invalid journal page header size");
+_Static_assert(sizeof(journal_full_record) == 24, "Invalid journal full record size");
+_Static_assert(sizeof(journal_delta_record) == 8, "Invalid journal delta record size");
+_Static_assert(sizeof(journal_cursor_record) == 8, "Invalid journal cursor record size");
+
+/**
+ * @brief Journal flash storage, not programmed with the firmware
+ */
+__attribute__((__section__(".telemetry_journal")))
+    const uint8_t journal_data[JOURNAL_SIZE];
+
+/**
+ * @brief Journal state
+ */
+static journal journal_dev;
+
+/* Journal private functions */
+static const journal_page_header *page_header(uint8_t page);
+static bool page_valid(uint8_t page);
+static uint8_t record_size(uint8_t type);
+static uint8_t crc8(const uint8_t *data, uint16_t length);
+static int8_t read_record(journal_iterator *iterator, journal_sample *sample);
+static bool next_page(journal_iterator *iterator);
+static bool at_writer(const journal_iterator *iterator);
+static bool encode_delta(const journal_sample *base, const journal_sample *sample,
+        journal_delta_record *record);
+static bool open_page(void);
+static bool write_record(const void *record, uint8_t size);
+static bool write_cursor(void);
+static uint32_t find_cursor(void);
+
+void journal_init(void)
+{
+    uint8_t newest = 0;
+    uint8_t oldest = 0;
+    bool found = false;
+
+    memset(&journal_dev, 0, sizeof(journal_dev));
+
+    for (uint8_t page = 0; page < JOURNAL_PAGE_COUNT; page++)
+    {
+        if (!page_valid(page))
+            continue;
+
+        uint32_t sequence = page_header(page)->first_sequence;
+
+        if (!found || (int32_t)(sequence - page_header(newest)->first_sequence) > 0)
+        {
+            newest = page;
+        }
+
+        if (!found || (int32_t)(sequence - page_header(oldest)->first_sequence) < 0)
+        {
+            oldest = page;
+        }
+
+        found = true;
+    }
+
+    if (!found)
+    {
+        /* Empty journal, the first append opens page 0 */
+        journal_dev.writer.page = JOURNAL_PAGE_COUNT - 1;
+        journal_dev.writer.offset = FLASH_PAGE_SIZE;
+        journal_dev.reader = journal_dev.writer;
+        return;
+    }
+
+    /* Walk the newest page to find the end of the journal */
+    journal_iterator *writer = &journal_dev.writer;
+    journal_sample sample;
+
+    writer->page = newest;
+    writer->offset = sizeof(journal_page_header);
+    writer->sequence = page_header(newest)->first_sequence;
+    writer->base_valid = false;
+
+    while (read_record(writer, &sample) != RECORD_END)
+        ;
+
+    /* Uptime samples written before this point belong to an earlier boot */
+    journal_dev.boot_sequence = writer->sequence;
+    writer->base_valid = false;
+
+    /* Skip the samples delivered before the reset */
+    journal_iterator *reader = &journal_dev.reader;
+    uint32_t cursor = find_cursor();
+
+    reader->page = oldest;
+    reader->offset = sizeof(journal_page_header);
+    reader->sequence = page_header(oldest)->first_sequence;
+    reader->base_valid = false;
+
+    if ((int32_t)(cursor - reader->sequence) < 0)
+    {
+        journal_dev.statistics.samples_lost += reader->sequence - cursor;
+        return;
+    }
+
+    while ((int32_t)(reader->sequence - cursor) < 0 && !at_writer(reader))
+    {
+        if (read_record(reader, &sample) == RECORD_END && !next_page(reader))
+            break;
+    }
+}
+
+bool journal_append(const journal_sample *sample)
+{
+    if (sample == NULL)
+        return false;
+
+    journal_iterator *writer = &journal_dev.writer;
+    journal_delta_record delta;
+    bool use_delta = writer->base_valid && encode_delta(&writer->base, sample, &delta);
+    uint8_t size = use_delta ? sizeof(journal_delta_record) : sizeof(journal_full_record);
+
+    if (writer->offset + size > FLASH_PAGE_SIZE)
+    {
+        if (!open_page())
+            return false;
+
+        /* Every page starts with a full record so it can be read on its own */
+        use_delta = false;
+    }
+
+    bool result = false;
+
+    if (use_delta)
+    {
+        delta.crc = crc8(&delta.time, sizeof(delta) - 2);
+        result = write_record(&delta, sizeof(delta));
+    }
+    else
+    {
+        journal_full_record full;
+
+        memset(&full, 0xFF, sizeof(full));
+        full.type = JOURNAL_RECORD_FULL;
+        full.temperature = sample->temperature;
+        full.humidity = sample->humidity;
+        full.tvoc = sample->tvoc;
+        full.eco2 = sample->eco2;
+        full.pressure = sample->pressure;
+        full.timestamp = sample->timestamp;
+        full.time_base = sample->time_base;
+        full.crc = crc8((const uint8_t *)&full.temperature, sizeof(full) - 2);
+
+        result = write_record(&full, sizeof(full));
+    }
+
+    /* A failed record still takes its sequence number, readers skip it */
+    writer->sequence++;
+    writer->base = *sample;
+    writer->base_valid = result;
+
+    if (result)
+    {
+        journal_dev.statistics.samples_written++;
+    }
+
+    return result;
+}
+
+uint32_t journal_pending(void)
+{
+    return journal_dev.writer.sequence - journal_dev.reader.sequence;
+}
+
+void journal_begin(journal_iterator *iterator)
+{
+    if (iterator == NULL)
+        return;
+
+    *iterator = journal_dev.reader;
+}
+
+bool journal_read(journal_iterator *iterator, journal_sample *sample)
+{
+    if (iterator == NULL || sample == NULL)
+        return false;
+
+    while (!at_writer(iterator))
+    {
+        int8_t result = read_record(iterator, sample);
+
+        if (result == RECORD_SAMPLE)
+        {
+            /* The boot the tick belonged to is gone, the sample can not be dated */
+            if (sample->time_base == JOURNAL_TIME_UPTIME
+                && (int32_t)(iterator->sequence - 1 - journal_dev.boot_sequence) < 0)
+            {
+                iterator->expired++;
+                continue;
+            }
+
+            return true;
+        }
+
+        if (result == RECORD_END && !next_page(iterator))
+            return false;
+    }
+
+    return false;
+}
+
+void journal_acknowledge(const journal_iterator *iterator)
+{
+    if (iterator == NULL)
+        return;
+
+    /* Position was read before the page holding it was erased */
+    if ((int32_t)(iterator->sequence - journal_dev.reader.sequence) <= 0)
+        return;
+
+    journal_dev.statistics.samples_lost += iterator->expired - journal_dev.reader.expired;
+    journal_dev.reader = *iterator;
+    write_cursor();
+}
+
+void journal_get_statistics(journal_statistics *statistics)
+{
+    if (statistics == NULL)
+        return;
+
+    *statistics = journal_dev.statistics;
+}
+
+/**
+ * @brief Header of a journal page
+ * @param page: Journal page index
+ * @return: Pointer to the page header in flash
+ */
+static const journal_page_header *page_header(uint8_t page)
+{
+    return (const journal_page_header *)&journal_data[page * FLASH_PAGE_SIZE];
+}
+
+/**
+ * @brief Check if a page was opened by the journal
+ * @param page: Journal page index
+ * @return: True if the page holds records, false otherwise
+ */
+static bool page_valid(uint8_t page)
+{
+    return (page_header(page)->magic == JOURNAL_MAGIC);
+}
+
+/**
+ * @brief Size of a record in flash
+ * @param type: Record type
+ * @return: Record size in bytes, unknown records are skipped one double word at a time
+ */
+static uint8_t record_size(uint8_t type)
+{
+    return (type == JOURNAL_RECORD_FULL) ? sizeof(journal_full_record) : 8;
+}
+
+/**
+ * @brief CRC-8 with polynomial 0x07
+ * @param data: Data bytes
+ * @param length: Number of bytes
+ * @return: CRC value
+ */
+static uint8_t crc8(const uint8_t *data, uint16_t length)
+{
+    uint8_t crc = 0;
+
+    while (length--)
+    {
+        crc ^= *data++;
+
+        for (uint8_t bit = 0; bit < 8; bit++)
+        {
+            crc = (crc & 0x80) ? (uint8_t)((crc << 1) ^ 0x07) : (uint8_t)(crc << 1);
+        }
+    }
+
+    return crc;
+}
+
+/**
+ * @brief Read the record at the iterator position, the page is not changed
+ * @param iterator: Journal position, advanced past the record
+ * @param sample: Decoded sample
+ * @return: RECORD_SAMPLE, RECORD_SKIPPED or RECORD_END
+ */
+static int8_t read_record(journal_iterator *iterator, journal_sample *sample)
+{
+    if (iterator->offset + 8 > FLASH_PAGE_SIZE)
+        return RECORD_END;
+
+    const uint8_t *record = &journal_data[iterator->page * FLASH_PAGE_SIZE + iterator->offset];
+    uint8_t type = record[0];
+
+    if (type == JOURNAL_RECORD_EMPTY)
+        return RECORD_END;
+
+    iterator->offset += record_size(type);
+
+    if (type == JOURNAL_RECORD_FULL && iterator->offset <= FLASH_PAGE_SIZE)
+    {
+        const journal_full_record *full = (const journal_full_record *)record;
+        iterator->sequence++;
+
+        if (full->crc != crc8((const uint8_t *)&full->temperature, sizeof(*full) - 2))
+        {
+            iterator->base_valid = false;
+            return RECORD_SKIPPED;
+        }
+
+        sample->timestamp = full->timestamp;
+        sample->time_base = full->time_base;
+        sample->temperature = full->temperature;
+        sample->humidity = full->humidity;
+        sample->pressure = full->pressure;
+        sample->tvoc = full->tvoc;
+        sample->eco2 = full->eco2;
+    }
+    else if (type == JOURNAL_RECORD_DELTA)
+    {
+        const journal_delta_record *delta = (const journal_delta_record *)record;
+        iterator->sequence++;
+
+        /* A delta without base can not be decoded until the next full record */
+        if (!iterator->base_valid || delta->crc != crc8(&delta->time, sizeof(*delta) - 2))
+        {
+            iterator->base_valid = false;
+            return RECORD_SKIPPED;
+        }
+
+        *sample = iterator->base;
+        sample->timestamp += delta->time;
+        sample->temperature += delta->temperature;
+        sample->humidity += delta->humidity;
+        sample->pressure += delta->pressure;
+        sample->tvoc += delta->tvoc;
+        sample->eco2 += delta->eco2;
+    }
+    else
+    {
+        /* Cursor or unknown record */
+        return RECORD_SKIPPED;
+    }
+
+    iterator->base = *sample;
+    iterator->base_valid = true;
+    return RECORD_SAMPLE;
+}
+
+/**
+ * @brief Move the iterator to the start of the following page
+ * @param iterator: Journal position
+ * @return: True if the iterator was moved, false if the following page is not in use
+ */
+static bool next_page(journal_iterator *iterator)
+{
+    uint8_t page = (iterator->page + 1) % JOURNAL_PAGE_COUNT;
+
+    if (!page_valid(page))
+        return false;
+
+    iterator->page = page;
+    iterator->offset = sizeof(journal_page_header);
+
+    /* Records between the pages were lost, delta base is not known */
+    if (page_header(page)->first_sequence != iterator->sequence)
+    {
+        iterator->sequence = page_header(page)->first_sequence;
+        iterator->base_valid = false;
+    }
+
+    return true;
+}
+
+/**
+ * @brief Check if the iterator reached the write position
+ * @param iterator: Journal position
+ * @return: True at the end of the journal, false otherwise
+ */
+static bool at_writer(const journal_iterator *iterator)
+{
+    return (iterator->page == journal_dev.writer.page
+            && iterator->offset >= journal_dev.writer.offset);
+}
+
+/**
+ * @brief Encode a sample as the difference to the previous one
+ * @param base: Previous sample
+ * @param sample: Sample to encode
+ * @param record: Encoded delta record
+ * @return: True if every difference fits in the record, false otherwise
+ */
+static bool encode_delta(const journal_sample *base, const journal_sample *sample,
+        journal_delta_record *record)
+{
+    int32_t time = (int32_t)(sample->timestamp - base->timestamp);
+    int32_t temperature = sample->temperature - base->temperature;
+    int32_t humidity = (int32_t)sample->humidity - base->humidity;
+    int32_t pressure = (int32_t)(sample->pressure - base->pressure);
+    int32_t tvoc = (int32_t)sample->tvoc - base->tvoc;
+    int32_t eco2 = (int32_t)sample->eco2 - base->eco2;
+
+    if (sample->time_base != base->time_base || time < 0 || time > UINT8_MAX)
+        return false;
+
+    if (temperature < INT8_MIN || temperature > INT8_MAX
+        || humidity < INT8_MIN || humidity > INT8_MAX
+        || pressure < INT8_MIN || pressure > INT8_MAX
+        || tvoc < INT8_MIN || tvoc > INT8_MAX
+        || eco2 < INT8_MIN || eco2 > INT8_MAX)
+        return false;
+
+    record->type = JOURNAL_RECORD_DELTA;
+    record->time = (uint8_t)time;
+    record->temperature = (int8_t)temperature;
+    record->humidity = (int8_t)humidity;
+    record->pressure = (int8_t)pressure;
+    record->tvoc = (int8_t)tvoc;
+    record->eco2 = (int8_t)eco2;
+
+    return true;
+}
+
+/**
+ * @brief Erase the page after the write page and start writing in it
+ *
+ * Pages are used round robin so the erase cycles are spread over the whole
+ * journal. When the journal is full the oldest page is dropped.
+ *
+ * @return: True if the page was opened, false otherwise
+ */
+static bool open_page(void)
+{
+    journal_iterator *writer = &journal_dev.writer;
+    journal_iterator *reader = &journal_dev.reader;
+    uint8_t page = (writer->page + 1) % JOURNAL_PAGE_COUNT;
+
+    if (page_valid(page) && reader->page == page && page != writer->page)
+    {
+        /* Move the replay position to the next oldest page */
+        journal_iterator next = *reader;
+
+        if (next_page(&next))
+        {
+            journal_dev.statistics.samples_lost += next.sequence - reader->sequence;
+            *reader = next;
+        }
+    }
+
+    FLASH_EraseInitTypeDef EraseInitStruct = { 0 };
+    uint32_t erase_error = 0;
+
+    EraseInitStruct.TypeErase = FLASH_TYPEERASE_PAGES;
+    EraseInitStruct.Page      = JOURNAL_FIRST_PAGE + page;
+    EraseInitStruct.NbPages   = 1;
+
+    HAL_FLASH_Unlock();
+    HAL_StatusTypeDef status = HAL_FLASHEx_Erase(&EraseInitStruct, &erase_error);
+
+    journal_page_header header = {
+        .magic = JOURNAL_MAGIC,
+        .first_sequence = writer->sequence
+    };
+
+    if (status == HAL_OK)
+    {
+        uint64_t data;
+        memcpy(&data, &header, sizeof(data));
+        status = HAL_FLASH_Program(FLASH_TYPEPROGRAM_DOUBLEWORD,
+                JOURNAL_FLASH_ADDRESS + page * FLASH_PAGE_SIZE, data);
+    }
+
+    HAL_FLASH_Lock();
+    journal_dev.statistics.page_erases++;
+
+    if (status != HAL_OK)
+    {
+        journal_dev.statistics.write_errors++;
+        return false;
+    }
+
+    /* Replay position inside the erased page, nothing was left to deliver */
+    if (reader->page == page)
+    {
+        reader->offset = sizeof(journal_page_header);
+        reader->sequence = writer->sequence;
+        reader->base_valid = false;
+    }
+
+    writer->page = page;
+    writer->offset = sizeof(journal_page_header);
+    writer->base_valid = false;
+
+    /* Keep the replay position in every page, older cursor records get erased */
+    return write_cursor();
+}
+
+/**
+ * @brief Program a record at the write position
+ * @param record: Record data, size must be a multiple of 8
+ * @param size: Record size
+ * @return: True if the record was programmed, false otherwise
+ */
+static bool write_record(const void *record, uint8_t size)
+{
+    journal_iterator *writer = &journal_dev.writer;
+    uint32_t address = JOURNAL_FLASH_ADDRESS + writer->page * FLASH_PAGE_SIZE + writer->offset;
+    const uint8_t *data = (const uint8_t *)record;
+    bool result = true;
+
+    HAL_FLASH_Unlock();
+
+    for (uint8_t index = 0; index < size; index += 8)
+    {
+        uint64_t word;
+        memcpy(&word, &data[index], sizeof(word));
+
+        if (HAL_FLASH_Program(FLASH_TYPEPROGRAM_DOUBLEWORD, address + index, word) != HAL_OK)
+        {
+            result = false;
+            break;
+        }
+    }
+
+    HAL_FLASH_Lock();
+
+    /* Partially programmed records are skipped by the readers */
+    writer->offset += size;
+
+    if (!result)
+    {
+        journal_dev.statistics.write_errors++;
+    }
+
+    return result;
+}
+
+/**
+ * @brief Append a cursor record with the replay position
+ * @return: True if the record was written, false otherwise
+ */
+static bool write_cursor(void)
+{
+    if (journal_dev.writer.offset + sizeof(journal_cursor_record) > FLASH_PAGE_SIZE)
+        return open_page();
+
+    journal_cursor_record cursor = {
+        .type = JOURNAL_RECORD_CURSOR,
+        .reserved = 0xFFFF,
+        .sequence = journal_dev.reader.sequence
+    };
+
+    cursor.crc = crc8((const uint8_t *)&cursor.reserved, sizeof(cursor) - 2);
+
+    return write_record(&cursor, sizeof(cursor));
+}
+
+/**
+ * @brief Find the newest replay position stored in the journal
+ * @return: Sequence number of the oldest sample not delivered
+ */
+static uint32_t find_cursor(void)
+{
+    uint32_t cursor = 0;
+    bool found = false;
+
+    for (uint8_t page = 0; page < JOURNAL_PAGE_COUNT; page++)
+    {
+        if (!page_valid(page))
+            continue;
+
+        uint16_t offset = sizeof(journal_page_header);
+
+        while (offset + 8 <= FLASH_PAGE_SIZE)
+        {
+            const journal_cursor_record *record =
+                    (const journal_cursor_record *)&journal_data[page * FLASH_PAGE_SIZE + offset];
+
+            if (record->type == JOURNAL_RECORD_EMPTY)
+                break;
+
+            if (record->type == JOURNAL_RECORD_CURSOR
+                && record->crc == crc8((const uint8_t *)&record->reserved, sizeof(*record) - 2)
+                && (!found || (int32_t)(record->sequence - cursor) > 0))
+            {
+                cursor = record->sequence;
+                found = true;
+            }
+
+            offset += record_size(record->type);
+        }
+    }
+
+    return cursor;
+}
@@ -0,0 +1,186 @@
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "stm32g0xx_hal.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Journal flash region, must match the JOURNAL region of the linker script
+ */
+#define JOURNAL_FLASH_ADDRESS 0x8018800
+#define JOURNAL_PAGE_COUNT    14
+#define JOURNAL_SIZE          (JOURNAL_PAGE_COUNT * FLASH_PAGE_SIZE)
+
+/**
+ * @brief Journal record types, the first byte of every record
+ */
+#define JOURNAL_RECORD_FULL   0x01
+#define JOURNAL_RECORD_DELTA  0x02
+#define JOURNAL_RECORD_CURSOR 0x03
+#define JOURNAL_RECORD_EMPTY  0xFF
+
+/**
+ * @brief Journal time bases, stored in the full records
+ */
+#define JOURNAL_TIME_UNIX   0xFFFF    /**< Unix time, left erased */
+#define JOURNAL_TIME_UPTIME 0x0000    /**< HAL tick in s, taken before the time was synchronized */
+
+/**
+ * @brief Timestamped sample stored in the journal
+ */
+typedef struct
+{
+    uint32_t timestamp;     /**< Time in s, in the time base */
+    uint16_t time_base;     /**< JOURNAL_TIME_UNIX or JOURNAL_TIME_UPTIME */
+    int16_t temperature;    /**< Temperature in 0.01 degC */
+    uint16_t humidity;      /**< Relative humidity in 0.01 % */
+    uint32_t pressure;      /**< Pressure in Pa */
+    uint16_t tvoc;          /**< Total volatile organic compound in ppb */
+    uint16_t eco2;          /**< Equivalent carbon dioxide in ppm */
+} journal_sample;
+
+/**
+ * @brief Page header, first double word of every used page
+ */
+typedef struct
+{
+    uint32_t magic;             /**< JOURNAL_MAGIC for a page in use */
+    uint32_t first_sequence;    /**< Sequence number of the first sample in the page */
+} journal_page_header;
+
+/**
+ * @brief Full sample record, starts every page and follows any gap
+ */
+typedef struct
+{
+    uint8_t type;            /**< JOURNAL_RECORD_FULL */
+    uint8_t crc;             /**< CRC-8 of the bytes after this field */
+    int16_t temperature;     /**< Temperature in 0.01 degC */
+    uint16_t humidity;       /**< Relative humidity in 0.01 % */
+    uint16_t tvoc;           /**< Total volatile organic compound in ppb */
+    uint16_t eco2;           /**< Equivalent carbon dioxide in ppm */
+    uint16_t time_base;      /**< Time base of the timestamp */
+    uint32_t pressure;       /**< Pressure in Pa */
+    uint32_t timestamp;      /**< Time in s, in the time base */
+    uint32_t reserved2;      /**< Unused, left erased */
+} journal_full_record;
+
+/**
+ * @brief Sample record holding the differences to the previous sample
+ */
+typedef struct
+{
+    uint8_t type;           /**< JOURNAL_RECORD_DELTA */
+    uint8_t crc;            /**< CRC-8 of the bytes after this field */
+    uint8_t time;           /**< Time since the previous sample in s */
+    int8_t temperature;     /**< Temperature difference in 0.01 degC */
+    int8_t humidity;        /**< Humidity difference in 0.01 % */
+    int8_t pressure;        /**< Pressure difference in Pa */
+    int8_t tvoc;            /**< TVOC difference in ppb */
+    int8_t eco2;            /**< eCO2 difference in ppm */
+} journal_delta_record;
+
+/**
+ * @brief Replay position record, written when samples were delivered
+ */
+typedef struct
+{
+    uint8_t type;          /**< JOURNAL_RECORD_CURSOR */
+    uint8_t crc;           /**< CRC-8 of the bytes after this field */
+    uint16_t reserved;     /**< Unused, left erased */
+    uint32_t sequence;     /**< Sequence number of the oldest sample not delivered */
+} journal_cursor_record;
+
+/**
+ * @brief Position in the journal, used for writing and replay
+ */
+typedef struct
+{
+    uint8_t page;               /**< Journal page index */
+    uint16_t offset;            /**< Byte offset of the next record in the page */
+    uint32_t sequence;          /**< Sequence number of the next sample */
+    journal_sample base;        /**< Previous sample, base of delta records */
+    bool base_valid;            /**< Base sample is known */
+    uint32_t expired;           /**< Uptime samples of an earlier boot skipped by reads */
+} journal_iterator;
+
+/**
+ * @brief Journal statistics
+ */
+typedef struct
+{
+    uint32_t samples_written;    /**< Samples appended */
+    uint32_t samples_lost;       /**< Samples erased before replay or unreadable */
+    uint32_t page_erases;        /**< Pages erased */
+    uint32_t write_errors;       /**< Failed flash operations */
+} journal_statistics;
+
+/**
+ * @brief Journal state
+ */
+typedef struct
+{
+    journal_iterator writer;          /**< Write position */
+    journal_iterator reader;          /**< Oldest sample not delivered */
+    journal_statistics statistics;    /**< Journal statistics */
+    uint32_t boot_sequence;           /**< Sequence number of the first sample of this boot */
+} journal;
+
+/**
+ * @brief Mount the journal, find the write and replay positions
+ */
+void journal_init(void);
+
+/**
+ * @brief Append a sample
+ * @param sample: Sample to append
+ * @return: true if the sample was written, false otherwise
+ */
+bool journal_append(const journal_sample *sample);
+
+/**
+ * @brief Number of samples not yet delivered
+ * @return: Number of samples
+ */
+uint32_t journal_pending(void);
+
+/**
+ * @brief Start reading at the oldest sample not delivered
+ * @param iterator: Read position
+ */
+void journal_begin(journal_iterator *iterator);
+
+/**
+ * @brief Read the next sample, unreadable samples are skipped
+ *
+ * Uptime samples of an earlier boot can not be converted to Unix time and
+ * are skipped too, they are counted as lost when acknowledged.
+ *
+ * @param iterator: Read position, advanced past the sample
+ * @param sample: Read sample
+ * @return: true if a sample was read, false at the end of the journal
+ */
+bool journal_read(journal_iterator *iterator, journal_sample *sample);
+
+/**
+ * @brief Mark the samples before a read position as delivered
+ * @param iterator: Read position after the last delivered sample
+ */
+void journal_acknowledge(const journal_iterator *iterator);
+
+/**
+ * @brief Read the journal statistics
+ * @param statistics: Pointer to statistics structure
+ */
+void journal_get_statistics(journal_statistics *statistics);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* JOURNAL_H */
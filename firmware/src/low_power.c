@@ -0,0 +1,164 @@
+#include <string.h>
+#include "low_power.h"
+#include "i2c_bus.h"
+#include "wifi.h"
+
+/**
+ * @brief LPTIM1 prescaler, LSI divided by 32 counts in ms
+ */
+#define LPTIM_PRESCALER_DIV32 5U
+
+/**
+ * @brief Low power state
+ */
+static low_power lp;
+
+/* Low power private functions */
+static bool stop_allowed(void);
+static uint16_t read_counter(void);
+static void wait_flag(uint32_t flag);
+
+void low_power_init(void)
+{
+    memset(&lp, 0, sizeof(lp));
+
+    __HAL_RCC_LPTIM1_CLK_ENABLE();
+
+    /* Configuration and interrupt registers are written while the timer is disabled */
+    LPTIM1->CR = 0;
+    LPTIM1->CFGR = (LPTIM_PRESCALER_DIV32 << LPTIM_CFGR_PRESC_Pos);
+    LPTIM1->IER = LPTIM_IER_CMPMIE;
+    LPTIM1->CR = LPTIM_CR_ENABLE;
+
+    /* Free running counter, the compare register holds the next wake up */
+    LPTIM1->ARR = 0xFFFF;
+    wait_flag(LPTIM_ISR_ARROK);
+    LPTIM1->CR |= LPTIM_CR_CNTSTRT;
+
+    HAL_NVIC_SetPriority(TIM6_DAC_LPTIM1_IRQn, 0, 0);
+    HAL_NVIC_EnableIRQ(TIM6_DAC_LPTIM1_IRQn);
+}
+
+bool low_power_add_uart_wakeup(UART_HandleTypeDef *huart)
+{
+    if (huart == NULL || lp.uart_count >= LOW_POWER_UART_COUNT)
+        return false;
+
+    UART_WakeUpTypeDef wakeup = { 0 };
+    wakeup.WakeUpEvent = UART_WAKEUP_ON_STARTBIT;
+
+    if (HAL_UARTEx_StopModeWakeUpSourceConfig(huart, wakeup) != HAL_OK)
+        return false;
+
+    __HAL_UART_ENABLE_IT(huart, UART_IT_WUF);
+
+    if (HAL_UARTEx_EnableStopMode(huart) != HAL_OK)
+        return false;
+
+    lp.uart_handles[lp.uart_count++] = huart;
+    return true;
+}
+
+void low_power_sleep(uint32_t idle_time)
+{
+    if (idle_time < LOW_POWER_MIN_STOP_TIME || !stop_allowed())
+    {
+        lp.statistics.sleeps++;
+        __WFI();
+        return;
+    }
+
+    if (idle_time > LOW_POWER_MAX_STOP_TIME)
+    {
+        idle_time = LOW_POWER_MAX_STOP_TIME;
+    }
+
+    uint16_t start = read_counter();
+
+    LPTIM1->ICR = LPTIM_ICR_CMPOKCF;
+    LPTIM1->CMP = (uint16_t)(start + idle_time);
+    wait_flag(LPTIM_ISR_CMPOK);
+    LPTIM1->ICR = LPTIM_ICR_CMPMCF;
+
+    /* SysTick does not run in STOP1, its interrupt would only wake the device */
+    HAL_SuspendTick();
+    HAL_PWR_EnterSTOPMode(PWR_LOWPOWERREGULATOR_ON, PWR_STOPENTRY_WFI);
+
+    /* The device wakes up on HSI16, which is already the system clock. The
+       ticks missed in STOP1 are added so HAL_GetTick based timing continues */
+    uint16_t elapsed = (uint16_t)(read_counter() - start);
+    uwTick += elapsed;
+    HAL_ResumeTick();
+
+    lp.statistics.stops++;
+    lp.statistics.stop_time += elapsed;
+}
+
+void low_power_timer_irq_handler(void)
+{
+    if (LPTIM1->ISR & LPTIM_ISR_CMPM)
+    {
+        LPTIM1->ICR = LPTIM_ICR_CMPMCF;
+    }
+}
+
+void low_power_get_statistics(low_power_statistics *statistics)
+{
+    if (statistics == NULL)
+        return;
+
+    *statistics = lp.statistics;
+}
+
+/**
+ * @brief Check if every peripheral in use keeps working in STOP1
+ * @return: true if STOP1 can be entered, false otherwise
+ */
+static bool stop_allowed(void)
+{
+    /* The I2C master loses its clock in STOP1 */
+    if (!i2c_bus_is_idle())
+        return false;
+
+    /* Start bit wakeup is too slow for a fast WiFi link that expects a response */
+    if (!wifi_stop_allowed())
+        return false;
+
+    /* Reception wakes the device, a transmission would stall */
+    for (uint8_t index = 0; index < lp.uart_count; index++)
+    {
+        if (lp.uart_handles[index]->gState != HAL_UART_STATE_READY)
+            return false;
+    }
+
+    return true;
+}
+
+/**
+ * @brief Read the LPTIM counter
+ * The counter runs on the asynchronous LSI clock, two equal reads are needed.
+ * @return: Counter value in ms
+ */
+static uint16_t read_counter(void)
+{
+    uint32_t first = 0;
+    uint32_t second = 0;
+
+    do
+    {
+        first = LPTIM1->CNT;
+        second = LPTIM1->CNT;
+    } while (first != second);
+
+    return (uint16_t)first;
+}
+
+/**
+ * @brief Wait until a register write was synchronized to the LPTIM clock
+ * @param flag: LPTIM_ISR_ARROK or LPTIM_ISR_CMPOK
+ */
+static void wait_flag(uint32_t flag)
+{
+    while (!(LPTIM1->ISR & flag))
+        ;
+}
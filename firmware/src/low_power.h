@@ -0,0 +1,83 @@
+#ifndef LOW_POWER_H
+#define LOW_POWER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "stm32g0xx_hal.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Shortest idle time in ms worth entering STOP1, shorter idle times use sleep mode
+ */
+#define LOW_POWER_MIN_STOP_TIME 3
+
+/**
+ * @brief Longest STOP1 period in ms, limited by the 16-bit LPTIM counter
+ */
+#define LOW_POWER_MAX_STOP_TIME 60000
+
+/**
+ * @brief Maximum number of UARTs that wake up the device
+ */
+#define LOW_POWER_UART_COUNT 2
+
+/**
+ * @brief Low power statistics
+ */
+typedef struct
+{
+    uint32_t sleeps;       /**< Sleep mode entries */
+    uint32_t stops;        /**< STOP1 entries */
+    uint32_t stop_time;    /**< Total time in STOP1 in ms */
+} low_power_statistics;
+
+/**
+ * @brief Low power state
+ */
+typedef struct
+{
+    UART_HandleTypeDef *uart_handles[LOW_POWER_UART_COUNT];    /**< UARTs that wake up the device */
+    uint8_t uart_count;                                         /**< Number of wake up UARTs */
+    low_power_statistics statistics;                            /**< Low power statistics */
+} low_power;
+
+/**
+ * @brief Start the LPTIM wake up timer
+ * LSI must be running and selected as LPTIM1 clock.
+ */
+void low_power_init(void);
+
+/**
+ * @brief Let a UART wake up the device from STOP1 on a start bit
+ * The UART kernel clock must be HSI16.
+ * @param huart: UART handle
+ * @return: true if the UART was configured, false otherwise
+ */
+bool low_power_add_uart_wakeup(UART_HandleTypeDef *huart);
+
+/**
+ * @brief Wait for an interrupt in the deepest mode allowed
+ * Must be called with interrupts disabled, HAL_GetTick includes the time spent in STOP1.
+ * @param idle_time: Time to the next scheduled work in ms
+ */
+void low_power_sleep(uint32_t idle_time);
+
+/**
+ * @brief LPTIM compare match interrupt handler
+ */
+void low_power_timer_irq_handler(void);
+
+/**
+ * @brief Read the low power statistics
+ * @param statistics: Pointer to statistics structure
+ */
+void low_power_get_statistics(low_power_statistics *statistics);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* LOW_POWER_H */
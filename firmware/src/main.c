@@ -1,20 +1,27 @@
 #include "main.h"
+#include "config_store.h"
+#include "i2c_bus.h"
 #include "ccs811.h"
+#include "ccs811_baseline.h"
+#include "acquisition.h"
 #include "bme280.h"
 #include "wifi.h"
 #include "pc_uart.h"
+#include "journal.h"
+#include "publish_policy.h"
+#include "filter.h"
+#include "telemetry.h"
 #include "status_led.h"
-#include "software_timer.h"
+#include "scheduler.h"
+#include "low_power.h"
 
 /**
- * @brief Check measurement every 5 seconds
+ * @brief Sensor poll and led periods in ms, the sensor drivers are polled only
+ *        while they wait for a delay or a measurement is in progress. The
+ *        measurement interval follows the acquisition level.
  */
-SOFTWARE_TIMER_DEF(measurement_timer, 5000);
-
-/**
- * @brief Blink status led
- */
-SOFTWARE_TIMER_DEF(led_blink_timer, 500);
+#define SENSOR_POLL_INTERVAL 10
+#define LED_BLINK_INTERVAL   500
 
 /**f
  * @brief I2C handles
@@ -27,6 +34,13 @@ I2C_HandleTypeDef hi2c1;
 UART_HandleTypeDef huart1;
 UART_HandleTypeDef huart2;
 
+/**
+ * @brief DMA handles
+ */
+DMA_HandleTypeDef hdma_usart1_rx;
+DMA_HandleTypeDef hdma_usart1_tx;
+DMA_HandleTypeDef hdma_usart2_tx;
+
 /**
  * @brief Sensors
  */
@@ -39,11 +53,20 @@ bme280_device bme280_dev;
 bme280_measurements environmental_data;
 ccs811_measurements air_quality;
 
+/**
+ * @brief Sensor reads were started, telemetry is updated when they finish
+ */
+static bool measurement_pending = false;
+
 /**
  * @brief Private function prototypes
  */
+static void measurement_task_handler(void);
+static void sensor_task_handler(void);
+static void led_task_handler(void);
 void SystemClock_Config(void);
 static void MX_GPIO_Init(void);
+static void MX_DMA_Init(void);
 static void MX_I2C1_Init(void);
 static void MX_USART1_UART_Init(void);
 static void MX_USART2_UART_Init(void);
@@ -51,6 +74,16 @@ static void MX_CCS811_Init(void);
 static void MX_BME280_Init(void);
 static void MX_WiFi_Init(void);
 
+/**
+ * @brief Application tasks
+ */
+SCHEDULER_TASK_DEF(measurement_task, measurement_task_handler, SCHEDULER_PRIORITY_NORMAL);
+SCHEDULER_TASK_DEF(sensor_task, sensor_task_handler, SCHEDULER_PRIORITY_NORMAL);
+SCHEDULER_TASK_DEF(led_task, led_task_handler, SCHEDULER_PRIORITY_LOW);
+SCHEDULER_TIMER_DEF(measurement_timer, &measurement_task);
+SCHEDULER_TIMER_DEF(sensor_timer, &sensor_task);
+SCHEDULER_TIMER_DEF(led_blink_timer, &led_task);
+
 /**
  * @brief The application entry point.
  */
@@ -62,12 +95,20 @@ int main(void)
     /* Configure the system clock */
     SystemClock_Config();
 
+    /* Modules register their tasks during initialization */
+    scheduler_init();
+    low_power_init();
+
     /* Initialize all configured peripherals */
     MX_GPIO_Init();
+    MX_DMA_Init();
     MX_I2C1_Init();
     MX_USART1_UART_Init();
     MX_USART2_UART_Init();
 
+    /* Saved configuration of all modules */
+    config_store_init();
+
     /* Initialize PC communication */
     pc_uart_init(&huart2);
 
@@ -76,48 +117,101 @@ int main(void)
     MX_BME280_Init();
 
     /* Start WiFi */
+    journal_init();
+    publish_policy_init();
+    filter_init();
+    telemetry_init();
     MX_WiFi_Init();
 
     /* System initialized */
     status_led_set_state(STATUS_LED_GREEN);
-    timer_start(&led_blink_timer);
 
-    timer_start(&measurement_timer);
+    scheduler_register(&measurement_task);
+    scheduler_register(&sensor_task);
+    scheduler_register(&led_task);
+    scheduler_timer_start(&led_blink_timer, LED_BLINK_INTERVAL, LED_BLINK_INTERVAL);
+    uint32_t interval = acquisition_get_interval();
+    scheduler_timer_start(&measurement_timer, interval, interval);
+    scheduler_post(&sensor_task);
 
-    while (1)
+    scheduler_run();
+}
+
+/**
+ * @brief Start the sensor measurements
+ */
+static void measurement_task_handler(void)
+{
+    /* Sensors not ready are skipped, their last values are used */
+    bme280_start_measurement(&bme280_dev);
+    ccs811_start_measurement(&ccs811_dev);
+    measurement_pending = true;
+    scheduler_post(&sensor_task);
+}
+
+/**
+ * @brief Advance the sensor drivers and pass finished measurements to telemetry
+ */
+static void sensor_task_handler(void)
+{
+    bme280_handler(&bme280_dev);
+    ccs811_handler(&ccs811_dev);
+    acquisition_handler();
+
+    if (measurement_pending && !bme280_is_busy(&bme280_dev) && !ccs811_is_busy(&ccs811_dev))
     {
-        if (timer_is_expired(&measurement_timer))
+        if (bme280_get_measurements(&bme280_dev, &environmental_data))
         {
-            if (!bme280_is_measuring(&bme280_dev))
-            {
-                bme280_read_measurements(&bme280_dev, &environmental_data);
-                ccs811_set_environmental_data(&ccs811_dev, environmental_data.humidity,
-                        environmental_data.temperature);
-            }
-
-            if (ccs811_data_available(&ccs811_dev))
-            {
-                ccs811_read_measurements(&ccs811_dev, &air_quality);
-            }
-
-            timer_start(&measurement_timer);
+            ccs811_set_environmental_data(&ccs811_dev, environmental_data.humidity,
+                    environmental_data.temperature);
         }
-        
-        wifi_handler();
-        pc_uart_handler();
 
-        if (timer_is_expired(&led_blink_timer))
+        if (ccs811_get_measurements(&ccs811_dev, &air_quality))
         {
-            if (status_led_get_state() == STATUS_LED_OFF)
-            {
-                status_led_set_state(STATUS_LED_GREEN);
-            }
-            else
-            {
-                status_led_set_state(STATUS_LED_OFF);
-            }
-            timer_start(&led_blink_timer);
+            ccs811_baseline_measurement_read();
         }
+
+        telemetry_handler(&environmental_data, &air_quality);
+        pc_uart_stream_sample(&environmental_data, &air_quality);
+        measurement_pending = false;
+
+        if (acquisition_update(&environmental_data, &air_quality))
+        {
+            uint32_t interval = acquisition_get_interval();
+            scheduler_timer_start(&measurement_timer, interval, interval);
+        }
+
+        /* A new sample can complete a telemetry batch */
+        wifi_trigger_handler();
+    }
+    else if (ccs811_dev.interrupt_mode == CCS811_INTERRUPT_THRESHOLD
+            && ccs811_get_measurements(&ccs811_dev, &air_quality))
+    {
+        /* eCO2 crossed a threshold band, report it without waiting for the next cycle */
+        ccs811_baseline_measurement_read();
+        telemetry_handler(&environmental_data, &air_quality);
+        pc_uart_stream_sample(&environmental_data, &air_quality);
+        wifi_trigger_handler();
+    }
+
+    if (measurement_pending || !bme280_is_ready(&bme280_dev) || !ccs811_is_ready(&ccs811_dev))
+    {
+        scheduler_timer_start(&sensor_timer, SENSOR_POLL_INTERVAL, 0);
+    }
+}
+
+/**
+ * @brief Toggle the status led
+ */
+static void led_task_handler(void)
+{
+    if (status_led_get_state() == STATUS_LED_OFF)
+    {
+        status_led_set_state(STATUS_LED_GREEN);
+    }
+    else
+    {
+        status_led_set_state(STATUS_LED_OFF);
     }
 }
 
@@ -135,8 +229,9 @@ void SystemClock_Config(void)
 
     /* Initializes the RCC Oscillators according to the specified parameters
     in the RCC_OscInitTypeDef structure. */
-    RCC_OscInitStruct.OscillatorType = RCC_OSCILLATORTYPE_HSI;
+    RCC_OscInitStruct.OscillatorType = RCC_OSCILLATORTYPE_HSI | RCC_OSCILLATORTYPE_LSI;
     RCC_OscInitStruct.HSIState = RCC_HSI_ON;
+    RCC_OscInitStruct.LSIState = RCC_LSI_ON;
     RCC_OscInitStruct.HSIDiv = RCC_HSI_DIV1;
     RCC_OscInitStruct.HSICalibrationValue = RCC_HSICALIBRATION_DEFAULT;
     RCC_OscInitStruct.PLL.PLLState = RCC_PLL_NONE;
@@ -157,11 +252,14 @@ void SystemClock_Config(void)
         Error_Handler();
     }
 
-    /* Initializes the peripherals clocks */
-    PeriphClkInit.PeriphClockSelection = RCC_PERIPHCLK_USART1 | RCC_PERIPHCLK_USART2 | RCC_PERIPHCLK_I2C1;
-    PeriphClkInit.Usart1ClockSelection = RCC_USART1CLKSOURCE_PCLK1;
-    PeriphClkInit.Usart2ClockSelection = RCC_USART2CLKSOURCE_PCLK1;
+    /* Initializes the peripherals clocks, the UARTs run on HSI16 to receive in STOP1
+    and LPTIM1 counts on LSI while the device is stopped */
+    PeriphClkInit.PeriphClockSelection = RCC_PERIPHCLK_USART1 | RCC_PERIPHCLK_USART2 | RCC_PERIPHCLK_I2C1
+            | RCC_PERIPHCLK_LPTIM1;
+    PeriphClkInit.Usart1ClockSelection = RCC_USART1CLKSOURCE_HSI;
+    PeriphClkInit.Usart2ClockSelection = RCC_USART2CLKSOURCE_HSI;
     PeriphClkInit.I2c1ClockSelection = RCC_I2C1CLKSOURCE_PCLK1;
+    PeriphClkInit.Lptim1ClockSelection = RCC_LPTIM1CLKSOURCE_LSI;
 
     if (HAL_RCCEx_PeriphCLKConfig(&PeriphClkInit) != HAL_OK)
     {
@@ -202,6 +300,29 @@ static void MX_GPIO_Init(void)
     GPIO_InitStruct.Pull = GPIO_NOPULL;
     GPIO_InitStruct.Speed = GPIO_SPEED_FREQ_LOW;
     HAL_GPIO_Init(GPIOB, &GPIO_InitStruct);
+
+    /* Configure GPIO pin : PB4, CCS811 nINT, the EXTI is armed by the driver for the nINT modes */
+    GPIO_InitStruct.Pin = CCS811_INT_Pin;
+    GPIO_InitStruct.Mode = GPIO_MODE_INPUT;
+    GPIO_InitStruct.Pull = GPIO_PULLUP;
+    HAL_GPIO_Init(CCS811_INT_GPIO_Port, &GPIO_InitStruct);
+}
+
+/**
+ * @brief DMA initialization
+ */
+static void MX_DMA_Init(void)
+{
+    /* DMA controller clock enable */
+    __HAL_RCC_DMA1_CLK_ENABLE();
+
+    /* DMA1_Channel1_IRQn interrupt configuration */
+    HAL_NVIC_SetPriority(DMA1_Channel1_IRQn, 0, 0);
+    HAL_NVIC_EnableIRQ(DMA1_Channel1_IRQn);
+
+    /* DMA1_Channel2_3_IRQn interrupt configuration */
+    HAL_NVIC_SetPriority(DMA1_Channel2_3_IRQn, 0, 0);
+    HAL_NVIC_EnableIRQ(DMA1_Channel2_3_IRQn);
 }
 
 /**
@@ -235,6 +356,11 @@ static void MX_I2C1_Init(void)
     {
         Error_Handler();
     }
+
+    if (!i2c_bus_init(&hi2c1))
+    {
+        Error_Handler();
+    }
 }
 
 /**
@@ -273,6 +399,11 @@ static void MX_USART1_UART_Init(void)
     {
         Error_Handler();
     }
+
+    if (!low_power_add_uart_wakeup(&huart1))
+    {
+        Error_Handler();
+    }
 }
 
 /**
@@ -311,6 +442,11 @@ static void MX_USART2_UART_Init(void)
     {
         Error_Handler();
     }
+
+    if (!low_power_add_uart_wakeup(&huart2))
+    {
+        Error_Handler();
+    }
 }
 
 /**
@@ -318,18 +454,35 @@ static void MX_USART2_UART_Init(void)
  */
 static void MX_CCS811_Init(void)
 {
-    ccs811_dev.i2c_handle = &hi2c1;
     ccs811_dev.i2c_address = CCS811_DEFAULT_ADDRESS;
     ccs811_dev.hardware_id = 0;
     ccs811_dev.hardware_version = 0;
     ccs811_dev.drive_mode = CCS811_DRIVE_1SEC;
-    ccs811_dev.env_data.humidity = 0.0f;
-    ccs811_dev.env_data.temperature = 0.0f;
+    /* nINT is not connected on the board, the STATUS register is read for every sample */
+    ccs811_dev.interrupt_mode = CCS811_INTERRUPT_NONE;
+    ccs811_dev.thresholds.low_to_medium = CCS811_DEFAULT_LOW_TO_MEDIUM;
+    ccs811_dev.thresholds.medium_to_high = CCS811_DEFAULT_MEDIUM_TO_HIGH;
+    ccs811_dev.thresholds.hysteresis = CCS811_DEFAULT_HYSTERESIS;
+    ccs811_dev.interrupt_port = CCS811_INT_GPIO_Port;
+    ccs811_dev.interrupt_pin = CCS811_INT_Pin;
+    ccs811_dev.interrupt_irq = CCS811_INT_EXTI_IRQn;
+    ccs811_dev.interrupt_task = &sensor_task;
+    ccs811_dev.env_data.humidity = 0;
+    ccs811_dev.env_data.temperature = 0;
+
+    /* Drive mode follows the acquisition level from now on */
+    acquisition_init(&ccs811_dev);
 
     if (!ccs811_init(&ccs811_dev))
     {
         Error_Handler();
     }
+
+    /* Saved baseline is restored as soon as the sensor is ready */
+    if (!ccs811_baseline_init(&ccs811_dev))
+    {
+        Error_Handler();
+    }
 }
 
 /**
@@ -337,9 +490,8 @@ static void MX_CCS811_Init(void)
  */
 static void MX_BME280_Init(void)
 {
-    bme280_dev.i2c_handle = &hi2c1;
     bme280_dev.i2c_address = BME280_DEFAULT_ADDRESS;
-    bme280_dev.mode = BMP280_MODE_NORMAL;
+    bme280_dev.mode = BMP280_MODE_FORCED;
     bme280_dev.hardware_id = 0;
     bme280_dev.filter = BMP280_FILTER_4;
     bme280_dev.standby_duration = BME280_STANDBY_MS_250;
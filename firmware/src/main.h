@@ -21,6 +21,9 @@ void Error_Handler(void);
 #define TMS_GPIO_Port GPIOA
 #define TCK_Pin GPIO_PIN_14
 #define TCK_GPIO_Port GPIOA
+#define CCS811_INT_Pin GPIO_PIN_4
+#define CCS811_INT_GPIO_Port GPIOB
+#define CCS811_INT_EXTI_IRQn EXTI4_15_IRQn
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,302 @@
+#include <stddef.h>
+#include <string.h>
+#include "mqtt.h"
+
+/**
+ * @brief CONNECT variable header fields
+ */
+#define MQTT_PROTOCOL_LEVEL        4
+#define MQTT_FLAG_USERNAME         0x80
+#define MQTT_FLAG_PASSWORD         0x40
+#define MQTT_FLAG_CLEAN_SESSION    0x02
+
+/**
+ * @brief PUBLISH fixed header flags
+ */
+#define MQTT_PUBLISH_DUP           0x08
+#define MQTT_PUBLISH_QOS_SHIFT     1
+
+/* MQTT private functions */
+static uint16_t string_size(const char *text);
+static uint8_t length_size(uint32_t length);
+static uint8_t *write_header(uint8_t *buffer, uint8_t header, uint32_t length);
+static uint8_t *write_string(uint8_t *buffer, const char *text);
+static mqtt_packet_type finish_packet(mqtt_parser *parser, mqtt_packet *packet);
+
+uint16_t mqtt_encode_connect(uint8_t *buffer, uint16_t size, const mqtt_connect_options *options)
+{
+    if (buffer == NULL || options == NULL || options->client_id == NULL)
+        return 0;
+
+    uint8_t flags = 0;
+    uint32_t length = 10 + string_size(options->client_id);
+
+    if (options->clean_session)
+    {
+        flags |= MQTT_FLAG_CLEAN_SESSION;
+    }
+
+    if (options->username != NULL)
+    {
+        flags |= MQTT_FLAG_USERNAME;
+        length += string_size(options->username);
+
+        /* Password is only allowed together with a user name */
+        if (options->password != NULL)
+        {
+            flags |= MQTT_FLAG_PASSWORD;
+            length += string_size(options->password);
+        }
+    }
+
+    if (1 + length_size(length) + length > size)
+        return 0;
+
+    uint8_t *position = write_header(buffer, MQTT_PACKET_CONNECT << 4, length);
+
+    position = write_string(position, "MQTT");
+    *position++ = MQTT_PROTOCOL_LEVEL;
+    *position++ = flags;
+    *position++ = (uint8_t)(options->keep_alive >> 8);
+    *position++ = (uint8_t)(options->keep_alive & 0xFF);
+
+    position = write_string(position, options->client_id);
+
+    if (flags & MQTT_FLAG_USERNAME)
+    {
+        position = write_string(position, options->username);
+    }
+
+    if (flags & MQTT_FLAG_PASSWORD)
+    {
+        position = write_string(position, options->password);
+    }
+
+    return (uint16_t)(position - buffer);
+}
+
+uint16_t mqtt_encode_publish(uint8_t *buffer, uint16_t size, const char *topic,
+        const uint8_t *payload, uint16_t length, uint8_t qos, uint16_t packet_id, bool dup)
+{
+    if (buffer == NULL || topic == NULL || (payload == NULL && length > 0) || qos > 1)
+        return 0;
+
+    uint8_t header = (MQTT_PACKET_PUBLISH << 4) | (qos << MQTT_PUBLISH_QOS_SHIFT);
+    uint32_t remaining = string_size(topic) + length;
+
+    if (qos > 0)
+    {
+        remaining += 2;
+
+        /* DUP must be zero for QoS 0 messages */
+        if (dup)
+        {
+            header |= MQTT_PUBLISH_DUP;
+        }
+    }
+
+    if (1 + length_size(remaining) + remaining > size)
+        return 0;
+
+    uint8_t *position = write_header(buffer, header, remaining);
+    position = write_string(position, topic);
+
+    if (qos > 0)
+    {
+        *position++ = (uint8_t)(packet_id >> 8);
+        *position++ = (uint8_t)(packet_id & 0xFF);
+    }
+
+    if (length > 0)
+    {
+        /* Payload can be formatted in place after room left for the header */
+        memmove(position, payload, length);
+        position += length;
+    }
+
+    return (uint16_t)(position - buffer);
+}
+
+uint16_t mqtt_encode_pingreq(uint8_t *buffer, uint16_t size)
+{
+    if (buffer == NULL || size < 2)
+        return 0;
+
+    buffer[0] = MQTT_PACKET_PINGREQ << 4;
+    buffer[1] = 0;
+
+    return 2;
+}
+
+void mqtt_parser_reset(mqtt_parser *parser)
+{
+    if (parser == NULL)
+        return;
+
+    parser->state = MQTT_PARSER_HEADER;
+    parser->header = 0;
+    parser->remaining = 0;
+    parser->shift = 0;
+    parser->body_length = 0;
+}
+
+uint16_t mqtt_parser_process(mqtt_parser *parser, const uint8_t *data, uint16_t length,
+        mqtt_packet *packet)
+{
+    if (parser == NULL || data == NULL || packet == NULL)
+        return 0;
+
+    packet->type = MQTT_PACKET_NONE;
+
+    for (uint16_t index = 0; index < length; index++)
+    {
+        uint8_t byte = data[index];
+
+        switch (parser->state)
+        {
+        case MQTT_PARSER_HEADER:
+            parser->header = byte;
+            parser->remaining = 0;
+            parser->shift = 0;
+            parser->body_length = 0;
+            parser->state = MQTT_PARSER_LENGTH;
+            break;
+
+        case MQTT_PARSER_LENGTH:
+            parser->remaining |= (uint32_t)(byte & 0x7F) << parser->shift;
+            parser->shift += 7;
+
+            if (byte & 0x80)
+            {
+                /* Remaining length is at most four bytes long */
+                if (parser->shift >= 28)
+                {
+                    mqtt_parser_reset(parser);
+                }
+                break;
+            }
+
+            if (parser->remaining == 0)
+            {
+                packet->type = finish_packet(parser, packet);
+                return index + 1;
+            }
+
+            parser->state = MQTT_PARSER_BODY;
+            break;
+
+        case MQTT_PARSER_BODY:
+            if (parser->body_length < sizeof(parser->body))
+            {
+                parser->body[parser->body_length++] = byte;
+            }
+
+            if (--parser->remaining == 0)
+            {
+                packet->type = finish_packet(parser, packet);
+                return index + 1;
+            }
+            break;
+
+        default:
+            mqtt_parser_reset(parser);
+            break;
+        }
+    }
+
+    return length;
+}
+
+/**
+ * @brief Size of an encoded string
+ * @param text: Null terminated string
+ * @return: String length including the two byte length prefix
+ */
+static uint16_t string_size(const char *text)
+{
+    return 2 + strlen(text);
+}
+
+/**
+ * @brief Number of bytes needed to encode a remaining length
+ * @param length: Remaining length
+ * @return: Number of length bytes
+ */
+static uint8_t length_size(uint32_t length)
+{
+    uint8_t count = 1;
+
+    while (length >= 128 && count < 4)
+    {
+        length >>= 7;
+        count++;
+    }
+
+    return count;
+}
+
+/**
+ * @brief Write the fixed header
+ * @param buffer: Output buffer
+ * @param header: Packet type and flags
+ * @param length: Remaining length
+ * @return: Position after the fixed header
+ */
+static uint8_t *write_header(uint8_t *buffer, uint8_t header, uint32_t length)
+{
+    *buffer++ = header;
+
+    do
+    {
+        uint8_t byte = length & 0x7F;
+        length >>= 7;
+
+        if (length > 0)
+        {
+            byte |= 0x80;
+        }
+
+        *buffer++ = byte;
+    } while (length > 0);
+
+    return buffer;
+}
+
+/**
+ * @brief Write a length prefixed string
+ * @param buffer: Output buffer
+ * @param text: Null terminated string
+ * @return: Position after the string
+ */
+static uint8_t *write_string(uint8_t *buffer, const char *text)
+{
+    uint16_t length = strlen(text);
+
+    *buffer++ = (uint8_t)(length >> 8);
+    *buffer++ = (uint8_t)(length & 0xFF);
+    memcpy(buffer, text, length);
+
+    return buffer + length;
+}
+
+/**
+ * @brief Fill the decoded packet and prepare for the next one
+ * @param parser: Pointer to packet decoder
+ * @param packet: Decoded packet
+ * @return: Type of the decoded packet
+ */
+static mqtt_packet_type finish_packet(mqtt_parser *parser, mqtt_packet *packet)
+{
+    packet->return_code = 0;
+    packet->packet_id = 0;
+
+    if (parser->body_length == sizeof(parser->body))
+    {
+        /* CONNACK holds flags and return code, acknowledgments the packet id */
+        packet->return_code = parser->body[1];
+        packet->packet_id = ((uint16_t)parser->body[0] << 8) | parser->body[1];
+    }
+
+    parser->state = MQTT_PARSER_HEADER;
+    return (mqtt_packet_type)(parser->header >> 4);
+}
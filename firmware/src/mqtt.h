@@ -0,0 +1,146 @@
+#ifndef MQTT_H
+#define MQTT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief MQTT 3.1.1 control packet types
+ */
+typedef enum
+{
+    MQTT_PACKET_NONE        = 0,     /**< No packet, more data is needed */
+    MQTT_PACKET_CONNECT     = 1,     /**< Client request to connect to the broker */
+    MQTT_PACKET_CONNACK     = 2,     /**< Connect acknowledgment */
+    MQTT_PACKET_PUBLISH     = 3,     /**< Publish message */
+    MQTT_PACKET_PUBACK      = 4,     /**< Publish acknowledgment, QoS 1 */
+    MQTT_PACKET_PUBREC      = 5,     /**< Publish received, QoS 2 */
+    MQTT_PACKET_PUBREL      = 6,     /**< Publish release, QoS 2 */
+    MQTT_PACKET_PUBCOMP     = 7,     /**< Publish complete, QoS 2 */
+    MQTT_PACKET_SUBSCRIBE   = 8,     /**< Subscribe request */
+    MQTT_PACKET_SUBACK      = 9,     /**< Subscribe acknowledgment */
+    MQTT_PACKET_UNSUBSCRIBE = 10,    /**< Unsubscribe request */
+    MQTT_PACKET_UNSUBACK    = 11,    /**< Unsubscribe acknowledgment */
+    MQTT_PACKET_PINGREQ     = 12,    /**< Keep alive request */
+    MQTT_PACKET_PINGRESP    = 13,    /**< Keep alive response */
+    MQTT_PACKET_DISCONNECT  = 14     /**< Client is disconnecting */
+} mqtt_packet_type;
+
+/**
+ * @brief CONNACK return code of an accepted connection
+ */
+#define MQTT_CONNECTION_ACCEPTED 0
+
+/**
+ * @brief CONNECT packet options
+ */
+typedef struct
+{
+    const char *client_id;    /**< Client identifier */
+    const char *username;     /**< User name, NULL if not used */
+    const char *password;     /**< Password, NULL if not used */
+    uint16_t keep_alive;      /**< Keep alive interval in seconds */
+    bool clean_session;       /**< Discard the session state on the broker */
+} mqtt_connect_options;
+
+/**
+ * @brief Decoded broker packet
+ */
+typedef struct
+{
+    mqtt_packet_type type;    /**< Packet type */
+    uint8_t return_code;      /**< CONNACK return code */
+    uint16_t packet_id;       /**< Packet identifier of PUBACK and other acknowledgments */
+} mqtt_packet;
+
+/**
+ * @brief Broker packet decoder internal states
+ */
+typedef enum
+{
+    MQTT_PARSER_HEADER,    /**< Waiting for the fixed header byte */
+    MQTT_PARSER_LENGTH,    /**< Reading the remaining length */
+    MQTT_PARSER_BODY       /**< Reading or skipping the packet body */
+} mqtt_parser_state;
+
+/**
+ * @brief Broker packet decoder
+ *
+ * Only the first two body bytes are kept, they hold the fields of all the
+ * packets a publishing client has to handle. Longer bodies are skipped.
+ */
+typedef struct
+{
+    mqtt_parser_state state;    /**< Current state */
+    uint8_t header;             /**< Fixed header byte of the current packet */
+    uint32_t remaining;         /**< Body bytes not yet read */
+    uint8_t shift;              /**< Bit position of the next remaining length digit */
+    uint8_t body[2];            /**< First body bytes */
+    uint8_t body_length;        /**< Number of body bytes kept */
+} mqtt_parser;
+
+/**
+ * @brief Encode a CONNECT packet
+ * @param buffer: Output buffer
+ * @param size: Output buffer size
+ * @param options: Connection options
+ * @return: Packet length, 0 if the packet does not fit
+ */
+uint16_t mqtt_encode_connect(uint8_t *buffer, uint16_t size, const mqtt_connect_options *options);
+
+/**
+ * @brief Encode a PUBLISH packet
+ *
+ * The payload may overlap the output buffer after the packet header.
+ *
+ * @param buffer: Output buffer
+ * @param size: Output buffer size
+ * @param topic: Topic name
+ * @param payload: Message payload
+ * @param length: Message payload length
+ * @param qos: Quality of service, 0 or 1
+ * @param packet_id: Packet identifier, used only with QoS 1
+ * @param dup: Set when the message is sent again
+ * @return: Packet length, 0 if the packet does not fit
+ */
+uint16_t mqtt_encode_publish(uint8_t *buffer, uint16_t size, const char *topic,
+        const uint8_t *payload, uint16_t length, uint8_t qos, uint16_t packet_id, bool dup);
+
+/**
+ * @brief Encode a PINGREQ packet
+ * @param buffer: Output buffer
+ * @param size: Output buffer size
+ * @return: Packet length, 0 if the packet does not fit
+ */
+uint16_t mqtt_encode_pingreq(uint8_t *buffer, uint16_t size);
+
+/**
+ * @brief Reset packet decoder state
+ * @param parser: Pointer to packet decoder
+ */
+void mqtt_parser_reset(mqtt_parser *parser);
+
+/**
+ * @brief Process received bytes until a packet is complete
+ *
+ * Like the AT tokenizer the function stops right after the byte that
+ * completed a packet, the caller should call it again with the remaining bytes.
+ *
+ * @param parser: Pointer to packet decoder
+ * @param data: Received bytes
+ * @param length: Number of received bytes
+ * @param packet: Decoded packet, type is MQTT_PACKET_NONE if all bytes were consumed
+ * @return: Number of bytes consumed
+ */
+uint16_t mqtt_parser_process(mqtt_parser *parser, const uint8_t *data, uint16_t length,
+        mqtt_packet *packet);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MQTT_H */
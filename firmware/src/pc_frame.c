@@ -0,0 +1,122 @@
+#include "pc_frame.h"
+
+_Static_assert(sizeof(pc_frame_header) == PC_FRAME_HEADER_SIZE, "Invalid frame header size");
+
+void pc_frame_init(void)
+{
+    __HAL_RCC_CRC_CLK_ENABLE();
+
+    /* 16 bit polynomial, no bit reversal, byte writes are processed MSB first */
+    CRC->POL = PC_FRAME_CRC_POLYNOMIAL;
+    CRC->INIT = PC_FRAME_CRC_INIT;
+    CRC->CR = CRC_CR_POLYSIZE_0;
+}
+
+uint16_t pc_frame_crc(const uint8_t *data, uint16_t length)
+{
+    CRC->CR |= CRC_CR_RESET;
+
+    for (uint16_t index = 0; index < length; index++)
+    {
+        *(__IO uint8_t *)&CRC->DR = data[index];
+    }
+
+    return (uint16_t)CRC->DR;
+}
+
+uint16_t pc_frame_encode(uint8_t *frame, uint16_t length, uint8_t *buffer)
+{
+    length += pc_frame_put_u16(&frame[length], pc_frame_crc(frame, length));
+
+    uint16_t position = 0;
+    buffer[position++] = PC_FRAME_DELIMITER;
+
+    /* Every code byte holds the distance to the next zero of the frame */
+    uint16_t code_position = position++;
+    uint8_t code = 1;
+
+    for (uint16_t index = 0; index < length; index++)
+    {
+        if (frame[index] != 0)
+        {
+            buffer[position++] = frame[index];
+            code++;
+        }
+
+        if ((frame[index] == 0) || (code == 0xFF))
+        {
+            buffer[code_position] = code;
+            code_position = position++;
+            code = 1;
+        }
+    }
+
+    buffer[code_position] = code;
+    buffer[position++] = PC_FRAME_DELIMITER;
+
+    return position;
+}
+
+pc_frame_result pc_frame_decode(uint8_t *data, uint16_t *length)
+{
+    uint16_t size = *length;
+    uint16_t input = 0;
+    uint16_t output = 0;
+
+    /* The output never passes the input, the frame is decoded in place */
+    while (input < size)
+    {
+        uint8_t code = data[input++];
+
+        if ((code == 0) || (input + code - 1 > size))
+            return PC_FRAME_INVALID;
+
+        for (uint8_t index = 1; index < code; index++)
+        {
+            data[output++] = data[input++];
+        }
+
+        if ((code < 0xFF) && (input < size))
+        {
+            data[output++] = 0;
+        }
+    }
+
+    if (output < PC_FRAME_HEADER_SIZE + PC_FRAME_CRC_SIZE)
+        return PC_FRAME_INVALID;
+
+    output -= PC_FRAME_CRC_SIZE;
+
+    if (pc_frame_get_u16(&data[output]) != pc_frame_crc(data, output))
+        return PC_FRAME_CRC_MISMATCH;
+
+    *length = output;
+    return PC_FRAME_VALID;
+}
+
+uint8_t pc_frame_put_u16(uint8_t *buffer, uint16_t value)
+{
+    buffer[0] = (uint8_t)value;
+    buffer[1] = (uint8_t)(value >> 8);
+    return 2;
+}
+
+uint8_t pc_frame_put_u32(uint8_t *buffer, uint32_t value)
+{
+    buffer[0] = (uint8_t)value;
+    buffer[1] = (uint8_t)(value >> 8);
+    buffer[2] = (uint8_t)(value >> 16);
+    buffer[3] = (uint8_t)(value >> 24);
+    return 4;
+}
+
+uint16_t pc_frame_get_u16(const uint8_t *buffer)
+{
+    return (uint16_t)(buffer[0] | (buffer[1] << 8));
+}
+
+uint32_t pc_frame_get_u32(const uint8_t *buffer)
+{
+    return (uint32_t)buffer[0] | ((uint32_t)buffer[1] << 8)
+            | ((uint32_t)buffer[2] << 16) | ((uint32_t)buffer[3] << 24);
+}
@@ -0,0 +1,164 @@
+#ifndef PC_FRAME_H
+#define PC_FRAME_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "stm32g0xx_hal.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Byte that starts and ends an encoded frame, never found inside it
+ */
+#define PC_FRAME_DELIMITER 0x00
+
+/**
+ * @brief Frame size related macros
+ *
+ * A frame is a header, the payload and a CRC-16, COBS encoded between two
+ * delimiters. Frames up to 254 bytes need a single COBS code byte.
+ */
+#define PC_FRAME_HEADER_SIZE       3
+#define PC_FRAME_CRC_SIZE          2
+#define PC_FRAME_MAX_PAYLOAD       240
+#define PC_FRAME_MAX_SIZE          (PC_FRAME_HEADER_SIZE + PC_FRAME_MAX_PAYLOAD + PC_FRAME_CRC_SIZE)
+#define PC_FRAME_MAX_ENCODED_SIZE  (PC_FRAME_MAX_SIZE + PC_FRAME_MAX_SIZE / 254 + 3)
+
+/**
+ * @brief CRC-16/CCITT-FALSE parameters of the hardware CRC unit
+ */
+#define PC_FRAME_CRC_POLYNOMIAL    0x1021
+#define PC_FRAME_CRC_INIT          0xFFFF
+
+/**
+ * @brief Frame commands, a reply carries the command of its request
+ */
+typedef enum
+{
+    PC_COMMAND_NONE,               /**< Unused */
+    PC_COMMAND_PING,               /**< Echo the payload */
+    PC_COMMAND_SENSORS,            /**< Read the last measurements */
+    PC_COMMAND_AGGREGATES,         /**< Read the newest closed aggregate window */
+    PC_COMMAND_WIFI_GET,           /**< Read the WiFi state and configuration */
+    PC_COMMAND_WIFI_SET,           /**< Set the WiFi configuration */
+    PC_COMMAND_TELEMETRY_GET,      /**< Read the batch configuration */
+    PC_COMMAND_TELEMETRY_SET,      /**< Set the batch configuration */
+    PC_COMMAND_POLICY_SET,         /**< Set the publish policy */
+    PC_COMMAND_BME280_SET,         /**< Set the BME280 mode, filter and oversampling */
+    PC_COMMAND_ACQUISITION_SET,    /**< Set the adaptive acquisition */
+    PC_COMMAND_FILTER_SET,         /**< Set the filter of a channel */
+    PC_COMMAND_STREAM,             /**< Start or stop the measurement stream */
+    PC_COMMAND_STREAM_RECORD,      /**< Stream record, sent by the device without request */
+    PC_COMMAND_COUNT
+} pc_command;
+
+/**
+ * @brief Status of a reply, always 0 in a request
+ */
+typedef enum
+{
+    PC_FRAME_STATUS_OK,                 /**< Command done, the payload holds the result */
+    PC_FRAME_STATUS_FAILED,             /**< Command rejected by the module */
+    PC_FRAME_STATUS_UNKNOWN_COMMAND,    /**< No handler for the command */
+    PC_FRAME_STATUS_BAD_LENGTH          /**< Payload length does not match the command */
+} pc_frame_status;
+
+/**
+ * @brief Decoding results
+ */
+typedef enum
+{
+    PC_FRAME_VALID,            /**< Frame decoded and CRC matched */
+    PC_FRAME_INVALID,          /**< Wrong COBS encoding or too short for a header */
+    PC_FRAME_CRC_MISMATCH      /**< Frame decoded but the CRC did not match */
+} pc_frame_result;
+
+/**
+ * @brief Frame header, the payload follows
+ */
+typedef struct
+{
+    uint8_t command;     /**< pc_command */
+    uint8_t sequence;    /**< Chosen by the host and copied to the reply */
+    uint8_t status;      /**< pc_frame_status */
+} pc_frame_header;
+
+/**
+ * @brief Frame statistics
+ */
+typedef struct
+{
+    uint32_t received;            /**< Valid frames received */
+    uint32_t sent;                /**< Frames sent */
+    uint32_t crc_errors;          /**< Frames dropped for a CRC mismatch */
+    uint32_t framing_errors;      /**< Frames dropped for a wrong encoding or a length overflow */
+    uint32_t unknown_commands;    /**< Frames with a command without handler */
+} pc_frame_statistics;
+
+/**
+ * @brief Enable the CRC unit for CRC-16/CCITT-FALSE
+ */
+void pc_frame_init(void);
+
+/**
+ * @brief CRC of a byte block with the hardware CRC unit
+ * @param data: Data to check
+ * @param length: Data length in bytes
+ * @return: CRC-16/CCITT-FALSE of the data
+ */
+uint16_t pc_frame_crc(const uint8_t *data, uint16_t length);
+
+/**
+ * @brief Append the CRC to a frame and COBS encode it between two delimiters
+ * @param frame: Header and payload, with PC_FRAME_CRC_SIZE free bytes after them
+ * @param length: Header and payload length
+ * @param buffer: Output buffer of at least PC_FRAME_MAX_ENCODED_SIZE bytes
+ * @return: Encoded length, delimiters included
+ */
+uint16_t pc_frame_encode(uint8_t *frame, uint16_t length, uint8_t *buffer);
+
+/**
+ * @brief Decode a COBS encoded frame in place and check its CRC
+ * @param data: Bytes received between two delimiters, replaced by the frame
+ * @param length: Encoded length, set to the header and payload length
+ * @return: PC_FRAME_VALID if the frame can be dispatched
+ */
+pc_frame_result pc_frame_decode(uint8_t *data, uint16_t *length);
+
+/**
+ * @brief Write a 16 bit payload field, little endian
+ * @param buffer: Output buffer
+ * @param value: Field value
+ * @return: Number of bytes written
+ */
+uint8_t pc_frame_put_u16(uint8_t *buffer, uint16_t value);
+
+/**
+ * @brief Write a 32 bit payload field, little endian
+ * @param buffer: Output buffer
+ * @param value: Field value
+ * @return: Number of bytes written
+ */
+uint8_t pc_frame_put_u32(uint8_t *buffer, uint32_t value);
+
+/**
+ * @brief Read a 16 bit payload field, little endian
+ * @param buffer: Field position
+ * @return: Field value
+ */
+uint16_t pc_frame_get_u16(const uint8_t *buffer);
+
+/**
+ * @brief Read a 32 bit payload field, little endian
+ * @param buffer: Field position
+ * @return: Field value
+ */
+uint32_t pc_frame_get_u32(const uint8_t *buffer);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PC_FRAME_H */
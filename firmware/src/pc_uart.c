@@ -5,7 +5,18 @@
 #include "wifi.h"
 #include "bme280.h"
 #include "ccs811.h"
+#include "ccs811_baseline.h"
+#include "telemetry.h"
+#include "publish_policy.h"
+#include "acquisition.h"
+#include "aggregate.h"
+#include "filter.h"
+#include "config_store.h"
+#include "format.h"
+#include "i2c_bus.h"
 #include "circular_buffer.h"
+#include "scheduler.h"
+#include "low_power.h"
 
 /**
  * @brief PC communication
@@ -22,21 +33,147 @@ CIRCULAR_BUFFER_DEF(pc_uart_cbuff, 512);
  */
 static uint8_t received_byte = 0;
 
+/**
+ * @brief PC task, posted for every received byte
+ */
+SCHEDULER_TASK_DEF(pc_uart_task, pc_uart_handler, SCHEDULER_PRIORITY_HIGH);
+
+/**
+ * @brief PC UART DMA transmission, the queue is full when no transmit buffer is free
+ */
+UART_TX_DEF(pc_tx, PC_TX_BUFFER_COUNT - 1);
+
 /**
  * @brief Measurement values from the sensors
  */
 extern bme280_measurements environmental_data;
 extern ccs811_measurements air_quality;
 
+/**
+ * @brief BME280 device, configured by the BME280CFG command
+ */
+extern bme280_device bme280_dev;
+
 /**
  * @brief PC private functions
  */
 static void clear_rx_buffer(void);
+static void receive_byte(uint8_t byte);
+static void receive_frame(void);
+static void dispatch_frame(const uint8_t *frame, uint16_t length);
+static void send_frame(uint8_t *frame, uint16_t length);
+static bool output_write(const uint8_t *data, uint16_t length);
+static bool output_reserve(uint16_t length);
+static void queue_fill_buffer(void);
+static void output_sent(void *context);
 static void parse_received_data(void);
 static void parse_wifi_configuration(void);
+static void parse_telemetry_configuration(void);
+static void parse_policy_configuration(void);
+static void parse_bme280_configuration(void);
+static void parse_acquisition_configuration(void);
+static void parse_filter_configuration(void);
 static void send_sensors_values(void);
+static void send_aggregate_values(void);
 static void send_device_status(void);
+static bool send_status_sections(void);
+static uint16_t section_length(int length, uint16_t size);
+static uint16_t status_wifi(char *text, uint16_t size);
+static uint16_t status_link(char *text, uint16_t size);
+static uint16_t status_commands(char *text, uint16_t size);
+static uint16_t status_telemetry(char *text, uint16_t size);
+static uint16_t status_policy(char *text, uint16_t size);
+static uint16_t status_system(char *text, uint16_t size);
+static uint16_t status_baseline(char *text, uint16_t size);
+static uint16_t status_acquisition(char *text, uint16_t size);
+static uint16_t status_processing(char *text, uint16_t size);
+static uint16_t status_store(char *text, uint16_t size);
+static uint16_t status_frames(char *text, uint16_t size);
+static uint16_t status_output(char *text, uint16_t size);
 static void send_config_reply(bool reply);
+static pc_frame_status frame_ping(const uint8_t *request, uint16_t length,
+        uint8_t *reply, uint16_t *reply_length);
+static pc_frame_status frame_sensors(const uint8_t *request, uint16_t length,
+        uint8_t *reply, uint16_t *reply_length);
+static pc_frame_status frame_aggregates(const uint8_t *request, uint16_t length,
+        uint8_t *reply, uint16_t *reply_length);
+static pc_frame_status frame_wifi_get(const uint8_t *request, uint16_t length,
+        uint8_t *reply, uint16_t *reply_length);
+static pc_frame_status frame_wifi_set(const uint8_t *request, uint16_t length,
+        uint8_t *reply, uint16_t *reply_length);
+static pc_frame_status frame_telemetry_get(const uint8_t *request, uint16_t length,
+        uint8_t *reply, uint16_t *reply_length);
+static pc_frame_status frame_telemetry_set(const uint8_t *request, uint16_t length,
+        uint8_t *reply, uint16_t *reply_length);
+static pc_frame_status frame_policy_set(const uint8_t *request, uint16_t length,
+        uint8_t *reply, uint16_t *reply_length);
+static pc_frame_status frame_bme280_set(const uint8_t *request, uint16_t length,
+        uint8_t *reply, uint16_t *reply_length);
+static pc_frame_status frame_acquisition_set(const uint8_t *request, uint16_t length,
+        uint8_t *reply, uint16_t *reply_length);
+static pc_frame_status frame_filter_set(const uint8_t *request, uint16_t length,
+        uint8_t *reply, uint16_t *reply_length);
+static pc_frame_status frame_stream(const uint8_t *request, uint16_t length,
+        uint8_t *reply, uint16_t *reply_length);
+
+/**
+ * @brief Text commands, matched against the first field of a line
+ */
+static const pc_text_command text_commands[] = {
+    { "WIFICFG", parse_wifi_configuration },
+    { "TELEMETRYCFG", parse_telemetry_configuration },
+    { "POLICYCFG", parse_policy_configuration },
+    { "BME280CFG", parse_bme280_configuration },
+    { "ACQCFG", parse_acquisition_configuration },
+    { "FILTERCFG", parse_filter_configuration },
+    { "AGGREGATES", send_aggregate_values },
+    { "SENSORS", send_sensors_values },
+    { "STATUS", send_device_status },
+};
+
+/**
+ * @brief Frame commands, indexed by the command of the frame
+ */
+static const pc_command_entry frame_commands[PC_COMMAND_COUNT] = {
+    [PC_COMMAND_PING]            = { frame_ping, 0, PC_FRAME_MAX_PAYLOAD },
+    [PC_COMMAND_SENSORS]         = { frame_sensors, 0, 0 },
+    [PC_COMMAND_AGGREGATES]      = { frame_aggregates, 0, 0 },
+    [PC_COMMAND_WIFI_GET]        = { frame_wifi_get, 0, 0 },
+    [PC_COMMAND_WIFI_SET]        = { frame_wifi_set, PC_WIFI_SET_LENGTH, PC_WIFI_SET_LENGTH },
+    [PC_COMMAND_TELEMETRY_GET]   = { frame_telemetry_get, 0, 0 },
+    [PC_COMMAND_TELEMETRY_SET]   = { frame_telemetry_set, PC_TELEMETRY_SET_LENGTH, PC_TELEMETRY_SET_LENGTH },
+    [PC_COMMAND_POLICY_SET]      = { frame_policy_set, PC_POLICY_SET_LENGTH, PC_POLICY_SET_LENGTH },
+    [PC_COMMAND_BME280_SET]      = { frame_bme280_set, PC_BME280_SET_LENGTH, PC_BME280_SET_LENGTH },
+    [PC_COMMAND_ACQUISITION_SET] = { frame_acquisition_set, PC_ACQUISITION_SET_LENGTH, PC_ACQUISITION_SET_LENGTH },
+    [PC_COMMAND_FILTER_SET]      = { frame_filter_set, PC_FILTER_SET_LENGTH, PC_FILTER_SET_LENGTH },
+    [PC_COMMAND_STREAM]          = { frame_stream, PC_STREAM_LENGTH, PC_STREAM_LENGTH },
+};
+
+/**
+ * @brief STATUS reply sections, written in order
+ */
+static const pc_status_section status_sections[] = {
+    status_wifi,
+    status_link,
+    status_commands,
+    status_telemetry,
+    status_policy,
+    status_system,
+    status_baseline,
+    status_acquisition,
+    status_processing,
+    status_store,
+    status_frames,
+    status_output,
+};
+
+#define PC_STATUS_SECTION_COUNT (sizeof(status_sections) / sizeof(status_sections[0]))
+
+_Static_assert(PC_WIFI_GET_REPLY_LENGTH <= PC_FRAME_MAX_PAYLOAD, "WiFi configuration does not fit in a frame");
+_Static_assert(PC_AGGREGATES_REPLY_LENGTH <= PC_FRAME_MAX_PAYLOAD, "Aggregate window does not fit in a frame");
+_Static_assert(PC_REPLY_MAX_SIZE <= PC_TX_BUFFER_COUNT * PC_TX_BUFFER_SIZE, "Longest reply does not fit in the transmit buffers");
+_Static_assert(PC_STATUS_SECTION_SIZE <= PC_REPLY_MAX_SIZE, "STATUS section larger than a reply");
+_Static_assert(PC_FRAME_MAX_ENCODED_SIZE <= PC_REPLY_MAX_SIZE, "Frame reply larger than a reply");
 
 bool pc_uart_init(UART_HandleTypeDef *huart)
 {
@@ -45,6 +182,21 @@ bool pc_uart_init(UART_HandleTypeDef *huart)
 
     pc_uart_dev.uart_handle = huart;
     clear_rx_buffer();
+    pc_uart_dev.frame_index = 0;
+    pc_uart_dev.frame_mode = false;
+    pc_uart_dev.frame_overflow = false;
+    memset(&pc_uart_dev.statistics, 0, sizeof(pc_uart_dev.statistics));
+    memset(&pc_uart_dev.output, 0, sizeof(pc_uart_dev.output));
+    memset(&pc_uart_dev.stream, 0, sizeof(pc_uart_dev.stream));
+    pc_uart_dev.status_pending = false;
+    pc_uart_dev.status_section = 0;
+    pc_frame_init();
+
+    if (!uart_tx_start(&pc_tx, pc_uart_dev.uart_handle))
+        return false;
+
+    if (!scheduler_register(&pc_uart_task))
+        return false;
 
     HAL_StatusTypeDef result = HAL_OK;
     result = HAL_UART_Receive_IT(pc_uart_dev.uart_handle, &received_byte, sizeof(received_byte));
@@ -54,23 +206,31 @@ bool pc_uart_init(UART_HandleTypeDef *huart)
 
 void pc_uart_handler(void)
 {
-    if (circular_buffer_has_data(&pc_uart_cbuff))
+    const uint8_t *data;
+    uint16_t length;
+
+    /* A STATUS reply is written as space frees up, later commands wait for it */
+    if (!send_status_sections())
+        return;
+
+    while ((length = circular_buffer_peek(&pc_uart_cbuff, &data)) > 0)
     {
-        uint8_t data = 0;
-        circular_buffer_pop(&pc_uart_cbuff, &data);
+        uint16_t index;
 
-        if (pc_uart_dev.rx_index >= PC_RX_BUFFER_SIZE)
+        for (index = 0; index < length; index++)
         {
-            clear_rx_buffer();
+            /* Line ends and delimiters run commands, they stay in the buffer until the reply fits */
+            if (((data[index] == 0x0A) || (data[index] == PC_FRAME_DELIMITER))
+                    && (pc_uart_dev.status_pending || !output_reserve(PC_REPLY_MAX_SIZE)))
+                break;
+
+            receive_byte(data[index]);
         }
 
-        pc_uart_dev.rx_buffer[pc_uart_dev.rx_index] = data;
-        pc_uart_dev.rx_index++;
+        circular_buffer_consume(&pc_uart_cbuff, index);
 
-        if (data == 0x0A)
-        {
-            parse_received_data();
-        }
+        if (index < length)
+            return;
     }
 }
 
@@ -81,98 +241,1164 @@ void pc_uart_rx_callback(UART_HandleTypeDef *huart)
 
     circular_buffer_push(&pc_uart_cbuff, received_byte);
     HAL_UART_Receive_IT(pc_uart_dev.uart_handle, &received_byte, sizeof(received_byte));
+    scheduler_post(&pc_uart_task);
+}
+
+void pc_uart_tx_callback(UART_HandleTypeDef *huart)
+{
+    uart_tx_complete(&pc_tx, huart);
+}
+
+void pc_uart_error_callback(UART_HandleTypeDef *huart)
+{
+    if (huart->Instance != pc_uart_dev.uart_handle->Instance)
+        return;
+
+    /* The HAL stops the transfers that reported the error */
+    if (huart->RxState == HAL_UART_STATE_READY)
+    {
+        HAL_UART_Receive_IT(pc_uart_dev.uart_handle, &received_byte, sizeof(received_byte));
+    }
+
+    uart_tx_error(&pc_tx, huart);
+}
+
+void pc_uart_stream_sample(const bme280_measurements *environmental_data,
+        const ccs811_measurements *air_quality)
+{
+    pc_stream *stream = &pc_uart_dev.stream;
+
+    if (environmental_data == NULL || air_quality == NULL || stream->divider == 0)
+        return;
+
+    if (++stream->count < stream->divider)
+        return;
+
+    stream->count = 0;
+
+    const int32_t values[PUBLISH_CHANNEL_COUNT] = {
+        environmental_data->temperature,
+        (int32_t)environmental_data->humidity,
+        (int32_t)environmental_data->pressure,
+        air_quality->tvoc,
+        air_quality->eco2
+    };
+
+    uint8_t frame[PC_FRAME_HEADER_SIZE + PC_STREAM_RECORD_MAX_LENGTH + PC_FRAME_CRC_SIZE];
+    pc_frame_header *header = (pc_frame_header *)frame;
+    uint8_t *field = &frame[PC_FRAME_HEADER_SIZE];
+
+    header->command = PC_COMMAND_STREAM_RECORD;
+    header->sequence = (uint8_t)stream->sequence;
+    header->status = PC_FRAME_STATUS_OK;
+    field += pc_frame_put_u32(field, stream->sequence++);
+    field += pc_frame_put_u32(field, HAL_GetTick());
+    *field++ = stream->channels;
+
+    for (uint8_t channel = 0; channel < PUBLISH_CHANNEL_COUNT; channel++)
+    {
+        if (stream->channels & (1U << channel))
+        {
+            field += pc_frame_put_u32(field, (uint32_t)values[channel]);
+        }
+    }
+
+    uint8_t encoded[PC_FRAME_MAX_ENCODED_SIZE];
+    uint16_t encoded_length = pc_frame_encode(frame, field - frame, encoded);
+
+    /* The sequence gap of a dropped record tells the host */
+    if (output_write(encoded, encoded_length))
+    {
+        stream->statistics.records_sent++;
+        pc_uart_dev.statistics.sent++;
+    }
+    else
+    {
+        stream->statistics.records_dropped++;
+    }
 }
 
 static void clear_rx_buffer()
 {
-    memset(pc_uart_dev.rx_buffer, 0, PC_RX_BUFFER_SIZE);
+    pc_uart_dev.rx_buffer[0] = 0;
     pc_uart_dev.rx_index = 0;
+    pc_uart_dev.rx_overflow = false;
 }
 
-static void parse_received_data()
+/**
+ * @brief Add a byte to the text line or to the frame being received
+ * @param byte: Received byte
+ */
+static void receive_byte(uint8_t byte)
 {
-    if (strstr((char *)pc_uart_dev.rx_buffer, "WIFICFG") != NULL)
+    if (byte == PC_FRAME_DELIMITER)
+    {
+        /* A delimiter after frame data ends the frame, any other one starts a frame */
+        if (pc_uart_dev.frame_mode && (pc_uart_dev.frame_index > 0))
+        {
+            receive_frame();
+            pc_uart_dev.frame_mode = false;
+        }
+        else
+        {
+            pc_uart_dev.frame_mode = true;
+        }
+
+        pc_uart_dev.frame_index = 0;
+        pc_uart_dev.frame_overflow = false;
+        clear_rx_buffer();
+        return;
+    }
+
+    if (pc_uart_dev.frame_mode)
+    {
+        if (pc_uart_dev.frame_index < PC_FRAME_MAX_ENCODED_SIZE)
+        {
+            pc_uart_dev.frame_buffer[pc_uart_dev.frame_index++] = byte;
+        }
+        else
+        {
+            pc_uart_dev.frame_overflow = true;
+        }
+        return;
+    }
+
+    if (byte == 0x0A)
     {
-        parse_wifi_configuration();
+        if (!pc_uart_dev.rx_overflow)
+        {
+            pc_uart_dev.rx_buffer[pc_uart_dev.rx_index] = 0;
+            parse_received_data();
+        }
+
+        clear_rx_buffer();
+        return;
     }
-    else if (strstr((char *)pc_uart_dev.rx_buffer, "SENSORS") != NULL)
+
+    /* Line does not fit in the buffer, drop it up to its end */
+    if (pc_uart_dev.rx_index >= PC_RX_BUFFER_SIZE - 1)
     {
-        send_sensors_values();
+        pc_uart_dev.rx_overflow = true;
+        return;
     }
-    else if (strstr((char *)pc_uart_dev.rx_buffer, "STATUS") != NULL)
+
+    pc_uart_dev.rx_buffer[pc_uart_dev.rx_index++] = (char)byte;
+}
+
+/**
+ * @brief Decode the received frame and run its command
+ */
+static void receive_frame()
+{
+    uint16_t length = pc_uart_dev.frame_index;
+
+    if (pc_uart_dev.frame_overflow)
     {
-        send_device_status();
+        pc_uart_dev.statistics.framing_errors++;
+        return;
     }
 
-    clear_rx_buffer();
+    /* A damaged frame is not answered, its command and sequence can not be trusted */
+    switch (pc_frame_decode(pc_uart_dev.frame_buffer, &length))
+    {
+    case PC_FRAME_VALID:
+        pc_uart_dev.statistics.received++;
+        dispatch_frame(pc_uart_dev.frame_buffer, length);
+        break;
+    case PC_FRAME_CRC_MISMATCH:
+        pc_uart_dev.statistics.crc_errors++;
+        break;
+    case PC_FRAME_INVALID:
+        pc_uart_dev.statistics.framing_errors++;
+        break;
+    }
+}
+
+/**
+ * @brief Run the handler of a frame command and send the reply
+ * @param frame: Decoded frame, header and payload
+ * @param length: Frame length without CRC
+ */
+static void dispatch_frame(const uint8_t *frame, uint16_t length)
+{
+    uint8_t reply[PC_FRAME_MAX_SIZE];
+    const pc_frame_header *request = (const pc_frame_header *)frame;
+    pc_frame_header *header = (pc_frame_header *)reply;
+    uint16_t payload_length = length - PC_FRAME_HEADER_SIZE;
+    uint16_t reply_length = 0;
+
+    header->command = request->command;
+    header->sequence = request->sequence;
+
+    if ((request->command >= PC_COMMAND_COUNT) || (frame_commands[request->command].handler == NULL))
+    {
+        pc_uart_dev.statistics.unknown_commands++;
+        header->status = PC_FRAME_STATUS_UNKNOWN_COMMAND;
+    }
+    else if ((payload_length < frame_commands[request->command].min_length)
+            || (payload_length > frame_commands[request->command].max_length))
+    {
+        header->status = PC_FRAME_STATUS_BAD_LENGTH;
+    }
+    else
+    {
+        header->status = frame_commands[request->command].handler(&frame[PC_FRAME_HEADER_SIZE],
+                payload_length, &reply[PC_FRAME_HEADER_SIZE], &reply_length);
+    }
+
+    send_frame(reply, PC_FRAME_HEADER_SIZE + reply_length);
+}
+
+/**
+ * @brief Encode and send a frame
+ * @param frame: Header and payload, with room for the CRC
+ * @param length: Header and payload length
+ */
+static void send_frame(uint8_t *frame, uint16_t length)
+{
+    uint8_t encoded[PC_FRAME_MAX_ENCODED_SIZE];
+    uint16_t encoded_length = pc_frame_encode(frame, length, encoded);
+
+    if (output_write(encoded, encoded_length))
+    {
+        pc_uart_dev.statistics.sent++;
+    }
+}
+
+/**
+ * @brief Append data to the transmit buffers and queue them for DMA
+ *
+ * The data is written completely or not at all, the caller never waits for
+ * the UART. Refused writes are counted.
+ *
+ * @param data: Data to send
+ * @param length: Data length
+ * @return: true if the data was queued, false if it does not fit
+ */
+static bool output_write(const uint8_t *data, uint16_t length)
+{
+    pc_uart_output *output = &pc_uart_dev.output;
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    uint16_t space = PC_TX_BUFFER_SIZE - output->lengths[output->fill];
+    uint32_t free = space + (uint32_t)(PC_TX_BUFFER_COUNT - 1 - output->queued) * PC_TX_BUFFER_SIZE;
+
+    if (length > free)
+    {
+        output->dropped++;
+        __set_PRIMASK(primask);
+        return false;
+    }
+
+    while (length > 0)
+    {
+        uint8_t fill = output->fill;
+        space = PC_TX_BUFFER_SIZE - output->lengths[fill];
+        uint16_t count = (length < space) ? length : space;
+
+        memcpy(&output->buffers[fill][output->lengths[fill]], data, count);
+        output->lengths[fill] += count;
+        data += count;
+        length -= count;
+
+        if ((output->queued == 0) || (output->lengths[fill] >= PC_TX_BUFFER_SIZE))
+        {
+            queue_fill_buffer();
+        }
+    }
+
+    __set_PRIMASK(primask);
+    return true;
+}
+
+/**
+ * @brief Check for transmit space, the PC task is posted again once a buffer is sent if there is none
+ * @param length: Bytes that must fit
+ * @return: true if length bytes can be written
+ */
+static bool output_reserve(uint16_t length)
+{
+    pc_uart_output *output = &pc_uart_dev.output;
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    uint16_t space = PC_TX_BUFFER_SIZE - output->lengths[output->fill];
+    uint32_t free = space + (uint32_t)(PC_TX_BUFFER_COUNT - 1 - output->queued) * PC_TX_BUFFER_SIZE;
+    bool available = (length <= free);
+
+    output->waiting = !available;
+
+    __set_PRIMASK(primask);
+    return available;
+}
+
+/**
+ * @brief Hand the fill buffer to the UART transmitter and open the next one
+ * Called with interrupts disabled or from the transfer complete interrupt.
+ */
+static void queue_fill_buffer()
+{
+    pc_uart_output *output = &pc_uart_dev.output;
+    uint8_t sending = output->fill;
+
+    if ((output->lengths[sending] == 0) || (output->queued >= PC_TX_BUFFER_COUNT - 1))
+        return;
+
+    output->fill = (sending + 1) % PC_TX_BUFFER_COUNT;
+    output->lengths[output->fill] = 0;
+    output->queued++;
+
+    /* The transmitter counts the rejected buffer, its data is lost */
+    if (!uart_tx_send(&pc_tx, output->buffers[sending], output->lengths[sending], output_sent, NULL))
+    {
+        output->queued--;
+    }
+}
+
+/**
+ * @brief Transmitter callback, the oldest queued buffer is free again
+ * @param context: Unused
+ */
+static void output_sent(void *context)
+{
+    (void)context;
+    pc_uart_output *output = &pc_uart_dev.output;
+
+    output->queued--;
+
+    if ((output->queued == 0) || (output->lengths[output->fill] >= PC_TX_BUFFER_SIZE))
+    {
+        queue_fill_buffer();
+    }
+
+    if (output->waiting)
+    {
+        output->waiting = false;
+        scheduler_post(&pc_uart_task);
+    }
+}
+
+static void parse_received_data()
+{
+    /* The command name is the first field, up to a separator or the line end */
+    size_t name_length = strcspn(pc_uart_dev.rx_buffer, "|\r");
+
+    for (uint8_t index = 0; index < sizeof(text_commands) / sizeof(text_commands[0]); index++)
+    {
+        if ((strlen(text_commands[index].name) == name_length)
+                && (strncmp(pc_uart_dev.rx_buffer, text_commands[index].name, name_length) == 0))
+        {
+            text_commands[index].handler();
+            return;
+        }
+    }
 }
 
 static void parse_wifi_configuration()
 {
-    char wifi_cfg[6][32];
+    char *wifi_cfg[PC_WIFI_CFG_FIELDS];
     uint8_t index = 0;
 
     char *str = strtok(pc_uart_dev.rx_buffer, "|");
-    strcpy(wifi_cfg[index++], str);
 
-    while ((str != NULL) && (index < 6))
+    while ((str != NULL) && (index < PC_WIFI_CFG_FIELDS))
     {
+        wifi_cfg[index++] = str;
         str = strtok(NULL, "|");
-        strcpy(wifi_cfg[index++], str);
     }
 
-    if (index != 6)
+    /* Protocol and QoS are optional, older tools send only the first six fields */
+    if (index < 6)
         return;
 
+    /* Every string needs its terminating null character inside its buffer */
+    if ((strlen(wifi_cfg[1]) >= WIFI_CFG_STR_SIZE)
+            || (strlen(wifi_cfg[2]) >= WIFI_CFG_STR_SIZE)
+            || (strlen(wifi_cfg[3]) >= WIFI_CFG_STR_SIZE)
+            || (strlen(wifi_cfg[5]) >= WIFI_CFG_STR_SIZE))
+    {
+        send_config_reply(false);
+        return;
+    }
+
     wifi_config wifi_configuration;
+    memset(&wifi_configuration, 0, sizeof(wifi_configuration));
     strcpy(wifi_configuration.network_ssid, wifi_cfg[1]);
     strcpy(wifi_configuration.network_password, wifi_cfg[2]);
     strcpy(wifi_configuration.broker_address, wifi_cfg[3]);
     wifi_configuration.broker_port = strtoul(wifi_cfg[4], NULL, 0);
     strcpy(wifi_configuration.broker_token, wifi_cfg[5]);
+    wifi_configuration.broker_protocol = (index > 6) ? strtoul(wifi_cfg[6], NULL, 0) : WIFI_PROTOCOL_HTTP;
+    wifi_configuration.broker_qos = (index > 7) ? strtoul(wifi_cfg[7], NULL, 0) : 0;
+
+    if (wifi_configuration.broker_protocol > WIFI_PROTOCOL_MQTT || wifi_configuration.broker_qos > 1)
+    {
+        send_config_reply(false);
+        return;
+    }
 
     bool status = wifi_set_configuration(&wifi_configuration);
     send_config_reply(status);
 }
 
+static void parse_telemetry_configuration()
+{
+    char *telemetry_cfg[PC_TELEMETRY_CFG_FIELDS];
+    uint8_t index = 0;
+
+    char *str = strtok(pc_uart_dev.rx_buffer, "|");
+
+    while ((str != NULL) && (index < PC_TELEMETRY_CFG_FIELDS))
+    {
+        telemetry_cfg[index++] = str;
+        str = strtok(NULL, "|");
+    }
+
+    /* The aggregate period is optional, older tools send only the first three fields */
+    if (index < 3)
+    {
+        send_config_reply(false);
+        return;
+    }
+
+    telemetry_config configuration;
+    configuration.batch_size = strtoul(telemetry_cfg[1], NULL, 0);
+    configuration.max_age = strtoul(telemetry_cfg[2], NULL, 0);
+    configuration.aggregate_period = (index > 3) ? strtoul(telemetry_cfg[3], NULL, 0) : 0;
+
+    bool status = telemetry_set_configuration(&configuration);
+    send_config_reply(status);
+}
+
+static void parse_policy_configuration()
+{
+    char *policy_cfg[PC_POLICY_CFG_FIELDS];
+    uint8_t index = 0;
+
+    char *str = strtok(pc_uart_dev.rx_buffer, "|");
+
+    while ((str != NULL) && (index < PC_POLICY_CFG_FIELDS))
+    {
+        policy_cfg[index++] = str;
+        str = strtok(NULL, "|");
+    }
+
+    if (index != PC_POLICY_CFG_FIELDS)
+    {
+        send_config_reply(false);
+        return;
+    }
+
+    publish_policy_config configuration;
+    configuration.min_interval = strtoul(policy_cfg[1], NULL, 0);
+    configuration.heartbeat = strtoul(policy_cfg[2], NULL, 0);
+
+    for (uint8_t channel = 0; channel < PUBLISH_CHANNEL_COUNT; channel++)
+    {
+        configuration.deadband[channel].absolute = strtoul(policy_cfg[3 + channel * 2], NULL, 0);
+        configuration.deadband[channel].relative = strtoul(policy_cfg[4 + channel * 2], NULL, 0);
+    }
+
+    bool status = publish_policy_set_configuration(&configuration);
+    send_config_reply(status);
+}
+
+static void parse_bme280_configuration()
+{
+    char *bme280_cfg[PC_BME280_CFG_FIELDS];
+    uint8_t index = 0;
+
+    char *str = strtok(pc_uart_dev.rx_buffer, "|");
+
+    while ((str != NULL) && (index < PC_BME280_CFG_FIELDS))
+    {
+        bme280_cfg[index++] = str;
+        str = strtok(NULL, "|");
+    }
+
+    if (index != PC_BME280_CFG_FIELDS)
+    {
+        send_config_reply(false);
+        return;
+    }
+
+    bool status = bme280_configure(&bme280_dev,
+            (bme280_mode)strtoul(bme280_cfg[1], NULL, 0),
+            (bme280_filter)strtoul(bme280_cfg[2], NULL, 0),
+            (bme280_sampling)strtoul(bme280_cfg[3], NULL, 0),
+            (bme280_sampling)strtoul(bme280_cfg[4], NULL, 0),
+            (bme280_sampling)strtoul(bme280_cfg[5], NULL, 0));
+    send_config_reply(status);
+}
+
+static void parse_acquisition_configuration()
+{
+    char *acquisition_cfg[PC_ACQUISITION_CFG_FIELDS];
+    uint8_t index = 0;
+
+    char *str = strtok(pc_uart_dev.rx_buffer, "|");
+
+    while ((str != NULL) && (index < PC_ACQUISITION_CFG_FIELDS))
+    {
+        acquisition_cfg[index++] = str;
+        str = strtok(NULL, "|");
+    }
+
+    if (index != PC_ACQUISITION_CFG_FIELDS)
+    {
+        send_config_reply(false);
+        return;
+    }
+
+    acquisition_config configuration;
+    configuration.fastest = (acquisition_level)strtoul(acquisition_cfg[1], NULL, 0);
+    configuration.slowest = (acquisition_level)strtoul(acquisition_cfg[2], NULL, 0);
+    configuration.stable_samples = strtoul(acquisition_cfg[3], NULL, 0);
+
+    for (uint8_t channel = 0; channel < PUBLISH_CHANNEL_COUNT; channel++)
+    {
+        configuration.rate[channel] = strtoul(acquisition_cfg[4 + channel], NULL, 0);
+    }
+
+    bool status = acquisition_set_configuration(&configuration);
+    send_config_reply(status);
+}
+
+static void parse_filter_configuration()
+{
+    char *filter_cfg[PC_FILTER_CFG_FIELDS];
+    uint8_t index = 0;
+
+    char *str = strtok(pc_uart_dev.rx_buffer, "|");
+
+    while ((str != NULL) && (index < PC_FILTER_CFG_FIELDS))
+    {
+        filter_cfg[index++] = str;
+        str = strtok(NULL, "|");
+    }
+
+    if (index != PC_FILTER_CFG_FIELDS)
+    {
+        send_config_reply(false);
+        return;
+    }
+
+    filter_config configuration;
+    publish_channel channel = (publish_channel)strtoul(filter_cfg[1], NULL, 0);
+    configuration.type = (filter_type)strtoul(filter_cfg[2], NULL, 0);
+    configuration.median_size = strtoul(filter_cfg[3], NULL, 0);
+    configuration.ewma_weight = strtoul(filter_cfg[4], NULL, 0);
+    configuration.process_noise = strtoul(filter_cfg[5], NULL, 0);
+    configuration.measurement_noise = strtoul(filter_cfg[6], NULL, 0);
+
+    bool status = filter_set_configuration(channel, &configuration);
+    send_config_reply(status);
+}
+
 static void send_sensors_values()
 {
     char values_str[128];
+    char *text = values_str;
+
+    /* Values are sent as strings with two decimals, pressure in hPa */
+    text += format_text(text, "{\"temperature\":\"");
+    text += format_fixed(text, environmental_data.temperature, 2);
+    text += format_text(text, "\", \"humidity\":\"");
+    text += format_fixed(text, (int32_t)((environmental_data.humidity + 5) / 10), 2);
+    text += format_text(text, "\", \"pressure\":\"");
+    text += format_fixed(text, (int32_t)environmental_data.pressure, 2);
+    text += format_text(text, "\", \"tvoc\":\"");
+    text += format_uint(text, air_quality.tvoc, 1);
+    text += format_text(text, "\", \"eco2\":\"");
+    text += format_uint(text, air_quality.eco2, 1);
+    text += format_text(text, "\"}\r\n");
+
+    output_write((uint8_t *)values_str, text - values_str);
+}
+
+static void send_aggregate_values()
+{
+    static const char *const names[PUBLISH_CHANNEL_COUNT] = {
+        "temperature", "humidity", "pressure", "tvoc", "eco2"
+    };
+    static const uint8_t decimals[PUBLISH_CHANNEL_COUNT] = { 2, 2, 2, 0, 0 };
+
+    char values_str[PC_REPLY_MAX_SIZE];
+    char *text = values_str;
+    aggregate_record record;
+
+    /* Newest closed window, same units as SENSORS, empty before the first one */
+    if (!aggregate_get_last(&record))
+    {
+        text += format_text(text, "{}\r\n");
+        output_write((uint8_t *)values_str, text - values_str);
+        return;
+    }
+
+    text += format_text(text, "{\"samples\":");
+    text += format_uint(text, record.count, 1);
+    text += format_text(text, ", \"period\":");
+    text += format_uint(text, record.period, 1);
+
+    for (uint8_t channel = 0; channel < PUBLISH_CHANNEL_COUNT; channel++)
+    {
+        const aggregate_channel *statistics = &record.channels[channel];
+
+        text += format_text(text, ", \"");
+        text += format_text(text, names[channel]);
+        text += format_text(text, "\":{\"min\":\"");
+        text += format_fixed(text, statistics->min, decimals[channel]);
+        text += format_text(text, "\", \"max\":\"");
+        text += format_fixed(text, statistics->max, decimals[channel]);
+        text += format_text(text, "\", \"mean\":\"");
+        text += format_fixed(text, statistics->mean, decimals[channel]);
+        text += format_text(text, "\", \"std\":\"");
+        text += format_fixed(text, (int32_t)statistics->stddev, decimals[channel]);
+        text += format_text(text, "\"}");
+    }
 
-    sprintf(values_str, "{\"temperature\":\"%.2f\", \"humidity\":\"%.2f\","
-            " \"pressure\":\"%.2f\", \"tvoc\":\"%d\", \"eco2\":\"%d\"}\r\n",
-            environmental_data.temperature,
-            environmental_data.humidity,
-            environmental_data.pressure / 100, /* Convert pressure to hPa */
-            air_quality.tvoc,
-            air_quality.eco2);
+    text += format_text(text, "}\r\n");
 
-    HAL_UART_Transmit(pc_uart_dev.uart_handle, (uint8_t*)values_str, strlen(values_str), HAL_MAX_DELAY);
+    output_write((uint8_t *)values_str, text - values_str);
 }
 
 static void send_device_status()
 {
-    char status_str[256];
+    pc_uart_dev.status_pending = true;
+    pc_uart_dev.status_section = 0;
+    send_status_sections();
+}
+
+/**
+ * @brief Write the pending STATUS sections that fit in the transmit buffers
+ *
+ * The reply is longer than the transmit buffers, the PC task calls this again
+ * when space frees up.
+ *
+ * @return: true if no STATUS section is left to write
+ */
+static bool send_status_sections()
+{
+    char section[PC_STATUS_SECTION_SIZE];
+
+    while (pc_uart_dev.status_pending && output_reserve(PC_STATUS_SECTION_SIZE))
+    {
+        uint16_t length = status_sections[pc_uart_dev.status_section](section, sizeof(section));
+        output_write((uint8_t *)section, length);
+
+        if (++pc_uart_dev.status_section >= PC_STATUS_SECTION_COUNT)
+        {
+            pc_uart_dev.status_pending = false;
+        }
+    }
+
+    return !pc_uart_dev.status_pending;
+}
+
+/**
+ * @brief Length of a status section written by snprintf
+ * @param length: snprintf result
+ * @param size: Section buffer size
+ * @return: Number of characters in the buffer, a truncated section is cut at the buffer end
+ */
+static uint16_t section_length(int length, uint16_t size)
+{
+    if (length < 0)
+        return 0;
+
+    return (length < size) ? (uint16_t)length : (uint16_t)(size - 1);
+}
 
-    wifi_state state = wifi_get_state();
+static uint16_t status_wifi(char *text, uint16_t size)
+{
     wifi_config configuration;
     wifi_get_configuration(&configuration);
 
-    sprintf(status_str, "{\"wifi_state\":%d, \"wifi_ssid\":\"%s\", \"wifi_password\":\"%s\","
-            "\"broker_address\":\"%s\", \"broker_port\":\"%lu\", \"broker_token\":\"%s\"}\r\n",
-            state,
+    int length = snprintf(text, size, "{\"wifi_state\":%d, \"wifi_ssid\":\"%s\", \"wifi_password\":\"%s\","
+            "\"broker_address\":\"%s\", \"broker_port\":\"%lu\", \"broker_token\":\"%s\","
+            " \"broker_protocol\":%u, \"broker_qos\":%u,",
+            wifi_get_state(),
             configuration.network_ssid,
             configuration.network_password,
             configuration.broker_address,
             configuration.broker_port,
-            configuration.broker_token);
+            configuration.broker_token,
+            configuration.broker_protocol,
+            configuration.broker_qos);
+
+    return section_length(length, size);
+}
+
+static uint16_t status_link(char *text, uint16_t size)
+{
+    uart_rx_statistics link;
+    wifi_get_link_statistics(&link);
+    uart_tx_statistics link_tx;
+    wifi_get_tx_statistics(&link_tx);
+
+    int length = snprintf(text, size, " \"link_rx_bytes\":%lu, \"link_rx_overruns\":%lu, \"link_rx_errors\":%lu,"
+            " \"link_rx_irqs\":%u, \"link_tx_bytes\":%lu, \"link_tx_rate\":%lu,"
+            " \"link_tx_max_depth\":%u, \"link_tx_stall_time\":%lu, \"link_tx_rejected\":%lu,"
+            " \"link_tx_errors\":%lu,",
+            link.bytes_received,
+            link.overruns,
+            link.errors,
+            link.irqs_per_second,
+            link_tx.bytes_sent,
+            link_tx.bytes_per_second,
+            link_tx.max_depth,
+            link_tx.stall_time,
+            link_tx.rejected,
+            link_tx.errors);
+
+    return section_length(length, size);
+}
+
+static uint16_t status_commands(char *text, uint16_t size)
+{
+    wifi_baud_statistics baud;
+    wifi_get_baud_statistics(&baud);
+    at_command_statistics commands;
+    wifi_get_command_statistics(&commands);
+
+    int length = snprintf(text, size, " \"link_baud_rate\":%lu, \"link_baud_switches\":%lu,"
+            " \"link_baud_refused\":%lu, \"link_baud_failures\":%lu, \"at_completed\":%lu, \"at_failed\":%lu,"
+            " \"at_timeouts\":%lu, \"at_last_latency\":%lu, \"at_max_latency\":%lu,",
+            baud.baud_rate,
+            baud.switches,
+            baud.refused,
+            baud.failures,
+            commands.completed,
+            commands.failed,
+            commands.timeouts,
+            commands.last_latency,
+            commands.max_latency);
+
+    return section_length(length, size);
+}
+
+static uint16_t status_telemetry(char *text, uint16_t size)
+{
+    telemetry_config telemetry_configuration;
+    telemetry_get_configuration(&telemetry_configuration);
+    telemetry_statistics telemetry;
+    telemetry_get_statistics(&telemetry);
+    journal_statistics journal;
+    journal_get_statistics(&journal);
+
+    int length = snprintf(text, size, " \"telemetry_batch_size\":%u, \"telemetry_max_age\":%u, \"telemetry_pending\":%u,"
+            " \"telemetry_sent\":%lu, \"telemetry_dropped\":%lu, \"telemetry_batches\":%lu,"
+            " \"journal_pending\":%lu, \"journal_written\":%lu, \"journal_lost\":%lu,"
+            " \"journal_erases\":%lu, \"journal_errors\":%lu,",
+            telemetry_configuration.batch_size,
+            telemetry_configuration.max_age,
+            telemetry_pending(),
+            telemetry.samples_sent,
+            telemetry.samples_dropped,
+            telemetry.batches_sent,
+            journal_pending(),
+            journal.samples_written,
+            journal.samples_lost,
+            journal.page_erases,
+            journal.write_errors);
+
+    return section_length(length, size);
+}
+
+static uint16_t status_policy(char *text, uint16_t size)
+{
+    publish_policy_statistics policy;
+    publish_policy_get_statistics(&policy);
 
-    HAL_UART_Transmit(pc_uart_dev.uart_handle, (uint8_t*)status_str, strlen(status_str), HAL_MAX_DELAY);
+    int length = snprintf(text, size, " \"policy_published\":%lu,"
+            " \"policy_heartbeats\":%lu, \"policy_suppressed\":%lu, \"policy_rate_limited\":%lu,",
+            policy.published,
+            policy.heartbeats,
+            policy.suppressed,
+            policy.rate_limited);
+
+    return section_length(length, size);
+}
+
+static uint16_t status_system(char *text, uint16_t size)
+{
+    i2c_bus_statistics i2c;
+    i2c_bus_get_statistics(&i2c);
+    scheduler_statistics scheduler;
+    scheduler_get_statistics(&scheduler);
+    low_power_statistics power;
+    low_power_get_statistics(&power);
+
+    int length = snprintf(text, size, " \"i2c_completed\":%lu, \"i2c_errors\":%lu, \"i2c_timeouts\":%lu,"
+            " \"i2c_recoveries\":%lu, \"i2c_last_latency\":%lu, \"i2c_max_latency\":%lu,"
+            " \"scheduler_runs\":%lu, \"scheduler_sleeps\":%lu, \"scheduler_max_latency\":%lu,"
+            " \"power_sleeps\":%lu, \"power_stops\":%lu, \"power_stop_time\":%lu,",
+            i2c.completed,
+            i2c.errors,
+            i2c.timeouts,
+            i2c.recoveries,
+            i2c.last_latency,
+            i2c.max_latency,
+            scheduler.runs,
+            scheduler.sleeps,
+            scheduler.max_latency,
+            power.sleeps,
+            power.stops,
+            power.stop_time);
+
+    return section_length(length, size);
+}
+
+static uint16_t status_baseline(char *text, uint16_t size)
+{
+    ccs811_baseline_statistics baseline;
+    ccs811_baseline_get_statistics(&baseline);
+
+    int length = snprintf(text, size, " \"baseline_restored\":%u, \"baseline_value\":%u, \"baseline_timestamp\":%lu,"
+            " \"baseline_valid_time\":%lu, \"baseline_saves\":%lu, \"baseline_errors\":%lu,",
+            baseline.restored,
+            baseline.baseline,
+            baseline.timestamp,
+            baseline.valid_time,
+            baseline.saves,
+            baseline.errors);
+
+    return section_length(length, size);
+}
+
+static uint16_t status_acquisition(char *text, uint16_t size)
+{
+    acquisition_statistics acquisition;
+    acquisition_get_statistics(&acquisition);
+
+    int length = snprintf(text, size, " \"acq_level\":%u, \"acq_interval\":%lu, \"acq_speedups\":%lu, \"acq_slowdowns\":%lu,"
+            " \"acq_drive_changes\":%lu, \"acq_fast_samples\":%lu, \"acq_normal_samples\":%lu,"
+            " \"acq_slow_samples\":%lu,",
+            acquisition_get_level(),
+            acquisition_get_interval(),
+            acquisition.speedups,
+            acquisition.slowdowns,
+            acquisition.drive_changes,
+            acquisition.samples[ACQUISITION_LEVEL_FAST],
+            acquisition.samples[ACQUISITION_LEVEL_NORMAL],
+            acquisition.samples[ACQUISITION_LEVEL_SLOW]);
+
+    return section_length(length, size);
+}
+
+static uint16_t status_processing(char *text, uint16_t size)
+{
+    telemetry_statistics telemetry;
+    telemetry_get_statistics(&telemetry);
+    aggregate_statistics aggregates;
+    aggregate_get_statistics(&aggregates);
+    filter_config filters[PUBLISH_CHANNEL_COUNT];
+
+    for (uint8_t channel = 0; channel < PUBLISH_CHANNEL_COUNT; channel++)
+    {
+        filter_get_configuration((publish_channel)channel, &filters[channel]);
+    }
+
+    int length = snprintf(text, size, " \"agg_period\":%u, \"agg_pending\":%u,"
+            " \"agg_samples\":%lu, \"agg_windows\":%lu, \"agg_dropped\":%lu,"
+            " \"agg_sent\":%lu, \"filter_type\":[%u,%u,%u,%u,%u],"
+            " \"filter_latency\":[%u,%u,%u,%u,%u],",
+            aggregate_get_period(),
+            aggregate_pending(),
+            aggregates.samples,
+            aggregates.windows,
+            aggregates.dropped,
+            telemetry.windows_sent,
+            filters[PUBLISH_CHANNEL_TEMPERATURE].type,
+            filters[PUBLISH_CHANNEL_HUMIDITY].type,
+            filters[PUBLISH_CHANNEL_PRESSURE].type,
+            filters[PUBLISH_CHANNEL_TVOC].type,
+            filters[PUBLISH_CHANNEL_ECO2].type,
+            filter_get_latency(PUBLISH_CHANNEL_TEMPERATURE),
+            filter_get_latency(PUBLISH_CHANNEL_HUMIDITY),
+            filter_get_latency(PUBLISH_CHANNEL_PRESSURE),
+            filter_get_latency(PUBLISH_CHANNEL_TVOC),
+            filter_get_latency(PUBLISH_CHANNEL_ECO2));
+
+    return section_length(length, size);
+}
+
+static uint16_t status_store(char *text, uint16_t size)
+{
+    config_store_statistics store;
+    config_store_get_statistics(&store);
+
+    int length = snprintf(text, size, " \"store_free\":%u, \"store_writes\":%lu,"
+            " \"store_unchanged\":%lu, \"store_compactions\":%lu, \"store_erases\":%lu,"
+            " \"store_errors\":%lu,",
+            config_store_free(),
+            store.writes,
+            store.unchanged,
+            store.compactions,
+            store.erases,
+            store.errors);
+
+    return section_length(length, size);
+}
+
+static uint16_t status_frames(char *text, uint16_t size)
+{
+    int length = snprintf(text, size, " \"frame_rx\":%lu, \"frame_tx\":%lu,"
+            " \"frame_crc_errors\":%lu, \"frame_errors\":%lu, \"frame_unknown\":%lu,"
+            " \"stream_channels\":%u, \"stream_divider\":%u, \"stream_sent\":%lu,"
+            " \"stream_dropped\":%lu,",
+            pc_uart_dev.statistics.received,
+            pc_uart_dev.statistics.sent,
+            pc_uart_dev.statistics.crc_errors,
+            pc_uart_dev.statistics.framing_errors,
+            pc_uart_dev.statistics.unknown_commands,
+            pc_uart_dev.stream.channels,
+            pc_uart_dev.stream.divider,
+            pc_uart_dev.stream.statistics.records_sent,
+            pc_uart_dev.stream.statistics.records_dropped);
+
+    return section_length(length, size);
+}
+
+static uint16_t status_output(char *text, uint16_t size)
+{
+    uart_tx_statistics output;
+    uart_tx_get_statistics(&pc_tx, &output);
+
+    int length = snprintf(text, size, " \"tx_bytes\":%lu, \"tx_rate\":%lu,"
+            " \"tx_max_depth\":%u, \"tx_stall_time\":%lu, \"tx_rejected\":%lu,"
+            " \"tx_errors\":%lu, \"tx_dropped\":%lu}\r\n",
+            output.bytes_sent,
+            output.bytes_per_second,
+            output.max_depth,
+            output.stall_time,
+            output.rejected,
+            output.errors,
+            pc_uart_dev.output.dropped);
+
+    return section_length(length, size);
 }
 
 static void send_config_reply(bool reply)
 {
     char reply_str[32];
     sprintf(reply_str, "{\"status\":\"%s\"}\r\n", reply ? "OK" : "FAIL");
-    HAL_UART_Transmit(pc_uart_dev.uart_handle, (uint8_t*)reply_str, strlen(reply_str), HAL_MAX_DELAY);
+    output_write((uint8_t *)reply_str, strlen(reply_str));
+}
+
+static pc_frame_status frame_ping(const uint8_t *request, uint16_t length,
+        uint8_t *reply, uint16_t *reply_length)
+{
+    memcpy(reply, request, length);
+    *reply_length = length;
+    return PC_FRAME_STATUS_OK;
+}
+
+static pc_frame_status frame_sensors(const uint8_t *request, uint16_t length,
+        uint8_t *reply, uint16_t *reply_length)
+{
+    uint8_t *field = reply;
+
+    field += pc_frame_put_u32(field, (uint32_t)environmental_data.temperature);
+    field += pc_frame_put_u32(field, environmental_data.humidity);
+    field += pc_frame_put_u32(field, environmental_data.pressure);
+    field += pc_frame_put_u16(field, air_quality.tvoc);
+    field += pc_frame_put_u16(field, air_quality.eco2);
+
+    *reply_length = field - reply;
+    return PC_FRAME_STATUS_OK;
+}
+
+static pc_frame_status frame_aggregates(const uint8_t *request, uint16_t length,
+        uint8_t *reply, uint16_t *reply_length)
+{
+    aggregate_record record;
+    uint8_t *field = reply;
+
+    /* Empty before the first closed window */
+    if (aggregate_get_last(&record))
+    {
+        field += pc_frame_put_u16(field, record.period);
+        field += pc_frame_put_u16(field, record.count);
+
+        for (uint8_t channel = 0; channel < PUBLISH_CHANNEL_COUNT; channel++)
+        {
+            field += pc_frame_put_u32(field, (uint32_t)record.channels[channel].min);
+            field += pc_frame_put_u32(field, (uint32_t)record.channels[channel].max);
+            field += pc_frame_put_u32(field, (uint32_t)record.channels[channel].mean);
+            field += pc_frame_put_u32(field, record.channels[channel].stddev);
+        }
+    }
+
+    *reply_length = field - reply;
+    return PC_FRAME_STATUS_OK;
+}
+
+static pc_frame_status frame_wifi_get(const uint8_t *request, uint16_t length,
+        uint8_t *reply, uint16_t *reply_length)
+{
+    wifi_config configuration;
+    wifi_get_configuration(&configuration);
+    uint8_t *field = reply;
+
+    /* Strings are padded with null characters, unused bytes are never sent */
+    *field++ = (uint8_t)wifi_get_state();
+    strncpy((char *)field, configuration.network_ssid, WIFI_CFG_STR_SIZE);
+    field += WIFI_CFG_STR_SIZE;
+    strncpy((char *)field, configuration.network_password, WIFI_CFG_STR_SIZE);
+    field += WIFI_CFG_STR_SIZE;
+    strncpy((char *)field, configuration.broker_address, WIFI_CFG_STR_SIZE);
+    field += WIFI_CFG_STR_SIZE;
+    field += pc_frame_put_u32(field, configuration.broker_port);
+    strncpy((char *)field, configuration.broker_token, WIFI_CFG_STR_SIZE);
+    field += WIFI_CFG_STR_SIZE;
+    *field++ = configuration.broker_protocol;
+    *field++ = configuration.broker_qos;
+
+    *reply_length = field - reply;
+    return PC_FRAME_STATUS_OK;
+}
+
+static pc_frame_status frame_wifi_set(const uint8_t *request, uint16_t length,
+        uint8_t *reply, uint16_t *reply_length)
+{
+    wifi_config configuration;
+    const uint8_t *field = request;
+
+    memcpy(configuration.network_ssid, field, WIFI_CFG_STR_SIZE);
+    field += WIFI_CFG_STR_SIZE;
+    memcpy(configuration.network_password, field, WIFI_CFG_STR_SIZE);
+    field += WIFI_CFG_STR_SIZE;
+    memcpy(configuration.broker_address, field, WIFI_CFG_STR_SIZE);
+    field += WIFI_CFG_STR_SIZE;
+    configuration.broker_port = pc_frame_get_u32(field);
+    field += 4;
+    memcpy(configuration.broker_token, field, WIFI_CFG_STR_SIZE);
+    field += WIFI_CFG_STR_SIZE;
+    configuration.broker_protocol = *field++;
+    configuration.broker_qos = *field++;
+
+    /* Every string needs its terminating null character inside its buffer */
+    if ((memchr(configuration.network_ssid, 0, WIFI_CFG_STR_SIZE) == NULL)
+            || (memchr(configuration.network_password, 0, WIFI_CFG_STR_SIZE) == NULL)
+            || (memchr(configuration.broker_address, 0, WIFI_CFG_STR_SIZE) == NULL)
+            || (memchr(configuration.broker_token, 0, WIFI_CFG_STR_SIZE) == NULL))
+        return PC_FRAME_STATUS_FAILED;
+
+    if (configuration.broker_protocol > WIFI_PROTOCOL_MQTT || configuration.broker_qos > 1)
+        return PC_FRAME_STATUS_FAILED;
+
+    return wifi_set_configuration(&configuration) ? PC_FRAME_STATUS_OK : PC_FRAME_STATUS_FAILED;
+}
+
+static pc_frame_status frame_telemetry_get(const uint8_t *request, uint16_t length,
+        uint8_t *reply, uint16_t *reply_length)
+{
+    telemetry_config configuration;
+    telemetry_get_configuration(&configuration);
+    uint8_t *field = reply;
+
+    *field++ = configuration.batch_size;
+    field += pc_frame_put_u16(field, configuration.max_age);
+    field += pc_frame_put_u16(field, configuration.aggregate_period);
+
+    *reply_length = field - reply;
+    return PC_FRAME_STATUS_OK;
+}
+
+static pc_frame_status frame_telemetry_set(const uint8_t *request, uint16_t length,
+        uint8_t *reply, uint16_t *reply_length)
+{
+    telemetry_config configuration;
+
+    configuration.batch_size = request[0];
+    configuration.max_age = pc_frame_get_u16(&request[1]);
+    configuration.aggregate_period = pc_frame_get_u16(&request[3]);
+
+    return telemetry_set_configuration(&configuration) ? PC_FRAME_STATUS_OK : PC_FRAME_STATUS_FAILED;
+}
+
+static pc_frame_status frame_policy_set(const uint8_t *request, uint16_t length,
+        uint8_t *reply, uint16_t *reply_length)
+{
+    publish_policy_config configuration;
+    const uint8_t *field = &request[4];
+
+    configuration.min_interval = pc_frame_get_u16(&request[0]);
+    configuration.heartbeat = pc_frame_get_u16(&request[2]);
+
+    for (uint8_t channel = 0; channel < PUBLISH_CHANNEL_COUNT; channel++)
+    {
+        configuration.deadband[channel].absolute = pc_frame_get_u32(field);
+        configuration.deadband[channel].relative = pc_frame_get_u16(field + 4);
+        field += 6;
+    }
+
+    return publish_policy_set_configuration(&configuration) ? PC_FRAME_STATUS_OK : PC_FRAME_STATUS_FAILED;
+}
+
+static pc_frame_status frame_bme280_set(const uint8_t *request, uint16_t length,
+        uint8_t *reply, uint16_t *reply_length)
+{
+    bool status = bme280_configure(&bme280_dev,
+            (bme280_mode)request[0],
+            (bme280_filter)request[1],
+            (bme280_sampling)request[2],
+            (bme280_sampling)request[3],
+            (bme280_sampling)request[4]);
+
+    return status ? PC_FRAME_STATUS_OK : PC_FRAME_STATUS_FAILED;
+}
+
+static pc_frame_status frame_acquisition_set(const uint8_t *request, uint16_t length,
+        uint8_t *reply, uint16_t *reply_length)
+{
+    acquisition_config configuration;
+
+    configuration.fastest = (acquisition_level)request[0];
+    configuration.slowest = (acquisition_level)request[1];
+    configuration.stable_samples = request[2];
+
+    for (uint8_t channel = 0; channel < PUBLISH_CHANNEL_COUNT; channel++)
+    {
+        configuration.rate[channel] = pc_frame_get_u32(&request[3 + channel * 4]);
+    }
+
+    return acquisition_set_configuration(&configuration) ? PC_FRAME_STATUS_OK : PC_FRAME_STATUS_FAILED;
+}
+
+static pc_frame_status frame_filter_set(const uint8_t *request, uint16_t length,
+        uint8_t *reply, uint16_t *reply_length)
+{
+    filter_config configuration;
+    publish_channel channel = (publish_channel)request[0];
+
+    configuration.type = (filter_type)request[1];
+    configuration.median_size = request[2];
+    configuration.ewma_weight = pc_frame_get_u16(&request[3]);
+    configuration.process_noise = pc_frame_get_u16(&request[5]);
+    configuration.measurement_noise = pc_frame_get_u16(&request[7]);
+
+    return filter_set_configuration(channel, &configuration) ? PC_FRAME_STATUS_OK : PC_FRAME_STATUS_FAILED;
+}
+
+static pc_frame_status frame_stream(const uint8_t *request, uint16_t length,
+        uint8_t *reply, uint16_t *reply_length)
+{
+    pc_stream *stream = &pc_uart_dev.stream;
+    uint8_t channels = request[0];
+    uint16_t divider = pc_frame_get_u16(&request[1]);
+
+    if ((channels >= (1U << PUBLISH_CHANNEL_COUNT)) || ((divider > 0) && (channels == 0)))
+        return PC_FRAME_STATUS_FAILED;
+
+    stream->channels = channels;
+    stream->divider = divider;
+    stream->count = 0;
+
+    *reply_length = pc_frame_put_u32(reply, stream->sequence);
+    return PC_FRAME_STATUS_OK;
 }
@@ -4,6 +4,11 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include "stm32g0xx_hal.h"
+#include "pc_frame.h"
+#include "wifi.h"
+#include "publish_policy.h"
+#include "bme280.h"
+#include "ccs811.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -14,14 +19,197 @@ extern "C" {
  */
 #define PC_RX_BUFFER_SIZE 512
 
+/**
+ * @brief Transmit buffer ring, the buffers before the fill buffer are queued for DMA
+ */
+#define PC_TX_BUFFER_COUNT 8
+#define PC_TX_BUFFER_SIZE  128
+
+/**
+ * @brief Transmit space a command needs before it runs, the longest text reply is AGGREGATES
+ */
+#define PC_REPLY_MAX_SIZE 576
+
+/**
+ * @brief Size of a STATUS reply section, the reply is sent one section at a time
+ */
+#define PC_STATUS_SECTION_SIZE 384
+
+/**
+ * @brief Number of fields of the WIFICFG command, including the command name
+ */
+#define PC_WIFI_CFG_FIELDS 8
+
+/**
+ * @brief Number of fields of the TELEMETRYCFG command, including the command name
+ *
+ * TELEMETRYCFG|batch_size|max_age|aggregate_period| with the period in s,
+ * the period is optional and 0 sends every sample.
+ */
+#define PC_TELEMETRY_CFG_FIELDS 4
+
+/**
+ * @brief Number of fields of the POLICYCFG command, including the command name
+ *
+ * POLICYCFG|min_interval|heartbeat| followed by an absolute and a relative
+ * deadband for temperature, humidity, pressure, tvoc and eco2.
+ */
+#define PC_POLICY_CFG_FIELDS 13
+
+/**
+ * @brief Number of fields of the BME280CFG command, including the command name
+ *
+ * BME280CFG|mode|filter|temperature_sampling|pressure_sampling|humidity_sampling|
+ * with the register values of bme280_mode, bme280_filter and bme280_sampling.
+ */
+#define PC_BME280_CFG_FIELDS 6
+
+/**
+ * @brief Number of fields of the ACQCFG command, including the command name
+ *
+ * ACQCFG|fastest|slowest|stable_samples| followed by the rate of change per
+ * minute of temperature, humidity, pressure, tvoc and eco2.
+ */
+#define PC_ACQUISITION_CFG_FIELDS 9
+
+/**
+ * @brief Number of fields of the FILTERCFG command, including the command name
+ *
+ * FILTERCFG|channel|type|median_size|ewma_weight|process_noise|measurement_noise|
+ * with the values of publish_channel and filter_type, the EWMA weight in 1/256
+ * and the Kalman variances in channel units squared.
+ */
+#define PC_FILTER_CFG_FIELDS 7
+
+/**
+ * @brief Payload lengths of the frame commands, fields are little endian
+ *
+ * SENSORS reply: temperature i32 in 0.01 degC, humidity u32 in 0.001 %,
+ * pressure u32 in Pa, tvoc u16 in ppb, eco2 u16 in ppm.
+ * AGGREGATES reply: period u16, samples u16, then min i32, max i32, mean i32
+ * and std u32 of every channel, empty before the first window.
+ * WIFI_SET: ssid, password and broker address as null padded strings of
+ * WIFI_CFG_STR_SIZE bytes, port u32, token string, protocol u8, qos u8.
+ * WIFI_GET reply: state u8 followed by the WIFI_SET payload.
+ * TELEMETRY_SET and TELEMETRY_GET reply: batch_size u8, max_age u16, aggregate_period u16.
+ * POLICY_SET: min_interval u16, heartbeat u16, absolute u32 and relative u16 deadband of every channel.
+ * BME280_SET: mode, filter, temperature, pressure and humidity sampling as u8.
+ * ACQUISITION_SET: fastest u8, slowest u8, stable_samples u8, rate u32 of every channel.
+ * FILTER_SET: channel u8, type u8, median_size u8, ewma_weight u16, process_noise u16, measurement_noise u16.
+ * STREAM: channels u8 with bit n for publish_channel n, divider u16 sending
+ * every divider-th measurement, 0 stops the stream. The reply holds the
+ * sequence u32 of the next record.
+ * STREAM_RECORD: sequence u32, tick u32, channels u8, then the value of every
+ * selected channel as i32 in the units of the SENSORS reply. The header
+ * sequence holds the low byte of the record sequence.
+ * PING accepts any payload up to PC_FRAME_MAX_PAYLOAD and replies with it.
+ */
+#define PC_SENSORS_REPLY_LENGTH       16
+#define PC_AGGREGATES_REPLY_LENGTH    (4 + PUBLISH_CHANNEL_COUNT * 16)
+#define PC_WIFI_SET_LENGTH            (4 * WIFI_CFG_STR_SIZE + 6)
+#define PC_WIFI_GET_REPLY_LENGTH      (PC_WIFI_SET_LENGTH + 1)
+#define PC_TELEMETRY_SET_LENGTH       5
+#define PC_POLICY_SET_LENGTH          (4 + PUBLISH_CHANNEL_COUNT * 6)
+#define PC_BME280_SET_LENGTH          5
+#define PC_ACQUISITION_SET_LENGTH     (3 + PUBLISH_CHANNEL_COUNT * 4)
+#define PC_FILTER_SET_LENGTH          9
+#define PC_STREAM_LENGTH              3
+#define PC_STREAM_RECORD_MAX_LENGTH   (9 + PUBLISH_CHANNEL_COUNT * 4)
+
+/**
+ * @brief Frame command handler
+ * @param request: Request payload, its length was checked by the dispatcher
+ * @param length: Request payload length
+ * @param reply: Reply payload buffer of PC_FRAME_MAX_PAYLOAD bytes
+ * @param reply_length: Set to the reply payload length
+ * @return: Reply status
+ */
+typedef pc_frame_status (*pc_command_handler)(const uint8_t *request, uint16_t length,
+        uint8_t *reply, uint16_t *reply_length);
+
+/**
+ * @brief Frame command table entry, indexed by pc_command
+ */
+typedef struct
+{
+    pc_command_handler handler;    /**< Command handler, NULL for an unknown command */
+    uint16_t min_length;           /**< Shortest request payload */
+    uint16_t max_length;           /**< Longest request payload */
+} pc_command_entry;
+
+/**
+ * @brief Text command table entry
+ */
+typedef struct
+{
+    const char *name;           /**< Command name, the first field of the line */
+    void (*handler)(void);      /**< Command handler, reads the line from the receive buffer */
+} pc_text_command;
+
+/**
+ * @brief STATUS reply section writer
+ * @param text: Section buffer
+ * @param size: Section buffer size
+ * @return: Number of characters written
+ */
+typedef uint16_t (*pc_status_section)(char *text, uint16_t size);
+
+/**
+ * @brief Transmit buffer ring
+ *
+ * Producers append to the fill buffer. A full fill buffer is handed to the
+ * UART transmitter and the next one opens, a partial one is handed over as
+ * soon as the transmitter has nothing else to send.
+ */
+typedef struct
+{
+    uint8_t buffers[PC_TX_BUFFER_COUNT][PC_TX_BUFFER_SIZE];    /**< Transmit buffers */
+    volatile uint16_t lengths[PC_TX_BUFFER_COUNT];             /**< Bytes in every buffer */
+    volatile uint8_t fill;                                     /**< Buffer receiving new data */
+    volatile uint8_t queued;                                   /**< Buffers queued before the fill buffer */
+    volatile bool waiting;                                     /**< The PC task waits for transmit space */
+    uint32_t dropped;                                          /**< Writes refused for lack of space */
+} pc_uart_output;
+
+/**
+ * @brief Stream statistics
+ */
+typedef struct
+{
+    uint32_t records_sent;       /**< Records queued for transmission */
+    uint32_t records_dropped;    /**< Records dropped on a full transmit queue */
+} pc_stream_statistics;
+
+/**
+ * @brief Measurement stream state
+ */
+typedef struct
+{
+    uint8_t channels;                   /**< Selected channels, bit n for publish_channel n */
+    uint16_t divider;                   /**< Every divider-th measurement is sent, 0 when stopped */
+    uint16_t count;                     /**< Measurements since the last record */
+    uint32_t sequence;                  /**< Sequence of the next record, dropped records included */
+    pc_stream_statistics statistics;    /**< Stream statistics */
+} pc_stream;
+
 /**
  * @brief PC device definition
  */
 typedef struct
 {
-    UART_HandleTypeDef *uart_handle;      /**< UART handle connected to PC */
-    char rx_buffer[PC_RX_BUFFER_SIZE];    /**< Received data from PC */
-    uint16_t rx_index;                    /**< Current index of received data */
+    UART_HandleTypeDef *uart_handle;                      /**< UART handle connected to PC */
+    char rx_buffer[PC_RX_BUFFER_SIZE];                    /**< Received text line from PC */
+    uint16_t rx_index;                                    /**< Current index of received data */
+    bool rx_overflow;                                     /**< Text line too long, dropped up to its end */
+    uint8_t frame_buffer[PC_FRAME_MAX_ENCODED_SIZE];      /**< Received encoded frame from PC */
+    uint16_t frame_index;                                 /**< Current index of the encoded frame */
+    bool frame_mode;                                      /**< A delimiter started a frame */
+    bool frame_overflow;                                  /**< Frame too long, dropped up to its end */
+    pc_frame_statistics statistics;                       /**< Frame statistics */
+    pc_uart_output output;                                /**< Transmit queue */
+    pc_stream stream;                                     /**< Measurement stream */
+    bool status_pending;                                  /**< STATUS reply not completely written */
+    uint8_t status_section;                               /**< Next STATUS section to write */
 } pc_uart;
 
 /**
@@ -33,6 +221,9 @@ bool pc_uart_init(UART_HandleTypeDef *huart);
 
 /**
  * @brief PC communication handler
+ *
+ * Text commands end with LF. A frame is sent between two delimiters, the
+ * first one drops a partial text line, so text and frames can be mixed.
  */
 void pc_uart_handler(void);
 
@@ -43,6 +234,30 @@ void pc_uart_handler(void);
  */
 void pc_uart_rx_callback(UART_HandleTypeDef *huart);
 
+/**
+ * @brief PC UART tx complete callback, starts the next queued transmit buffer
+ * @param huart: UART handle that finished the transmission
+ */
+void pc_uart_tx_callback(UART_HandleTypeDef *huart);
+
+/**
+ * @brief PC UART error callback, restarts reception and transmission
+ * @param huart: UART handle that reported the error
+ */
+void pc_uart_error_callback(UART_HandleTypeDef *huart);
+
+/**
+ * @brief Send a stream record when the stream is running and the divider is reached
+ *
+ * The record sequence counts dropped records too, so the host sees a gap
+ * when the transmit queue was full.
+ *
+ * @param environmental_data: Measurements of the BME280
+ * @param air_quality: Measurements of the CCS811
+ */
+void pc_uart_stream_sample(const bme280_measurements *environmental_data,
+        const ccs811_measurements *air_quality);
+
 #ifdef __cplusplus
 }
 #endif
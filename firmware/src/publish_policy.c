@@ -0,0 +1,144 @@
+#include <string.h>
+#include "publish_policy.h"
+#include "config_store.h"
+
+/**
+ * @brief Layout version of the stored configuration
+ */
+#define CONFIG_VERSION 1
+
+/**
+ * @brief Publish policy state
+ */
+static publish_policy publish_policy_dev;
+
+/* Publish policy private functions */
+static bool outside_deadband(publish_channel channel, int32_t value);
+
+void publish_policy_init(void)
+{
+    memset(&publish_policy_dev, 0, sizeof(publish_policy_dev));
+
+    publish_policy_config *config = &publish_policy_dev.configuration;
+    config->deadband[PUBLISH_CHANNEL_TEMPERATURE].absolute = PUBLISH_DEFAULT_TEMPERATURE_DEADBAND;
+    config->deadband[PUBLISH_CHANNEL_HUMIDITY].absolute = PUBLISH_DEFAULT_HUMIDITY_DEADBAND;
+    config->deadband[PUBLISH_CHANNEL_PRESSURE].absolute = PUBLISH_DEFAULT_PRESSURE_DEADBAND;
+    config->deadband[PUBLISH_CHANNEL_TVOC].absolute = PUBLISH_DEFAULT_TVOC_DEADBAND;
+    config->deadband[PUBLISH_CHANNEL_TVOC].relative = PUBLISH_DEFAULT_TVOC_RELATIVE;
+    config->deadband[PUBLISH_CHANNEL_ECO2].absolute = PUBLISH_DEFAULT_ECO2_DEADBAND;
+    config->deadband[PUBLISH_CHANNEL_ECO2].relative = PUBLISH_DEFAULT_ECO2_RELATIVE;
+    config->min_interval = PUBLISH_DEFAULT_MIN_INTERVAL;
+    config->heartbeat = PUBLISH_DEFAULT_HEARTBEAT;
+
+    publish_policy_config stored;
+
+    if (config_store_read(CONFIG_KEY_PUBLISH_POLICY, CONFIG_VERSION, &stored, sizeof(stored)))
+    {
+        publish_policy_set_configuration(&stored);
+    }
+}
+
+bool publish_policy_set_configuration(const publish_policy_config *config)
+{
+    if (config == NULL)
+        return false;
+
+    for (uint8_t channel = 0; channel < PUBLISH_CHANNEL_COUNT; channel++)
+    {
+        if (config->deadband[channel].relative > PUBLISH_MAX_RELATIVE_DEADBAND)
+            return false;
+    }
+
+    if (config->heartbeat != 0 && config->heartbeat < config->min_interval)
+        return false;
+
+    /* Used right away, even if it can not be saved */
+    publish_policy_dev.configuration = *config;
+
+    return config_store_write(CONFIG_KEY_PUBLISH_POLICY, CONFIG_VERSION,
+            &publish_policy_dev.configuration, sizeof(publish_policy_dev.configuration));
+}
+
+void publish_policy_get_configuration(publish_policy_config *config)
+{
+    if (config == NULL)
+        return;
+
+    *config = publish_policy_dev.configuration;
+}
+
+bool publish_policy_evaluate(const int32_t values[PUBLISH_CHANNEL_COUNT], uint32_t tick)
+{
+    if (values == NULL)
+        return false;
+
+    const publish_policy_config *config = &publish_policy_dev.configuration;
+    publish_policy_statistics *statistics = &publish_policy_dev.statistics;
+    bool publish = !publish_policy_dev.published;
+
+    if (!publish)
+    {
+        uint32_t elapsed = tick - publish_policy_dev.last_tick;
+
+        if (elapsed < config->min_interval * 1000UL)
+        {
+            statistics->rate_limited++;
+            return false;
+        }
+
+        for (uint8_t channel = 0; channel < PUBLISH_CHANNEL_COUNT && !publish; channel++)
+        {
+            publish = outside_deadband(channel, values[channel]);
+        }
+
+        if (!publish && config->heartbeat != 0 && elapsed >= config->heartbeat * 1000UL)
+        {
+            statistics->heartbeats++;
+            publish = true;
+        }
+    }
+
+    if (!publish)
+    {
+        statistics->suppressed++;
+        return false;
+    }
+
+    memcpy(publish_policy_dev.last_values, values, sizeof(publish_policy_dev.last_values));
+    publish_policy_dev.last_tick = tick;
+    publish_policy_dev.published = true;
+    statistics->published++;
+
+    return true;
+}
+
+void publish_policy_get_statistics(publish_policy_statistics *statistics)
+{
+    if (statistics == NULL)
+        return;
+
+    *statistics = publish_policy_dev.statistics;
+}
+
+/**
+ * @brief Check if a value left the deadband around the last published value
+ * @param channel: Measured channel
+ * @param value: New value
+ * @return: True if the change is significant, false otherwise
+ */
+static bool outside_deadband(publish_channel channel, int32_t value)
+{
+    const publish_deadband *deadband = &publish_policy_dev.configuration.deadband[channel];
+    int32_t last = publish_policy_dev.last_values[channel];
+    uint32_t change = (value > last) ? (uint32_t)(value - last) : (uint32_t)(last - value);
+    uint32_t magnitude = (last < 0) ? (uint32_t)-last : (uint32_t)last;
+    /* Sensor values are small enough not to overflow the product */
+    uint32_t limit = magnitude * deadband->relative / 1000;
+
+    if (limit < deadband->absolute)
+    {
+        limit = deadband->absolute;
+    }
+
+    return (change > limit);
+}
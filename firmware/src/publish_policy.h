@@ -0,0 +1,128 @@
+#ifndef PUBLISH_POLICY_H
+#define PUBLISH_POLICY_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Default policy, a change inside the deadband of every channel is not published
+ *
+ * Deadbands are in the integer units of the telemetry samples, relative
+ * deadbands in 0.1 % of the last published value.
+ */
+#define PUBLISH_DEFAULT_TEMPERATURE_DEADBAND   10     /**< 0.1 degC */
+#define PUBLISH_DEFAULT_HUMIDITY_DEADBAND      50     /**< 0.5 % */
+#define PUBLISH_DEFAULT_PRESSURE_DEADBAND      20     /**< 0.2 hPa */
+#define PUBLISH_DEFAULT_TVOC_DEADBAND          5      /**< 5 ppb */
+#define PUBLISH_DEFAULT_TVOC_RELATIVE          50     /**< 5 % */
+#define PUBLISH_DEFAULT_ECO2_DEADBAND          20     /**< 20 ppm */
+#define PUBLISH_DEFAULT_ECO2_RELATIVE          20     /**< 2 % */
+#define PUBLISH_DEFAULT_MIN_INTERVAL           10     /**< s */
+#define PUBLISH_DEFAULT_HEARTBEAT              300    /**< s */
+
+/**
+ * @brief Maximum relative deadband, 100 %
+ */
+#define PUBLISH_MAX_RELATIVE_DEADBAND 1000
+
+/**
+ * @brief Measured channels
+ */
+typedef enum
+{
+    PUBLISH_CHANNEL_TEMPERATURE,    /**< Temperature in 0.01 degC */
+    PUBLISH_CHANNEL_HUMIDITY,       /**< Relative humidity in 0.01 % */
+    PUBLISH_CHANNEL_PRESSURE,       /**< Pressure in Pa */
+    PUBLISH_CHANNEL_TVOC,           /**< Total volatile organic compound in ppb */
+    PUBLISH_CHANNEL_ECO2,           /**< Equivalent carbon dioxide in ppm */
+    PUBLISH_CHANNEL_COUNT
+} publish_channel;
+
+/**
+ * @brief Deadband of a channel, the larger of both limits is used
+ */
+typedef struct
+{
+    uint32_t absolute;    /**< Absolute deadband in channel units */
+    uint16_t relative;    /**< Relative deadband in 0.1 % of the last published value */
+} publish_deadband;
+
+/**
+ * @brief Publish policy configuration
+ */
+typedef struct
+{
+    publish_deadband deadband[PUBLISH_CHANNEL_COUNT];    /**< Deadband of every channel */
+    uint16_t min_interval;                               /**< Minimum time between two samples in s */
+    uint16_t heartbeat;                                  /**< Maximum time without sample in s, 0 disables it */
+} publish_policy_config;
+
+/**
+ * @brief Publish policy statistics
+ */
+typedef struct
+{
+    uint32_t published;        /**< Samples passed by the policy */
+    uint32_t heartbeats;       /**< Samples passed only because of the heartbeat */
+    uint32_t suppressed;       /**< Samples inside the deadbands */
+    uint32_t rate_limited;     /**< Samples dropped by the minimum interval */
+} publish_policy_statistics;
+
+/**
+ * @brief Publish policy state
+ */
+typedef struct
+{
+    publish_policy_config configuration;            /**< Policy configuration */
+    publish_policy_statistics statistics;           /**< Policy statistics */
+    int32_t last_values[PUBLISH_CHANNEL_COUNT];     /**< Values of the last published sample */
+    uint32_t last_tick;                             /**< HAL tick of the last published sample */
+    bool published;                                 /**< A sample was published */
+} publish_policy;
+
+/**
+ * @brief Initialize the publish policy with the saved or the default configuration
+ */
+void publish_policy_init(void);
+
+/**
+ * @brief Set and save the policy configuration
+ * @param config: Pointer to configuration structure
+ * @return: true if the configuration is valid and was saved, false otherwise
+ */
+bool publish_policy_set_configuration(const publish_policy_config *config);
+
+/**
+ * @brief Read the policy configuration
+ * @param config: Pointer to configuration structure
+ */
+void publish_policy_get_configuration(publish_policy_config *config);
+
+/**
+ * @brief Decide if a sample should be published
+ *
+ * A sample is published when any channel left its deadband around the last
+ * published value, or when the heartbeat interval passed. Nothing is
+ * published within the minimum interval after the last sample.
+ *
+ * @param values: Sample values indexed by publish_channel
+ * @param tick: HAL tick of the sample
+ * @return: true if the sample should be published, false otherwise
+ */
+bool publish_policy_evaluate(const int32_t values[PUBLISH_CHANNEL_COUNT], uint32_t tick);
+
+/**
+ * @brief Read the policy statistics
+ * @param statistics: Pointer to statistics structure
+ */
+void publish_policy_get_statistics(publish_policy_statistics *statistics);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PUBLISH_POLICY_H */
@@ -0,0 +1,318 @@
+#include <string.h>
+#include "scheduler.h"
+#include "low_power.h"
+
+#define QUEUE_MASK (SCHEDULER_QUEUE_SIZE - 1)
+#define WHEEL_MASK (SCHEDULER_WHEEL_SIZE - 1)
+
+_Static_assert((SCHEDULER_QUEUE_SIZE & QUEUE_MASK) == 0, "Invalid scheduler queue size");
+_Static_assert((SCHEDULER_WHEEL_SIZE & WHEEL_MASK) == 0, "Invalid scheduler wheel size");
+
+/**
+ * @brief Scheduler
+ */
+static scheduler sched;
+
+/* Scheduler private functions */
+static scheduler_task *next_task(void);
+static bool has_pending_task(void);
+static uint32_t next_expiry(void);
+static void advance_wheel(void);
+static void process_slot(uint8_t slot, uint32_t tick);
+static void insert_timer(scheduler_timer *timer);
+static void remove_timer(scheduler_timer *timer);
+
+void scheduler_init(void)
+{
+    memset(&sched, 0, sizeof(sched));
+    sched.wheel_tick = HAL_GetTick();
+}
+
+bool scheduler_register(scheduler_task *task)
+{
+    if (task == NULL || task->function == NULL || task->priority >= SCHEDULER_PRIORITY_COUNT)
+        return false;
+
+    if (task->registered)
+        return true;
+
+    /* Every task is queued at most once, so the queue can not overflow */
+    if (sched.task_count[task->priority] >= SCHEDULER_QUEUE_SIZE)
+        return false;
+
+    sched.task_count[task->priority]++;
+    task->pending = false;
+    task->registered = true;
+
+    return true;
+}
+
+void scheduler_post(scheduler_task *task)
+{
+    if (task == NULL || !task->registered)
+        return;
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    if (!task->pending)
+    {
+        uint8_t priority = task->priority;
+
+        task->pending = true;
+        task->post_time = HAL_GetTick();
+        sched.queue[priority][sched.head[priority] & QUEUE_MASK] = task;
+        sched.head[priority]++;
+    }
+
+    __set_PRIMASK(primask);
+}
+
+void scheduler_timer_start(scheduler_timer *timer, uint32_t delay, uint32_t period)
+{
+    if (timer == NULL)
+        return;
+
+    if (timer->active)
+    {
+        remove_timer(timer);
+    }
+
+    /* The wheel processes ticks after wheel_tick, an earlier expiry would be missed */
+    if (delay == 0)
+    {
+        delay = 1;
+    }
+
+    timer->expiry = HAL_GetTick() + delay;
+    timer->period = period;
+    insert_timer(timer);
+}
+
+void scheduler_timer_stop(scheduler_timer *timer)
+{
+    if (timer == NULL || !timer->active)
+        return;
+
+    remove_timer(timer);
+}
+
+bool scheduler_timer_is_active(scheduler_timer *timer)
+{
+    if (timer == NULL)
+        return false;
+
+    return timer->active;
+}
+
+void scheduler_run(void)
+{
+    while (1)
+    {
+        advance_wheel();
+
+        scheduler_task *task = next_task();
+
+        if (task != NULL)
+        {
+            uint32_t latency = HAL_GetTick() - task->post_time;
+
+            if (latency > sched.statistics.max_latency)
+            {
+                sched.statistics.max_latency = latency;
+            }
+
+            sched.statistics.runs++;
+            task->function();
+            continue;
+        }
+
+        /* WFI wakes up on a pending interrupt even with interrupts disabled,
+           so an event posted after the check is not lost */
+        __disable_irq();
+
+        if (!has_pending_task() && sched.wheel_tick == HAL_GetTick())
+        {
+            sched.statistics.sleeps++;
+            low_power_sleep(next_expiry());
+        }
+
+        __enable_irq();
+    }
+}
+
+void scheduler_get_statistics(scheduler_statistics *statistics)
+{
+    if (statistics == NULL)
+        return;
+
+    *statistics = sched.statistics;
+}
+
+/**
+ * @brief Take the oldest task of the highest priority class from the queue
+ * @return: Pointer to the task, NULL if the queue is empty
+ */
+static scheduler_task *next_task(void)
+{
+    scheduler_task *task = NULL;
+
+    __disable_irq();
+
+    for (uint8_t priority = 0; priority < SCHEDULER_PRIORITY_COUNT; priority++)
+    {
+        if (sched.head[priority] != sched.tail[priority])
+        {
+            task = sched.queue[priority][sched.tail[priority] & QUEUE_MASK];
+            sched.tail[priority]++;
+
+            /* Posts from now on queue the task again */
+            task->pending = false;
+            break;
+        }
+    }
+
+    __enable_irq();
+
+    return task;
+}
+
+/**
+ * @brief Check if any task is queued, must be called with interrupts disabled
+ * @return: true if a task is queued, false otherwise
+ */
+static bool has_pending_task(void)
+{
+    for (uint8_t priority = 0; priority < SCHEDULER_PRIORITY_COUNT; priority++)
+    {
+        if (sched.head[priority] != sched.tail[priority])
+            return true;
+    }
+
+    return false;
+}
+
+/**
+ * @brief Time to the next timer expiry
+ * @return: Time in ms from the last processed tick, UINT32_MAX without running timers
+ */
+static uint32_t next_expiry(void)
+{
+    uint32_t delay = UINT32_MAX;
+
+    for (uint8_t slot = 0; slot < SCHEDULER_WHEEL_SIZE; slot++)
+    {
+        for (scheduler_timer *timer = sched.wheel[slot]; timer != NULL; timer = timer->next)
+        {
+            uint32_t remaining = timer->expiry - sched.wheel_tick;
+
+            if (remaining < delay)
+            {
+                delay = remaining;
+            }
+        }
+    }
+
+    return delay;
+}
+
+/**
+ * @brief Process every wheel slot up to the current HAL tick
+ */
+static void advance_wheel(void)
+{
+    uint32_t now = HAL_GetTick();
+
+    /* After a long sleep every slot is visited once instead of every elapsed tick */
+    if (now - sched.wheel_tick >= SCHEDULER_WHEEL_SIZE)
+    {
+        for (uint8_t slot = 0; slot < SCHEDULER_WHEEL_SIZE; slot++)
+        {
+            process_slot(slot, now);
+        }
+
+        sched.wheel_tick = now;
+        return;
+    }
+
+    while (sched.wheel_tick != now)
+    {
+        sched.wheel_tick++;
+        process_slot(sched.wheel_tick & WHEEL_MASK, sched.wheel_tick);
+    }
+}
+
+/**
+ * @brief Expire the timers of a wheel slot which are due at a HAL tick
+ * @param slot: Wheel slot index
+ * @param tick: HAL tick, timers expiring at or before it are expired
+ */
+static void process_slot(uint8_t slot, uint32_t tick)
+{
+    scheduler_timer **link = &sched.wheel[slot];
+
+    while (*link != NULL)
+    {
+        scheduler_timer *timer = *link;
+
+        /* Slot also holds timers of later wheel turns */
+        if ((int32_t)(timer->expiry - tick) > 0)
+        {
+            link = &timer->next;
+            continue;
+        }
+
+        *link = timer->next;
+        timer->active = false;
+        scheduler_post(timer->task);
+
+        /* Period is added to the expiry, not to the current tick, so a late
+           task does not move the following expiries */
+        if (timer->period > 0)
+        {
+            /* Periods missed while the wheel was not advanced are skipped */
+            do
+            {
+                timer->expiry += timer->period;
+            } while ((int32_t)(timer->expiry - tick) <= 0);
+
+            insert_timer(timer);
+        }
+    }
+}
+
+/**
+ * @brief Add a timer to the slot of its expiry
+ * @param timer: Pointer to scheduler timer
+ */
+static void insert_timer(scheduler_timer *timer)
+{
+    scheduler_timer **slot = &sched.wheel[timer->expiry & WHEEL_MASK];
+
+    timer->next = *slot;
+    *slot = timer;
+    timer->active = true;
+}
+
+/**
+ * @brief Remove a timer from its wheel slot
+ * @param timer: Pointer to scheduler timer
+ */
+static void remove_timer(scheduler_timer *timer)
+{
+    scheduler_timer **link = &sched.wheel[timer->expiry & WHEEL_MASK];
+
+    while (*link != NULL)
+    {
+        if (*link == timer)
+        {
+            *link = timer->next;
+            break;
+        }
+
+        link = &(*link)->next;
+    }
+
+    timer->next = NULL;
+    timer->active = false;
+}
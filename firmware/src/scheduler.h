@@ -0,0 +1,169 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "stm32g0xx_hal.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Maximum number of tasks in one priority class, power of two
+ */
+#define SCHEDULER_QUEUE_SIZE 8
+
+/**
+ * @brief Number of timer wheel slots, power of two, one slot per ms
+ */
+#define SCHEDULER_WHEEL_SIZE 32
+
+/**
+ * @brief Macro for scheduler task definition
+ * @param name: Task name
+ * @param func: Task function
+ * @param prio: Task priority class
+ */
+#define SCHEDULER_TASK_DEF(name, func, prio) \
+    static scheduler_task name = {           \
+        .function = func,                    \
+        .priority = prio,                    \
+        .registered = false,                 \
+        .pending = false                     \
+    }
+
+/**
+ * @brief Macro for scheduler timer definition
+ * @param name: Timer name
+ * @param target: Pointer to the task posted when the timer expires
+ */
+#define SCHEDULER_TIMER_DEF(name, target) \
+    static scheduler_timer name = {       \
+        .task = target,                   \
+        .active = false,                  \
+        .next = NULL                      \
+    }
+
+/**
+ * @brief Task priority classes, a higher class always runs first
+ */
+typedef enum
+{
+    SCHEDULER_PRIORITY_HIGH,
+    SCHEDULER_PRIORITY_NORMAL,
+    SCHEDULER_PRIORITY_LOW,
+    SCHEDULER_PRIORITY_COUNT
+} scheduler_priority;
+
+/**
+ * @brief Task function, runs to completion in the main loop
+ */
+typedef void (*scheduler_function)(void);
+
+/**
+ * @brief Scheduler task
+ */
+typedef struct
+{
+    const scheduler_function function;    /**< Task function */
+    const scheduler_priority priority;    /**< Task priority class */
+    bool registered;                      /**< Task was registered */
+    volatile bool pending;                /**< Task is queued */
+    uint32_t post_time;                   /**< HAL tick when the task was queued */
+} scheduler_task;
+
+/**
+ * @brief Scheduler timer, posts its task when it expires
+ */
+typedef struct scheduler_timer
+{
+    scheduler_task *const task;       /**< Task posted on expiry */
+    uint32_t expiry;                  /**< HAL tick of the next expiry */
+    uint32_t period;                  /**< Period in ms, 0 for a one-shot timer */
+    bool active;                      /**< Timer is in the wheel */
+    struct scheduler_timer *next;     /**< Next timer in the same wheel slot */
+} scheduler_timer;
+
+/**
+ * @brief Scheduler statistics
+ */
+typedef struct
+{
+    uint32_t runs;           /**< Task runs */
+    uint32_t sleeps;         /**< Idle periods with an empty queue */
+    uint32_t max_latency;    /**< Highest time from post to run in ms */
+} scheduler_statistics;
+
+/**
+ * @brief Scheduler state
+ */
+typedef struct
+{
+    scheduler_task *queue[SCHEDULER_PRIORITY_COUNT][SCHEDULER_QUEUE_SIZE];    /**< Event queue of every priority class */
+    uint8_t head[SCHEDULER_PRIORITY_COUNT];                                  /**< Queue write counters */
+    uint8_t tail[SCHEDULER_PRIORITY_COUNT];                                  /**< Queue read counters */
+    uint8_t task_count[SCHEDULER_PRIORITY_COUNT];                            /**< Registered tasks of every class */
+    scheduler_timer *wheel[SCHEDULER_WHEEL_SIZE];                            /**< Timer lists, indexed by expiry tick */
+    uint32_t wheel_tick;                                                     /**< Last HAL tick processed by the wheel */
+    scheduler_statistics statistics;                                         /**< Scheduler statistics */
+} scheduler;
+
+/**
+ * @brief Initialize the scheduler, must be called before any timer is started
+ */
+void scheduler_init(void);
+
+/**
+ * @brief Register a task, it can be posted afterwards
+ * @param task: Pointer to scheduler task
+ * @return: true if the task was registered, false if its priority class is full
+ */
+bool scheduler_register(scheduler_task *task);
+
+/**
+ * @brief Queue a task, can be called from interrupts
+ * A task already queued is not queued again.
+ * @param task: Pointer to scheduler task
+ */
+void scheduler_post(scheduler_task *task);
+
+/**
+ * @brief Start a timer, a running timer is restarted
+ * Timers must only be used from tasks, not from interrupts.
+ * @param timer: Pointer to scheduler timer
+ * @param delay: Time to the first expiry in ms
+ * @param period: Period in ms, 0 for a one-shot timer
+ */
+void scheduler_timer_start(scheduler_timer *timer, uint32_t delay, uint32_t period);
+
+/**
+ * @brief Stop a timer
+ * @param timer: Pointer to scheduler timer
+ */
+void scheduler_timer_stop(scheduler_timer *timer);
+
+/**
+ * @brief Check if a timer is running
+ * @param timer: Pointer to scheduler timer
+ * @return: true if the timer is running, false otherwise
+ */
+bool scheduler_timer_is_active(scheduler_timer *timer);
+
+/**
+ * @brief Run queued tasks and expired timers, sleep while there is nothing to do
+ * This function never returns.
+ */
+void scheduler_run(void);
+
+/**
+ * @brief Read the scheduler statistics
+ * @param statistics: Pointer to statistics structure
+ */
+void scheduler_get_statistics(scheduler_statistics *statistics);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SCHEDULER_H */
@@ -1,5 +1,15 @@
 #include "main.h"
 
+/**
+ * DMA handles
+ * - DMA1 Channel 1: USART1 RX, circular (DMA1_Channel1_IRQHandler)
+ * - DMA1 Channel 2: USART2 TX, normal (DMA1_Channel2_3_IRQHandler)
+ * - DMA1 Channel 3: USART1 TX, normal (DMA1_Channel2_3_IRQHandler)
+ */
+extern DMA_HandleTypeDef hdma_usart1_rx;
+extern DMA_HandleTypeDef hdma_usart1_tx;
+extern DMA_HandleTypeDef hdma_usart2_tx;
+
 /**
  * Initializes the Global MSP.
  */
@@ -85,6 +95,12 @@ void HAL_I2C_MspDeInit(I2C_HandleTypeDef* hi2c)
  *   PA2 - USART2_TX
  *   PA3 - USART2_RX
  *
+ * USART1 DMA Configuration
+ *   DMA1 channel 1 - USART1_RX, circular mode
+ *
+ * USART2 DMA Configuration
+ *   DMA1 channel 2 - USART2_TX, normal mode
+ *
  * @param huart: UART handle pointer
  */
 void HAL_UART_MspInit(UART_HandleTypeDef* huart)
@@ -104,6 +120,41 @@ void HAL_UART_MspInit(UART_HandleTypeDef* huart)
         GPIO_InitStruct.Alternate = GPIO_AF1_USART1;
         HAL_GPIO_Init(GPIOC, &GPIO_InitStruct);
 
+        /* USART1 DMA Init */
+        hdma_usart1_rx.Instance = DMA1_Channel1;
+        hdma_usart1_rx.Init.Request = DMA_REQUEST_USART1_RX;
+        hdma_usart1_rx.Init.Direction = DMA_PERIPH_TO_MEMORY;
+        hdma_usart1_rx.Init.PeriphInc = DMA_PINC_DISABLE;
+        hdma_usart1_rx.Init.MemInc = DMA_MINC_ENABLE;
+        hdma_usart1_rx.Init.PeriphDataAlignment = DMA_PDATAALIGN_BYTE;
+        hdma_usart1_rx.Init.MemDataAlignment = DMA_MDATAALIGN_BYTE;
+        hdma_usart1_rx.Init.Mode = DMA_CIRCULAR;
+        hdma_usart1_rx.Init.Priority = DMA_PRIORITY_HIGH;
+
+        if (HAL_DMA_Init(&hdma_usart1_rx) != HAL_OK)
+        {
+            Error_Handler();
+        }
+
+        __HAL_LINKDMA(huart, hdmarx, hdma_usart1_rx);
+
+        hdma_usart1_tx.Instance = DMA1_Channel3;
+        hdma_usart1_tx.Init.Request = DMA_REQUEST_USART1_TX;
+        hdma_usart1_tx.Init.Direction = DMA_MEMORY_TO_PERIPH;
+        hdma_usart1_tx.Init.PeriphInc = DMA_PINC_DISABLE;
+        hdma_usart1_tx.Init.MemInc = DMA_MINC_ENABLE;
+        hdma_usart1_tx.Init.PeriphDataAlignment = DMA_PDATAALIGN_BYTE;
+        hdma_usart1_tx.Init.MemDataAlignment = DMA_MDATAALIGN_BYTE;
+        hdma_usart1_tx.Init.Mode = DMA_NORMAL;
+        hdma_usart1_tx.Init.Priority = DMA_PRIORITY_MEDIUM;
+
+        if (HAL_DMA_Init(&hdma_usart1_tx) != HAL_OK)
+        {
+            Error_Handler();
+        }
+
+        __HAL_LINKDMA(huart, hdmatx, hdma_usart1_tx);
+
         /* USART1 interrupt Init */
         HAL_NVIC_SetPriority(USART1_IRQn, 0, 0);
         HAL_NVIC_EnableIRQ(USART1_IRQn);
@@ -121,6 +172,24 @@ void HAL_UART_MspInit(UART_HandleTypeDef* huart)
         GPIO_InitStruct.Alternate = GPIO_AF1_USART2;
         HAL_GPIO_Init(GPIOA, &GPIO_InitStruct);
 
+        /* USART2 DMA Init */
+        hdma_usart2_tx.Instance = DMA1_Channel2;
+        hdma_usart2_tx.Init.Request = DMA_REQUEST_USART2_TX;
+        hdma_usart2_tx.Init.Direction = DMA_MEMORY_TO_PERIPH;
+        hdma_usart2_tx.Init.PeriphInc = DMA_PINC_DISABLE;
+        hdma_usart2_tx.Init.MemInc = DMA_MINC_ENABLE;
+        hdma_usart2_tx.Init.PeriphDataAlignment = DMA_PDATAALIGN_BYTE;
+        hdma_usart2_tx.Init.MemDataAlignment = DMA_MDATAALIGN_BYTE;
+        hdma_usart2_tx.Init.Mode = DMA_NORMAL;
+        hdma_usart2_tx.Init.Priority = DMA_PRIORITY_LOW;
+
+        if (HAL_DMA_Init(&hdma_usart2_tx) != HAL_OK)
+        {
+            Error_Handler();
+        }
+
+        __HAL_LINKDMA(huart, hdmatx, hdma_usart2_tx);
+
         /* USART2 interrupt Init */
         HAL_NVIC_SetPriority(USART2_IRQn, 0, 0);
         HAL_NVIC_EnableIRQ(USART2_IRQn);
@@ -151,6 +220,10 @@ void HAL_UART_MspDeInit(UART_HandleTypeDef* huart)
 
         HAL_GPIO_DeInit(GPIOC, GPIO_PIN_4 | GPIO_PIN_5);
 
+        /* USART1 DMA DeInit */
+        HAL_DMA_DeInit(huart->hdmarx);
+        HAL_DMA_DeInit(huart->hdmatx);
+
         /* USART1 interrupt DeInit */
         HAL_NVIC_DisableIRQ(USART1_IRQn);
     }
@@ -161,6 +234,9 @@ void HAL_UART_MspDeInit(UART_HandleTypeDef* huart)
 
         HAL_GPIO_DeInit(GPIOA, GPIO_PIN_2 | GPIO_PIN_3);
 
+        /* USART2 DMA DeInit */
+        HAL_DMA_DeInit(huart->hdmatx);
+
         /* USART2 interrupt DeInit */
         HAL_NVIC_DisableIRQ(USART2_IRQn);
     }
@@ -1,8 +1,16 @@
 #include "main.h"
 #include "wifi.h"
 #include "pc_uart.h"
+#include "i2c_bus.h"
+#include "low_power.h"
+#include "ccs811.h"
 #include "stm32g0xx_it.h"
 
+/**
+ * Sensors
+ */
+extern ccs811_device ccs811_dev;
+
 /**
  * I2C handles
  */
@@ -14,6 +22,13 @@ extern I2C_HandleTypeDef hi2c1;
 extern UART_HandleTypeDef huart1;
 extern UART_HandleTypeDef huart2;
 
+/**
+ * DMA Handles
+ */
+extern DMA_HandleTypeDef hdma_usart1_rx;
+extern DMA_HandleTypeDef hdma_usart1_tx;
+extern DMA_HandleTypeDef hdma_usart2_tx;
+
 /**
  * @brief This function handles Non maskable interrupt.
  */
@@ -64,6 +79,40 @@ void SysTick_Handler(void)
  * please refer to the startup file (startup_stm32g0xx.s).
  */
 
+/**
+ * @brief This function handles DMA1 channel 1 interrupt.
+ */
+void DMA1_Channel1_IRQHandler(void)
+{
+    HAL_DMA_IRQHandler(&hdma_usart1_rx);
+}
+
+/**
+ * @brief This function handles DMA1 channel 2 and 3 interrupts.
+ */
+void DMA1_Channel2_3_IRQHandler(void)
+{
+    HAL_DMA_IRQHandler(&hdma_usart2_tx);
+    HAL_DMA_IRQHandler(&hdma_usart1_tx);
+}
+
+/**
+ * @brief This function handles EXTI line 4 to 15 interrupts
+ */
+void EXTI4_15_IRQHandler(void)
+{
+    HAL_GPIO_EXTI_IRQHandler(CCS811_INT_Pin);
+}
+
+/**
+ * @brief This function handles TIM6, DAC and LPTIM1 global interrupts
+ *        LPTIM1 wake-up interrupt through EXTI line 29.
+ */
+void TIM6_DAC_LPTIM1_IRQHandler(void)
+{
+    low_power_timer_irq_handler();
+}
+
 /**
  * @brief This function handles I2C1 event global interrupt
  *        I2C1 wake-up interrupt through EXTI line 23.
@@ -104,6 +153,83 @@ void USART2_IRQHandler(void)
  */
 void HAL_UART_RxCpltCallback(UART_HandleTypeDef *huart)
 {
-    wifi_rx_callback(huart);
     pc_uart_rx_callback(huart);
 }
+
+/**
+ * @brief Tx Transfer completed callback
+ * @param huart: UART handle that finished the transmission
+ */
+void HAL_UART_TxCpltCallback(UART_HandleTypeDef *huart)
+{
+    wifi_tx_callback(huart);
+    pc_uart_tx_callback(huart);
+}
+
+/**
+ * @brief Rx event callback, used by DMA reception with idle line detection
+ * @param huart: UART handle that received data
+ * @param size: Position in the reception buffer
+ */
+void HAL_UARTEx_RxEventCallback(UART_HandleTypeDef *huart, uint16_t size)
+{
+    wifi_rx_event_callback(huart, size);
+}
+
+/**
+ * @brief UART error callback
+ * @param huart: UART handle that reported the error
+ */
+void HAL_UART_ErrorCallback(UART_HandleTypeDef *huart)
+{
+    wifi_error_callback(huart);
+    pc_uart_error_callback(huart);
+}
+
+/**
+ * @brief I2C memory rx transfer completed callback
+ * @param hi2c: I2C handle that finished the transfer
+ */
+void HAL_I2C_MemRxCpltCallback(I2C_HandleTypeDef *hi2c)
+{
+    i2c_bus_transfer_callback(hi2c, true);
+}
+
+/**
+ * @brief I2C memory tx transfer completed callback
+ * @param hi2c: I2C handle that finished the transfer
+ */
+void HAL_I2C_MemTxCpltCallback(I2C_HandleTypeDef *hi2c)
+{
+    i2c_bus_transfer_callback(hi2c, true);
+}
+
+/**
+ * @brief I2C master tx transfer completed callback
+ * @param hi2c: I2C handle that finished the transfer
+ */
+void HAL_I2C_MasterTxCpltCallback(I2C_HandleTypeDef *hi2c)
+{
+    i2c_bus_transfer_callback(hi2c, true);
+}
+
+/**
+ * @brief I2C error callback
+ * @param hi2c: I2C handle that reported the error
+ */
+void HAL_I2C_ErrorCallback(I2C_HandleTypeDef *hi2c)
+{
+    i2c_bus_transfer_callback(hi2c, false);
+}
+
+/**
+ * @brief EXTI falling edge callback
+ * @param GPIO_Pin: Pin that generated the interrupt
+ */
+void HAL_GPIO_EXTI_Falling_Callback(uint16_t GPIO_Pin)
+{
+    if (GPIO_Pin == CCS811_INT_Pin)
+    {
+        ccs811_interrupt_callback(&ccs811_dev);
+    }
+}
@@ -13,6 +13,8 @@ void HardFault_Handler(void);
 void SVC_Handler(void);
 void PendSV_Handler(void);
 void SysTick_Handler(void);
+void DMA1_Channel1_IRQHandler(void);
+void DMA1_Channel2_3_IRQHandler(void);
 void I2C1_IRQHandler(void);
 void USART1_IRQHandler(void);
 void USART2_IRQHandler(void);
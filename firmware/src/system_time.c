@@ -0,0 +1,153 @@
+#include <stddef.h>
+#include <string.h>
+#include "system_time.h"
+
+/**
+ * @brief SNTP response prefix
+ */
+#define SNTP_PREFIX        "+CIPSNTPTIME:"
+#define SNTP_PREFIX_LENGTH (sizeof(SNTP_PREFIX) - 1)
+
+/**
+ * @brief Oldest accepted year, the chip reports 1970 when it is not synchronized
+ */
+#define SYSTEM_TIME_MIN_YEAR 2020
+
+/**
+ * @brief System wall clock
+ */
+static system_time wall_clock;
+
+/* System time private functions */
+static bool parse_number(const char **text, uint16_t *value);
+static int8_t parse_month(const char *text);
+static uint32_t days_from_civil(uint16_t year, uint8_t month, uint8_t day);
+
+bool system_time_set_sntp(const char *response)
+{
+    if (response == NULL || strncmp(response, SNTP_PREFIX, SNTP_PREFIX_LENGTH) != 0)
+        return false;
+
+    if (strlen(response) < SNTP_PREFIX_LENGTH + 24)
+        return false;
+
+    /* Skip the day of week */
+    const char *text = response + SNTP_PREFIX_LENGTH + 4;
+
+    int8_t month = parse_month(text);
+    if (month < 0)
+        return false;
+
+    text += 4;
+
+    uint16_t day = 0;
+    uint16_t hour = 0;
+    uint16_t minute = 0;
+    uint16_t second = 0;
+    uint16_t year = 0;
+
+    while (*text == ' ')
+        text++;
+
+    if (!parse_number(&text, &day) || *text++ != ' '
+        || !parse_number(&text, &hour) || *text++ != ':'
+        || !parse_number(&text, &minute) || *text++ != ':'
+        || !parse_number(&text, &second) || *text++ != ' '
+        || !parse_number(&text, &year))
+        return false;
+
+    if (year < SYSTEM_TIME_MIN_YEAR || day == 0 || day > 31
+        || hour > 23 || minute > 59 || second > 60)
+        return false;
+
+    uint32_t seconds = days_from_civil(year, month + 1, day) * 86400UL
+            + hour * 3600UL + minute * 60UL + second;
+
+    wall_clock.reference_tick = HAL_GetTick();
+    wall_clock.reference_ms = (uint64_t)seconds * 1000;
+    wall_clock.valid = true;
+
+    return true;
+}
+
+bool system_time_is_valid(void)
+{
+    return wall_clock.valid;
+}
+
+uint64_t system_time_from_tick(uint32_t tick)
+{
+    if (!wall_clock.valid)
+        return 0;
+
+    /* Signed difference, the tick can be older than the reference */
+    int32_t offset = (int32_t)(tick - wall_clock.reference_tick);
+
+    return wall_clock.reference_ms + offset;
+}
+
+/**
+ * @brief Parse a decimal number
+ * @param text: Pointer to the text position, advanced past the number
+ * @param value: Parsed value
+ * @return: true if at least one digit was parsed, false otherwise
+ */
+static bool parse_number(const char **text, uint16_t *value)
+{
+    const char *position = *text;
+    uint16_t result = 0;
+
+    while (*position >= '0' && *position <= '9')
+    {
+        result = result * 10 + (*position - '0');
+        position++;
+    }
+
+    if (position == *text)
+        return false;
+
+    *text = position;
+    *value = result;
+    return true;
+}
+
+/**
+ * @brief Parse a three letter month name
+ * @param text: Month name
+ * @return: Month index from 0 to 11, -1 if the name is not valid
+ */
+static int8_t parse_month(const char *text)
+{
+    static const char months[] = "JanFebMarAprMayJunJulAugSepOctNovDec";
+
+    for (int8_t index = 0; index < 12; index++)
+    {
+        if (strncmp(text, &months[index * 3], 3) == 0)
+            return index;
+    }
+
+    return -1;
+}
+
+/**
+ * @brief Number of days since 1970-01-01
+ * @param year: Year, from 1970
+ * @param month: Month from 1 to 12
+ * @param day: Day of month from 1 to 31
+ * @return: Number of days
+ */
+static uint32_t days_from_civil(uint16_t year, uint8_t month, uint8_t day)
+{
+    /* Years start in March so the leap day is the last day of the year */
+    if (month <= 2)
+    {
+        year--;
+    }
+
+    uint32_t era = year / 400;
+    uint32_t year_of_era = year - era * 400;
+    uint32_t day_of_year = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    uint32_t day_of_era = year_of_era * 365 + year_of_era / 4 - year_of_era / 100 + day_of_year;
+
+    return era * 146097 + day_of_era - 719468;
+}
@@ -0,0 +1,54 @@
+#ifndef SYSTEM_TIME_H
+#define SYSTEM_TIME_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "stm32g0xx_hal.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Wall clock, kept as the Unix time of a HAL tick reference
+ *
+ * The clock is set from the SNTP time reported by the WiFi chip and
+ * advanced with HAL_GetTick, it should be synchronized again before the
+ * tick counter wraps around after 49 days.
+ */
+typedef struct
+{
+    bool valid;                 /**< Time was synchronized at least once */
+    uint64_t reference_ms;      /**< Unix time in ms at the reference tick */
+    uint32_t reference_tick;    /**< HAL tick of the last synchronization */
+} system_time;
+
+/**
+ * @brief Set the time from the response of AT+CIPSNTPTIME?
+ *
+ * The response looks like "+CIPSNTPTIME:Thu Aug 04 14:48:05 2016", the
+ * chip reports 1970 until the SNTP server answered.
+ *
+ * @param response: Null terminated response line
+ * @return: true if the time was set, false if the response is not a valid time
+ */
+bool system_time_set_sntp(const char *response);
+
+/**
+ * @brief Check if the time was synchronized
+ * @return: true if the time is valid, false otherwise
+ */
+bool system_time_is_valid(void);
+
+/**
+ * @brief Convert a HAL tick to Unix time
+ * @param tick: HAL tick, must not be older than 49 days
+ * @return: Unix time in ms, 0 if the time is not valid
+ */
+uint64_t system_time_from_tick(uint32_t tick);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SYSTEM_TIME_H */
@@ -0,0 +1,594 @@
+#include <string.h>
+#include "telemetry.h"
+#include "config_store.h"
+#include "system_time.h"
+#include "publish_policy.h"
+#include "acquisition.h"
+#include "filter.h"
+#include "format.h"
+
+/**
+ * @brief Layout version of the stored configuration
+ */
+#define CONFIG_VERSION 1
+
+/**
+ * @brief Telemetry keys and decimals of the aggregate channels, indexed by publish_channel
+ */
+static const char *const channel_names[PUBLISH_CHANNEL_COUNT] = {
+    "temperature", "humidity", "pressure", "tvoc", "eco2"
+};
+static const uint8_t channel_decimals[PUBLISH_CHANNEL_COUNT] = { 2, 2, 2, 0, 0 };
+
+/**
+ * @brief Telemetry batching state
+ */
+static telemetry telemetry_dev;
+
+/* Telemetry private functions */
+static void convert_sample(const bme280_measurements *environmental_data,
+        const ccs811_measurements *air_quality, telemetry_sample *sample);
+static void sample_values(const telemetry_sample *sample, int32_t values[PUBLISH_CHANNEL_COUNT]);
+static void set_sample_values(telemetry_sample *sample, const int32_t values[PUBLISH_CHANNEL_COUNT]);
+static void add_sample(const telemetry_sample *sample);
+static bool store_oldest_sample(void);
+static uint16_t format_values(char *buffer, const telemetry_sample *sample);
+static int format_sample(char *buffer, uint16_t size, uint64_t timestamp,
+        const telemetry_sample *sample);
+static bool append_sample(char *buffer, uint16_t size, uint16_t *length, uint64_t timestamp,
+        const telemetry_sample *sample);
+static uint16_t format_aggregates(char *buffer, uint16_t size, uint16_t length);
+static uint16_t format_window(char *buffer, const aggregate_record *record);
+
+void telemetry_init(void)
+{
+    memset(&telemetry_dev, 0, sizeof(telemetry_dev));
+    telemetry_dev.configuration.batch_size = TELEMETRY_DEFAULT_BATCH_SIZE;
+    telemetry_dev.configuration.max_age = TELEMETRY_DEFAULT_MAX_AGE;
+
+    aggregate_init();
+
+    telemetry_config stored;
+
+    if (config_store_read(CONFIG_KEY_TELEMETRY, CONFIG_VERSION, &stored, sizeof(stored)))
+    {
+        telemetry_set_configuration(&stored);
+    }
+}
+
+bool telemetry_set_configuration(const telemetry_config *config)
+{
+    if (config == NULL)
+        return false;
+
+    if (config->batch_size == 0 || config->batch_size > TELEMETRY_MAX_BATCH_SIZE
+        || config->max_age == 0 || config->aggregate_period > AGGREGATE_MAX_PERIOD)
+        return false;
+
+    /* A new period discards the open window */
+    if (config->aggregate_period != aggregate_get_period())
+    {
+        aggregate_set_period(config->aggregate_period);
+    }
+
+    /* Used right away, even if it can not be saved */
+    telemetry_dev.configuration = *config;
+
+    return config_store_write(CONFIG_KEY_TELEMETRY, CONFIG_VERSION,
+            &telemetry_dev.configuration, sizeof(telemetry_dev.configuration));
+}
+
+void telemetry_get_configuration(telemetry_config *config)
+{
+    if (config == NULL)
+        return;
+
+    *config = telemetry_dev.configuration;
+}
+
+void telemetry_handler(const bme280_measurements *environmental_data,
+        const ccs811_measurements *air_quality)
+{
+    if (environmental_data == NULL || air_quality == NULL)
+        return;
+
+    telemetry_sample sample;
+    int32_t values[PUBLISH_CHANNEL_COUNT];
+
+    convert_sample(environmental_data, air_quality, &sample);
+    sample_values(&sample, values);
+
+    /* Spikes are removed before they reach the publish policy or a window */
+    filter_apply(values);
+    set_sample_values(&sample, values);
+
+    /* Windows summarize every sample, the publish policy does not apply */
+    if (aggregate_get_period() != 0)
+    {
+        aggregate_add(values, sample.tick);
+        return;
+    }
+
+    if (!publish_policy_evaluate(values, sample.tick))
+        return;
+
+    add_sample(&sample);
+}
+
+bool telemetry_batch_ready(void)
+{
+    uint16_t pending = telemetry_pending();
+
+    /* A closed window already covers a whole period, it is sent right away */
+    aggregate_update(HAL_GetTick());
+
+    /* Samples and windows are held until they can be sent with their own timestamp */
+    if (!system_time_is_valid())
+        return false;
+
+    /* Replay stored samples with a limited rate, they are sent before new ones */
+    if (journal_pending() > 0)
+        return (HAL_GetTick() - telemetry_dev.last_replay >= TELEMETRY_REPLAY_INTERVAL);
+
+    if (aggregate_pending() > 0)
+        return true;
+
+    if (pending == 0)
+        return false;
+
+    if (pending >= telemetry_dev.configuration.batch_size)
+        return true;
+
+    const telemetry_sample *oldest =
+            &telemetry_dev.samples[telemetry_dev.tail % TELEMETRY_BUFFER_SIZE];
+
+    return (HAL_GetTick() - oldest->tick >= telemetry_dev.configuration.max_age * 1000UL);
+}
+
+uint16_t telemetry_format(char *buffer, uint16_t size)
+{
+    uint16_t pending = telemetry_pending();
+
+    telemetry_dev.in_flight = 0;
+    telemetry_dev.replaying = false;
+    telemetry_dev.aggregating = false;
+
+    if (buffer == NULL || size < 3)
+        return 0;
+
+    /* Buffered ticks are converted back once the time is known, nothing is sent before */
+    if (!system_time_is_valid())
+        return 0;
+
+    uint16_t length = 1;
+    buffer[0] = '[';
+
+    if (journal_pending() > 0)
+    {
+        journal_iterator iterator;
+        journal_begin(&iterator);
+
+        while (telemetry_dev.in_flight < TELEMETRY_MAX_BATCH_SIZE)
+        {
+            journal_iterator next = iterator;
+            journal_sample stored;
+
+            if (!journal_read(&next, &stored))
+            {
+                /* Unreadable samples at the end of the journal are skipped */
+                iterator = next;
+                break;
+            }
+
+            telemetry_sample sample = {
+                .temperature = stored.temperature,
+                .humidity = stored.humidity,
+                .pressure = stored.pressure,
+                .tvoc = stored.tvoc,
+                .eco2 = stored.eco2
+            };
+
+            /* Samples stored before the first synchronization are dated from their tick */
+            uint64_t timestamp = (stored.time_base == JOURNAL_TIME_UPTIME)
+                    ? system_time_from_tick(stored.timestamp * 1000UL)
+                    : (uint64_t)stored.timestamp * 1000;
+
+            if (!append_sample(buffer, size, &length, timestamp, &sample))
+                break;
+
+            iterator = next;
+        }
+
+        if (telemetry_dev.in_flight > 0)
+        {
+            telemetry_dev.replaying = true;
+            telemetry_dev.replay = iterator;
+
+            buffer[length++] = ']';
+            buffer[length] = '\0';
+
+            return length;
+        }
+
+        journal_acknowledge(&iterator);
+    }
+
+    if (aggregate_pending() > 0)
+        return format_aggregates(buffer, size, length);
+
+    while (telemetry_dev.in_flight < pending
+           && telemetry_dev.in_flight < TELEMETRY_MAX_BATCH_SIZE)
+    {
+        const telemetry_sample *sample = &telemetry_dev.samples[
+                (telemetry_dev.tail + telemetry_dev.in_flight) % TELEMETRY_BUFFER_SIZE];
+
+        if (!append_sample(buffer, size, &length, system_time_from_tick(sample->tick), sample))
+            break;
+    }
+
+    if (telemetry_dev.in_flight == 0)
+        return 0;
+
+    buffer[length++] = ']';
+    buffer[length] = '\0';
+
+    return length;
+}
+
+void telemetry_release(void)
+{
+    if (telemetry_dev.in_flight == 0)
+        return;
+
+    if (telemetry_dev.replaying)
+    {
+        journal_acknowledge(&telemetry_dev.replay);
+        telemetry_dev.last_replay = HAL_GetTick();
+        telemetry_dev.replaying = false;
+    }
+    else if (telemetry_dev.aggregating)
+    {
+        aggregate_statistics aggregates;
+        aggregate_get_statistics(&aggregates);
+
+        /* Windows dropped on a full queue were part of the batch being sent */
+        uint32_t dropped = aggregates.dropped - telemetry_dev.aggregate_dropped;
+        aggregate_release((dropped < telemetry_dev.in_flight) ? telemetry_dev.in_flight - dropped : 0);
+    }
+    else
+    {
+        telemetry_dev.tail += telemetry_dev.in_flight;
+    }
+
+    if (telemetry_dev.aggregating)
+    {
+        telemetry_dev.statistics.windows_sent += telemetry_dev.in_flight;
+    }
+    else
+    {
+        telemetry_dev.statistics.samples_sent += telemetry_dev.in_flight;
+    }
+
+    telemetry_dev.statistics.batches_sent++;
+    telemetry_dev.in_flight = 0;
+    telemetry_dev.aggregating = false;
+}
+
+uint16_t telemetry_pending(void)
+{
+    return (uint16_t)(telemetry_dev.head - telemetry_dev.tail);
+}
+
+void telemetry_get_statistics(telemetry_statistics *statistics)
+{
+    if (statistics == NULL)
+        return;
+
+    *statistics = telemetry_dev.statistics;
+}
+
+/**
+ * @brief Convert measurements to a sample in integer units
+ * @param environmental_data: Measurements of the BME280
+ * @param air_quality: Measurements of the CCS811
+ * @param sample: Converted sample
+ */
+static void convert_sample(const bme280_measurements *environmental_data,
+        const ccs811_measurements *air_quality, telemetry_sample *sample)
+{
+    sample->tick = HAL_GetTick();
+    sample->temperature = (int16_t)environmental_data->temperature;
+    sample->humidity = (uint16_t)((environmental_data->humidity + 5) / 10);
+    sample->pressure = environmental_data->pressure;
+    sample->tvoc = air_quality->tvoc;
+    sample->eco2 = air_quality->eco2;
+    sample->interval = (uint8_t)(acquisition_get_interval() / 1000);
+}
+
+/**
+ * @brief Read the channel values of a sample
+ * @param sample: Telemetry sample
+ * @param values: Sample values indexed by publish_channel
+ */
+static void sample_values(const telemetry_sample *sample, int32_t values[PUBLISH_CHANNEL_COUNT])
+{
+    values[PUBLISH_CHANNEL_TEMPERATURE] = sample->temperature;
+    values[PUBLISH_CHANNEL_HUMIDITY] = sample->humidity;
+    values[PUBLISH_CHANNEL_PRESSURE] = (int32_t)sample->pressure;
+    values[PUBLISH_CHANNEL_TVOC] = sample->tvoc;
+    values[PUBLISH_CHANNEL_ECO2] = sample->eco2;
+}
+
+/**
+ * @brief Write channel values to a sample
+ * @param sample: Telemetry sample
+ * @param values: Sample values indexed by publish_channel, in the range of the sample fields
+ */
+static void set_sample_values(telemetry_sample *sample, const int32_t values[PUBLISH_CHANNEL_COUNT])
+{
+    sample->temperature = (int16_t)values[PUBLISH_CHANNEL_TEMPERATURE];
+    sample->humidity = (uint16_t)values[PUBLISH_CHANNEL_HUMIDITY];
+    sample->pressure = (uint32_t)values[PUBLISH_CHANNEL_PRESSURE];
+    sample->tvoc = (uint16_t)values[PUBLISH_CHANNEL_TVOC];
+    sample->eco2 = (uint16_t)values[PUBLISH_CHANNEL_ECO2];
+}
+
+/**
+ * @brief Store a sample, the oldest sample is moved to the journal on a full buffer
+ * @param sample: Telemetry sample
+ */
+static void add_sample(const telemetry_sample *sample)
+{
+    if (telemetry_pending() >= TELEMETRY_BUFFER_SIZE)
+    {
+        if (store_oldest_sample())
+        {
+            telemetry_dev.statistics.samples_journaled++;
+        }
+        else
+        {
+            telemetry_dev.statistics.samples_dropped++;
+        }
+
+        telemetry_dev.tail++;
+
+        /* The removed sample was part of the batch being sent */
+        if (!telemetry_dev.replaying && !telemetry_dev.aggregating && telemetry_dev.in_flight > 0)
+        {
+            telemetry_dev.in_flight--;
+        }
+    }
+
+    telemetry_dev.samples[telemetry_dev.head % TELEMETRY_BUFFER_SIZE] = *sample;
+    telemetry_dev.head++;
+    telemetry_dev.statistics.samples_added++;
+}
+
+/**
+ * @brief Append the oldest buffered sample to the flash journal
+ *
+ * Samples taken before the time was synchronized are stored with their tick
+ * and converted to Unix time when they are replayed.
+ *
+ * @return: True if the sample was stored, false otherwise
+ */
+static bool store_oldest_sample(void)
+{
+    const telemetry_sample *oldest = &telemetry_dev.samples[telemetry_dev.tail % TELEMETRY_BUFFER_SIZE];
+    journal_sample sample = {
+        .timestamp = oldest->tick / 1000,
+        .time_base = JOURNAL_TIME_UPTIME,
+        .temperature = oldest->temperature,
+        .humidity = oldest->humidity,
+        .pressure = oldest->pressure,
+        .tvoc = oldest->tvoc,
+        .eco2 = oldest->eco2
+    };
+
+    if (system_time_is_valid())
+    {
+        sample.timestamp = (uint32_t)(system_time_from_tick(oldest->tick) / 1000);
+        sample.time_base = JOURNAL_TIME_UNIX;
+    }
+
+    return journal_append(&sample);
+}
+
+/**
+ * @brief Format the values of a sample as a JSON object, without terminating null character
+ * @param buffer: Output buffer of at least TELEMETRY_VALUES_MAX_LENGTH bytes
+ * @param sample: Telemetry sample
+ * @return: Length of the formatted text
+ */
+static uint16_t format_values(char *buffer, const telemetry_sample *sample)
+{
+    char *text = buffer;
+
+    text += format_text(text, "{\"temperature\":");
+    text += format_fixed(text, sample->temperature, 2);
+    text += format_text(text, ",\"humidity\":");
+    text += format_fixed(text, sample->humidity, 2);
+
+    /* Pressure is sent in hPa */
+    text += format_text(text, ",\"pressure\":");
+    text += format_fixed(text, (int32_t)sample->pressure, 2);
+    text += format_text(text, ",\"tvoc\":");
+    text += format_uint(text, sample->tvoc, 1);
+    text += format_text(text, ",\"eco2\":");
+    text += format_uint(text, sample->eco2, 1);
+
+    /* Samples replayed from the journal do not know their interval */
+    if (sample->interval != 0)
+    {
+        text += format_text(text, ",\"interval\":");
+        text += format_uint(text, sample->interval, 1);
+    }
+
+    *text++ = '}';
+
+    return (uint16_t)(text - buffer);
+}
+
+/**
+ * @brief Format a sample as a ThingsBoard object with timestamp
+ * @param buffer: Output buffer
+ * @param size: Output buffer size
+ * @param timestamp: Unix time of the sample in ms
+ * @param sample: Telemetry sample
+ * @return: Length of the formatted text, like snprintf
+ */
+static int format_sample(char *buffer, uint16_t size, uint64_t timestamp,
+        const telemetry_sample *sample)
+{
+    char sample_text[TELEMETRY_SAMPLE_MAX_LENGTH];
+    char *text = sample_text;
+
+    /* Split the timestamp, 32-bit digits are much cheaper */
+    text += format_text(text, "{\"ts\":");
+    text += format_uint(text, (uint32_t)(timestamp / 1000), 1);
+    text += format_uint(text, (uint32_t)(timestamp % 1000), 3);
+    text += format_text(text, ",\"values\":");
+    text += format_values(text, sample);
+    *text++ = '}';
+
+    uint16_t length = (uint16_t)(text - sample_text);
+    if (length >= size)
+        return length;
+
+    memcpy(buffer, sample_text, length);
+    buffer[length] = '\0';
+
+    return length;
+}
+
+/**
+ * @brief Append a sample to the telemetry array of the batch being formatted
+ * @param buffer: Output buffer
+ * @param size: Output buffer size
+ * @param length: Length of the array text, updated on success
+ * @param timestamp: Unix time of the sample in ms
+ * @param sample: Telemetry sample
+ * @return: True if the sample was added, false if it does not fit
+ */
+static bool append_sample(char *buffer, uint16_t size, uint16_t *length, uint64_t timestamp,
+        const telemetry_sample *sample)
+{
+    uint16_t separator = (telemetry_dev.in_flight > 0) ? 1 : 0;
+
+    /* Keep room for the separator and the closing bracket */
+    if (*length + separator + 1 >= size)
+        return false;
+
+    int count = format_sample(&buffer[*length + separator],
+            size - *length - separator - 1, timestamp, sample);
+    if (count < 0 || count >= size - *length - separator - 1)
+        return false;
+
+    if (separator)
+    {
+        buffer[*length] = ',';
+    }
+
+    *length += separator + count;
+    telemetry_dev.in_flight++;
+
+    return true;
+}
+
+/**
+ * @brief Format the closed aggregate windows as a ThingsBoard telemetry array, the time must be valid
+ * @param buffer: Output buffer, holding the opening bracket
+ * @param size: Output buffer size
+ * @param length: Length of the text in the buffer
+ * @return: Length of the JSON text, 0 if there is nothing to send
+ */
+static uint16_t format_aggregates(char *buffer, uint16_t size, uint16_t length)
+{
+    uint8_t pending = aggregate_pending();
+    aggregate_statistics aggregates;
+    aggregate_get_statistics(&aggregates);
+
+    while (telemetry_dev.in_flight < pending)
+    {
+        const aggregate_record *record = aggregate_peek(telemetry_dev.in_flight);
+        uint16_t separator = (telemetry_dev.in_flight > 0) ? 1 : 0;
+        uint64_t timestamp = system_time_from_tick(record->start_tick);
+
+        /* Keep room for the separator and the closing bracket */
+        if (size - length - separator - 1 < TELEMETRY_AGGREGATE_MAX_LENGTH)
+            break;
+
+        char *text = &buffer[length];
+
+        if (separator)
+        {
+            *text++ = ',';
+        }
+
+        text += format_text(text, "{\"ts\":");
+        text += format_uint(text, (uint32_t)(timestamp / 1000), 1);
+        text += format_uint(text, (uint32_t)(timestamp % 1000), 3);
+        text += format_text(text, ",\"values\":");
+        text += format_window(text, record);
+        *text++ = '}';
+
+        length = (uint16_t)(text - buffer);
+        telemetry_dev.in_flight++;
+    }
+
+    if (telemetry_dev.in_flight == 0)
+        return 0;
+
+    telemetry_dev.aggregating = true;
+    telemetry_dev.aggregate_dropped = aggregates.dropped;
+
+    buffer[length++] = ']';
+    buffer[length] = '\0';
+
+    return length;
+}
+
+/**
+ * @brief Format the statistics of a window as a JSON object, without terminating null character
+ * @param buffer: Output buffer of at least TELEMETRY_AGGREGATE_MAX_LENGTH bytes
+ * @param record: Closed window
+ * @return: Length of the formatted text
+ */
+static uint16_t format_window(char *buffer, const aggregate_record *record)
+{
+    char *text = buffer;
+
+    *text++ = '{';
+
+    for (uint8_t channel = 0; channel < PUBLISH_CHANNEL_COUNT; channel++)
+    {
+        const aggregate_channel *statistics = &record->channels[channel];
+        uint8_t decimals = channel_decimals[channel];
+
+        text += format_text(text, "\"");
+        text += format_text(text, channel_names[channel]);
+        text += format_text(text, "_min\":");
+        text += format_fixed(text, statistics->min, decimals);
+        text += format_text(text, ",\"");
+        text += format_text(text, channel_names[channel]);
+        text += format_text(text, "_max\":");
+        text += format_fixed(text, statistics->max, decimals);
+        text += format_text(text, ",\"");
+        text += format_text(text, channel_names[channel]);
+        text += format_text(text, "_mean\":");
+        text += format_fixed(text, statistics->mean, decimals);
+        text += format_text(text, ",\"");
+        text += format_text(text, channel_names[channel]);
+        text += format_text(text, "_std\":");
+        text += format_fixed(text, (int32_t)statistics->stddev, decimals);
+        *text++ = ',';
+    }
+
+    text += format_text(text, "\"samples\":");
+    text += format_uint(text, record->count, 1);
+    text += format_text(text, ",\"period\":");
+    text += format_uint(text, record->period, 1);
+    *text++ = '}';
+
+    return (uint16_t)(text - buffer);
+}
@@ -0,0 +1,170 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "stm32g0xx_hal.h"
+#include "bme280.h"
+#include "ccs811.h"
+#include "journal.h"
+#include "aggregate.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Telemetry size related macros
+ *
+ * The buffer size must be a power of two, a batch of the maximum size has
+ * to fit in a single AT+CIPSEND transfer of 2048 bytes.
+ */
+#define TELEMETRY_BUFFER_SIZE     32
+#define TELEMETRY_MAX_BATCH_SIZE  16
+
+/**
+ * @brief Longest JSON text of the values and of a timestamped sample
+ */
+#define TELEMETRY_VALUES_MAX_LENGTH  112
+#define TELEMETRY_SAMPLE_MAX_LENGTH  144
+
+/**
+ * @brief Longest JSON text of a timestamped aggregate window, four statistics per channel
+ */
+#define TELEMETRY_AGGREGATE_MAX_LENGTH  704
+
+/**
+ * @brief Default batch configuration
+ */
+#define TELEMETRY_DEFAULT_BATCH_SIZE  10
+#define TELEMETRY_DEFAULT_MAX_AGE     60
+
+/**
+ * @brief Minimum time between two batches replayed from the journal in ms
+ */
+#define TELEMETRY_REPLAY_INTERVAL     2000
+
+/**
+ * @brief Telemetry sample, values in integer units
+ */
+typedef struct
+{
+    uint32_t tick;          /**< HAL tick when the sample was taken */
+    int16_t temperature;    /**< Temperature in 0.01 degC */
+    uint16_t humidity;      /**< Relative humidity in 0.01 % */
+    uint32_t pressure;      /**< Pressure in Pa */
+    uint16_t tvoc;          /**< Total volatile organic compound in ppb */
+    uint16_t eco2;          /**< Equivalent carbon dioxide in ppm */
+    uint8_t interval;       /**< Measurement interval in s when the sample was taken, 0 if unknown */
+} telemetry_sample;
+
+/**
+ * @brief Batch configuration
+ */
+typedef struct
+{
+    uint8_t batch_size;           /**< Number of samples sent together, 1 to TELEMETRY_MAX_BATCH_SIZE */
+    uint16_t max_age;             /**< Maximum age of the oldest sample before a batch is sent, in s */
+    uint16_t aggregate_period;    /**< Aggregate window in s, 0 sends every sample */
+} telemetry_config;
+
+/**
+ * @brief Telemetry statistics
+ */
+typedef struct
+{
+    uint32_t samples_added;      /**< Samples added to the buffer */
+    uint32_t samples_sent;       /**< Samples delivered to the broker */
+    uint32_t samples_dropped;    /**< Samples overwritten on a full buffer */
+    uint32_t samples_journaled;  /**< Samples moved to the flash journal on a full buffer */
+    uint32_t batches_sent;       /**< Batches delivered to the broker */
+    uint32_t windows_sent;       /**< Aggregate windows delivered to the broker */
+} telemetry_statistics;
+
+/**
+ * @brief Telemetry batching state
+ */
+typedef struct
+{
+    telemetry_sample samples[TELEMETRY_BUFFER_SIZE];    /**< Sample ring buffer */
+    uint16_t head;                                      /**< Next free position, free running */
+    uint16_t tail;                                      /**< Oldest sample, free running */
+    uint8_t in_flight;                                  /**< Samples in the last formatted batch */
+    bool replaying;                                     /**< Last formatted batch came from the journal */
+    bool aggregating;                                   /**< Last formatted batch holds aggregate windows */
+    uint32_t aggregate_dropped;                         /**< Dropped window count when the batch was formatted */
+    journal_iterator replay;                            /**< Journal position after the replayed batch */
+    uint32_t last_replay;                               /**< HAL tick of the last replayed batch */
+    telemetry_config configuration;                     /**< Batch configuration */
+    telemetry_statistics statistics;                    /**< Batching statistics */
+} telemetry;
+
+/**
+ * @brief Initialize telemetry batching with the saved or the default configuration
+ */
+void telemetry_init(void);
+
+/**
+ * @brief Set and save the batch configuration
+ * @param config: Pointer to configuration structure
+ * @return: true if the configuration is valid and was saved, false otherwise
+ */
+bool telemetry_set_configuration(const telemetry_config *config);
+
+/**
+ * @brief Read the batch configuration
+ * @param config: Pointer to configuration structure
+ */
+void telemetry_get_configuration(telemetry_config *config);
+
+/**
+ * @brief Filter a sample, then add it when the publish policy passes it or to the open aggregate window
+ * @param environmental_data: Measurements of the BME280
+ * @param air_quality: Measurements of the CCS811
+ */
+void telemetry_handler(const bme280_measurements *environmental_data,
+        const ccs811_measurements *air_quality);
+
+/**
+ * @brief Check if a batch should be sent
+ * @return: true if the batch is full or the oldest sample reached the maximum age
+ */
+bool telemetry_batch_ready(void);
+
+/**
+ * @brief Format the pending samples as a ThingsBoard telemetry array
+ *
+ * The samples stay in the buffer until telemetry_release is called, so a
+ * failed upload sends them again. Samples and windows are held until the
+ * time is synchronized and are then sent with the time they were taken.
+ * Samples stored in the flash journal are replayed first, oldest first.
+ * Closed aggregate windows are sent next, timestamped with the window start.
+ *
+ * @param buffer: Output buffer
+ * @param size: Output buffer size
+ * @return: Length of the JSON text, 0 if there is nothing to send
+ */
+uint16_t telemetry_format(char *buffer, uint16_t size);
+
+/**
+ * @brief Remove the samples or windows of the last formatted batch after it was delivered
+ */
+void telemetry_release(void);
+
+/**
+ * @brief Number of samples waiting to be sent
+ * @return: Number of samples
+ */
+uint16_t telemetry_pending(void);
+
+/**
+ * @brief Read the telemetry statistics
+ * @param statistics: Pointer to statistics structure
+ */
+void telemetry_get_statistics(telemetry_statistics *statistics);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TELEMETRY_H */
@@ -0,0 +1,132 @@
+#include "uart_rx.h"
+
+/**
+ * @brief Interrupt rate measurement window in ms
+ */
+#define UART_RX_IRQ_WINDOW 1000
+
+/* UART receiver private functions */
+static void copy_to_target(uart_rx *rx, uint16_t start, uint16_t end);
+static void count_interrupt(uart_rx *rx);
+
+bool uart_rx_start(uart_rx *rx, UART_HandleTypeDef *huart)
+{
+    if (rx == NULL || huart == NULL)
+        return false;
+
+    rx->uart_handle = huart;
+    rx->read_position = 0;
+    rx->irq_window_start = HAL_GetTick();
+    rx->irq_window_count = 0;
+
+    HAL_StatusTypeDef result = HAL_OK;
+    result = HAL_UARTEx_ReceiveToIdle_DMA(rx->uart_handle, rx->dma_buffer, rx->dma_buffer_size);
+
+    return (result == HAL_OK);
+}
+
+void uart_rx_stop(uart_rx *rx)
+{
+    if (rx == NULL || rx->uart_handle == NULL)
+        return;
+
+    HAL_UART_AbortReceive(rx->uart_handle);
+}
+
+void uart_rx_event(uart_rx *rx, UART_HandleTypeDef *huart, uint16_t position)
+{
+    if (rx == NULL || rx->uart_handle == NULL || huart->Instance != rx->uart_handle->Instance)
+        return;
+
+    count_interrupt(rx);
+
+    if (position == rx->read_position)
+        return;
+
+    if (position > rx->read_position)
+    {
+        copy_to_target(rx, rx->read_position, position);
+    }
+    else
+    {
+        /* DMA wrapped around the end of the buffer */
+        copy_to_target(rx, rx->read_position, rx->dma_buffer_size);
+        copy_to_target(rx, 0, position);
+    }
+
+    rx->read_position = (position >= rx->dma_buffer_size) ? 0 : position;
+}
+
+void uart_rx_error(uart_rx *rx, UART_HandleTypeDef *huart)
+{
+    if (rx == NULL || rx->uart_handle == NULL || huart->Instance != rx->uart_handle->Instance)
+        return;
+
+    if (huart->ErrorCode & HAL_UART_ERROR_ORE)
+    {
+        rx->statistics.overruns++;
+    }
+
+    if (huart->ErrorCode & (HAL_UART_ERROR_FE | HAL_UART_ERROR_NE | HAL_UART_ERROR_PE))
+    {
+        rx->statistics.errors++;
+    }
+
+    /* Reception is aborted by the HAL on errors, restart it */
+    HAL_UART_AbortReceive(rx->uart_handle);
+    uart_rx_start(rx, rx->uart_handle);
+}
+
+void uart_rx_get_statistics(uart_rx *rx, uart_rx_statistics *statistics)
+{
+    if (rx == NULL || statistics == NULL)
+        return;
+
+    /* The rate is only updated by interrupts, a silent link reads as zero */
+    if (HAL_GetTick() - rx->irq_window_start >= 2 * UART_RX_IRQ_WINDOW)
+    {
+        rx->statistics.irqs_per_second = 0;
+    }
+
+    statistics->bytes_received = rx->statistics.bytes_received;
+    statistics->overruns = rx->statistics.overruns + circular_buffer_overflow_count(rx->cbuf);
+    statistics->errors = rx->statistics.errors;
+    statistics->irq_count = rx->statistics.irq_count;
+    statistics->irqs_per_second = rx->statistics.irqs_per_second;
+}
+
+/**
+ * @brief Move received bytes from the DMA buffer to the target buffer
+ * @param rx: Pointer to UART receiver
+ * @param start: First DMA buffer position
+ * @param end: Last DMA buffer position, not included
+ */
+static void copy_to_target(uart_rx *rx, uint16_t start, uint16_t end)
+{
+    uint16_t length = end - start;
+
+    if (length == 0)
+        return;
+
+    circular_buffer_push_span(rx->cbuf, &rx->dma_buffer[start], length);
+    rx->statistics.bytes_received += length;
+}
+
+/**
+ * @brief Update interrupt counters
+ * @param rx: Pointer to UART receiver
+ */
+static void count_interrupt(uart_rx *rx)
+{
+    uint32_t now = HAL_GetTick();
+
+    rx->statistics.irq_count++;
+    rx->irq_window_count++;
+
+    if (now - rx->irq_window_start >= UART_RX_IRQ_WINDOW)
+    {
+        rx->statistics.irqs_per_second = rx->irq_window_count;
+        rx->irq_window_count = 0;
+        rx->irq_window_start = now;
+    }
+}
@@ -0,0 +1,102 @@
+#ifndef UART_RX_H
+#define UART_RX_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "stm32g0xx_hal.h"
+#include "circular_buffer.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Macro for UART DMA receiver definition
+ * @param name: Receiver name
+ * @param size: Size of the circular DMA buffer
+ * @param target: Circular buffer that receives the data
+ */
+#define UART_RX_DEF(name, size, target)       \
+    static uint8_t name##_dma_buffer[size];   \
+    static uart_rx name = {                   \
+        .uart_handle      = NULL,             \
+        .dma_buffer       = name##_dma_buffer,\
+        .dma_buffer_size  = size,             \
+        .read_position    = 0,                \
+        .cbuf             = target            \
+    }
+
+/**
+ * @brief UART reception statistics
+ */
+typedef struct
+{
+    uint32_t bytes_received;     /**< Total number of bytes received */
+    uint32_t overruns;           /**< Bytes lost by UART overrun or full circular buffer */
+    uint32_t errors;             /**< UART framing, noise and parity errors */
+    uint32_t irq_count;          /**< Total number of reception interrupts */
+    uint16_t irqs_per_second;    /**< Reception interrupts during the last second */
+} uart_rx_statistics;
+
+/**
+ * @brief UART DMA receiver
+ *
+ * The DMA writes continuously in a circular buffer, received data is moved
+ * to the target circular buffer on half transfer, transfer complete and
+ * idle line events.
+ */
+typedef struct
+{
+    UART_HandleTypeDef *uart_handle;    /**< UART handle used for reception */
+    uint8_t *dma_buffer;                /**< Circular DMA buffer */
+    const uint16_t dma_buffer_size;     /**< Size of the circular DMA buffer */
+    uint16_t read_position;             /**< DMA buffer position already moved to the target */
+    circular_buffer *cbuf;              /**< Target circular buffer */
+    uart_rx_statistics statistics;      /**< Reception statistics */
+    uint32_t irq_window_start;          /**< Start of the current interrupt rate window */
+    uint16_t irq_window_count;          /**< Interrupts in the current rate window */
+} uart_rx;
+
+/**
+ * @brief Start circular DMA reception with idle line detection
+ * @param rx: Pointer to UART receiver
+ * @param huart: UART handle used for reception
+ * @return: true if reception was started, false otherwise
+ */
+bool uart_rx_start(uart_rx *rx, UART_HandleTypeDef *huart);
+
+/**
+ * @brief Stop reception
+ * @param rx: Pointer to UART receiver
+ */
+void uart_rx_stop(uart_rx *rx);
+
+/**
+ * @brief Reception event handler
+ * This function must be called from HAL_UARTEx_RxEventCallback
+ * @param rx: Pointer to UART receiver
+ * @param huart: UART handle that generated the event
+ * @param position: Current DMA position in the circular buffer
+ */
+void uart_rx_event(uart_rx *rx, UART_HandleTypeDef *huart, uint16_t position);
+
+/**
+ * @brief Reception error handler
+ * This function must be called from HAL_UART_ErrorCallback
+ * @param rx: Pointer to UART receiver
+ * @param huart: UART handle that generated the error
+ */
+void uart_rx_error(uart_rx *rx, UART_HandleTypeDef *huart);
+
+/**
+ * @brief Read reception statistics
+ * @param rx: Pointer to UART receiver
+ * @param statistics: Pointer to statistics structure
+ */
+void uart_rx_get_statistics(uart_rx *rx, uart_rx_statistics *statistics);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* UART_RX_H */
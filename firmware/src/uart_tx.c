@@ -0,0 +1,234 @@
+#include "uart_tx.h"
+
+/**
+ * @brief Byte rate measurement window in ms
+ */
+#define UART_TX_RATE_WINDOW 1000
+
+/* UART transmitter private functions */
+static void start_next(uart_tx *tx);
+static void release(uart_tx *tx, bool sent);
+static void count_bytes(uart_tx *tx, uint16_t length);
+
+bool uart_tx_start(uart_tx *tx, UART_HandleTypeDef *huart)
+{
+    if (tx == NULL || huart == NULL || huart->hdmatx == NULL)
+        return false;
+
+    tx->uart_handle = huart;
+    tx->head = 0;
+    tx->tail = 0;
+    tx->count = 0;
+    tx->active = false;
+    tx->rate_window_start = HAL_GetTick();
+    tx->rate_window_bytes = 0;
+
+    return true;
+}
+
+bool uart_tx_send(uart_tx *tx, const uint8_t *data, uint16_t length,
+        uart_tx_callback callback, void *context)
+{
+    if (tx == NULL || tx->uart_handle == NULL || data == NULL || length == 0)
+        return false;
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    if (tx->count >= tx->queue_size)
+    {
+        tx->statistics.rejected++;
+        __set_PRIMASK(primask);
+        return false;
+    }
+
+    uart_tx_descriptor *descriptor = &tx->queue[tx->head];
+    descriptor->data = data;
+    descriptor->length = length;
+    descriptor->callback = callback;
+    descriptor->context = context;
+
+    tx->head = (tx->head + 1) % tx->queue_size;
+    tx->count++;
+
+    if (tx->count > tx->statistics.max_depth)
+    {
+        tx->statistics.max_depth = tx->count;
+    }
+
+    if (tx->count == tx->queue_size)
+    {
+        tx->stall_start = HAL_GetTick();
+    }
+
+    start_next(tx);
+
+    __set_PRIMASK(primask);
+    return true;
+}
+
+uint8_t uart_tx_free(uart_tx *tx)
+{
+    if (tx == NULL)
+        return 0;
+
+    return tx->queue_size - tx->count;
+}
+
+bool uart_tx_is_idle(uart_tx *tx)
+{
+    if (tx == NULL)
+        return true;
+
+    return (tx->count == 0);
+}
+
+void uart_tx_abort(uart_tx *tx)
+{
+    if (tx == NULL || tx->uart_handle == NULL)
+        return;
+
+    HAL_UART_AbortTransmit(tx->uart_handle);
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    while (tx->count > 0)
+    {
+        release(tx, false);
+    }
+
+    __set_PRIMASK(primask);
+}
+
+void uart_tx_complete(uart_tx *tx, UART_HandleTypeDef *huart)
+{
+    if (tx == NULL || tx->uart_handle == NULL || huart->Instance != tx->uart_handle->Instance)
+        return;
+
+    if (!tx->active)
+        return;
+
+    release(tx, true);
+    start_next(tx);
+}
+
+void uart_tx_error(uart_tx *tx, UART_HandleTypeDef *huart)
+{
+    if (tx == NULL || tx->uart_handle == NULL || huart->Instance != tx->uart_handle->Instance)
+        return;
+
+    /* Reception errors leave the transfer running, a DMA error stops it */
+    if (!tx->active || huart->gState != HAL_UART_STATE_READY)
+        return;
+
+    tx->statistics.errors++;
+    release(tx, false);
+    start_next(tx);
+}
+
+void uart_tx_get_statistics(uart_tx *tx, uart_tx_statistics *statistics)
+{
+    if (tx == NULL || statistics == NULL)
+        return;
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    uint32_t now = HAL_GetTick();
+
+    /* The rate is only updated by finished transfers, a silent link reads as zero */
+    if (now - tx->rate_window_start >= 2 * UART_TX_RATE_WINDOW)
+    {
+        tx->statistics.bytes_per_second = 0;
+    }
+
+    *statistics = tx->statistics;
+
+    if (tx->count == tx->queue_size)
+    {
+        statistics->stall_time += now - tx->stall_start;
+    }
+
+    __set_PRIMASK(primask);
+}
+
+/**
+ * @brief Start DMA for the descriptor at tail if the transmitter is free
+ * Called with interrupts disabled or from the transfer complete interrupt.
+ * @param tx: Pointer to UART transmitter
+ */
+static void start_next(uart_tx *tx)
+{
+    while (!tx->active && tx->count > 0)
+    {
+        uart_tx_descriptor *descriptor = &tx->queue[tx->tail];
+        tx->active = true;
+
+        if (HAL_UART_Transmit_DMA(tx->uart_handle, (uint8_t *)descriptor->data,
+                descriptor->length) != HAL_OK)
+        {
+            tx->statistics.errors++;
+            release(tx, false);
+        }
+    }
+}
+
+/**
+ * @brief Remove the descriptor at tail and return its buffer to the producer
+ *
+ * The descriptor is removed before the callback is called, so the callback
+ * can queue the next buffer.
+ *
+ * @param tx: Pointer to UART transmitter
+ * @param sent: The data was sent, false if it was dropped
+ */
+static void release(uart_tx *tx, bool sent)
+{
+    uart_tx_descriptor *descriptor = &tx->queue[tx->tail];
+    uart_tx_callback callback = descriptor->callback;
+    void *context = descriptor->context;
+
+    if (sent)
+    {
+        count_bytes(tx, descriptor->length);
+    }
+
+    if (tx->count == tx->queue_size)
+    {
+        tx->statistics.stall_time += HAL_GetTick() - tx->stall_start;
+    }
+
+    tx->tail = (tx->tail + 1) % tx->queue_size;
+    tx->count--;
+    tx->active = false;
+
+    if (callback != NULL)
+    {
+        callback(context);
+    }
+}
+
+/**
+ * @brief Update byte counters
+ * @param tx: Pointer to UART transmitter
+ * @param length: Bytes sent by the finished transfer
+ */
+static void count_bytes(uart_tx *tx, uint16_t length)
+{
+    uint32_t now = HAL_GetTick();
+
+    tx->statistics.bytes_sent += length;
+    tx->statistics.transfers++;
+    tx->rate_window_bytes += length;
+
+    uint32_t elapsed = now - tx->rate_window_start;
+
+    /* A window is closed by the first transfer after it, so it can be longer than the nominal one */
+    if (elapsed >= UART_TX_RATE_WINDOW)
+    {
+        tx->statistics.bytes_per_second = (uint32_t)((uint64_t)tx->rate_window_bytes * 1000 / elapsed);
+        tx->rate_window_bytes = 0;
+        tx->rate_window_start = now;
+    }
+}
@@ -0,0 +1,153 @@
+#ifndef UART_TX_H
+#define UART_TX_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "stm32g0xx_hal.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Macro for UART DMA transmitter definition
+ * @param name: Transmitter name
+ * @param size: Number of descriptors in the queue
+ */
+#define UART_TX_DEF(name, size)                         \
+    static uart_tx_descriptor name##_queue[size];       \
+    static uart_tx name = {                             \
+        .uart_handle  = NULL,                           \
+        .queue        = name##_queue,                   \
+        .queue_size   = size,                           \
+        .head         = 0,                              \
+        .tail         = 0,                              \
+        .count        = 0                               \
+    }
+
+/**
+ * @brief Callback called when the buffer of a descriptor is no longer used
+ * This function is called from interrupt context
+ * @param context: Context given with the descriptor
+ */
+typedef void (*uart_tx_callback)(void *context);
+
+/**
+ * @brief Transmit buffer descriptor
+ */
+typedef struct
+{
+    const uint8_t *data;          /**< Data to send, owned by the producer */
+    uint16_t length;              /**< Number of bytes */
+    uart_tx_callback callback;    /**< Called when the data was sent or dropped, can be NULL */
+    void *context;                /**< Context passed to the callback */
+} uart_tx_descriptor;
+
+/**
+ * @brief UART transmission statistics
+ */
+typedef struct
+{
+    uint32_t bytes_sent;          /**< Total number of bytes sent */
+    uint32_t transfers;           /**< Total number of finished DMA transfers */
+    uint32_t rejected;            /**< Descriptors refused on a full queue */
+    uint32_t errors;              /**< Transfers that could not be started or reported an error */
+    uint32_t stall_time;          /**< Time in ms the queue was full */
+    uint32_t bytes_per_second;    /**< Average byte rate of the last closed rate window */
+    uint8_t max_depth;            /**< Highest number of queued descriptors */
+} uart_tx_statistics;
+
+/**
+ * @brief UART DMA transmitter
+ *
+ * Producers queue buffer descriptors, the DMA sends them one after the
+ * other and the transfer complete interrupt starts the next one. A full
+ * queue refuses new descriptors instead of blocking the producer.
+ */
+typedef struct
+{
+    UART_HandleTypeDef *uart_handle;    /**< UART handle used for transmission */
+    uart_tx_descriptor *queue;          /**< Descriptor queue, the active transfer is at tail */
+    const uint8_t queue_size;           /**< Number of descriptors in the queue */
+    volatile uint8_t head;              /**< Next free queue position */
+    volatile uint8_t tail;              /**< Oldest queued descriptor */
+    volatile uint8_t count;             /**< Number of queued descriptors */
+    volatile bool active;               /**< DMA is sending the descriptor at tail */
+    uart_tx_statistics statistics;      /**< Transmission statistics */
+    uint32_t stall_start;               /**< Time the queue became full */
+    uint32_t rate_window_start;         /**< Start of the current byte rate window */
+    uint32_t rate_window_bytes;         /**< Bytes sent in the current rate window */
+} uart_tx;
+
+/**
+ * @brief Start the transmitter
+ * @param tx: Pointer to UART transmitter
+ * @param huart: UART handle used for transmission, linked to a tx DMA channel
+ * @return: true if the transmitter was started, false otherwise
+ */
+bool uart_tx_start(uart_tx *tx, UART_HandleTypeDef *huart);
+
+/**
+ * @brief Queue a buffer for transmission
+ *
+ * The data is not copied and must stay valid until the callback is called.
+ * This function can be called from interrupt context.
+ *
+ * @param tx: Pointer to UART transmitter
+ * @param data: Data to send
+ * @param length: Number of bytes
+ * @param callback: Called when the data was sent or dropped, can be NULL
+ * @param context: Context passed to the callback
+ * @return: true if the buffer was queued, false if the queue is full
+ */
+bool uart_tx_send(uart_tx *tx, const uint8_t *data, uint16_t length,
+        uart_tx_callback callback, void *context);
+
+/**
+ * @brief Number of descriptors that can still be queued
+ * @param tx: Pointer to UART transmitter
+ * @return: Free queue positions
+ */
+uint8_t uart_tx_free(uart_tx *tx);
+
+/**
+ * @brief Check if all queued data was sent
+ * @param tx: Pointer to UART transmitter
+ * @return: true if the queue is empty, false otherwise
+ */
+bool uart_tx_is_idle(uart_tx *tx);
+
+/**
+ * @brief Abort the active transfer and drop all queued descriptors
+ * @param tx: Pointer to UART transmitter
+ */
+void uart_tx_abort(uart_tx *tx);
+
+/**
+ * @brief Transfer complete handler, starts the next queued descriptor
+ * This function must be called from HAL_UART_TxCpltCallback
+ * @param tx: Pointer to UART transmitter
+ * @param huart: UART handle that finished the transmission
+ */
+void uart_tx_complete(uart_tx *tx, UART_HandleTypeDef *huart);
+
+/**
+ * @brief Transmission error handler
+ * This function must be called from HAL_UART_ErrorCallback
+ * @param tx: Pointer to UART transmitter
+ * @param huart: UART handle that generated the error
+ */
+void uart_tx_error(uart_tx *tx, UART_HandleTypeDef *huart);
+
+/**
+ * @brief Read transmission statistics
+ * @param tx: Pointer to UART transmitter
+ * @param statistics: Pointer to statistics structure
+ */
+void uart_tx_get_statistics(uart_tx *tx, uart_tx_statistics *statistics);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* UART_TX_H */
@@ -4,10 +4,23 @@
 #include "bme280.h"
 #include "ccs811.h"
 #include "circular_buffer.h"
-#include "software_timer.h"
+#include "scheduler.h"
+#include "uart_rx.h"
+#include "at_tokenizer.h"
+#include "at_command.h"
+#include "mqtt.h"
+#include "telemetry.h"
+#include "system_time.h"
+#include "format.h"
+#include "config_store.h"
 
 /**
- * @brief WiFi configuration flash storage
+ * @brief Layout version of the stored configuration
+ */
+#define CONFIG_VERSION 1
+
+/**
+ * @brief WiFi configuration flash storage of older firmware
  */
 __attribute__((__section__(".wifi_user_data")))
     const uint8_t wifi_user_data[512];
@@ -23,62 +36,132 @@ static wifi_device wifi_dev;
 CIRCULAR_BUFFER_DEF(wifi_cbuff, 1024);
 
 /**
- * @brief WiFi timeout timers
+ * @brief WiFi UART DMA reception
+ */
+UART_RX_DEF(wifi_rx, WIFI_DMA_BUFFER_SIZE, &wifi_cbuff);
+
+/**
+ * @brief WiFi UART DMA transmission
+ */
+UART_TX_DEF(wifi_tx, WIFI_TX_QUEUE_SIZE);
+
+/**
+ * @brief State machine transitions for AT command results
+ */
+typedef struct
+{
+    wifi_state success;    /**< State after the command succeeded */
+    wifi_state failure;    /**< State after the command failed or timed out */
+} wifi_transition;
+
+static const wifi_transition restart_transition = { WIFI_MODE_CONFIGURING, WIFI_ERROR_INITIALIZE };
+static const wifi_transition mode_transition = { WIFI_BAUD_NEGOTIATE, WIFI_ERROR_INITIALIZE };
+static const wifi_transition baud_transition = { WIFI_BAUD_SWITCH, WIFI_BAUD_REFUSED };
+static const wifi_transition verify_transition = { WIFI_NETWORK_CONNECT, WIFI_ERROR_BAUD };
+static const wifi_transition restore_transition = { WIFI_BAUD_RESTORE, WIFI_BAUD_RESTORE };
+static const wifi_transition network_transition = { WIFI_NETWORK_CONNECTED, WIFI_ERROR_NETWORK };
+static const wifi_transition broker_transition = { WIFI_MQTT_CONNECTED, WIFI_ERROR_MQTT_BROKER };
+static const wifi_transition prompt_transition = { WIFI_MQTT_PUBLISH_WAIT_REPLY, WIFI_ERROR_MQTT_PUBLISH };
+static const wifi_transition publish_transition = { WIFI_MQTT_CONNECTED, WIFI_ERROR_MQTT_PUBLISH };
+static const wifi_transition publish_ack_transition = { WIFI_MQTT_PUBLISH_WAIT_ACK, WIFI_ERROR_MQTT_PUBLISH };
+static const wifi_transition close_transition = { WIFI_MQTT_CONNECTING, WIFI_ERROR_MQTT_BROKER };
+static const wifi_transition session_transition = { WIFI_MQTT_SESSION_CONNECT, WIFI_ERROR_MQTT_BROKER };
+static const wifi_transition connect_transition = { WIFI_MQTT_SESSION_CONNECTING, WIFI_ERROR_MQTT_BROKER };
+static const wifi_transition ping_prompt_transition = { WIFI_MQTT_PING, WIFI_ERROR_MQTT_BROKER };
+static const wifi_transition ping_transition = { WIFI_MQTT_CONNECTED, WIFI_ERROR_MQTT_BROKER };
+static const wifi_transition time_config_transition = { WIFI_MQTT_CONNECT, WIFI_MQTT_CONNECT };
+static const wifi_transition time_query_transition = { WIFI_MQTT_CONNECTED, WIFI_MQTT_CONNECTED };
+
+/**
+ * @brief UART rates tried after a reset of the WiFi chip, fastest first
+ */
+static const uint32_t baud_rates[] = { WIFI_BAUD_RATES };
+
+#define WIFI_BAUD_RATE_COUNT (sizeof(baud_rates) / sizeof(baud_rates[0]))
+
+/**
+ * @brief WiFi task, runs on received data, finished transfers and timer expiry
+ */
+SCHEDULER_TASK_DEF(wifi_task, wifi_handler, SCHEDULER_PRIORITY_NORMAL);
+
+/**
+ * @brief Command timeout and retry timers
  */
-SOFTWARE_TIMER_DEF(wifi_init_timer, 3000);
-SOFTWARE_TIMER_DEF(wifi_network_timer, 10000);
-SOFTWARE_TIMER_DEF(wifi_mqtt_timer, 10000);
+SCHEDULER_TIMER_DEF(wifi_handler_timer, &wifi_task);
+SCHEDULER_TIMER_DEF(wifi_retry_timer, &wifi_task);
 
 /**
- * @brief Byte received from the UART
+ * @brief MQTT timers, keep alive requests are sent after half the keep alive interval
  */
-static uint8_t received_byte = 0;
+SCHEDULER_TIMER_DEF(wifi_keep_alive_timer, &wifi_task);
+SCHEDULER_TIMER_DEF(wifi_response_timer, &wifi_task);
 
 /**
- * @brief Measurement values from the sensors
+ * @brief Time synchronization timers, the query is repeated faster until the time is valid
  */
-extern bme280_measurements environmental_data;
-extern ccs811_measurements air_quality;
+SCHEDULER_TIMER_DEF(wifi_time_retry_timer, &wifi_task);
+SCHEDULER_TIMER_DEF(wifi_time_sync_timer, &wifi_task);
 
 /**
- * @brief Local variables to keep track if measured data has changed
+ * @brief Journal replay timer, the next replayed batch is due after TELEMETRY_REPLAY_INTERVAL
  */
-static bme280_measurements old_environmental_data;
-static ccs811_measurements old_air_quality;
+SCHEDULER_TIMER_DEF(wifi_replay_timer, &wifi_task);
+
+/**
+ * @brief Publish request or MQTT packet, kept until the chip asks for the data
+ */
+static char payload[WIFI_PAYLOAD_SIZE];
 
 /**
  * @brief WiFi private functions
  */
-static bool send_command(const char *command);
-static void clear_rx_buffer(void);
-static bool check_response(const char *str);
-static uint16_t create_payload(char *payload);
-static bool measured_data_changed(void);
+static void command_completed(const at_completion *completion);
+static void unsolicited_event(at_event event);
+static void send_packet(uint16_t length, const wifi_transition *prompt,
+        const wifi_transition *sent);
+static void handle_broker_data(const uint8_t *data, uint16_t length);
+static void handle_broker_packet(const mqtt_packet *packet);
+static void batch_delivered(void);
+static bool time_sync_due(void);
+static bool is_idle_state(wifi_state state);
+static bool is_error_state(wifi_state state);
+static uint16_t create_payload(char *payload, uint16_t size);
+static void build_http_header(void);
 static bool save_configuration();
 static void read_configuration();
+static bool set_baud_rate(uint32_t baud_rate);
 
 bool wifi_init(UART_HandleTypeDef *huart)
 {
     wifi_dev.uart_handle = huart;
-    wifi_dev.rx_index = 0;
-    wifi_dev.lf_received = false;
     wifi_dev.init_retry_count = 0;
     wifi_dev.network_retry_count = 0;
     wifi_dev.mqtt_retry_count = 0;
     wifi_dev.publish_retry_count = 0;
+    wifi_dev.baud_index = 0;
+    wifi_dev.broker_open = false;
+    memset(&wifi_dev.baud, 0, sizeof(wifi_dev.baud));
+    wifi_dev.baud.baud_rate = huart->Init.BaudRate;
     wifi_dev.state = WIFI_INITIALIZE;
 
-    clear_rx_buffer();
+    at_tokenizer_reset(&wifi_dev.tokenizer);
+
+    if (!uart_tx_start(&wifi_tx, wifi_dev.uart_handle))
+        return false;
 
-    HAL_StatusTypeDef result = HAL_OK;
-    result = HAL_UART_Receive_IT(wifi_dev.uart_handle, &received_byte,
-            sizeof(received_byte));
+    if (!at_command_init(&wifi_tx, unsolicited_event))
+        return false;
 
-    if (result != HAL_OK)
+    if (!uart_rx_start(&wifi_rx, wifi_dev.uart_handle))
         return false;
 
     read_configuration();
 
+    if (!scheduler_register(&wifi_task))
+        return false;
+
+    scheduler_post(&wifi_task);
+
     return true;
 }
 
@@ -92,13 +175,21 @@ bool wifi_set_configuration(wifi_config *config)
     strcpy(wifi_dev.configuration.broker_address, config->broker_address);
     wifi_dev.configuration.broker_port = config->broker_port;
     strcpy(wifi_dev.configuration.broker_token, config->broker_token);
+    wifi_dev.configuration.broker_protocol = config->broker_protocol;
+    wifi_dev.configuration.broker_qos = config->broker_qos;
 
     if (!save_configuration())
     {
         return false;
     }
 
+    build_http_header();
+
+    /* Drop the running sequence, its callbacks must not move the new state */
+    at_command_flush();
+    wifi_dev.broker_open = false;
     wifi_dev.state = WIFI_INITIALIZE;
+    scheduler_post(&wifi_task);
     return true;
 }
 
@@ -117,271 +208,297 @@ void wifi_get_configuration(wifi_config *config)
     strcpy(config->broker_address, wifi_dev.configuration.broker_address);
     config->broker_port = wifi_dev.configuration.broker_port;
     strcpy(config->broker_token, wifi_dev.configuration.broker_token);
+    config->broker_protocol = wifi_dev.configuration.broker_protocol;
+    config->broker_qos = wifi_dev.configuration.broker_qos;
+}
+
+void wifi_get_link_statistics(uart_rx_statistics *statistics)
+{
+    uart_rx_get_statistics(&wifi_rx, statistics);
+}
+
+void wifi_get_tx_statistics(uart_tx_statistics *statistics)
+{
+    uart_tx_get_statistics(&wifi_tx, statistics);
+}
+
+void wifi_get_baud_statistics(wifi_baud_statistics *statistics)
+{
+    if (statistics == NULL)
+        return;
+
+    *statistics = wifi_dev.baud;
+}
+
+bool wifi_stop_allowed(void)
+{
+    if (wifi_dev.baud.baud_rate <= WIFI_BAUD_WAKEUP_MAX)
+        return true;
+
+    /* An open connection reports +IPD and CLOSED at any time, including the answer to a ping */
+    if (wifi_dev.broker_open)
+        return false;
+
+    return at_command_is_idle() && is_idle_state(wifi_dev.state);
 }
 
 void wifi_handler()
 {
-    char command_buffer[128];
-    char payload[512];
+    char command_buffer[AT_COMMAND_MAX_LENGTH];
     uint16_t payload_size = 0;
+    bool is_mqtt = (wifi_dev.configuration.broker_protocol == WIFI_PROTOCOL_MQTT);
+    bool retry_due = !scheduler_timer_is_active(&wifi_retry_timer);
+    wifi_state entry_state = wifi_dev.state;
 
-    if (circular_buffer_has_data(&wifi_cbuff))
+    /* Tokenize everything received since the last pass, the data can wrap
+       around the end of the circular buffer so it is read in two blocks */
+    for (uint8_t block = 0; block < 2; block++)
     {
-        uint8_t data = 0;
-        circular_buffer_pop(&wifi_cbuff, &data);
+        const uint8_t *data = NULL;
+        uint16_t available = circular_buffer_peek(&wifi_cbuff, &data);
 
-        wifi_dev.rx_buffer[wifi_dev.rx_index] = data;
-        wifi_dev.rx_index++;
-
-        if (data == 0x0A)
+        while (available > 0)
         {
-            wifi_dev.lf_received = true;
+            at_event event = AT_EVENT_NONE;
+            uint16_t count = at_tokenizer_process(&wifi_dev.tokenizer, data, available, &event);
+
+            circular_buffer_consume(&wifi_cbuff, count);
+            data += count;
+            available -= count;
+
+            if (event == AT_EVENT_DATA)
+            {
+                handle_broker_data(wifi_dev.tokenizer.data, wifi_dev.tokenizer.data_length);
+            }
+
+            at_command_process_event(event);
         }
     }
 
+    /* Start queued commands and check response timeouts */
+    at_command_handler();
+
     switch (wifi_dev.state)
     {
     case WIFI_INITIALIZE:
-        if (!send_command("AT+RST\r\n"))
-        {
-            wifi_dev.state = WIFI_ERROR_INITIALIZE;
-        }
-        else
+        wifi_dev.broker_open = false;
+
+        /* The reset answers at the default rate, the chip has to be switched back first */
+        if (wifi_dev.baud.baud_rate != WIFI_BAUD_DEFAULT)
         {
-            wifi_dev.state = WIFI_RESTARTING;
-            timer_start(&wifi_init_timer);
+            snprintf(command_buffer, sizeof(command_buffer), "AT+UART_CUR=%lu,8,1,0,0\r\n",
+                    (uint32_t)WIFI_BAUD_DEFAULT);
+            at_command_send(command_buffer, AT_EVENT_MASK(AT_EVENT_OK),
+                    AT_EVENT_MASK(AT_EVENT_ERROR), WIFI_BAUD_TIMEOUT,
+                    command_completed, (void *)&restore_transition);
+            wifi_dev.state = WIFI_BAUD_RESTORING;
+            break;
         }
+
+        at_command_send("AT+RST\r\n", AT_EVENT_MASK(AT_EVENT_READY),
+                AT_EVENT_MASK(AT_EVENT_ERROR), WIFI_INIT_TIMEOUT,
+                command_completed, (void *)&restart_transition);
+        at_command_send("AT+CWMODE=1\r\n", AT_EVENT_MASK(AT_EVENT_OK),
+                AT_EVENT_MASK(AT_EVENT_ERROR), WIFI_INIT_TIMEOUT,
+                command_completed, (void *)&mode_transition);
+        wifi_dev.state = WIFI_RESTARTING;
         break;
 
-    case WIFI_RESTARTING:
-        if (wifi_dev.lf_received)
+    case WIFI_BAUD_NEGOTIATE:
+        /* Without a faster rate the link stays at the current one */
+        if (wifi_dev.baud_index >= WIFI_BAUD_RATE_COUNT)
         {
-            wifi_dev.lf_received = false;
-            if (check_response("ready"))
-            {
-                wifi_dev.state = WIFI_MODE_CONFIGURE;
-            }
-            else if (check_response("ERROR"))
-            {
-                wifi_dev.state = WIFI_ERROR_INITIALIZE;
-            }
-            clear_rx_buffer();
+            wifi_dev.state = WIFI_NETWORK_CONNECT;
+            break;
         }
 
-        if (timer_is_expired(&wifi_init_timer))
-        {
-            wifi_dev.state = WIFI_ERROR_INITIALIZE;
-        }
+        /* The chip answers at the old rate and switches after the answer */
+        snprintf(command_buffer, sizeof(command_buffer), "AT+UART_CUR=%lu,8,1,0,0\r\n",
+                baud_rates[wifi_dev.baud_index]);
+        at_command_send(command_buffer, AT_EVENT_MASK(AT_EVENT_OK),
+                AT_EVENT_MASK(AT_EVENT_ERROR), WIFI_BAUD_TIMEOUT,
+                command_completed, (void *)&baud_transition);
+        wifi_dev.state = WIFI_BAUD_NEGOTIATING;
         break;
 
-    case WIFI_MODE_CONFIGURE:
-        if (!send_command("AT+CWMODE=1\r\n"))
-        {
-            wifi_dev.state = WIFI_ERROR_INITIALIZE;
-        }
-        else
+    case WIFI_BAUD_SWITCH:
+        wifi_dev.baud.switches++;
+
+        if (!set_baud_rate(baud_rates[wifi_dev.baud_index]))
         {
-            wifi_dev.state = WIFI_MODE_CONFIGURING;
-            timer_start(&wifi_init_timer);
+            wifi_dev.state = WIFI_ERROR_BAUD;
+            break;
         }
+
+        at_command_send("AT\r\n", AT_EVENT_MASK(AT_EVENT_OK),
+                AT_EVENT_MASK(AT_EVENT_ERROR), WIFI_BAUD_TIMEOUT,
+                command_completed, (void *)&verify_transition);
+        wifi_dev.state = WIFI_BAUD_VERIFYING;
         break;
 
-    case WIFI_MODE_CONFIGURING:
-        if (wifi_dev.lf_received)
-        {
-            wifi_dev.lf_received = false;
-            if (check_response("OK"))
-            {
-                wifi_dev.state = WIFI_NETWORK_CONNECT;
-            }
-            else if (check_response("ERROR"))
-            {
-                wifi_dev.state = WIFI_ERROR_INITIALIZE;
-            }
-            clear_rx_buffer();
-        }
+    case WIFI_BAUD_REFUSED:
+        wifi_dev.baud.refused++;
+        wifi_dev.baud_index++;
+        wifi_dev.state = WIFI_BAUD_NEGOTIATE;
+        break;
 
-        if (timer_is_expired(&wifi_init_timer))
-        {
-            wifi_dev.state = WIFI_ERROR_INITIALIZE;
-        }
+    case WIFI_ERROR_BAUD:
+        /* The state of the chip is unknown, it is reset and the next slower rate is tried */
+        wifi_dev.baud.failures++;
+        wifi_dev.baud_index++;
+        wifi_dev.state = WIFI_INITIALIZE;
+        break;
+
+    case WIFI_BAUD_RESTORE:
+        /* Without an answer the chip is expected at the default rate anyway */
+        wifi_dev.state = set_baud_rate(WIFI_BAUD_DEFAULT) ? WIFI_INITIALIZE : WIFI_ERROR_INITIALIZE;
         break;
 
     case WIFI_NETWORK_CONNECT:
-        sprintf(command_buffer, "AT+CWJAP=\"%s\",\"%s\"\r\n",
+        snprintf(command_buffer, sizeof(command_buffer), "AT+CWJAP=\"%s\",\"%s\"\r\n",
                 wifi_dev.configuration.network_ssid,
                 wifi_dev.configuration.network_password);
 
-        if (!send_command(command_buffer))
-        {
-            wifi_dev.state = WIFI_ERROR_NETWORK;
-        }
-        else
-        {
-            wifi_dev.state = WIFI_NETWORK_CONNECTING;
-            timer_start(&wifi_network_timer);
-        }
-        break;
-
-    case WIFI_NETWORK_CONNECTING:
-        if (wifi_dev.lf_received)
-        {
-            wifi_dev.lf_received = false;
-            if (check_response("OK"))
-            {
-                wifi_dev.state = WIFI_NETWORK_CONNECTED;
-            }
-            else if (check_response("FAIL"))
-            {
-                wifi_dev.state = WIFI_ERROR_NETWORK;
-            }
-            clear_rx_buffer();
-        }
-
-        if (timer_is_expired(&wifi_network_timer))
-        {
-            wifi_dev.state = WIFI_ERROR_NETWORK;
-        }
+        at_command_send(command_buffer, AT_EVENT_MASK(AT_EVENT_OK),
+                AT_EVENT_MASK(AT_EVENT_FAIL) | AT_EVENT_MASK(AT_EVENT_ERROR),
+                WIFI_NETWORK_TIMEOUT, command_completed, (void *)&network_transition);
+        wifi_dev.state = WIFI_NETWORK_CONNECTING;
         break;
 
     case WIFI_NETWORK_CONNECTED:
         wifi_dev.network_retry_count = 0;
-        wifi_dev.state = WIFI_MQTT_CONNECT;
+
+        /* Samples are timestamped with SNTP time, a failure only delays the timestamps */
+        snprintf(command_buffer, sizeof(command_buffer), "AT+CIPSNTPCFG=1,0,\"%s\"\r\n",
+                WIFI_SNTP_SERVER);
+        at_command_send(command_buffer, AT_EVENT_MASK(AT_EVENT_OK),
+                AT_EVENT_MASK(AT_EVENT_ERROR), WIFI_INIT_TIMEOUT,
+                command_completed, (void *)&time_config_transition);
+        scheduler_timer_start(&wifi_time_retry_timer, WIFI_TIME_RETRY_INTERVAL, 0);
+        wifi_dev.state = WIFI_TIME_SYNC;
         break;
 
     case WIFI_MQTT_CONNECT:
-        sprintf(command_buffer, "AT+CIPSTART=\"TCP\",\"%s\",%lu\r\n",
+        wifi_dev.broker_open = false;
+        snprintf(command_buffer, sizeof(command_buffer), "AT+CIPSTART=\"TCP\",\"%s\",%lu\r\n",
                 wifi_dev.configuration.broker_address,
                 wifi_dev.configuration.broker_port);
 
-        if (!send_command(command_buffer))
-        {
-            wifi_dev.state = WIFI_ERROR_MQTT_BROKER;
-        }
-        else
+        if (is_mqtt)
         {
-            wifi_dev.state = WIFI_MQTT_CONNECTING;
-            timer_start(&wifi_mqtt_timer);
+            /* A new session needs a new connection, the broker drops a second CONNECT */
+            at_command_send("AT+CIPCLOSE\r\n",
+                    AT_EVENT_MASK(AT_EVENT_OK) | AT_EVENT_MASK(AT_EVENT_ERROR), 0,
+                    WIFI_MQTT_TIMEOUT, command_completed, (void *)&close_transition);
         }
+
+        at_command_send(command_buffer,
+                AT_EVENT_MASK(AT_EVENT_OK) | AT_EVENT_MASK(AT_EVENT_ALREADY_CONNECTED),
+                AT_EVENT_MASK(AT_EVENT_ERROR), WIFI_MQTT_TIMEOUT, command_completed,
+                (void *)(is_mqtt ? &session_transition : &broker_transition));
+        wifi_dev.state = WIFI_MQTT_CONNECTING;
         break;
 
-    case WIFI_MQTT_CONNECTING:
-        if (wifi_dev.lf_received)
-        {
-            wifi_dev.lf_received = false;
-            if (check_response("OK") || check_response("ALREADY CONNECTED"))
-            {
-                wifi_dev.state = WIFI_MQTT_CONNECTED;
-            }
-            else if (check_response("ERROR"))
-            {
-                wifi_dev.state = WIFI_ERROR_MQTT_BROKER;
-            }
-            clear_rx_buffer();
-        }
+    case WIFI_MQTT_SESSION_CONNECT:
+    {
+        char client_id[16];
+        snprintf(client_id, sizeof(client_id), "weaver-%08lx", HAL_GetUIDw0());
+
+        mqtt_connect_options options = {
+            .client_id = client_id,
+            .username = wifi_dev.configuration.broker_token,
+            .password = NULL,
+            .keep_alive = WIFI_MQTT_KEEP_ALIVE,
+            .clean_session = true
+        };
+
+        mqtt_parser_reset(&wifi_dev.parser);
+        wifi_dev.ping_pending = false;
+
+        payload_size = mqtt_encode_connect((uint8_t *)payload, sizeof(payload), &options);
+        send_packet(payload_size, &connect_transition, &connect_transition);
+        scheduler_timer_start(&wifi_response_timer, WIFI_MQTT_TIMEOUT, 0);
+        wifi_dev.state = WIFI_MQTT_SESSION_CONNECTING;
+        break;
+    }
 
-        if (timer_is_expired(&wifi_mqtt_timer))
+    case WIFI_MQTT_SESSION_CONNECTING:
+        if (!scheduler_timer_is_active(&wifi_response_timer))
         {
+            at_command_flush();
             wifi_dev.state = WIFI_ERROR_MQTT_BROKER;
         }
         break;
 
     case WIFI_MQTT_CONNECTED:
-        if (wifi_dev.lf_received)
+        if (is_mqtt && wifi_dev.ping_pending && !scheduler_timer_is_active(&wifi_response_timer))
         {
-            wifi_dev.lf_received = false;
-            if (check_response("WIFI DISCONNECTED"))
-            {
-                wifi_dev.state = WIFI_ERROR_NETWORK;
-            }
-            else if (check_response("CLOSED"))
-            {
-                wifi_dev.state = WIFI_ERROR_MQTT_BROKER;
-            }
-            clear_rx_buffer();
+            wifi_dev.state = WIFI_ERROR_MQTT_BROKER;
         }
-
-        if (measured_data_changed())
+        else if (telemetry_batch_ready())
         {
-            old_environmental_data = environmental_data;
-            old_air_quality = air_quality;
             wifi_dev.state = WIFI_MQTT_PUBLISH_START;
         }
-        break;
-
-    case WIFI_MQTT_PUBLISH_START:
-        payload_size = create_payload(payload);
-        sprintf(command_buffer, "AT+CIPSEND=%d\r\n", payload_size);
-
-        if (!send_command(command_buffer))
+        else if (is_mqtt && !wifi_dev.ping_pending && !scheduler_timer_is_active(&wifi_keep_alive_timer))
         {
-            wifi_dev.state = WIFI_ERROR_MQTT_PUBLISH;
-            timer_start(&wifi_mqtt_timer);
+            payload_size = mqtt_encode_pingreq((uint8_t *)payload, sizeof(payload));
+            send_packet(payload_size, &ping_prompt_transition, &ping_transition);
+            scheduler_timer_start(&wifi_response_timer, WIFI_MQTT_TIMEOUT, 0);
+            wifi_dev.ping_pending = true;
+            wifi_dev.state = WIFI_MQTT_PING;
         }
-        else
+        else if (time_sync_due() && at_command_is_idle())
         {
-            wifi_dev.state = WIFI_MQTT_PUBLISH;
+            at_command_send("AT+CIPSNTPTIME?\r\n", AT_EVENT_MASK(AT_EVENT_OK),
+                    AT_EVENT_MASK(AT_EVENT_ERROR), WIFI_INIT_TIMEOUT,
+                    command_completed, (void *)&time_query_transition);
+            scheduler_timer_start(&wifi_time_retry_timer, WIFI_TIME_RETRY_INTERVAL, 0);
+            wifi_dev.state = WIFI_TIME_SYNC;
         }
         break;
 
-    case WIFI_MQTT_PUBLISH:
-        if (wifi_dev.lf_received)
+    case WIFI_MQTT_PUBLISH_START:
+        payload_size = create_payload(payload, sizeof(payload));
+
+        /* Nothing to send, the samples were released by an earlier publish */
+        if (payload_size == 0)
         {
-            wifi_dev.lf_received = false;
-            if (check_response("OK"))
-            {
-                HAL_Delay(25);
-                if (!send_command(payload))
-                {
-                    wifi_dev.state = WIFI_ERROR_MQTT_PUBLISH;
-                }
-                else
-                {
-                    wifi_dev.state = WIFI_MQTT_PUBLISH_WAIT_REPLY;
-                    timer_start(&wifi_mqtt_timer);
-                }
-            }
-            clear_rx_buffer();
+            wifi_dev.state = WIFI_MQTT_CONNECTED;
+            break;
         }
 
-        if (timer_is_expired(&wifi_mqtt_timer))
+        if (is_mqtt && wifi_dev.configuration.broker_qos > 0)
         {
-            wifi_dev.state = WIFI_ERROR_MQTT_PUBLISH;
+            send_packet(payload_size, &prompt_transition, &publish_ack_transition);
+            scheduler_timer_start(&wifi_response_timer, WIFI_MQTT_TIMEOUT, 0);
         }
-        break;
-
-    case WIFI_MQTT_PUBLISH_WAIT_REPLY:
-        if (wifi_dev.lf_received)
+        else
         {
-            wifi_dev.lf_received = false;
-            if (check_response("SEND OK"))
-            {
-                wifi_dev.publish_retry_count = 0;
-                wifi_dev.state = WIFI_MQTT_CONNECTED;
-            }
-            else if (check_response("SEND FAIL"))
-            {
-                wifi_dev.state = WIFI_ERROR_MQTT_PUBLISH;
-            }
-            clear_rx_buffer();
+            send_packet(payload_size, &prompt_transition, &publish_transition);
         }
+        wifi_dev.state = WIFI_MQTT_PUBLISH;
+        break;
 
-        if (timer_is_expired(&wifi_mqtt_timer))
+    case WIFI_MQTT_PUBLISH_WAIT_ACK:
+        if (!scheduler_timer_is_active(&wifi_response_timer))
         {
             wifi_dev.state = WIFI_ERROR_MQTT_PUBLISH;
         }
         break;
 
     case WIFI_ERROR_INITIALIZE:
-        if (wifi_dev.init_retry_count < WIFI_INIT_MAX_RETRY)
+        if (retry_due && wifi_dev.init_retry_count < WIFI_INIT_MAX_RETRY)
         {
+            /* A chip left at a fast rate by a reset of the microcontroller only answers
+               at that rate, every retry switches it back from one of the fast rates first */
+            set_baud_rate(baud_rates[wifi_dev.init_retry_count % WIFI_BAUD_RATE_COUNT]);
             wifi_dev.init_retry_count++;
             wifi_dev.state = WIFI_INITIALIZE;
         }
         break;
 
     case WIFI_ERROR_NETWORK:
-        if (wifi_dev.network_retry_count < WIFI_NETWORK_MAX_RETRY)
+        if (retry_due && wifi_dev.network_retry_count < WIFI_NETWORK_MAX_RETRY)
         {
             wifi_dev.network_retry_count++;
             wifi_dev.state = WIFI_NETWORK_CONNECT;
@@ -389,7 +506,7 @@ void wifi_handler()
         break;
 
     case WIFI_ERROR_MQTT_BROKER:
-        if (wifi_dev.mqtt_retry_count < WIFI_MQTT_MAX_RETRY)
+        if (retry_due && wifi_dev.mqtt_retry_count < WIFI_MQTT_MAX_RETRY)
         {
             wifi_dev.mqtt_retry_count++;
             wifi_dev.state = WIFI_MQTT_CONNECT;
@@ -397,7 +514,7 @@ void wifi_handler()
         break;
 
     case WIFI_ERROR_MQTT_PUBLISH:
-        if (wifi_dev.publish_retry_count < WIFI_MQTT_MAX_RETRY)
+        if (retry_due && wifi_dev.publish_retry_count < WIFI_MQTT_MAX_RETRY)
         {
             wifi_dev.publish_retry_count++;
             wifi_dev.state = WIFI_MQTT_PUBLISH_START;
@@ -405,149 +522,447 @@ void wifi_handler()
         break;
 
     default:
+        /* Waiting states are advanced by command callbacks */
         break;
     }
+
+    /* A new state runs at once, a failed step waits before it is retried */
+    if (wifi_dev.state != entry_state)
+    {
+        if (is_error_state(wifi_dev.state))
+        {
+            /* Only a failed publish can leave the connection usable */
+            if (wifi_dev.state != WIFI_ERROR_MQTT_PUBLISH)
+            {
+                wifi_dev.broker_open = false;
+            }
+
+            scheduler_timer_start(&wifi_retry_timer, WIFI_RETRY_INTERVAL, 0);
+        }
+        else
+        {
+            scheduler_post(&wifi_task);
+        }
+    }
+
+    /* Responses post the task, the timer only catches a command without one */
+    if (at_command_is_idle())
+    {
+        scheduler_timer_stop(&wifi_handler_timer);
+    }
+    else
+    {
+        scheduler_timer_start(&wifi_handler_timer, at_command_time_left(), 0);
+    }
 }
 
-void wifi_rx_callback(UART_HandleTypeDef *huart)
+void wifi_trigger_handler(void)
 {
-    if (huart->Instance != wifi_dev.uart_handle->Instance)
+    scheduler_post(&wifi_task);
+}
+
+void wifi_get_command_statistics(at_command_statistics *statistics)
+{
+    at_command_get_statistics(statistics);
+}
+
+void wifi_rx_event_callback(UART_HandleTypeDef *huart, uint16_t position)
+{
+    uart_rx_event(&wifi_rx, huart, position);
+    scheduler_post(&wifi_task);
+}
+
+void wifi_error_callback(UART_HandleTypeDef *huart)
+{
+    uart_rx_error(&wifi_rx, huart);
+    uart_tx_error(&wifi_tx, huart);
+}
+
+void wifi_tx_callback(UART_HandleTypeDef *huart)
+{
+    uart_tx_complete(&wifi_tx, huart);
+    scheduler_post(&wifi_task);
+}
+
+/**
+ * @brief Move the state machine when an AT command completes
+ * @param completion: Command completion information, context points to a wifi_transition
+ */
+static void command_completed(const at_completion *completion)
+{
+    const wifi_transition *transition = (const wifi_transition *)completion->context;
+
+    /* The command that failed already moved the state machine */
+    if (completion->result == AT_RESULT_ABORTED)
+        return;
+
+    if (completion->result != AT_RESULT_SUCCESS)
+    {
+        wifi_dev.state = transition->failure;
         return;
+    }
+
+    if (transition == &broker_transition && wifi_dev.configuration.broker_protocol != WIFI_PROTOCOL_MQTT)
+    {
+        wifi_dev.mqtt_retry_count = 0;
+        wifi_dev.broker_open = true;
+    }
+    else if (transition == &publish_transition)
+    {
+        batch_delivered();
+    }
 
-    circular_buffer_push(&wifi_cbuff, received_byte);
-    HAL_UART_Receive_IT(wifi_dev.uart_handle, &received_byte, sizeof(received_byte));
+    wifi_dev.state = transition->success;
 }
 
 /**
- * @brief Send AT command to the WiFi chip
- * @param command: The AT command
- * @return: True if the command was sent successfully, false otherwise
+ * @brief Handle responses that are not part of a command reply
+ * @param event: Event generated by the AT tokenizer
  */
-static bool send_command(const char *command)
+static void unsolicited_event(at_event event)
 {
-    if (command == NULL)
-        return false;
+    if (event == AT_EVENT_LINE && wifi_dev.state == WIFI_TIME_SYNC)
+    {
+        if (system_time_set_sntp(at_tokenizer_line(&wifi_dev.tokenizer)))
+        {
+            scheduler_timer_start(&wifi_time_sync_timer, WIFI_TIME_SYNC_INTERVAL, 0);
+        }
+        return;
+    }
 
-    HAL_StatusTypeDef result = HAL_OK;
-    result = HAL_UART_Transmit(wifi_dev.uart_handle, (uint8_t *)command,
-            strlen(command), HAL_MAX_DELAY);
+    if (!wifi_dev.broker_open)
+        return;
 
-    return (result == HAL_OK);
+    /* Connection loss is reported asynchronously */
+    if (event == AT_EVENT_WIFI_DISCONNECTED)
+    {
+        at_command_flush();
+        wifi_dev.broker_open = false;
+        wifi_dev.state = WIFI_ERROR_NETWORK;
+    }
+    else if (event == AT_EVENT_CLOSED)
+    {
+        at_command_flush();
+        wifi_dev.broker_open = false;
+        wifi_dev.state = WIFI_ERROR_MQTT_BROKER;
+    }
 }
 
-static void clear_rx_buffer()
+/**
+ * @brief Queue the transmission of the payload buffer on the broker connection
+ * @param length: Number of payload bytes
+ * @param prompt: State transition when the chip asks for the data
+ * @param sent: State transition when the chip reports the data as sent
+ */
+static void send_packet(uint16_t length, const wifi_transition *prompt,
+        const wifi_transition *sent)
 {
-    memset(wifi_dev.rx_buffer, 0, WIFI_RX_BUFFER_SIZE);
-    wifi_dev.rx_index = 0;
+    char command_buffer[24];
+    uint8_t command_length = format_text(command_buffer, "AT+CIPSEND=");
+
+    command_length += format_uint(&command_buffer[command_length], length, 1);
+    memcpy(&command_buffer[command_length], "\r\n", 3);
+
+    /* Data is sent when the chip shows the prompt */
+    at_command_send(command_buffer, AT_EVENT_MASK(AT_EVENT_PROMPT),
+            AT_EVENT_MASK(AT_EVENT_ERROR), WIFI_MQTT_TIMEOUT,
+            command_completed, (void *)prompt);
+    at_command_send_data((const uint8_t *)payload, length,
+            AT_EVENT_MASK(AT_EVENT_SEND_OK),
+            AT_EVENT_MASK(AT_EVENT_SEND_FAIL) | AT_EVENT_MASK(AT_EVENT_ERROR),
+            WIFI_MQTT_TIMEOUT, command_completed, (void *)sent);
+
+    scheduler_timer_start(&wifi_keep_alive_timer, WIFI_MQTT_KEEP_ALIVE * 1000UL / 2, 0);
 }
 
 /**
- * @brief Check if response contains string
- * @param str: The string value
- * @return: True if the rx buffer contains the string, false otherwise
+ * @brief Decode the data received on the broker connection
+ * @param data: Received data
+ * @param length: Number of received bytes
  */
-static bool check_response(const char *str)
+static void handle_broker_data(const uint8_t *data, uint16_t length)
 {
-    if (str == NULL)
-        return false;
+    /* HTTP responses are not used */
+    if (wifi_dev.configuration.broker_protocol != WIFI_PROTOCOL_MQTT)
+        return;
+
+    while (length > 0)
+    {
+        mqtt_packet packet;
+        uint16_t count = mqtt_parser_process(&wifi_dev.parser, data, length, &packet);
+
+        data += count;
+        length -= count;
 
-    return (strstr((char *)wifi_dev.rx_buffer, str) != NULL);
+        if (packet.type != MQTT_PACKET_NONE)
+        {
+            handle_broker_packet(&packet);
+        }
+    }
 }
 
 /**
- * @brief Create POST request payload
- * @param payload: Pointer to payload buffer
- * @return: Size of the payload buffer
+ * @brief Move the state machine on packets sent by the broker
+ *
+ * The chip reports SEND OK before the data received in the same TCP
+ * segment, so acknowledgments always arrive in their waiting state.
+ *
+ * @param packet: Decoded broker packet
  */
-static uint16_t create_payload(char *payload)
+static void handle_broker_packet(const mqtt_packet *packet)
 {
-    if (payload == NULL)
-        return 0;
+    switch (packet->type)
+    {
+    case MQTT_PACKET_CONNACK:
+        if (wifi_dev.state != WIFI_MQTT_SESSION_CONNECTING)
+            break;
 
-    char json[128];
-    sprintf(json, "{temperature:%.2f, humidity:%.2f, pressure:%.2f, tvoc:%d, eco2:%d}",
-            environmental_data.temperature,
-            environmental_data.humidity,
-            environmental_data.pressure / 100, /* Convert pressure to hPa */
-            air_quality.tvoc,
-            air_quality.eco2);
-
-    sprintf(payload, "POST /api/v1/%s/telemetry HTTP/1.1\r\n"
-            "Host: 192.168.0.218:8080\r\n"
-            "Content-Type:application/json\r\n"
-            "Content-Length: %d\r\n\r\n%s\r\n",
-            wifi_dev.configuration.broker_token,
-            strlen(json),
-            json);
+        if (packet->return_code == MQTT_CONNECTION_ACCEPTED)
+        {
+            wifi_dev.mqtt_retry_count = 0;
+            wifi_dev.broker_open = true;
+            wifi_dev.state = WIFI_MQTT_CONNECTED;
+        }
+        else
+        {
+            at_command_flush();
+            wifi_dev.state = WIFI_ERROR_MQTT_BROKER;
+        }
+        break;
+
+    case MQTT_PACKET_PUBACK:
+        if (wifi_dev.state == WIFI_MQTT_PUBLISH_WAIT_ACK && packet->packet_id == wifi_dev.packet_id)
+        {
+            scheduler_timer_stop(&wifi_response_timer);
+            batch_delivered();
+            wifi_dev.state = WIFI_MQTT_CONNECTED;
+        }
+        break;
+
+    case MQTT_PACKET_PINGRESP:
+        scheduler_timer_stop(&wifi_response_timer);
+        wifi_dev.ping_pending = false;
+        break;
+
+    default:
+        break;
+    }
+}
+
+/**
+ * @brief Release the delivered telemetry batch, the task runs again when the next replay is due
+ */
+static void batch_delivered(void)
+{
+    wifi_dev.publish_retry_count = 0;
+    telemetry_release();
+    scheduler_timer_start(&wifi_replay_timer, TELEMETRY_REPLAY_INTERVAL, 0);
+}
+
+/**
+ * @brief Check if the time should be queried from the WiFi chip
+ * @return: True if a time query is due, false otherwise
+ */
+static bool time_sync_due(void)
+{
+    if (!system_time_is_valid())
+        return !scheduler_timer_is_active(&wifi_time_retry_timer);
 
-    return strlen(payload);
+    return !scheduler_timer_is_active(&wifi_time_sync_timer);
 }
 
 /**
- * @brief Check if measured data was changed
- * @return: True if measured data like air quality was changed, false otherwise
+ * @brief Check if the state machine only waits for timers or new telemetry
+ * @param state: WiFi state
+ * @return: true if no command or state change is in progress, false otherwise
  */
-static bool measured_data_changed()
+static bool is_idle_state(wifi_state state)
 {
-    if ((environmental_data.pressure != old_environmental_data.pressure)
-        || (environmental_data.temperature != old_environmental_data.temperature)
-        || (environmental_data.humidity != old_environmental_data.humidity))
+    switch (state)
+    {
+    case WIFI_NONE:
+    case WIFI_MQTT_CONNECTED:
+    case WIFI_ERROR_INITIALIZE:
+    case WIFI_ERROR_NETWORK:
+    case WIFI_ERROR_MQTT_BROKER:
+    case WIFI_ERROR_MQTT_PUBLISH:
         return true;
 
-    if ((air_quality.tvoc != old_air_quality.tvoc)
-        || (air_quality.eco2 != old_air_quality.eco2))
+    default:
+        return false;
+    }
+}
+
+/**
+ * @brief Check if the state machine waits to retry a failed step
+ * @param state: WiFi state
+ * @return: true for the error states, false otherwise
+ */
+static bool is_error_state(wifi_state state)
+{
+    switch (state)
+    {
+    case WIFI_ERROR_INITIALIZE:
+    case WIFI_ERROR_NETWORK:
+    case WIFI_ERROR_MQTT_BROKER:
+    case WIFI_ERROR_MQTT_PUBLISH:
         return true;
 
-    return false;
+    default:
+        return false;
+    }
 }
 
 /**
- * @brief Save WiFi configuration to flash
- * @return: True if the configuration was saved, false otherwise
+ * @brief Create publish payload, a POST request or an MQTT PUBLISH packet
+ *
+ * The telemetry batch is formatted after room left for the request header
+ * and moved in place once the header length is known.
+ *
+ * @param payload: Pointer to payload buffer
+ * @param size: Size of the payload buffer
+ * @return: Length of the payload, 0 if there is nothing to send
  */
-static bool save_configuration()
+static uint16_t create_payload(char *payload, uint16_t size)
 {
-    bool result = true;
-    FLASH_EraseInitTypeDef EraseInitStruct = { 0 };
-    uint32_t erase_error = 0;
-    uint32_t flash_address = WIFI_CFG_FLASH_ADDRESS;
-    uint64_t *record = (uint64_t *)&wifi_dev.configuration;
+    if (payload == NULL || size <= WIFI_PAYLOAD_HEADER_SIZE + 2)
+        return 0;
 
-    HAL_FLASH_Unlock();
+    char *json = payload + WIFI_PAYLOAD_HEADER_SIZE;
+    uint16_t json_length = telemetry_format(json, size - WIFI_PAYLOAD_HEADER_SIZE - 2);
 
-    EraseInitStruct.TypeErase = FLASH_TYPEERASE_PAGES;
-    EraseInitStruct.Page      = 63;
-    EraseInitStruct.NbPages   = 1;
+    if (json_length == 0)
+        return 0;
 
-    if (HAL_FLASHEx_Erase(&EraseInitStruct, &erase_error) != HAL_OK)
+    if (wifi_dev.configuration.broker_protocol == WIFI_PROTOCOL_MQTT)
     {
-        return false;
+        uint8_t qos = wifi_dev.configuration.broker_qos;
+
+        /* A retried QoS 1 message keeps its identifier and is flagged as duplicate */
+        bool dup = (qos > 0 && wifi_dev.publish_retry_count > 0);
+        if (qos > 0 && !dup)
+        {
+            wifi_dev.packet_id = (wifi_dev.packet_id == 0xFFFF) ? 1 : wifi_dev.packet_id + 1;
+        }
+
+        return mqtt_encode_publish((uint8_t *)payload, size, WIFI_MQTT_TELEMETRY_TOPIC,
+                (const uint8_t *)json, json_length, qos, wifi_dev.packet_id, dup);
     }
 
-    for (int index = 0; index < sizeof(wifi_dev.configuration);
-            index += 8, flash_address += 8, record++)
+    /* Only the content length changes between requests */
+    uint16_t header_length = wifi_dev.http_header_length;
+
+    if (header_length == 0 || header_length + FORMAT_NUMBER_MAX_LENGTH + 4 > WIFI_PAYLOAD_HEADER_SIZE)
+        return 0;
+
+    memcpy(payload, wifi_dev.http_header, header_length);
+    header_length += format_uint(&payload[header_length], json_length, 1);
+    memcpy(&payload[header_length], "\r\n\r\n", 4);
+    header_length += 4;
+
+    memmove(&payload[header_length], json, json_length);
+    memcpy(&payload[header_length + json_length], "\r\n", 2);
+
+    return header_length + json_length + 2;
+}
+
+/**
+ * @brief Save WiFi configuration to the configuration store
+ * @return: True if the configuration was saved, false otherwise
+ */
+static bool save_configuration()
+{
+    return config_store_write(CONFIG_KEY_WIFI, CONFIG_VERSION,
+            &wifi_dev.configuration, sizeof(wifi_dev.configuration));
+}
+
+/**
+ * @brief Read the WiFi configuration from the configuration store
+ *
+ * A configuration saved by older firmware is moved to the store once, its
+ * page is left as it is.
+ */
+static void read_configuration()
+{
+    if (!config_store_read(CONFIG_KEY_WIFI, CONFIG_VERSION,
+            &wifi_dev.configuration, sizeof(wifi_dev.configuration)))
     {
-        if (HAL_FLASH_Program(FLASH_TYPEPROGRAM_DOUBLEWORD,
-                flash_address, (uint64_t)*record) != HAL_OK)
+        memcpy(&wifi_dev.configuration, wifi_user_data, sizeof(wifi_dev.configuration));
+
+        /* Strings of an erased page are not terminated, an empty SSID was never configured */
+        if (wifi_user_data[0] == 0xFF)
         {
-            result = false;
-            break;
+            memset(&wifi_dev.configuration, 0, sizeof(wifi_dev.configuration));
+        }
+        else if (wifi_user_data[0] != '\0')
+        {
+            save_configuration();
         }
     }
 
-    HAL_FLASH_Lock();
-    return result;
+    /* Configurations saved before the protocol selection use HTTP */
+    if (wifi_dev.configuration.broker_protocol != WIFI_PROTOCOL_MQTT)
+    {
+        wifi_dev.configuration.broker_protocol = WIFI_PROTOCOL_HTTP;
+    }
+
+    if (wifi_dev.configuration.broker_qos > 1)
+    {
+        wifi_dev.configuration.broker_qos = 0;
+    }
+
+    build_http_header();
 }
 
 /**
- * @brief Read the WiFi configuration from flash
+ * @brief Build the constant part of the HTTP request header, up to the content length value
  */
-static void read_configuration()
+static void build_http_header(void)
 {
-    uint8_t *record = (uint8_t*)&wifi_dev.configuration;
+    int length = snprintf(wifi_dev.http_header, sizeof(wifi_dev.http_header),
+            "POST /api/v1/%s/telemetry HTTP/1.1\r\n"
+            "Host: %s:%lu\r\n"
+            "Content-Type: application/json\r\n"
+            "Content-Length: ",
+            wifi_dev.configuration.broker_token,
+            wifi_dev.configuration.broker_address,
+            wifi_dev.configuration.broker_port);
 
-    for (int index = 0; index < sizeof(wifi_dev.configuration); index++)
+    /* A request without complete header is never sent */
+    wifi_dev.http_header_length = (length > 0 && length < sizeof(wifi_dev.http_header)) ? length : 0;
+}
+
+/**
+ * @brief Switch the UART connected to the WiFi chip to a new rate
+ *
+ * The 16 MHz kernel clock needs 8 times oversampling above 1 Mbaud, it also
+ * gives a smaller rate error at the other fast rates.
+ *
+ * @param baud_rate: New UART rate
+ * @return: true if the UART was configured, false otherwise
+ */
+static bool set_baud_rate(uint32_t baud_rate)
+{
+    UART_HandleTypeDef *huart = wifi_dev.uart_handle;
+
+    if (baud_rate == wifi_dev.baud.baud_rate)
+        return true;
+
+    uart_rx_stop(&wifi_rx);
+
+    huart->Init.BaudRate = baud_rate;
+    huart->Init.OverSampling = (baud_rate > WIFI_BAUD_DEFAULT) ? UART_OVERSAMPLING_8 : UART_OVERSAMPLING_16;
+
+    bool result = (HAL_UART_Init(huart) == HAL_OK);
+
+    if (result)
     {
-        *record++ = wifi_user_data[index];
+        wifi_dev.baud.baud_rate = baud_rate;
     }
+
+    /* Bytes received during the switch do not belong to a response */
+    at_tokenizer_reset(&wifi_dev.tokenizer);
+    uart_rx_start(&wifi_rx, huart);
+
+    return result;
 }
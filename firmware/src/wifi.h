@@ -4,6 +4,11 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include "stm32g0xx_hal.h"
+#include "uart_rx.h"
+#include "uart_tx.h"
+#include "at_tokenizer.h"
+#include "at_command.h"
+#include "mqtt.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -12,9 +17,17 @@ extern "C" {
 /**
  * @brief WiFi size related macros
  */
-#define WIFI_RX_BUFFER_SIZE 1024
+#define WIFI_DMA_BUFFER_SIZE 256
+#define WIFI_TX_QUEUE_SIZE   4
 #define WIFI_CFG_STR_SIZE   32
 
+/**
+ * @brief Publish payload size, the largest AT+CIPSEND transfer, and the room
+ *        reserved in it for the HTTP header or MQTT packet header
+ */
+#define WIFI_PAYLOAD_SIZE        2048
+#define WIFI_PAYLOAD_HEADER_SIZE 192
+
 /**
  * @brief Maximum retry count for error recovery
  */
@@ -23,7 +36,49 @@ extern "C" {
 #define WIFI_MQTT_MAX_RETRY    5
 
 /**
- * @brief Configuration flash address
+ * @brief AT command response timeouts in ms
+ */
+#define WIFI_INIT_TIMEOUT    3000
+#define WIFI_BAUD_TIMEOUT    1000
+#define WIFI_NETWORK_TIMEOUT 10000
+#define WIFI_MQTT_TIMEOUT    10000
+
+/**
+ * @brief UART rates of the link to the WiFi chip
+ *
+ * The chip starts at the default rate after every reset. The faster rates
+ * are tried from the fastest down, separated by commas.
+ */
+#define WIFI_BAUD_DEFAULT     115200
+#define WIFI_BAUD_RATES       1500000, 921600, 460800
+#define WIFI_BAUD_WAKEUP_MAX  115200
+
+/**
+ * @brief Pause before a failed step is retried in ms
+ */
+#define WIFI_RETRY_INTERVAL 1000
+
+/**
+ * @brief MQTT session parameters
+ */
+#define WIFI_MQTT_KEEP_ALIVE       60
+#define WIFI_MQTT_TELEMETRY_TOPIC  "v1/devices/me/telemetry"
+
+/**
+ * @brief Protocol used to send telemetry to the broker
+ */
+#define WIFI_PROTOCOL_HTTP 0
+#define WIFI_PROTOCOL_MQTT 1
+
+/**
+ * @brief SNTP time synchronization, intervals in ms
+ */
+#define WIFI_SNTP_SERVER          "pool.ntp.org"
+#define WIFI_TIME_RETRY_INTERVAL  10000
+#define WIFI_TIME_SYNC_INTERVAL   3600000
+
+/**
+ * @brief Configuration flash address of older firmware, the configuration store is used now
  */
 #define WIFI_CFG_FLASH_ADDRESS 0x801F800
 
@@ -49,7 +104,20 @@ typedef enum
     WIFI_ERROR_INITIALIZE,           /**< WiFi chip encountered an error during initialization */
     WIFI_ERROR_NETWORK,              /**< WiFi chip encountered an error while connecting to network */
     WIFI_ERROR_MQTT_BROKER,          /**< WiFi chip encountered an error while connecting to MQTT broker */
-    WIFI_ERROR_MQTT_PUBLISH          /**< WiFi chip encountered an error while publishing data to MQTT broker */
+    WIFI_ERROR_MQTT_PUBLISH,         /**< WiFi chip encountered an error while publishing data to MQTT broker */
+    WIFI_MQTT_SESSION_CONNECT,       /**< Open MQTT session on the broker connection */
+    WIFI_MQTT_SESSION_CONNECTING,    /**< Wait for the broker to accept the MQTT session */
+    WIFI_MQTT_PUBLISH_WAIT_ACK,      /**< Wait for the broker to acknowledge a QoS 1 publish */
+    WIFI_MQTT_PING,                  /**< Send MQTT keep alive request */
+    WIFI_TIME_SYNC,                  /**< Configure SNTP or read the time from the WiFi chip */
+    WIFI_BAUD_NEGOTIATE,             /**< Ask the WiFi chip for the next faster UART rate */
+    WIFI_BAUD_NEGOTIATING,           /**< Wait for the WiFi chip to accept the rate */
+    WIFI_BAUD_SWITCH,                /**< Switch the UART to the accepted rate and check the link */
+    WIFI_BAUD_VERIFYING,             /**< Wait for the WiFi chip to answer at the new rate */
+    WIFI_BAUD_REFUSED,               /**< WiFi chip refused the rate, try the next slower one */
+    WIFI_ERROR_BAUD,                 /**< No answer at the new rate, restart at the default rate */
+    WIFI_BAUD_RESTORE,               /**< Switch the UART back to the default rate */
+    WIFI_BAUD_RESTORING              /**< Wait for the WiFi chip to return to the default rate */
 } wifi_state;
 
 /**
@@ -62,23 +130,42 @@ typedef struct
     char broker_address[WIFI_CFG_STR_SIZE];      /**< MQTT broker ip address */
     uint32_t broker_port;                        /**< MQTT broker port */
     char broker_token[WIFI_CFG_STR_SIZE];        /**< MQTT broker authentication token */
+    uint8_t broker_protocol;                     /**< WIFI_PROTOCOL_HTTP or WIFI_PROTOCOL_MQTT */
+    uint8_t broker_qos;                          /**< MQTT publish quality of service, 0 or 1 */
 } wifi_config;
 
+/**
+ * @brief UART rate negotiation statistics
+ */
+typedef struct
+{
+    uint32_t baud_rate;    /**< Current UART rate */
+    uint32_t switches;     /**< Rate changes accepted by the WiFi chip */
+    uint32_t refused;      /**< Rates refused by the WiFi chip */
+    uint32_t failures;     /**< Rates without answer after the switch */
+} wifi_baud_statistics;
+
 /**
  * @brief WiFi device definition
  */
 typedef struct
 {
     UART_HandleTypeDef *uart_handle;           /**< UART handle connected to WiFi chip */
-    uint8_t rx_buffer[WIFI_RX_BUFFER_SIZE];    /**< Received data from WiFi chip */
-    uint16_t rx_index;                         /**< Current index of received data */
+    at_tokenizer tokenizer;                    /**< Tokenizer for the responses of the WiFi chip */
     wifi_state state;                          /**< Current WiFi state */
-    bool lf_received;                          /**< Line feed received, parse received data */
     uint8_t init_retry_count;                  /**< Initialization retry count */
     uint8_t network_retry_count;               /**< WiFi network connection retry count */
     uint8_t mqtt_retry_count;                  /**< MQTT configuration retry count */
     uint8_t publish_retry_count;               /**< MQTT publish retry count */
     wifi_config configuration;                 /**< WiFi network and broker configuration */
+    mqtt_parser parser;                        /**< Decoder for the packets sent by the MQTT broker */
+    uint16_t packet_id;                        /**< Identifier of the last QoS 1 publish */
+    bool ping_pending;                         /**< MQTT keep alive request sent, no response yet */
+    bool broker_open;                          /**< Broker connection established and not closed */
+    char http_header[WIFI_PAYLOAD_HEADER_SIZE];    /**< Constant part of the HTTP request header */
+    uint8_t http_header_length;                /**< Length of the HTTP header template */
+    uint8_t baud_index;                        /**< Next rate to negotiate in WIFI_BAUD_RATES */
+    wifi_baud_statistics baud;                 /**< UART rate negotiation statistics */
 } wifi_device;
 
 /**
@@ -105,17 +192,71 @@ wifi_state wifi_get_state(void);
  */
 void wifi_get_configuration(wifi_config *config);
 
+/**
+ * @brief Read the statistics of the UART link to the WiFi chip
+ * @param statistics: Pointer to statistics structure
+ */
+void wifi_get_link_statistics(uart_rx_statistics *statistics);
+
+/**
+ * @brief Read the transmission statistics of the UART link to the WiFi chip
+ * @param statistics: Pointer to statistics structure
+ */
+void wifi_get_tx_statistics(uart_tx_statistics *statistics);
+
+/**
+ * @brief Read the UART rate and the negotiation statistics
+ * @param statistics: Pointer to statistics structure
+ */
+void wifi_get_baud_statistics(wifi_baud_statistics *statistics);
+
+/**
+ * @brief Check if the WiFi link keeps working in STOP1
+ *
+ * Start bit wakeup loses the first bytes above WIFI_BAUD_WAKEUP_MAX, so a
+ * fast link needs the device awake while a response is expected and while
+ * the broker connection is open.
+ *
+ * @return: true if STOP1 can be entered, false otherwise
+ */
+bool wifi_stop_allowed(void);
+
+/**
+ * @brief Read the AT command statistics of the WiFi chip
+ * @param statistics: Pointer to statistics structure
+ */
+void wifi_get_command_statistics(at_command_statistics *statistics);
+
 /**
  * @brief WiFi handler for the state machine
+ * The handler is a scheduler task posted on UART events and by its own timer.
  */
 void wifi_handler(void);
 
 /**
- * @brief WiFi UART rx callback
- * This function is called everytime a byte was received by the UART
+ * @brief Run the WiFi handler as soon as possible, used when new telemetry is available
+ */
+void wifi_trigger_handler(void);
+
+/**
+ * @brief WiFi UART rx event callback
+ * This function is called on DMA half transfer, transfer complete and idle line events
  * @param huart: UART handle that received data
+ * @param position: Current position in the DMA buffer
+ */
+void wifi_rx_event_callback(UART_HandleTypeDef *huart, uint16_t position);
+
+/**
+ * @brief WiFi UART error callback, restarts reception and releases a failed transfer
+ * @param huart: UART handle that reported the error
+ */
+void wifi_error_callback(UART_HandleTypeDef *huart);
+
+/**
+ * @brief WiFi UART tx complete callback
+ * @param huart: UART handle that finished the transmission
  */
-void wifi_rx_callback(UART_HandleTypeDef *huart);
+void wifi_tx_callback(UART_HandleTypeDef *huart);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,387 @@
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <time.h>
+#include "bme280_compensation.h"
+
+/**
+ * @brief Sweep limits, the operating range of the BME280
+ */
+#define TEMPERATURE_MIN  -40.0
+#define TEMPERATURE_MAX  85.0
+#define PRESSURE_MIN     30000.0
+#define PRESSURE_MAX     110000.0
+
+/**
+ * @brief Largest accepted error against the double precision algorithm
+ */
+#define TEMPERATURE_TOLERANCE  0.01     /**< degC, one result step */
+#define PRESSURE_TOLERANCE     1.0      /**< Pa, 64-bit variant */
+#define PRESSURE_32_TOLERANCE  8.0      /**< Pa, 32-bit variant */
+#define HUMIDITY_TOLERANCE     0.02     /**< %RH */
+
+/**
+ * @brief Calls per benchmark run
+ */
+#define BENCHMARK_CALLS 10000000
+
+/**
+ * @brief Calibration data used for the sweeps
+ */
+typedef struct
+{
+    const char *name;
+    bme280_calibration_data calibration;
+} calibration_set;
+
+/**
+ * @brief Largest error of a compensation variant
+ */
+typedef struct
+{
+    double max_error;
+    double worst_input;
+    double worst_output;
+    double worst_reference;
+    unsigned long samples;
+} sweep_result;
+
+/**
+ * @brief Datasheet example calibration and a second set with other magnitudes and signs
+ */
+static const calibration_set calibration_sets[] = {
+    {
+        "datasheet",
+        {
+            .dig_t1 = 27504, .dig_t2 = 26435, .dig_t3 = -1000,
+            .dig_p1 = 36477, .dig_p2 = -10685, .dig_p3 = 3024, .dig_p4 = 2855, .dig_p5 = 140,
+            .dig_p6 = -7, .dig_p7 = 15500, .dig_p8 = -14600, .dig_p9 = 6000,
+            .dig_h1 = 75, .dig_h2 = 362, .dig_h3 = 0, .dig_h4 = 313, .dig_h5 = 50, .dig_h6 = 30
+        }
+    },
+    {
+        "alternate",
+        {
+            .dig_t1 = 28485, .dig_t2 = 26735, .dig_t3 = 50,
+            .dig_p1 = 36738, .dig_p2 = -10635, .dig_p3 = 3024, .dig_p4 = 6980, .dig_p5 = -4,
+            .dig_p6 = -7, .dig_p7 = 9900, .dig_p8 = -10230, .dig_p9 = 4285,
+            .dig_h1 = 75, .dig_h2 = 370, .dig_h3 = 0, .dig_h4 = 297, .dig_h5 = 50, .dig_h6 = 30
+        }
+    },
+};
+
+#define CALIBRATION_SET_COUNT (sizeof(calibration_sets) / sizeof(calibration_sets[0]))
+
+/**
+ * @brief Temperatures of the pressure and humidity sweeps in degC
+ */
+static const double sweep_temperatures[] = { -40.0, 0.0, 25.0, 60.0, 85.0 };
+
+#define SWEEP_TEMPERATURE_COUNT (sizeof(sweep_temperatures) / sizeof(sweep_temperatures[0]))
+
+/**
+ * @brief Keeps the benchmarked results alive
+ */
+static volatile uint32_t benchmark_sink;
+
+static double reference_t_fine(const bme280_calibration_data *calibration, int32_t adc_temperature);
+static double reference_pressure(const bme280_calibration_data *calibration, int32_t adc_pressure,
+        double t_fine);
+static double reference_humidity(const bme280_calibration_data *calibration, int32_t adc_humidity,
+        double t_fine);
+static int32_t adc_for_temperature(const bme280_calibration_data *calibration, double temperature);
+static void update_result(sweep_result *result, double input, double output, double reference);
+static bool report(const char *set, const char *name, const sweep_result *result,
+        const char *unit, double tolerance);
+static bool check_datasheet_example(void);
+static bool sweep(const calibration_set *set);
+static void benchmark(const bme280_calibration_data *calibration);
+static double elapsed_ns(const struct timespec *start, const struct timespec *end);
+
+int main(void)
+{
+    bool passed = check_datasheet_example();
+
+    for (unsigned int index = 0; index < CALIBRATION_SET_COUNT; index++)
+    {
+        passed &= sweep(&calibration_sets[index]);
+    }
+
+    benchmark(&calibration_sets[0].calibration);
+
+    printf("%s\n", passed ? "PASSED" : "FAILED");
+    return passed ? 0 : 1;
+}
+
+/**
+ * @brief Double precision temperature algorithm from the BME280 datasheet
+ * @param calibration: Calibration data
+ * @param adc_temperature: ADC reading for temperature
+ * @return: Fine temperature, degC * 5120
+ */
+static double reference_t_fine(const bme280_calibration_data *calibration, int32_t adc_temperature)
+{
+    double var1 = (adc_temperature / 16384.0 - calibration->dig_t1 / 1024.0) * calibration->dig_t2;
+    double var2 = adc_temperature / 131072.0 - calibration->dig_t1 / 8192.0;
+
+    return var1 + var2 * var2 * calibration->dig_t3;
+}
+
+/**
+ * @brief Double precision pressure algorithm from the BME280 datasheet
+ * @param calibration: Calibration data
+ * @param adc_pressure: ADC reading for pressure
+ * @param t_fine: Fine temperature
+ * @return: Pressure in Pa
+ */
+static double reference_pressure(const bme280_calibration_data *calibration, int32_t adc_pressure,
+        double t_fine)
+{
+    double var1 = t_fine / 2.0 - 64000.0;
+    double var2 = var1 * var1 * calibration->dig_p6 / 32768.0;
+
+    var2 = var2 + var1 * calibration->dig_p5 * 2.0;
+    var2 = var2 / 4.0 + calibration->dig_p4 * 65536.0;
+    var1 = (calibration->dig_p3 * var1 * var1 / 524288.0 + calibration->dig_p2 * var1) / 524288.0;
+    var1 = (1.0 + var1 / 32768.0) * calibration->dig_p1;
+
+    if (var1 == 0.0)
+        return 0.0;
+
+    double pressure = 1048576.0 - adc_pressure;
+    pressure = (pressure - var2 / 4096.0) * 6250.0 / var1;
+    var1 = calibration->dig_p9 * pressure * pressure / 2147483648.0;
+    var2 = pressure * calibration->dig_p8 / 32768.0;
+
+    return pressure + (var1 + var2 + calibration->dig_p7) / 16.0;
+}
+
+/**
+ * @brief Double precision humidity algorithm from the BME280 datasheet
+ * @param calibration: Calibration data
+ * @param adc_humidity: ADC reading for humidity
+ * @param t_fine: Fine temperature
+ * @return: Relative humidity in %
+ */
+static double reference_humidity(const bme280_calibration_data *calibration, int32_t adc_humidity,
+        double t_fine)
+{
+    double h4 = (int16_t)calibration->dig_h4;
+    double humidity = t_fine - 76800.0;
+
+    humidity = (adc_humidity - (h4 * 64.0 + calibration->dig_h5 / 16384.0 * humidity))
+            * (calibration->dig_h2 / 65536.0 * (1.0 + calibration->dig_h6 / 67108864.0 * humidity
+            * (1.0 + calibration->dig_h3 / 67108864.0 * humidity)));
+    humidity = humidity * (1.0 - calibration->dig_h1 * humidity / 524288.0);
+
+    if (humidity > 100.0)
+        return 100.0;
+
+    return (humidity < 0.0) ? 0.0 : humidity;
+}
+
+/**
+ * @brief Find the temperature ADC reading closest to a temperature
+ * @param calibration: Calibration data
+ * @param temperature: Temperature in degC
+ * @return: ADC reading
+ */
+static int32_t adc_for_temperature(const bme280_calibration_data *calibration, double temperature)
+{
+    int32_t low = 0;
+    int32_t high = (1 << 20) - 1;
+
+    /* The temperature rises with the reading over the operating range */
+    while (low < high)
+    {
+        int32_t middle = (low + high) / 2;
+
+        if (reference_t_fine(calibration, middle) / 5120.0 < temperature)
+        {
+            low = middle + 1;
+        }
+        else
+        {
+            high = middle;
+        }
+    }
+
+    return low;
+}
+
+static void update_result(sweep_result *result, double input, double output, double reference)
+{
+    double error = fabs(output - reference);
+
+    result->samples++;
+
+    if (error > result->max_error)
+    {
+        result->max_error = error;
+        result->worst_input = input;
+        result->worst_output = output;
+        result->worst_reference = reference;
+    }
+}
+
+static bool report(const char *set, const char *name, const sweep_result *result,
+        const char *unit, double tolerance)
+{
+    bool passed = (result->samples > 0) && (result->max_error <= tolerance);
+
+    printf("%-10s %-12s %9lu samples, max error %.4f %s (adc %.0f: %.4f, reference %.4f) %s\n",
+            set, name, result->samples, result->max_error, unit, result->worst_input,
+            result->worst_output, result->worst_reference, passed ? "ok" : "FAIL");
+
+    return passed;
+}
+
+/**
+ * @brief Check the worked example of the datasheet
+ * @return: true if the results match it
+ */
+static bool check_datasheet_example(void)
+{
+    const bme280_calibration_data *calibration = &calibration_sets[0].calibration;
+    bme280_compensation compensation;
+    int32_t t_fine = 0;
+
+    bme280_compensation_init(&compensation, calibration);
+
+    /* Datasheet: 25.08 degC, t_fine 128422 and 100653.27 Pa, rounded by the 64-bit variant */
+    int32_t temperature = bme280_compensate_temperature(&compensation, 519888, &t_fine);
+    uint32_t pressure = bme280_compensate_pressure(&compensation, 415148, t_fine);
+    uint32_t pressure_32 = bme280_compensate_pressure_32(&compensation, 415148, t_fine);
+    double reference = reference_pressure(calibration, 415148, reference_t_fine(calibration, 519888));
+
+    bool passed = (temperature == 2508) && (t_fine == 128422) && (pressure == 100653)
+            && (fabs(pressure_32 - reference) <= PRESSURE_32_TOLERANCE);
+
+    printf("datasheet example: %ld.%02ld degC, t_fine %ld, %lu Pa, %lu Pa (32-bit), %.2f Pa (double) %s\n",
+            (long)(temperature / 100), (long)(temperature % 100), (long)t_fine,
+            (unsigned long)pressure, (unsigned long)pressure_32, reference, passed ? "ok" : "FAIL");
+
+    return passed;
+}
+
+/**
+ * @brief Compare every variant with the double precision algorithms over the operating range
+ * @param set: Calibration data
+ * @return: true if every variant stays within its tolerance
+ */
+static bool sweep(const calibration_set *set)
+{
+    const bme280_calibration_data *calibration = &set->calibration;
+    bme280_compensation compensation;
+    sweep_result temperature = { 0 };
+    sweep_result pressure = { 0 };
+    sweep_result pressure_32 = { 0 };
+    sweep_result humidity = { 0 };
+
+    bme280_compensation_init(&compensation, calibration);
+
+    int32_t adc_min = adc_for_temperature(calibration, TEMPERATURE_MIN);
+    int32_t adc_max = adc_for_temperature(calibration, TEMPERATURE_MAX);
+
+    for (int32_t adc = adc_min; adc <= adc_max; adc++)
+    {
+        int32_t t_fine = 0;
+        int32_t result = bme280_compensate_temperature(&compensation, adc, &t_fine);
+
+        update_result(&temperature, adc, result / 100.0, reference_t_fine(calibration, adc) / 5120.0);
+    }
+
+    for (unsigned int index = 0; index < SWEEP_TEMPERATURE_COUNT; index++)
+    {
+        int32_t adc_temperature = adc_for_temperature(calibration, sweep_temperatures[index]);
+        double reference_fine = reference_t_fine(calibration, adc_temperature);
+        int32_t t_fine = 0;
+
+        bme280_compensate_temperature(&compensation, adc_temperature, &t_fine);
+
+        for (int32_t adc = 0; adc < (1 << 20); adc++)
+        {
+            double reference = reference_pressure(calibration, adc, reference_fine);
+
+            if (reference < PRESSURE_MIN || reference > PRESSURE_MAX)
+                continue;
+
+            update_result(&pressure, adc, bme280_compensate_pressure(&compensation, adc, t_fine),
+                    reference);
+            update_result(&pressure_32, adc, bme280_compensate_pressure_32(&compensation, adc, t_fine),
+                    reference);
+        }
+
+        for (int32_t adc = 0; adc < (1 << 16); adc++)
+        {
+            double reference = reference_humidity(calibration, adc, reference_fine);
+
+            update_result(&humidity, adc,
+                    bme280_compensate_humidity(&compensation, adc, t_fine) / 1000.0, reference);
+        }
+    }
+
+    bool passed = report(set->name, "temperature", &temperature, "degC", TEMPERATURE_TOLERANCE);
+    passed &= report(set->name, "pressure", &pressure, "Pa", PRESSURE_TOLERANCE);
+    passed &= report(set->name, "pressure_32", &pressure_32, "Pa", PRESSURE_32_TOLERANCE);
+    passed &= report(set->name, "humidity", &humidity, "%RH", HUMIDITY_TOLERANCE);
+
+    return passed;
+}
+
+/**
+ * @brief Measure the host time per call of every variant
+ * @param calibration: Calibration data
+ */
+static void benchmark(const bme280_calibration_data *calibration)
+{
+    bme280_compensation compensation;
+    struct timespec start;
+    struct timespec end;
+    uint32_t sum = 0;
+    int32_t t_fine = 0;
+
+    bme280_compensation_init(&compensation, calibration);
+    bme280_compensate_temperature(&compensation, 519888, &t_fine);
+
+    /* The readings change on every call so nothing is hoisted out of the loop */
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int32_t call = 0; call < BENCHMARK_CALLS; call++)
+    {
+        int32_t fine = 0;
+        sum += (uint32_t)bme280_compensate_temperature(&compensation, 500000 + (call & 0x3FFF), &fine);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    printf("benchmark  temperature  %6.2f ns/call\n", elapsed_ns(&start, &end) / BENCHMARK_CALLS);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int32_t call = 0; call < BENCHMARK_CALLS; call++)
+    {
+        sum += bme280_compensate_pressure(&compensation, 400000 + (call & 0x3FFF), t_fine);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    printf("benchmark  pressure     %6.2f ns/call\n", elapsed_ns(&start, &end) / BENCHMARK_CALLS);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int32_t call = 0; call < BENCHMARK_CALLS; call++)
+    {
+        sum += bme280_compensate_pressure_32(&compensation, 400000 + (call & 0x3FFF), t_fine);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    printf("benchmark  pressure_32  %6.2f ns/call\n", elapsed_ns(&start, &end) / BENCHMARK_CALLS);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int32_t call = 0; call < BENCHMARK_CALLS; call++)
+    {
+        sum += bme280_compensate_humidity(&compensation, 30000 + (call & 0x3FFF), t_fine);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    printf("benchmark  humidity     %6.2f ns/call\n", elapsed_ns(&start, &end) / BENCHMARK_CALLS);
+
+    benchmark_sink = sum;
+}
+
+static double elapsed_ns(const struct timespec *start, const struct timespec *end)
+{
+    return (end->tv_sec - start->tv_sec) * 1e9 + (end->tv_nsec - start->tv_nsec);
+}
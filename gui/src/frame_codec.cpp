@@ -0,0 +1,142 @@
+#include "frame_codec.hpp"
+#include <QString>
+
+namespace FrameCodec
+{
+
+// CRC-16/CCITT-FALSE, the setting of the device CRC unit
+quint16 crc16(const QByteArray &data)
+{
+    quint16 crc = 0xFFFF;
+
+    for (const char byte : data)
+    {
+        crc ^= static_cast<quint16>(static_cast<quint8>(byte) << 8);
+
+        for (int bit = 0; bit < 8; bit++)
+        {
+            crc = (crc & 0x8000) ? static_cast<quint16>((crc << 1) ^ 0x1021)
+                                 : static_cast<quint16>(crc << 1);
+        }
+    }
+
+    return crc;
+}
+
+QByteArray encode(const Frame &frame)
+{
+    QByteArray raw;
+    appendU8(raw, frame.command);
+    appendU8(raw, frame.sequence);
+    appendU8(raw, frame.status);
+    raw.append(frame.payload);
+    appendU16(raw, crc16(raw));
+
+    // The leading delimiter drops any partial text line on the device
+    QByteArray encoded;
+    encoded.append(Delimiter);
+
+    int codePosition = encoded.size();
+    encoded.append(char(0));
+    quint8 code = 1;
+
+    for (const char byte : raw)
+    {
+        if (byte != 0)
+        {
+            encoded.append(byte);
+            code++;
+        }
+
+        if (byte == 0 || code == 0xFF)
+        {
+            encoded[codePosition] = static_cast<char>(code);
+            codePosition = encoded.size();
+            encoded.append(char(0));
+            code = 1;
+        }
+    }
+
+    encoded[codePosition] = static_cast<char>(code);
+    encoded.append(Delimiter);
+    return encoded;
+}
+
+bool decode(const QByteArray &data, Frame &frame)
+{
+    QByteArray raw;
+    int position = 0;
+
+    while (position < data.size())
+    {
+        const quint8 code = static_cast<quint8>(data.at(position++));
+
+        if (code == 0 || position + code - 1 > data.size())
+            return false;
+
+        raw.append(data.mid(position, code - 1));
+        position += code - 1;
+
+        if (code < 0xFF && position < data.size())
+            raw.append(char(0));
+    }
+
+    if (raw.size() < HeaderSize + CrcSize)
+        return false;
+
+    const int length = raw.size() - CrcSize;
+    if (readU16(raw, length) != crc16(raw.left(length)))
+        return false;
+
+    frame.command = static_cast<quint8>(raw.at(0));
+    frame.sequence = static_cast<quint8>(raw.at(1));
+    frame.status = static_cast<quint8>(raw.at(2));
+    frame.payload = raw.mid(HeaderSize, length - HeaderSize);
+    return true;
+}
+
+void appendU8(QByteArray &payload, quint8 value)
+{
+    payload.append(static_cast<char>(value));
+}
+
+void appendU16(QByteArray &payload, quint16 value)
+{
+    appendU8(payload, static_cast<quint8>(value));
+    appendU8(payload, static_cast<quint8>(value >> 8));
+}
+
+void appendU32(QByteArray &payload, quint32 value)
+{
+    appendU16(payload, static_cast<quint16>(value));
+    appendU16(payload, static_cast<quint16>(value >> 16));
+}
+
+void appendString(QByteArray &payload, const QString &value, int size)
+{
+    // Null padded, the last byte is always a terminating null character
+    QByteArray text = value.toLatin1().left(size - 1);
+    text.append(QByteArray(size - text.size(), char(0)));
+    payload.append(text);
+}
+
+quint16 readU16(const QByteArray &payload, int position)
+{
+    return static_cast<quint16>(static_cast<quint8>(payload.at(position))
+        | (static_cast<quint8>(payload.at(position + 1)) << 8));
+}
+
+quint32 readU32(const QByteArray &payload, int position)
+{
+    return readU16(payload, position)
+        | (static_cast<quint32>(readU16(payload, position + 2)) << 16);
+}
+
+QString readString(const QByteArray &payload, int position, int size)
+{
+    const QByteArray text = payload.mid(position, size);
+    const int end = text.indexOf(char(0));
+    return QString::fromLatin1(end < 0 ? text : text.left(end));
+}
+
+}
@@ -0,0 +1,63 @@
+#ifndef FRAME_CODEC_HPP
+#define FRAME_CODEC_HPP
+
+#include <QByteArray>
+#include <QString>
+
+// Binary protocol of the device PC UART, see pc_frame.h in the firmware
+namespace FrameCodec
+{
+    enum Command : quint8
+    {
+        CMD_NONE,
+        CMD_PING,
+        CMD_SENSORS,
+        CMD_AGGREGATES,
+        CMD_WIFI_GET,
+        CMD_WIFI_SET,
+        CMD_TELEMETRY_GET,
+        CMD_TELEMETRY_SET,
+        CMD_POLICY_SET,
+        CMD_BME280_SET,
+        CMD_ACQUISITION_SET,
+        CMD_FILTER_SET,
+        CMD_STREAM,
+        CMD_STREAM_RECORD,
+    };
+
+    enum Status : quint8
+    {
+        STATUS_OK,
+        STATUS_FAILED,
+        STATUS_UNKNOWN_COMMAND,
+        STATUS_BAD_LENGTH,
+    };
+
+    struct Frame
+    {
+        quint8 command = CMD_NONE;
+        quint8 sequence = 0;
+        quint8 status = STATUS_OK;
+        QByteArray payload;
+    };
+
+    const char Delimiter = 0x00;
+    const int HeaderSize = 3;
+    const int CrcSize = 2;
+    const int MaxPayload = 240;
+    const int WifiStringSize = 32;
+
+    quint16 crc16(const QByteArray &data);
+    QByteArray encode(const Frame &frame);
+    bool decode(const QByteArray &data, Frame &frame);
+
+    void appendU8(QByteArray &payload, quint8 value);
+    void appendU16(QByteArray &payload, quint16 value);
+    void appendU32(QByteArray &payload, quint32 value);
+    void appendString(QByteArray &payload, const QString &value, int size);
+    quint16 readU16(const QByteArray &payload, int position);
+    quint32 readU32(const QByteArray &payload, int position);
+    QString readString(const QByteArray &payload, int position, int size);
+}
+
+#endif // FRAME_CODEC_HPP
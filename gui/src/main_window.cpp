@@ -5,15 +5,14 @@
 #include <QSerialPortInfo>
 #include <QListWidgetItem>
 #include <QMessageBox>
-#include <QJsonDocument>
-#include <QJsonObject>
-#include <QJsonValue>
 #include "version.hpp"
 #include <QDebug>
 
 MainWindow::MainWindow(QWidget *parent)
     : QMainWindow(parent)
     , ui(new Ui::MainWindow)
+    , m_sequence(0)
+    , m_streamSequence(0)
 {
     ui->setupUi(this);
 
@@ -26,6 +25,10 @@ MainWindow::MainWindow(QWidget *parent)
     ui->editMqttPort->setInputMask("0000");
     ui->editMqttPort->setText("8080");
     ui->editMqttToken->setPlaceholderText("Authentication token");
+    ui->cbxMqttProtocol->addItem(QStringLiteral("HTTP"));
+    ui->cbxMqttProtocol->addItem(QStringLiteral("MQTT"));
+    ui->cbxMqttQos->addItem(QStringLiteral("0"));
+    ui->cbxMqttQos->addItem(QStringLiteral("1"));
 
     m_serialPort = new QSerialPort(this);
     m_serialPort->setBaudRate(QSerialPort::Baud115200);
@@ -43,6 +46,7 @@ MainWindow::MainWindow(QWidget *parent)
     connect(ui->actionToggleConnection, SIGNAL(triggered()), this, SLOT(toggleConnection()));
     connect(ui->actionLoadSerialPorts, SIGNAL(triggered()), this, SLOT(loadSerialPorts()));
     connect(ui->actionReadSensors, SIGNAL(triggered()), this, SLOT(readSensors()));
+    connect(ui->actionStreamSensors, SIGNAL(toggled(bool)), this, SLOT(toggleStream(bool)));
     connect(ui->actionReadConfiguration, SIGNAL(triggered()), this, SLOT(readConfiguration()));
     connect(ui->actionSendConfiguration, SIGNAL(triggered()), this, SLOT(configureDevice()));
 
@@ -129,29 +133,43 @@ void MainWindow::toggleConnection()
 
 void MainWindow::readConfiguration()
 {
-    const QString command = "STATUS\r\n";
     logMessage(MSG_INFORMATION, "Reading configuration...");
-    m_serialPort->write(command.toLatin1());
+    sendFrame(FrameCodec::CMD_WIFI_GET);
 }
 
 void MainWindow::readSensors()
 {
-    const QString command = "SENSORS\r\n";
     logMessage(MSG_INFORMATION, "Reading sensors...");
-    m_serialPort->write(command.toLatin1());
+    sendFrame(FrameCodec::CMD_SENSORS);
+}
+
+void MainWindow::toggleStream(bool enabled)
+{
+    if (!m_serialPort->isOpen())
+        return;
+
+    // All five channels, every measurement
+    QByteArray payload;
+    FrameCodec::appendU8(payload, 0x1F);
+    FrameCodec::appendU16(payload, enabled ? 1 : 0);
+
+    logMessage(MSG_INFORMATION, enabled ? "Starting sensors stream..." : "Stopping sensors stream...");
+    sendFrame(FrameCodec::CMD_STREAM, payload);
 }
 
 void MainWindow::configureDevice()
 {
-    QString command = "WIFICFG|"
-        + ui->editWiFiNetwork->text() + "|"
-        + ui->editWiFiPassword->text() + "|"
-        + ui->editMqttIpAddress->text() + "|"
-        + ui->editMqttPort->text() + "|"
-        + ui->editMqttToken->text() + "|\r\n";
+    QByteArray payload;
+    FrameCodec::appendString(payload, ui->editWiFiNetwork->text(), FrameCodec::WifiStringSize);
+    FrameCodec::appendString(payload, ui->editWiFiPassword->text(), FrameCodec::WifiStringSize);
+    FrameCodec::appendString(payload, ui->editMqttIpAddress->text(), FrameCodec::WifiStringSize);
+    FrameCodec::appendU32(payload, ui->editMqttPort->text().toUInt());
+    FrameCodec::appendString(payload, ui->editMqttToken->text(), FrameCodec::WifiStringSize);
+    FrameCodec::appendU8(payload, ui->cbxMqttProtocol->currentIndex());
+    FrameCodec::appendU8(payload, ui->cbxMqttQos->currentIndex());
 
     logMessage(MSG_INFORMATION, "Sending configuration...");
-    m_serialPort->write(command.toLatin1());
+    sendFrame(FrameCodec::CMD_WIFI_SET, payload);
 }
 
 void MainWindow::loadSerialPorts()
@@ -181,13 +199,23 @@ void MainWindow::loadSerialPorts()
 
 void MainWindow::readSerialData()
 {
-    const QByteArray data = m_serialPort->readAll();
-    m_receivedData.append(data);
+    m_receivedData.append(m_serialPort->readAll());
 
-    if (m_receivedData.at(m_receivedData.size() - 1) == 0x0A)
+    // Every frame is sent between two delimiters, empty chunks are skipped
+    int delimiter;
+    while ((delimiter = m_receivedData.indexOf(FrameCodec::Delimiter)) >= 0)
     {
-        parseReceivedData();
-        m_receivedData.clear();
+        const QByteArray encoded = m_receivedData.left(delimiter);
+        m_receivedData.remove(0, delimiter + 1);
+
+        if (encoded.isEmpty())
+            continue;
+
+        FrameCodec::Frame frame;
+        if (FrameCodec::decode(encoded, frame))
+            handleFrame(frame);
+        else
+            logMessage(MSG_ERROR, "Invalid frame received.");
     }
 }
 
@@ -224,6 +252,9 @@ void MainWindow::connectDevice()
     m_serialPort->setFlowControl(static_cast<QSerialPort::FlowControl>(
                             ui->cbxFlowControl->itemData(ui->cbxFlowControl->currentIndex()).toInt()));
 
+    m_receivedData.clear();
+    m_pendingRequests.clear();
+
     if (!m_serialPort->open(QIODevice::ReadWrite))
     {
         logMessage(MSG_ERROR, "Unable to open serial port "
@@ -294,6 +325,9 @@ void MainWindow::toggleControls(bool connected)
     ui->btnToggleConnection->setText(connectionLabel);
 
     ui->actionReadSensors->setEnabled(connected);
+    ui->actionStreamSensors->setEnabled(connected);
+    if (!connected)
+        ui->actionStreamSensors->setChecked(false);
     ui->actionReadConfiguration->setEnabled(connected);
     ui->actionSendConfiguration->setEnabled(connected);
     ui->actionLoadSerialPorts->setEnabled(!connected);
@@ -338,57 +372,131 @@ void MainWindow::logMessage(MessageType type, QString message)
     ui->logView->scrollToBottom();
 }
 
-void MainWindow::parseReceivedData()
+void MainWindow::sendFrame(quint8 command, const QByteArray &payload)
 {
-    qDebug() << QString(m_receivedData);
-    QJsonParseError jsonError;
-    QJsonDocument json = QJsonDocument::fromJson(m_receivedData, &jsonError);
+    FrameCodec::Frame frame;
+    frame.command = command;
+    frame.sequence = m_sequence++;
+    frame.payload = payload;
+
+    m_pendingRequests.insert(frame.sequence, command);
+    m_serialPort->write(FrameCodec::encode(frame));
+}
 
-    if (jsonError.error != 0)
+void MainWindow::handleFrame(const FrameCodec::Frame &frame)
+{
+    if (frame.command == FrameCodec::CMD_STREAM_RECORD)
+    {
+        handleStreamRecord(frame);
+        return;
+    }
+
+    if (m_pendingRequests.value(frame.sequence, FrameCodec::CMD_NONE) != frame.command)
     {
-        logMessage(MSG_ERROR, jsonError.errorString());
+        logMessage(MSG_WARNING, "Unexpected reply to command "
+                   + QString::number(frame.command) + " received.");
         return;
     }
 
-    QJsonObject root = json.object();
-    if (root.contains("status"))
+    m_pendingRequests.remove(frame.sequence);
+
+    if (frame.command == FrameCodec::CMD_WIFI_SET)
     {
-        QJsonValue status = root.value("status");
-        if (status.toString() == "OK")
+        if (frame.status == FrameCodec::STATUS_OK)
             logMessage(MSG_ACTION, "Configuration sent.");
         else
-            logMessage(MSG_ERROR, " Error sending configuration.");
+            logMessage(MSG_ERROR, "Error sending configuration.");
     }
-    else if (root.contains("wifi_state"))
+    else if (frame.status != FrameCodec::STATUS_OK)
     {
-        QJsonValue wifi_state = root.value("wifi_state");
-        ui->editWiFiStatus->setText(wifiStateToString(wifi_state.toInt()));
-        QJsonValue wifi_ssid = root.value("wifi_ssid");
-        ui->editWiFiNetwork->setText(wifi_ssid.toString());
-        QJsonValue wifi_password = root.value("wifi_password");
-        ui->editWiFiPassword->setText(wifi_password.toString());
-        QJsonValue broker_address = root.value("broker_address");
-        ui->editMqttIpAddress->setText(broker_address.toString());
-        QJsonValue broker_port = root.value("broker_port");
-        ui->editMqttPort->setText(broker_port.toString());
-        QJsonValue broker_token = root.value("broker_token");
-        ui->editMqttToken->setText(broker_token.toString());
+        logMessage(MSG_ERROR, "Command " + QString::number(frame.command)
+                   + " failed with status " + QString::number(frame.status) + ".");
+    }
+    else if (frame.command == FrameCodec::CMD_WIFI_GET
+             && frame.payload.size() >= 4 * FrameCodec::WifiStringSize + 7)
+    {
+        const QByteArray &payload = frame.payload;
+        const int size = FrameCodec::WifiStringSize;
+
+        ui->editWiFiStatus->setText(wifiStateToString(payload.at(0)));
+        ui->editWiFiNetwork->setText(FrameCodec::readString(payload, 1, size));
+        ui->editWiFiPassword->setText(FrameCodec::readString(payload, 1 + size, size));
+        ui->editMqttIpAddress->setText(FrameCodec::readString(payload, 1 + 2 * size, size));
+        ui->editMqttPort->setText(QString::number(FrameCodec::readU32(payload, 1 + 3 * size)));
+        ui->editMqttToken->setText(FrameCodec::readString(payload, 5 + 3 * size, size));
+        ui->cbxMqttProtocol->setCurrentIndex(payload.at(5 + 4 * size));
+        ui->cbxMqttQos->setCurrentIndex(payload.at(6 + 4 * size));
         logMessage(MSG_ACTION, "WiFi configuration received.");
     }
-    else if (root.contains("temperature"))
+    else if (frame.command == FrameCodec::CMD_SENSORS && frame.payload.size() >= 16)
     {
-        QJsonValue temperature = root.value("temperature");
-        ui->editTemperature->setText(temperature.toString());
-        QJsonValue humidity = root.value("humidity");
-        ui->editHumidity->setText(humidity.toString());
-        QJsonValue pressure = root.value("pressure");
-        ui->editPressure->setText(pressure.toString());
-        QJsonValue tvoc = root.value("tvoc");
-        ui->editTVoc->setText(tvoc.toString());
-        QJsonValue eco2 = root.value("eco2");
-        ui->editECo2->setText(eco2.toString());
+        const QByteArray &payload = frame.payload;
+        const qint32 temperature = static_cast<qint32>(FrameCodec::readU32(payload, 0));
+
+        showSensorValue(0, temperature);
+        showSensorValue(1, FrameCodec::readU32(payload, 4));
+        showSensorValue(2, FrameCodec::readU32(payload, 8));
+        showSensorValue(3, FrameCodec::readU16(payload, 12));
+        showSensorValue(4, FrameCodec::readU16(payload, 14));
         logMessage(MSG_ACTION, "Sensors values received.");
     }
+    else if (frame.command == FrameCodec::CMD_STREAM && frame.payload.size() >= 4)
+    {
+        m_streamSequence = FrameCodec::readU32(frame.payload, 0);
+        logMessage(MSG_ACTION, ui->actionStreamSensors->isChecked() ?
+                   "Sensors stream started." : "Sensors stream stopped.");
+    }
+}
+
+void MainWindow::handleStreamRecord(const FrameCodec::Frame &frame)
+{
+    const QByteArray &payload = frame.payload;
+    if (payload.size() < 9)
+        return;
+
+    // The device counts records dropped on a full transmit queue, a gap shows the loss
+    const quint32 sequence = FrameCodec::readU32(payload, 0);
+    if (sequence != m_streamSequence)
+    {
+        logMessage(MSG_WARNING, QString::number(sequence - m_streamSequence)
+                   + " stream records lost.");
+    }
+    m_streamSequence = sequence + 1;
+
+    const quint8 channels = static_cast<quint8>(payload.at(8));
+    int position = 9;
+
+    for (int channel = 0; channel < 5 && position + 4 <= payload.size(); channel++)
+    {
+        if (channels & (1 << channel))
+        {
+            showSensorValue(channel, static_cast<qint32>(FrameCodec::readU32(payload, position)));
+            position += 4;
+        }
+    }
+}
+
+void MainWindow::showSensorValue(int channel, qint32 value)
+{
+    // Units of the sensors reply, temperature 0.01 degC, humidity 0.001 %, pressure Pa
+    switch (channel)
+    {
+    case 0:
+        ui->editTemperature->setText(QString::number(value / 100.0, 'f', 2));
+        break;
+    case 1:
+        ui->editHumidity->setText(QString::number(value / 1000.0, 'f', 2));
+        break;
+    case 2:
+        ui->editPressure->setText(QString::number(value / 100.0, 'f', 2));
+        break;
+    case 3:
+        ui->editTVoc->setText(QString::number(value));
+        break;
+    case 4:
+        ui->editECo2->setText(QString::number(value));
+        break;
+    }
 }
 
 QString MainWindow::wifiStateToString(uint8_t state)
@@ -412,7 +520,20 @@ QString MainWindow::wifiStateToString(uint8_t state)
         "WIFI_ERROR_INITIALIZE",
         "WIFI_ERROR_NETWORK",
         "WIFI_ERROR_MQTT_BROKER",
-        "WIFI_ERROR_MQTT_PUBLISH"
+        "WIFI_ERROR_MQTT_PUBLISH",
+        "WIFI_MQTT_SESSION_CONNECT",
+        "WIFI_MQTT_SESSION_CONNECTING",
+        "WIFI_MQTT_PUBLISH_WAIT_ACK",
+        "WIFI_MQTT_PING",
+        "WIFI_TIME_SYNC",
+        "WIFI_BAUD_NEGOTIATE",
+        "WIFI_BAUD_NEGOTIATING",
+        "WIFI_BAUD_SWITCH",
+        "WIFI_BAUD_VERIFYING",
+        "WIFI_BAUD_REFUSED",
+        "WIFI_ERROR_BAUD",
+        "WIFI_BAUD_RESTORE",
+        "WIFI_BAUD_RESTORING"
     };
 
     Q_ASSERT(state <= wifiStateStrings.count());
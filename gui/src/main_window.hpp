@@ -3,6 +3,8 @@
 
 #include <QMainWindow>
 #include <QSerialPort>
+#include <QMap>
+#include "frame_codec.hpp"
 
 QT_BEGIN_NAMESPACE
 namespace Ui { class MainWindow; }
@@ -35,6 +37,7 @@ private slots:
     void toggleConnection();
     void readConfiguration();
     void readSensors();
+    void toggleStream(bool);
     void configureDevice();
     void loadSerialPorts();
     void readSerialData();
@@ -45,13 +48,19 @@ private:
     Ui::MainWindow *ui;
     QSerialPort *m_serialPort;
     QByteArray m_receivedData;
+    quint8 m_sequence;
+    QMap<quint8, quint8> m_pendingRequests;
+    quint32 m_streamSequence;
 
     void connectDevice();
     void disconnectDevice();
     void fillPortParameters();
     void toggleControls(bool);
     void logMessage(MessageType, QString);
-    void parseReceivedData();
+    void sendFrame(quint8, const QByteArray & = QByteArray());
+    void handleFrame(const FrameCodec::Frame &);
+    void handleStreamRecord(const FrameCodec::Frame &);
+    void showSensorValue(int, qint32);
     QString wifiStateToString(uint8_t);
 };
 